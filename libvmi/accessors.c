@@ -432,6 +432,10 @@ vmi_resume_vm(
         return VMI_FAILURE;
 #endif
 
+    /* the guest may change its pagetables and processes once it runs again */
+    (void) v2p_cache_bump_epoch(vmi);
+    process_index_invalidate(vmi);
+
     return driver_resume_vm(vmi);
 }
 
@@ -659,8 +663,7 @@ vmi_pid_to_dtb(
 
     ret = pid_cache_get(vmi, pid, &_dtb);
     if ( VMI_FAILURE == ret ) {
-        if (vmi->os_interface->os_pid_to_pgd)
-            ret = vmi->os_interface->os_pid_to_pgd(vmi, pid, &_dtb);
+        ret = process_index_pid_to_dtb(vmi, pid, &_dtb);
 
         if ( VMI_SUCCESS == ret )
             pid_cache_set(vmi, pid, _dtb);
@@ -685,8 +688,8 @@ vmi_dtb_to_pid(
         return VMI_FAILURE;
 #endif
 
-    if (vmi->os_interface && vmi->os_interface->os_pgd_to_pid)
-        ret = vmi->os_interface->os_pgd_to_pid(vmi, dtb, &_pid);
+    if (vmi->os_interface)
+        ret = process_index_dtb_to_pid(vmi, dtb, &_pid);
 
     *pid = _pid;
     return ret;
@@ -702,23 +705,44 @@ void* vmi_read_page (vmi_instance_t vmi, addr_t frame_num)
     return driver_read_page(vmi, frame_num);
 }
 
+static bool
+collect_page(
+    page_info_t *info,
+    void *data)
+{
+    GSList **pages = (GSList **) data;
+    page_info_t *p = g_try_malloc(sizeof(page_info_t));
+
+    if ( !p )
+        return false;
+
+    *p = *info;
+    *pages = g_slist_prepend(*pages, p);
+    return true;
+}
+
 GSList* vmi_get_va_pages(vmi_instance_t vmi, addr_t dtb)
 {
+    GSList *pages = NULL;
+
 #ifdef ENABLE_SAFETY_CHECKS
     if (!vmi)
         return NULL;
 
-    if (!vmi->arch_interface.get_pages[vmi->page_mode]) {
+    if (!vmi->arch_interface.walk_pages[vmi->page_mode]) {
         dbprint(VMI_DEBUG_PTLOOKUP, "Invalid or not supported paging mode during get_va_pages\n");
         return NULL;
     }
 #endif
 
-    return vmi->arch_interface.get_pages[vmi->page_mode](vmi, 0, 0, dtb);
+    vmi->arch_interface.walk_pages[vmi->page_mode](vmi, 0, 0, dtb, 0, ~0ull, collect_page, &pages);
+    return pages;
 }
 
 GSList* vmi_get_nested_va_pages(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t pt, page_mode_t pm)
 {
+    GSList *pages = NULL;
+
 #ifdef ENABLE_SAFETY_CHECKS
     if (!vmi)
         return NULL;
@@ -726,13 +750,177 @@ GSList* vmi_get_nested_va_pages(vmi_instance_t vmi, addr_t npt, page_mode_t npm,
     if (valid_npm(npm) && !npt)
         return NULL;
 
-    if (!valid_pm(pm)) {
+    if (!valid_pm(pm) || !vmi->arch_interface.walk_pages[pm]) {
         dbprint(VMI_DEBUG_PTLOOKUP, "Invalid or not supported paging mode during get_va_pages\n");
         return NULL;
     }
 #endif
 
-    return vmi->arch_interface.get_pages[pm](vmi, npt, npm, pt);
+    vmi->arch_interface.walk_pages[pm](vmi, npt, npm, pt, 0, ~0ull, collect_page, &pages);
+    return pages;
+}
+
+/* Access rights of a page, the intersection of the rights at every level */
+static uint32_t
+va_page_perms(
+    page_mode_t pm,
+    const page_info_t *info)
+{
+    addr_t entries[4];
+    unsigned int levels = 0, i;
+    addr_t write_bit = 1ull << 1, user_bit = 1ull << 2, nx_bit = 0;
+    uint32_t perms;
+
+    switch (pm) {
+        case VMI_PM_LEGACY:
+            entries[levels++] = info->x86_legacy.pgd_value;
+            if (VMI_PS_4KB == info->size)
+                entries[levels++] = info->x86_legacy.pte_value;
+            break;
+        case VMI_PM_PAE:
+            /* PDPTEs have no access rights in PAE mode */
+            entries[levels++] = info->x86_pae.pgd_value;
+            if (VMI_PS_4KB == info->size)
+                entries[levels++] = info->x86_pae.pte_value;
+            nx_bit = 1ull << 63;
+            break;
+        case VMI_PM_IA32E:
+        case VMI_PM_EPT_4L:
+            entries[levels++] = info->x86_ia32e.pml4e_value;
+            entries[levels++] = info->x86_ia32e.pdpte_value;
+            if (VMI_PS_1GB != info->size)
+                entries[levels++] = info->x86_ia32e.pgd_value;
+            if (VMI_PS_4KB == info->size)
+                entries[levels++] = info->x86_ia32e.pte_value;
+            nx_bit = 1ull << 63;
+            break;
+        default:
+            return 0;
+    }
+
+    /* EPT entries have R/W/X bits and no notion of user pages */
+    if (VMI_PM_EPT_4L == pm) {
+        perms = VMI_VA_RANGE_WRITE | VMI_VA_RANGE_EXEC;
+        for (i = 0; i < levels; i++) {
+            if (!(entries[i] & (1ull << 1)))
+                perms &= ~VMI_VA_RANGE_WRITE;
+            if (!(entries[i] & (1ull << 2)))
+                perms &= ~VMI_VA_RANGE_EXEC;
+        }
+        return perms;
+    }
+
+    perms = VMI_VA_RANGE_WRITE | VMI_VA_RANGE_USER | VMI_VA_RANGE_EXEC;
+    for (i = 0; i < levels; i++) {
+        if (!(entries[i] & write_bit))
+            perms &= ~VMI_VA_RANGE_WRITE;
+        if (!(entries[i] & user_bit))
+            perms &= ~VMI_VA_RANGE_USER;
+        if (entries[i] & nx_bit)
+            perms &= ~VMI_VA_RANGE_EXEC;
+    }
+
+    return perms;
+}
+
+typedef struct va_walk {
+    vmi_instance_t vmi;
+    page_mode_t pm;
+    bool coalesce;
+    vmi_va_range_cb_t callback;
+    void *data;
+
+    bool pending;           /**< range has not been reported yet */
+    bool stopped;           /**< the callback ended the walk */
+    vmi_va_range_t range;
+    page_info_t info;       /**< first page of range */
+} va_walk_t;
+
+static bool
+va_walk_flush(
+    va_walk_t *walk)
+{
+    if (!walk->pending)
+        return true;
+
+    walk->pending = false;
+    if (!walk->callback(walk->vmi, &walk->range, walk->data))
+        walk->stopped = true;
+
+    return !walk->stopped;
+}
+
+static bool
+va_walk_page(
+    page_info_t *info,
+    void *data)
+{
+    va_walk_t *walk = (va_walk_t *) data;
+    uint32_t perms = va_page_perms(walk->pm, info);
+
+    if (walk->pending &&
+            walk->range.vaddr + walk->range.size == info->vaddr &&
+            walk->range.paddr + walk->range.size == info->paddr &&
+            walk->range.perms == perms) {
+        walk->range.size += info->size;
+        return true;
+    }
+
+    if (!va_walk_flush(walk))
+        return false;
+
+    walk->info = *info;
+    walk->range.vaddr = info->vaddr;
+    walk->range.paddr = info->paddr;
+    walk->range.size = info->size;
+    walk->range.perms = perms;
+    walk->range.info = &walk->info;
+    walk->pending = true;
+
+    return walk->coalesce || va_walk_flush(walk);
+}
+
+status_t
+vmi_walk_va_pages(
+    vmi_instance_t vmi,
+    addr_t npt,
+    page_mode_t npm,
+    addr_t pt,
+    page_mode_t pm,
+    addr_t start,
+    addr_t end,
+    uint32_t flags,
+    vmi_va_range_cb_t callback,
+    void *data)
+{
+    va_walk_t walk = {
+        .vmi = vmi,
+        .pm = pm,
+        .coalesce = !!(flags & VMI_WALK_COALESCE),
+        .callback = callback,
+        .data = data,
+    };
+    status_t ret;
+
+#ifdef ENABLE_SAFETY_CHECKS
+    if (!vmi || !callback || start > end)
+        return VMI_FAILURE;
+
+    if (valid_npm(npm) && !npt)
+        return VMI_FAILURE;
+#endif
+
+    if (!valid_pm(pm) || !vmi->arch_interface.walk_pages[pm]) {
+        dbprint(VMI_DEBUG_PTLOOKUP, "Invalid or not supported paging mode during vmi_walk_va_pages\n");
+        return VMI_FAILURE;
+    }
+
+    ret = vmi->arch_interface.walk_pages[pm](vmi, npt, npm, pt, start, end, va_walk_page, &walk);
+
+    /* the last run, unless the callback stopped the walk */
+    va_walk_flush(&walk);
+
+    return ret;
 }
 
 status_t
@@ -750,7 +938,12 @@ vmi_pagetable_lookup(
     return vmi_pagetable_lookup_cache(vmi, pt, vaddr, paddr);
 }
 
-status_t vmi_nested_pagetable_lookup (
+/*
+ * vmi_nested_pagetable_lookup() that also tells the size of the mapping the
+ * address is in, so callers can skip the lookups for the rest of it. With
+ * nested paging that is the smaller one of the two mappings.
+ */
+status_t vmi_nested_pagetable_lookup_size(
     vmi_instance_t vmi,
     addr_t npt,
     page_mode_t npm,
@@ -758,8 +951,11 @@ status_t vmi_nested_pagetable_lookup (
     page_mode_t pm,
     addr_t vaddr,
     addr_t *paddr,
-    addr_t *naddr)
+    addr_t *naddr,
+    page_size_t *size)
 {
+    page_size_t mapping;
+
 #ifdef ENABLE_SAFETY_CHECKS
     if (!vmi || !paddr)
         return VMI_FAILURE;
@@ -773,38 +969,58 @@ status_t vmi_nested_pagetable_lookup (
     }
 #endif
 
-    /* check if entry exists in the cache */
-    if (VMI_SUCCESS == v2p_cache_get(vmi, vaddr, pt, npt, paddr)) {
-
-        /* verify that address is still valid */
-        uint8_t value = 0;
-        if (VMI_SUCCESS == vmi_read_8_pa(vmi, *paddr, &value)) {
-            if (valid_npm(npm)) {
-                *naddr = *paddr;
-                *paddr = ~0ull;
-            }
-
-            return VMI_SUCCESS;
+    /* check if entry exists in the cache, entries are valid for the current epoch */
+    if (VMI_SUCCESS == v2p_cache_get(vmi, vaddr, pt, npt, paddr, size)) {
+        if (valid_npm(npm)) {
+            *naddr = *paddr;
+            *paddr = ~0ull;
         }
+
+        return VMI_SUCCESS;
     }
 
-    page_info_t info;
+    page_info_t info = { 0 };
 
     if (VMI_FAILURE == vmi->arch_interface.lookup[pm](vmi, npt, npm, pt, vaddr, &info))
         return VMI_FAILURE;
 
     *paddr = info.paddr;
+    mapping = info.size ? info.size : VMI_PS_4KB;
 
     if (valid_npm(npm)) {
         *naddr = info.naddr;
-        v2p_cache_set(vmi, vaddr, pt, npt, info.naddr);
-        return VMI_SUCCESS;
+        /*
+         * The nested mapping may be smaller than the guest one. Lookups that
+         * don't report its size only cover the 4KB frame they translated.
+         */
+        if (!info.nsize)
+            info.nsize = VMI_PS_4KB;
+        if (info.nsize < mapping)
+            mapping = info.nsize;
+        v2p_cache_set(vmi, vaddr, pt, npt, info.naddr, mapping);
+    } else {
+        v2p_cache_set(vmi, vaddr, pt, 0, info.paddr, mapping);
     }
 
-    v2p_cache_set(vmi, vaddr, pt, 0, info.paddr);
+    if (size)
+        *size = mapping;
+
     return VMI_SUCCESS;
 }
 
+status_t vmi_nested_pagetable_lookup (
+    vmi_instance_t vmi,
+    addr_t npt,
+    page_mode_t npm,
+    addr_t pt,
+    page_mode_t pm,
+    addr_t vaddr,
+    addr_t *paddr,
+    addr_t *naddr)
+{
+    return vmi_nested_pagetable_lookup_size(vmi, npt, npm, pt, pm, vaddr, paddr, naddr, NULL);
+}
+
 
 /*
  * Return a status when page_info is not needed, but also use the cache,
@@ -835,19 +1051,9 @@ status_t vmi_pagetable_lookup_cache(
 
     *paddr = 0;
 
-    /* check if entry exists in the cache */
-    if (VMI_SUCCESS == v2p_cache_get(vmi, vaddr, pt, 0, paddr)) {
-
-        /* verify that address is still valid */
-        uint8_t value = 0;
-
-        if (VMI_SUCCESS == vmi_read_8_pa(vmi, *paddr, &value)) {
-            return VMI_SUCCESS;
-        } else {
-            if ( VMI_FAILURE == v2p_cache_del(vmi, vaddr, 0, pt) )
-                return VMI_FAILURE;
-        }
-    }
+    /* check if entry exists in the cache, entries are valid for the current epoch */
+    if (VMI_SUCCESS == v2p_cache_get(vmi, vaddr, pt, 0, paddr, NULL))
+        return VMI_SUCCESS;
 
     if (vmi->arch_interface.lookup[vmi->page_mode]) {
         ret = vmi->arch_interface.lookup[vmi->page_mode](vmi, 0, 0, pt, vaddr, &info);
@@ -859,7 +1065,7 @@ status_t vmi_pagetable_lookup_cache(
     /* add this to the cache */
     if (ret == VMI_SUCCESS) {
         *paddr = info.paddr;
-        v2p_cache_set(vmi, vaddr, pt, 0, info.paddr);
+        v2p_cache_set(vmi, vaddr, pt, 0, info.paddr, info.size);
     }
     return ret;
 }
@@ -894,7 +1100,7 @@ status_t vmi_pagetable_lookup_extended(
 
     /* add this to the cache */
     if (ret == VMI_SUCCESS) {
-        v2p_cache_set(vmi, vaddr, pt, 0, info->paddr);
+        v2p_cache_set(vmi, vaddr, pt, 0, info->paddr, info->size);
     }
     return ret;
 }
@@ -946,6 +1152,9 @@ vmi_translate_uv2p(
         if ( VMI_FAILURE == pid_cache_del(vmi, pid) )
             return VMI_FAILURE;
 
+        /* the process may be gone, or its PID reused */
+        process_index_invalidate(vmi);
+
         ret = vmi_pid_to_dtb(vmi, pid, &dtb);
         if (VMI_SUCCESS == ret) {
             page_info_t info = {0};
@@ -1076,9 +1285,23 @@ vmi_pidcache_flush(
     if (!vmi)
         return;
 
+    process_index_invalidate(vmi);
+
     return pid_cache_flush(vmi);
 }
 
+status_t
+vmi_pidcache_refresh(
+    vmi_instance_t vmi)
+{
+#ifdef ENABLE_SAFETY_CHECKS
+    if (!vmi)
+        return VMI_FAILURE;
+#endif
+
+    return process_index_refresh(vmi);
+}
+
 void
 vmi_symcache_add(
     vmi_instance_t vmi,
@@ -1144,7 +1367,7 @@ vmi_v2pcache_add(
     if (!vmi)
         return;
 
-    return v2p_cache_set(vmi, va, pt, 0, pa);
+    return v2p_cache_set(vmi, va, pt, 0, pa, VMI_PS_4KB);
 }
 
 void
@@ -1158,7 +1381,7 @@ vmi_v2pcache_nested_add(
     if (!vmi)
         return;
 
-    return v2p_cache_set(vmi, va, pt, npt, pa);
+    return v2p_cache_set(vmi, va, pt, npt, pa, VMI_PS_4KB);
 }
 
 void
@@ -1184,6 +1407,18 @@ vmi_v2pcache_nested_flush(
     return v2p_cache_flush(vmi, pt, npt);
 }
 
+uint32_t
+vmi_v2pcache_bump_epoch(
+    vmi_instance_t vmi)
+{
+    if (!vmi)
+        return 0;
+
+    process_index_invalidate(vmi);
+
+    return v2p_cache_bump_epoch(vmi);
+}
+
 void
 vmi_pagecache_flush(
     vmi_instance_t vmi)
@@ -1193,3 +1428,42 @@ vmi_pagecache_flush(
 
     return memory_cache_flush(vmi);
 }
+
+status_t
+vmi_pagecache_set_size(
+    vmi_instance_t vmi,
+    uint32_t size)
+{
+#ifdef ENABLE_SAFETY_CHECKS
+    if (!vmi)
+        return VMI_FAILURE;
+#endif
+
+    return memory_cache_set_size(vmi, size);
+}
+
+status_t
+vmi_pagecache_set_readahead(
+    vmi_instance_t vmi,
+    uint32_t max_pages)
+{
+#ifdef ENABLE_SAFETY_CHECKS
+    if (!vmi)
+        return VMI_FAILURE;
+#endif
+
+    return memory_cache_set_readahead(vmi, max_pages);
+}
+
+status_t
+vmi_set_access_hint(
+    vmi_instance_t vmi,
+    access_hint_t hint)
+{
+#ifdef ENABLE_SAFETY_CHECKS
+    if (!vmi)
+        return VMI_FAILURE;
+#endif
+
+    return driver_set_access_hint(vmi, hint);
+}
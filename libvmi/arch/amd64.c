@@ -32,6 +32,7 @@
 #include "x86.h"
 #include "driver/driver_wrapper.h"
 #include "arch/amd64.h"
+#include "arch/x86_table.h"
 
 /* PML4 Table  */
 static inline
@@ -47,7 +48,8 @@ status_t get_pml4e (vmi_instance_t vmi,
 {
     ctx->addr = (info->pt & VMI_BIT_MASK(12,51)) | get_pml4_index(info->vaddr);
 
-    if (VMI_FAILURE == vmi_read_64(vmi, ctx, &info->x86_ia32e.pml4e_value)) {
+    if (VMI_FAILURE == read_table_entry(vmi, ctx, X86_TABLE_ENTRY_MASK, X86_TABLE_ENTRY,
+                                        &info->x86_ia32e.pml4e_value)) {
         dbprint(VMI_DEBUG_PTLOOKUP, "--PTLookup: error reading pml4e_location = 0x%.16"PRIx64"\n", ctx->addr);
         return VMI_FAILURE;
     }
@@ -72,7 +74,8 @@ status_t get_pdpte_ia32e (vmi_instance_t vmi,
 {
     ctx->addr = (info->x86_ia32e.pml4e_value & VMI_BIT_MASK(12,51)) | get_pdpt_index_ia32e(info->vaddr);
 
-    if (VMI_FAILURE == vmi_read_64(vmi, ctx, &info->x86_ia32e.pdpte_value)) {
+    if (VMI_FAILURE == read_table_entry(vmi, ctx, X86_TABLE_ENTRY_MASK, X86_TABLE_ENTRY,
+                                        &info->x86_ia32e.pdpte_value)) {
         dbprint(VMI_DEBUG_PTLOOKUP, "--PTLookup: failed to read pdpte_location = 0x%.16"PRIx64"\n", ctx->addr);
         return VMI_FAILURE;
     }
@@ -97,7 +100,8 @@ status_t get_pde_ia32e (vmi_instance_t vmi,
 {
     ctx->addr = (info->x86_ia32e.pdpte_value & VMI_BIT_MASK(12,51)) | get_pd_index_ia32e(info->vaddr);
 
-    if (VMI_FAILURE == vmi_read_64(vmi, ctx, &info->x86_ia32e.pgd_value)) {
+    if (VMI_FAILURE == read_table_entry(vmi, ctx, X86_TABLE_ENTRY_MASK, X86_TABLE_ENTRY,
+                                        &info->x86_ia32e.pgd_value)) {
         dbprint(VMI_DEBUG_PTLOOKUP, "--PTLookup: failed to read pde_location = 0x%.16"PRIx64"\n", ctx->addr);
         return VMI_FAILURE;
     }
@@ -123,7 +127,7 @@ status_t get_pte_ia32e (vmi_instance_t vmi,
 {
     ctx->addr = (info->x86_ia32e.pgd_value & VMI_BIT_MASK(12,51)) | get_pt_index_ia32e(info->vaddr);
 
-    if (VMI_FAILURE == vmi_read_64(vmi, ctx, &info->x86_ia32e.pte_value)) {
+    if (VMI_FAILURE == x86_read_pte_group(vmi, ctx, info->pt, info->vaddr, &info->x86_ia32e.pte_value)) {
         dbprint(VMI_DEBUG_PTLOOKUP, "--PTLookup: failed to read pte_location = 0x%.16"PRIx64"\n", ctx->addr);
         return VMI_FAILURE;
     }
@@ -235,148 +239,172 @@ status_t v2p_ia32e (vmi_instance_t vmi,
 done:
     dbprint(VMI_DEBUG_PTLOOKUP, "--PTLookup: paddr = 0x%.16"PRIx64"\n", info->paddr);
 
-    if (valid_npm(npm) && VMI_FAILURE == vmi_nested_pagetable_lookup(vmi, 0, 0, npt, npm, info->paddr, &info->naddr, NULL) )
+    if (valid_npm(npm) && VMI_FAILURE == vmi_nested_pagetable_lookup_size(vmi, 0, 0, npt, npm, info->paddr, &info->naddr, NULL, &info->nsize) )
         return VMI_FAILURE;
 
     return status;
 }
 
-GSList* get_pages_ia32e(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t dtb)
+status_t walk_pages_ia32e(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t dtb,
+                          addr_t start, addr_t end, arch_page_cb_t cb, void *data)
 {
 
-    GSList *ret = NULL;
+    status_t ret = VMI_FAILURE;
     uint8_t entry_size = 0x8;
+    bool transition_pages = vmi->x86.transition_pages;
+    page_info_t info;
 
-#define IA32E_ENTRIES_PER_PAGE 0x200 // 0x1000/0x8
-
-    uint64_t *pml4_page = g_malloc(VMI_PS_4KB);
+    uint64_t *pml4_page = g_try_malloc0(VMI_PS_4KB);
     uint64_t *pdpt_page = g_try_malloc0(VMI_PS_4KB);
     uint64_t *pgd_page = g_try_malloc0(VMI_PS_4KB);
     uint64_t *pt_page = g_try_malloc0(VMI_PS_4KB);
+    x86_table_masks_t pml4_masks, pdpt_masks, pgd_masks, pt_masks;
 
     if ( !pml4_page || !pdpt_page || !pgd_page || !pt_page )
         goto done;
 
-    addr_t pml4e_location = dtb & VMI_BIT_MASK(12,51);
+    addr_t pml4_base = dtb & VMI_BIT_MASK(12,51);
 
     ACCESS_CONTEXT(ctx,
                    .npt = npt,
                    .npm = npm);
 
-    ctx.addr = pml4e_location;
+    ctx.addr = pml4_base;
     if (VMI_FAILURE == vmi_read(vmi, &ctx, VMI_PS_4KB, pml4_page, NULL))
         goto done;
 
-    uint64_t pml4e_index;
-    for (pml4e_index = 0; pml4e_index < IA32E_ENTRIES_PER_PAGE; pml4e_index++, pml4e_location += entry_size) {
+    /* only the present entries of each table are visited */
+    x86_table_scan(pml4_page, transition_pages, 0, &pml4_masks);
 
-        uint64_t pml4e_value = pml4_page[pml4e_index];
+    int pml4e_index;
+    for (pml4e_index = x86_table_next(pml4_masks.present, 0); pml4e_index >= 0;
+            pml4e_index = x86_table_next(pml4_masks.present, pml4e_index + 1)) {
 
-        if (!ENTRY_PRESENT(vmi->x86.transition_pages, pml4e_value)) {
+        addr_t pml4e_va = canonical_addr((addr_t) pml4e_index << 39);
+        if (!va_span_overlaps(pml4e_va, 1ull << 39, start, end))
             continue;
-        }
 
-        uint64_t pdpte_location = pml4e_value & VMI_BIT_MASK(12,51);
+        uint64_t pml4e_location = pml4_base + pml4e_index * entry_size;
+        uint64_t pml4e_value = pml4_page[pml4e_index];
+        uint64_t pdpt_base = pml4e_value & VMI_BIT_MASK(12,51);
 
-        ctx.addr = pdpte_location;
+        ctx.addr = pdpt_base;
         if (VMI_FAILURE == vmi_read(vmi, &ctx, VMI_PS_4KB, pdpt_page, NULL))
             goto done;
 
-        uint64_t pdpte_index;
-        for (pdpte_index = 0; pdpte_index < IA32E_ENTRIES_PER_PAGE; pdpte_index++, pdpte_location++) {
+        x86_table_scan(pdpt_page, transition_pages, 0, &pdpt_masks);
 
-            uint64_t pdpte_value = pdpt_page[pdpte_index];
+        int pdpte_index;
+        for (pdpte_index = x86_table_next(pdpt_masks.present, 0); pdpte_index >= 0;
+                pdpte_index = x86_table_next(pdpt_masks.present, pdpte_index + 1)) {
 
-            if (!ENTRY_PRESENT(vmi->x86.transition_pages, pdpte_value)) {
+            addr_t pdpte_va = pml4e_va | ((addr_t) pdpte_index << 30);
+            if (!va_span_overlaps(pdpte_va, VMI_PS_1GB, start, end))
                 continue;
-            }
 
-            if (PAGE_SIZE(pdpte_value)) {
-                page_info_t *info = g_try_malloc0(sizeof(page_info_t));
-                if ( !info )
-                    goto done;
+            uint64_t pdpte_location = pdpt_base + pdpte_index * entry_size;
+            uint64_t pdpte_value = pdpt_page[pdpte_index];
 
-                info->vaddr = canonical_addr((pml4e_index << 39) | (pdpte_index << 30));
-                info->pt = dtb;
-                info->paddr = get_gigpage_ia32e(info->vaddr, pdpte_value);
-                info->size = VMI_PS_1GB;
-                info->x86_ia32e.pml4e_location = pml4e_location;
-                info->x86_ia32e.pml4e_value = pml4e_value;
-                info->x86_ia32e.pdpte_location = pdpte_location;
-                info->x86_ia32e.pdpte_value = pdpte_value;
-                ret = g_slist_prepend(ret, info);
+            if (x86_table_test(pdpt_masks.large, pdpte_index)) {
+                info = (page_info_t) {
+                    .vaddr = pdpte_va,
+                    .pt = dtb,
+                    .paddr = get_gigpage_ia32e(pdpte_va, pdpte_value),
+                    .size = VMI_PS_1GB,
+                    .x86_ia32e = {
+                        .pml4e_location = pml4e_location,
+                        .pml4e_value = pml4e_value,
+                        .pdpte_location = pdpte_location,
+                        .pdpte_value = pdpte_value,
+                    },
+                };
+                if (!cb(&info, data))
+                    goto stop;
                 continue;
             }
 
-            uint64_t pgd_location = pdpte_value & VMI_BIT_MASK(12,51);
+            uint64_t pgd_base = pdpte_value & VMI_BIT_MASK(12,51);
 
-            ctx.addr = pgd_location;
+            ctx.addr = pgd_base;
             if (VMI_FAILURE == vmi_read(vmi, &ctx, VMI_PS_4KB, pgd_page, NULL))
                 goto done;
 
-            uint64_t pgde_index;
-            for (pgde_index = 0; pgde_index < IA32E_ENTRIES_PER_PAGE; pgde_index++, pgd_location += entry_size) {
+            x86_table_scan(pgd_page, transition_pages, 0, &pgd_masks);
+
+            int pgde_index;
+            for (pgde_index = x86_table_next(pgd_masks.present, 0); pgde_index >= 0;
+                    pgde_index = x86_table_next(pgd_masks.present, pgde_index + 1)) {
 
+                addr_t pgde_va = pdpte_va | ((addr_t) pgde_index << 21);
+                if (!va_span_overlaps(pgde_va, VMI_PS_2MB, start, end))
+                    continue;
+
+                uint64_t pgd_location = pgd_base + pgde_index * entry_size;
                 uint64_t pgd_value = pgd_page[pgde_index];
 
-                if (ENTRY_PRESENT(vmi->os_type, pgd_value)) {
-
-                    if (PAGE_SIZE(pgd_value)) {
-                        page_info_t *info = g_try_malloc0(sizeof(page_info_t));
-                        if ( !info )
-                            goto done;
-
-                        info->vaddr = canonical_addr((pml4e_index << 39) | (pdpte_index << 30) |
-                                                     (pgde_index << 21));
-                        info->pt = dtb;
-                        info->paddr = get_2megpage_ia32e(info->vaddr, pgd_value);
-                        info->size = VMI_PS_2MB;
-                        info->x86_ia32e.pml4e_location = pml4e_location;
-                        info->x86_ia32e.pml4e_value = pml4e_value;
-                        info->x86_ia32e.pdpte_location = pdpte_location;
-                        info->x86_ia32e.pdpte_value = pdpte_value;
-                        info->x86_ia32e.pgd_location = pgd_location;
-                        info->x86_ia32e.pgd_value = pgd_value;
-                        ret = g_slist_prepend(ret, info);
+                if (x86_table_test(pgd_masks.large, pgde_index)) {
+                    info = (page_info_t) {
+                        .vaddr = pgde_va,
+                        .pt = dtb,
+                        .paddr = get_2megpage_ia32e(pgde_va, pgd_value),
+                        .size = VMI_PS_2MB,
+                        .x86_ia32e = {
+                            .pml4e_location = pml4e_location,
+                            .pml4e_value = pml4e_value,
+                            .pdpte_location = pdpte_location,
+                            .pdpte_value = pdpte_value,
+                            .pgd_location = pgd_location,
+                            .pgd_value = pgd_value,
+                        },
+                    };
+                    if (!cb(&info, data))
+                        goto stop;
+                    continue;
+                }
+
+                uint64_t pt_base = (pgd_value & VMI_BIT_MASK(12,51));
+                ctx.addr = pt_base;
+                if (VMI_FAILURE == vmi_read(vmi, &ctx, VMI_PS_4KB, pt_page, NULL))
+                    goto done;
+
+                x86_table_scan(pt_page, transition_pages, 0, &pt_masks);
+
+                int pte_index;
+                for (pte_index = x86_table_next(pt_masks.present, 0); pte_index >= 0;
+                        pte_index = x86_table_next(pt_masks.present, pte_index + 1)) {
+
+                    addr_t pte_va = pgde_va | ((addr_t) pte_index << 12);
+                    if (!va_span_overlaps(pte_va, VMI_PS_4KB, start, end))
                         continue;
-                    }
-
-                    uint64_t pte_location = (pgd_value & VMI_BIT_MASK(12,51));
-                    ctx.addr = pte_location;
-                    if (VMI_FAILURE == vmi_read(vmi, &ctx, VMI_PS_4KB, pt_page, NULL))
-                        goto done;
-
-                    uint64_t pte_index;
-                    for (pte_index = 0; pte_index < IA32E_ENTRIES_PER_PAGE; pte_index++, pte_location += entry_size) {
-                        uint64_t pte_value = pt_page[pte_index];
-
-                        if (ENTRY_PRESENT(vmi->os_type, pte_value)) {
-                            page_info_t *info = g_try_malloc0(sizeof(page_info_t));
-                            if ( !info )
-                                goto done;
-
-                            info->vaddr = canonical_addr((pml4e_index << 39) | (pdpte_index << 30) |
-                                                         (pgde_index << 21) | (pte_index << 12));
-                            info->pt = dtb;
-                            info->paddr = get_paddr_ia32e(info->vaddr, pte_value);
-                            info->size = VMI_PS_4KB;
-                            info->x86_ia32e.pml4e_location = pml4e_location;
-                            info->x86_ia32e.pml4e_value = pml4e_value;
-                            info->x86_ia32e.pdpte_location = pdpte_location;
-                            info->x86_ia32e.pdpte_value = pdpte_value;
-                            info->x86_ia32e.pgd_location = pgd_location;
-                            info->x86_ia32e.pgd_value = pgd_value;
-                            info->x86_ia32e.pte_location = pte_location;
-                            info->x86_ia32e.pte_value = pte_value;
-                            ret = g_slist_prepend(ret, info);
-                            continue;
-                        }
-                    }
+
+                    uint64_t pte_value = pt_page[pte_index];
+
+                    info = (page_info_t) {
+                        .vaddr = pte_va,
+                        .pt = dtb,
+                        .paddr = get_paddr_ia32e(pte_va, pte_value),
+                        .size = VMI_PS_4KB,
+                        .x86_ia32e = {
+                            .pml4e_location = pml4e_location,
+                            .pml4e_value = pml4e_value,
+                            .pdpte_location = pdpte_location,
+                            .pdpte_value = pdpte_value,
+                            .pgd_location = pgd_location,
+                            .pgd_value = pgd_value,
+                            .pte_location = pt_base + pte_index * entry_size,
+                            .pte_value = pte_value,
+                        },
+                    };
+                    if (!cb(&info, data))
+                        goto stop;
                 }
             }
         }
     }
 
+stop:
+    ret = VMI_SUCCESS;
+
 done:
     g_free(pt_page);
     g_free(pgd_page);
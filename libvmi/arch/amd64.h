@@ -28,6 +28,7 @@
 #include "private.h"
 
 status_t v2p_ia32e (vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t pt, addr_t vaddr, page_info_t *info);
-GSList* get_pages_ia32e(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t dtb);
+status_t walk_pages_ia32e(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t pt,
+                          addr_t start, addr_t end, arch_page_cb_t cb, void *data);
 
 #endif
@@ -29,6 +29,31 @@
 #include "arch/arm_aarch64.h"
 #include "arch/ept.h"
 
+status_t read_table_entry(vmi_instance_t vmi, const access_context_t *ctx,
+                          uint64_t mask, uint64_t table, uint64_t *value)
+{
+#ifdef ENABLE_ADDRESS_CACHE
+    addr_t npt = valid_npm(ctx->npm) ? ctx->npt : 0;
+
+    if (VMI_SUCCESS == pt_cache_get(vmi, npt, ctx->addr, value))
+        return VMI_SUCCESS;
+
+    stats_inc(vmi, page_walk_reads);
+    if (VMI_FAILURE == vmi_read_64(vmi, ctx, value))
+        return VMI_FAILURE;
+
+    if ((*value & mask) == table)
+        pt_cache_set(vmi, npt, ctx->addr, *value);
+
+    return VMI_SUCCESS;
+#else
+    (void) mask;
+    (void) table;
+    stats_inc(vmi, page_walk_reads);
+    return vmi_read_64(vmi, ctx, value);
+#endif
+}
+
 /*
  * check that this vm uses a paging method that we support
  * and set pm/cr3/pae/pse/lme flags optionally on the given pointers
@@ -223,10 +248,10 @@ void arch_init_lookup_tables(vmi_instance_t vmi)
     vmi->arch_interface.lookup[VMI_PM_AARCH64] = v2p_aarch64;
     vmi->arch_interface.lookup[VMI_PM_EPT_4L] = v2p_ept_4l;
 
-    vmi->arch_interface.get_pages[VMI_PM_LEGACY] = get_pages_nopae;
-    vmi->arch_interface.get_pages[VMI_PM_PAE] = get_pages_pae;
-    vmi->arch_interface.get_pages[VMI_PM_IA32E] = get_pages_ia32e;
-    vmi->arch_interface.get_pages[VMI_PM_EPT_4L] = get_pages_ept_4l;
+    vmi->arch_interface.walk_pages[VMI_PM_LEGACY] = walk_pages_nopae;
+    vmi->arch_interface.walk_pages[VMI_PM_PAE] = walk_pages_pae;
+    vmi->arch_interface.walk_pages[VMI_PM_IA32E] = walk_pages_ia32e;
+    vmi->arch_interface.walk_pages[VMI_PM_EPT_4L] = walk_pages_ept_4l;
 }
 
 status_t arch_init(vmi_instance_t vmi)
@@ -234,7 +259,8 @@ status_t arch_init(vmi_instance_t vmi)
     if (vmi->page_mode != VMI_PM_UNKNOWN)
         return VMI_SUCCESS;
 
-    if (VMI_FAILURE == get_vcpu_page_mode(vmi, 0, &vmi->page_mode))
+    /* without out_pm the PSE bit and the AArch64 TCR_EL1 fields get recorded too */
+    if (VMI_FAILURE == get_vcpu_page_mode(vmi, 0, NULL))
         return VMI_FAILURE;
 
     return VMI_SUCCESS;
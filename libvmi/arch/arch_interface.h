@@ -30,15 +30,30 @@ typedef status_t (*arch_lookup_t)
  addr_t pt,
  addr_t addr,
  page_info_t *info);
-typedef GSList* (*arch_get_pages_t)
+
+/* Called for each mapped page, returns false to stop the walk */
+typedef bool (*arch_page_cb_t)
+(page_info_t *info,
+ void *data);
+
+/*
+ * Walks the pages mapped in [start, end] in ascending VA order. Pages that
+ * overlap the range are reported whole. Returns VMI_FAILURE if a table could
+ * not be read, after reporting the pages that could.
+ */
+typedef status_t (*arch_walk_pages_t)
 (vmi_instance_t vmi,
  addr_t npt,
  page_mode_t npm,
- addr_t dtb);
+ addr_t pt,
+ addr_t start,
+ addr_t end,
+ arch_page_cb_t cb,
+ void *data);
 
 typedef struct arch_interface {
     arch_lookup_t lookup[VMI_PM_EPT_5L + 1];
-    arch_get_pages_t get_pages[VMI_PM_EPT_5L + 1];
+    arch_walk_pages_t walk_pages[VMI_PM_EPT_5L + 1];
 } arch_interface_t;
 
 status_t get_vcpu_page_mode(vmi_instance_t vmi, unsigned long vcpu, page_mode_t *out_pm);
@@ -54,6 +69,20 @@ static inline bool valid_pm(page_mode_t pm)
     return pm >= VMI_PM_LEGACY && pm < VMI_PM_EPT_5L;
 }
 
+/*
+ * Reads a 64-bit paging-structure entry through the paging-structure cache.
+ * Entries with (value & mask) == table, the ones that point to the next
+ * table, are cached; leaves are left to the v2p cache.
+ */
+status_t read_table_entry(vmi_instance_t vmi, const access_context_t *ctx,
+                          uint64_t mask, uint64_t table, uint64_t *value);
+
+/* Whether the size bytes at base overlap [start, end] */
+static inline bool va_span_overlaps(addr_t base, addr_t size, addr_t start, addr_t end)
+{
+    return base <= end && base + (size - 1) >= start;
+}
+
 static inline
 page_mode_t get_page_mode_x86(reg_t cr0, reg_t cr4, reg_t efer)
 {
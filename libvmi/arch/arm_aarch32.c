@@ -40,6 +40,7 @@ void get_first_level_descriptor(vmi_instance_t vmi, uint32_t dtb, uint32_t vaddr
 {
     info->arm_aarch32.fld_location = (dtb & VMI_BIT_MASK(14,31)) | (first_level_table_index(vaddr) << 2);
     uint32_t fld_v;
+    stats_inc(vmi, page_walk_reads);
     if (VMI_SUCCESS == vmi_read_32_pa(vmi, info->arm_aarch32.fld_location, &fld_v)) {
         info->arm_aarch32.fld_value = fld_v;
     }
@@ -58,6 +59,7 @@ void get_coarse_second_level_descriptor(vmi_instance_t vmi, uint32_t vaddr, page
 {
     info->arm_aarch32.sld_location = (info->arm_aarch32.fld_value & VMI_BIT_MASK(10,31)) | (coarse_second_level_table_index(vaddr) << 2);
     uint32_t sld_v;
+    stats_inc(vmi, page_walk_reads);
     if (VMI_SUCCESS == vmi_read_32_pa(vmi, info->arm_aarch32.sld_location, &sld_v)) {
         info->arm_aarch32.sld_value = sld_v;
     }
@@ -76,6 +78,7 @@ void get_fine_second_level_descriptor(vmi_instance_t vmi, uint32_t vaddr, page_i
 {
     info->arm_aarch32.sld_location = (info->arm_aarch32.fld_value & VMI_BIT_MASK(12,31)) | (fine_second_level_table_index(vaddr) << 2);
     uint32_t sld_v;
+    stats_inc(vmi, page_walk_reads);
     if (VMI_SUCCESS == vmi_read_32_pa(vmi, info->arm_aarch32.sld_location, &sld_v)) {
         info->arm_aarch32.sld_value = sld_v;
     }
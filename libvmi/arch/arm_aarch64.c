@@ -28,6 +28,15 @@
 #include "driver/driver_wrapper.h"
 #include "arch/arm_aarch64.h"
 
+// Level 0-2 descriptor, cached if it is a table descriptor (0b11)
+static inline
+status_t read_table_descriptor(vmi_instance_t vmi, addr_t location, uint64_t *value)
+{
+    ACCESS_CONTEXT(ctx, .addr = location);
+
+    return read_table_entry(vmi, &ctx, VMI_BIT_MASK(0,1), VMI_BIT_MASK(0,1), value);
+}
+
 // 0th Level Page Table Index (4kb Pages)
 static inline
 uint64_t zero_level_4kb_table_index(uint64_t vaddr)
@@ -41,7 +50,7 @@ void get_zero_level_4kb_descriptor(vmi_instance_t vmi, uint64_t dtb, uint64_t va
 {
     info->arm_aarch64.zld_location = (dtb & VMI_BIT_MASK(12,47)) | (zero_level_4kb_table_index(vaddr) << 3);
     uint64_t zld_v;
-    if (VMI_SUCCESS == vmi_read_64_pa(vmi, info->arm_aarch64.zld_location, &zld_v)) {
+    if (VMI_SUCCESS == read_table_descriptor(vmi, info->arm_aarch64.zld_location, &zld_v)) {
         info->arm_aarch64.zld_value = zld_v;
     }
 }
@@ -59,7 +68,7 @@ void get_first_level_4kb_descriptor(vmi_instance_t vmi, uint64_t dtb, uint64_t v
 {
     info->arm_aarch64.fld_location = (dtb & VMI_BIT_MASK(12,47)) | (first_level_4kb_table_index(vaddr) << 3);
     uint64_t fld_v;
-    if (VMI_SUCCESS == vmi_read_64_pa(vmi, info->arm_aarch64.fld_location, &fld_v)) {
+    if (VMI_SUCCESS == read_table_descriptor(vmi, info->arm_aarch64.fld_location, &fld_v)) {
         info->arm_aarch64.fld_value = fld_v;
     }
 }
@@ -77,7 +86,7 @@ void get_first_level_64kb_descriptor(vmi_instance_t vmi, uint64_t dtb, uint64_t
 {
     info->arm_aarch64.fld_location = (dtb & VMI_BIT_MASK(9,47)) | (first_level_64kb_table_index(vaddr) << 3);
     uint64_t fld_v;
-    if (VMI_SUCCESS == vmi_read_64_pa(vmi, info->arm_aarch64.fld_location, &fld_v)) {
+    if (VMI_SUCCESS == read_table_descriptor(vmi, info->arm_aarch64.fld_location, &fld_v)) {
         info->arm_aarch64.fld_value = fld_v;
     }
 }
@@ -95,7 +104,7 @@ void get_second_level_4kb_descriptor(vmi_instance_t vmi, uint64_t dtb, uint64_t
 {
     info->arm_aarch64.sld_location = (dtb & VMI_BIT_MASK(12,47)) | (second_level_4kb_table_index(vaddr) << 3);
     uint64_t sld_v;
-    if (VMI_SUCCESS == vmi_read_64_pa(vmi, info->arm_aarch64.sld_location, &sld_v)) {
+    if (VMI_SUCCESS == read_table_descriptor(vmi, info->arm_aarch64.sld_location, &sld_v)) {
         info->arm_aarch64.sld_value = sld_v;
     }
 }
@@ -113,7 +122,7 @@ void get_second_level_64kb_descriptor(vmi_instance_t vmi, uint64_t dtb, uint64_t
 {
     info->arm_aarch64.sld_location = (dtb & VMI_BIT_MASK(16,47)) | (second_level_64kb_table_index(vaddr) << 3);
     uint64_t sld_v;
-    if (VMI_SUCCESS == vmi_read_64_pa(vmi, info->arm_aarch64.sld_location, &sld_v)) {
+    if (VMI_SUCCESS == read_table_descriptor(vmi, info->arm_aarch64.sld_location, &sld_v)) {
         info->arm_aarch64.sld_value = sld_v;
     }
 }
@@ -131,6 +140,7 @@ void get_third_level_4kb_descriptor(vmi_instance_t vmi, uint64_t vaddr, page_inf
 {
     info->arm_aarch64.tld_location = (info->arm_aarch64.sld_value & VMI_BIT_MASK(12,47)) | (third_level_4kb_table_index(vaddr) << 3);
     uint64_t tld_v;
+    stats_inc(vmi, page_walk_reads);
     if (VMI_SUCCESS == vmi_read_64_pa(vmi, info->arm_aarch64.tld_location, &tld_v)) {
         info->arm_aarch64.tld_value = tld_v;
     }
@@ -149,6 +159,7 @@ void get_third_level_64kb_descriptor(vmi_instance_t vmi, uint64_t vaddr, page_in
 {
     info->arm_aarch64.tld_location = (info->arm_aarch64.sld_value & VMI_BIT_MASK(16,47)) | (third_level_64kb_table_index(vaddr) << 3);
     uint64_t tld_v;
+    stats_inc(vmi, page_walk_reads);
     if (VMI_SUCCESS == vmi_read_64_pa(vmi, info->arm_aarch64.tld_location, &tld_v)) {
         info->arm_aarch64.tld_value = tld_v;
     }
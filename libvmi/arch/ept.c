@@ -25,7 +25,8 @@ status_t v2p_ept_4l (vmi_instance_t vmi, addr_t UNUSED(npt), page_mode_t UNUSED(
     return vmi->arch_interface.lookup[VMI_PM_IA32E](vmi, 0, 0, pt, vaddr, info);
 }
 
-GSList* get_pages_ept_4l(vmi_instance_t vmi, addr_t UNUSED(npt), page_mode_t UNUSED(npm), addr_t pt)
+status_t walk_pages_ept_4l(vmi_instance_t vmi, addr_t UNUSED(npt), page_mode_t UNUSED(npm), addr_t pt,
+                           addr_t start, addr_t end, arch_page_cb_t cb, void *data)
 {
-    return vmi->arch_interface.get_pages[VMI_PM_IA32E](vmi, 0, 0, pt);
+    return vmi->arch_interface.walk_pages[VMI_PM_IA32E](vmi, 0, 0, pt, start, end, cb, data);
 }
@@ -32,6 +32,7 @@
 #include "x86.h"
 #include "driver/driver_wrapper.h"
 #include "arch/intel.h"
+#include "arch/x86_table.h"
 
 /* page directory pointer table */
 static inline
@@ -53,7 +54,8 @@ status_t get_pdpi (vmi_instance_t instance,
 {
     ctx->addr = get_pdptb(info->pt) + pdpi_index(info->vaddr);
 
-    if (VMI_FAILURE == vmi_read_64(instance, ctx, &info->x86_pae.pdpe_value)) {
+    /* PAE PDPTEs have no page size bit */
+    if (VMI_FAILURE == read_table_entry(instance, ctx, 1ull, 1ull, &info->x86_pae.pdpe_value)) {
         dbprint(VMI_DEBUG_PTLOOKUP, "--PTLookup: failed to read pdpi_location = 0x%.16"PRIx64"\n", ctx->addr);
         return VMI_FAILURE;
     }
@@ -101,6 +103,7 @@ status_t get_pgd_nopae (vmi_instance_t instance,
     ctx->addr = pdba_base_nopae(ctx->pt) + pgd_index_nopae(info->vaddr);
     info->x86_legacy.pgd_value = 0;
 
+    stats_inc(instance, page_walk_reads);
     if (VMI_FAILURE == vmi_read_32(instance, ctx, (uint32_t*)&info->x86_legacy.pgd_value)) {
         dbprint(VMI_DEBUG_PTLOOKUP, "--PTLookup: failed to read pgd_location at = 0x%.8"PRIx64"\n", ctx->addr);
         return VMI_FAILURE;
@@ -120,7 +123,8 @@ status_t get_pgd_pae (vmi_instance_t instance,
 {
     ctx->addr = pdba_base_pae(info->x86_pae.pdpe_value) + pgd_index_pae(info->vaddr);
 
-    if (VMI_FAILURE == vmi_read_64(instance, ctx, &info->x86_pae.pgd_value)) {
+    if (VMI_FAILURE == read_table_entry(instance, ctx, X86_TABLE_ENTRY_MASK, X86_TABLE_ENTRY,
+                                        &info->x86_pae.pgd_value)) {
         dbprint(VMI_DEBUG_PTLOOKUP, "--PTLookup: failed to read pgd_entry = 0x%.8"PRIx64"\n", ctx->addr);
         return VMI_FAILURE;
     }
@@ -165,6 +169,7 @@ status_t get_pte_nopae (vmi_instance_t instance,
     ctx->addr = ptba_base_nopae(info->x86_legacy.pgd_value) + pte_index_nopae(info->vaddr);
     info->x86_legacy.pte_value = 0;
 
+    stats_inc(instance, page_walk_reads);
     if (VMI_FAILURE == vmi_read_32(instance, ctx, (uint32_t*)&info->x86_legacy.pte_value)) {
         dbprint(VMI_DEBUG_PTLOOKUP, "--PTLookup: failed to read pte_entry = 0x%.8"PRIx64"\n", ctx->addr);
         return VMI_FAILURE;
@@ -184,7 +189,7 @@ status_t get_pte_pae (vmi_instance_t instance,
 {
     ctx->addr = ptba_base_pae(info->x86_pae.pgd_value) + pte_index_pae(info->vaddr);
 
-    if (VMI_FAILURE == vmi_read_64(instance, ctx, &info->x86_pae.pte_value)) {
+    if (VMI_FAILURE == x86_read_pte_group(instance, ctx, info->pt, info->vaddr, &info->x86_pae.pte_value)) {
         dbprint(VMI_DEBUG_PTLOOKUP, "--PTLookup: failed to read pte_entry = 0x%.8"PRIx64"\n", ctx->addr);
         return VMI_FAILURE;
     }
@@ -339,7 +344,7 @@ done:
     dbprint(VMI_DEBUG_PTLOOKUP, "--PTLookup: paddr = 0x%.16"PRIx64"\n", info->paddr);
 
     if (valid_npm(npm)) {
-        if ( VMI_FAILURE == vmi_nested_pagetable_lookup(vmi, 0, 0, npt, npm, info->paddr, &info->naddr, NULL) )
+        if ( VMI_FAILURE == vmi_nested_pagetable_lookup_size(vmi, 0, 0, npt, npm, info->paddr, &info->naddr, NULL, &info->nsize) )
             return VMI_FAILURE;
 
         dbprint(VMI_DEBUG_PTLOOKUP, "--PTLookup: naddr = 0x%.16"PRIx64"\n", info->naddr);
@@ -415,7 +420,7 @@ done:
     dbprint(VMI_DEBUG_PTLOOKUP, "--PTLookup: paddr = 0x%.16"PRIx64"\n", info->paddr);
 
     if (valid_npm(npm)) {
-        if (VMI_FAILURE == vmi_nested_pagetable_lookup(vmi, 0, 0, npt, npm, info->paddr, &info->naddr, NULL) )
+        if (VMI_FAILURE == vmi_nested_pagetable_lookup_size(vmi, 0, 0, npt, npm, info->paddr, &info->naddr, NULL, &info->nsize) )
             return VMI_FAILURE;
 
         dbprint(VMI_DEBUG_PTLOOKUP, "--PTLookup: naddr = 0x%.16"PRIx64"\n", info->naddr);
@@ -424,13 +429,15 @@ done:
     return status;
 }
 
-GSList* get_pages_nopae(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t dtb)
+status_t walk_pages_nopae(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t dtb,
+                          addr_t start, addr_t end, arch_page_cb_t cb, void *data)
 {
 
     addr_t pgd_location = dtb;
     uint8_t entry_size = 0x4;
-
-    GSList *ret = NULL;
+    bool transition_pages = vmi->x86.transition_pages;
+    status_t ret = VMI_FAILURE;
+    page_info_t info;
 
     uint32_t *pgd_page = g_try_malloc0(VMI_PS_4KB);
     uint32_t *pt_page = g_try_malloc0(entry_size * PTRS_PER_NOPAE_PGD);
@@ -439,6 +446,9 @@ GSList* get_pages_nopae(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t
                    .npt = npt,
                    .npm = npm);
 
+    if ( !pgd_page || !pt_page )
+        goto done;
+
     ctx.addr = dtb;
     if ( VMI_FAILURE == vmi_read(vmi, &ctx, VMI_PS_4KB, pgd_page, NULL)) {
         goto done;
@@ -450,52 +460,61 @@ GSList* get_pages_nopae(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t
 
         uint32_t pgd_entry = pgd_page[pgd_index];
 
-        if (ENTRY_PRESENT(vmi->os_type, pgd_entry)) {
+        if (!ENTRY_PRESENT(transition_pages, pgd_entry) ||
+                !va_span_overlaps(pgd_base_vaddr, VMI_PS_4MB, start, end))
+            continue;
 
-            if (PAGE_SIZE(pgd_entry) && (VMI_FILE == vmi->mode || vmi->x86.pse)) {
-                page_info_t *p = g_try_malloc0(sizeof(page_info_t));
-                if ( !p )
-                    goto done;
+        if (PAGE_SIZE(pgd_entry) && (VMI_FILE == vmi->mode || vmi->x86.pse)) {
+            info = (page_info_t) {
+                .vaddr = pgd_base_vaddr,
+                .pt = dtb,
+                .paddr = get_large_paddr_nopae(pgd_base_vaddr, pgd_entry),
+                .size = VMI_PS_4MB,
+                .x86_legacy = {
+                    .pgd_location = pgd_location,
+                    .pgd_value = pgd_entry,
+                },
+            };
+            if (!cb(&info, data))
+                goto stop;
+            continue;
+        }
 
-                p->vaddr = pgd_base_vaddr;
-                p->pt = dtb;
-                p->paddr = get_large_paddr_nopae(p->vaddr, pgd_base_vaddr);
-                p->size = VMI_PS_4MB;
-                p->x86_legacy.pgd_location = pgd_location;
-                p->x86_legacy.pgd_value = pgd_entry;
-                ret = g_slist_prepend(ret, p);
-                continue;
-            }
+        uint32_t pte_location = ptba_base_nopae(pgd_entry);
 
-            uint32_t pte_location = ptba_base_nopae(pgd_entry);
+        ctx.addr = pte_location;
+        if (VMI_FAILURE == vmi_read(vmi, &ctx, VMI_PS_4KB, pt_page, NULL))
+            goto done;
 
-            ctx.addr = pte_location;
-            if (VMI_FAILURE == vmi_read(vmi, &ctx, VMI_PS_4KB, pt_page, NULL))
-                goto done;
+        uint32_t pte_index;
+        for (pte_index = 0; pte_index < PTRS_PER_NOPAE_PTE; pte_index++, pte_location += entry_size) {
+            uint32_t pte_entry = pt_page[pte_index];
+            addr_t vaddr = pgd_base_vaddr + pte_index * VMI_PS_4KB;
 
-            uint32_t pte_index;
-            for (pte_index = 0; pte_index < PTRS_PER_NOPAE_PTE; pte_index++, pte_location += entry_size) {
-                uint32_t pte_entry = pt_page[pte_index];
-
-                if (ENTRY_PRESENT(vmi->os_type, pte_entry)) {
-                    page_info_t *p = g_try_malloc0(sizeof(page_info_t));
-                    if ( !p )
-                        goto done;
-
-                    p->vaddr = pgd_base_vaddr + pte_index * VMI_PS_4KB;
-                    p->pt = dtb;
-                    p->paddr = get_paddr_nopae(p->vaddr, pte_entry);
-                    p->size = VMI_PS_4KB;
-                    p->x86_legacy.pgd_location = pgd_location;
-                    p->x86_legacy.pgd_value = pgd_entry;
-                    p->x86_legacy.pte_location = pte_location;
-                    p->x86_legacy.pte_value = pte_entry;
-                    ret = g_slist_prepend(ret, p);
-                }
-            }
+            if (!ENTRY_PRESENT(transition_pages, pte_entry) ||
+                    !va_span_overlaps(vaddr, VMI_PS_4KB, start, end))
+                continue;
+
+            info = (page_info_t) {
+                .vaddr = vaddr,
+                .pt = dtb,
+                .paddr = get_paddr_nopae(vaddr, pte_entry),
+                .size = VMI_PS_4KB,
+                .x86_legacy = {
+                    .pgd_location = pgd_location,
+                    .pgd_value = pgd_entry,
+                    .pte_location = pte_location,
+                    .pte_value = pte_entry,
+                },
+            };
+            if (!cb(&info, data))
+                goto stop;
         }
     }
 
+stop:
+    ret = VMI_SUCCESS;
+
 done:
     g_free(pt_page);
     g_free(pgd_page);
@@ -503,13 +522,15 @@ done:
     return ret;
 }
 
-GSList* get_pages_pae(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t dtb)
+status_t walk_pages_pae(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t dtb,
+                        addr_t start, addr_t end, arch_page_cb_t cb, void *data)
 {
 
     uint32_t pdpi_base = get_pdptb(dtb);
     uint8_t entry_size = 0x8;
-
-    GSList *ret = NULL;
+    bool transition_pages = vmi->x86.transition_pages;
+    status_t ret = VMI_FAILURE;
+    page_info_t info;
 
     uint64_t pdpi_table[PTRS_PER_PDPI];
     uint64_t *page_directory = NULL;
@@ -523,11 +544,11 @@ GSList* get_pages_pae(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t dt
     if (VMI_FAILURE == vmi_read(vmi, &ctx, sizeof(pdpi_table), pdpi_table, NULL))
         return ret;
 
-    page_directory = g_malloc(VMI_PS_4KB);
+    page_directory = g_try_malloc0(VMI_PS_4KB);
     if ( !page_directory )
         goto done;
 
-    page_table = g_malloc(VMI_PS_4KB);
+    page_table = g_try_malloc0(VMI_PS_4KB);
     if ( !page_table )
         goto done;
 
@@ -538,9 +559,9 @@ GSList* get_pages_pae(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t dt
         uint64_t pdp_base_va = pdp_index * PTRS_PER_PAE_PGD * PTRS_PER_PAE_PGD * PTRS_PER_PAE_PTE * entry_size;
         uint64_t pdp_entry = pdpi_table[pdp_index];
 
-        if (!ENTRY_PRESENT(vmi->x86.transition_pages, pdp_entry)) {
+        if (!ENTRY_PRESENT(transition_pages, pdp_entry) ||
+                !va_span_overlaps(pdp_base_va, VMI_PS_1GB, start, end))
             continue;
-        }
 
         uint64_t pde_location = pdba_base_pae(pdp_entry);
 
@@ -554,58 +575,66 @@ GSList* get_pages_pae(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t dt
 
             uint64_t pd_entry = page_directory[pd_index];
 
-            if (ENTRY_PRESENT(vmi->os_type, pd_entry)) {
-
-                if (PAGE_SIZE(pd_entry)) {
-                    page_info_t *p = g_try_malloc0(sizeof(page_info_t));
-                    if ( !p )
-                        goto done;
-
-                    p->vaddr = pd_base_va;
-                    p->pt = dtb;
-                    p->paddr = get_large_paddr_pae(p->vaddr, pd_entry);
-                    p->size = VMI_PS_2MB;
-                    p->x86_pae.pdpe_location = pdpi_location;
-                    p->x86_pae.pdpe_value = pdp_entry;
-                    p->x86_pae.pgd_location = pde_location;
-                    p->x86_pae.pgd_value = pd_entry;
-                    ret = g_slist_prepend(ret, p);
+            if (!ENTRY_PRESENT(transition_pages, pd_entry) ||
+                    !va_span_overlaps(pd_base_va, VMI_PS_2MB, start, end))
+                continue;
+
+            if (PAGE_SIZE(pd_entry)) {
+                info = (page_info_t) {
+                    .vaddr = pd_base_va,
+                    .pt = dtb,
+                    .paddr = get_large_paddr_pae(pd_base_va, pd_entry),
+                    .size = VMI_PS_2MB,
+                    .x86_pae = {
+                        .pdpe_location = pdpi_location,
+                        .pdpe_value = pdp_entry,
+                        .pgd_location = pde_location,
+                        .pgd_value = pd_entry,
+                    },
+                };
+                if (!cb(&info, data))
+                    goto stop;
+                continue;
+            }
+
+            uint64_t pte_location = ptba_base_pae(pd_entry);
+
+            ctx.addr = pte_location;
+            if (VMI_FAILURE == vmi_read(vmi, &ctx, VMI_PS_4KB, page_table, NULL))
+                goto done;
+
+            uint32_t pt_index;
+            for (pt_index = 0; pt_index < PTRS_PER_PAE_PTE; pt_index++, pte_location += entry_size) {
+                uint64_t pte_entry = page_table[pt_index];
+                addr_t vaddr = pd_base_va + pt_index * VMI_PS_4KB;
+
+                if (!ENTRY_PRESENT(transition_pages, pte_entry) ||
+                        !va_span_overlaps(vaddr, VMI_PS_4KB, start, end))
                     continue;
-                }
-
-                uint64_t pte_location = ptba_base_pae(pd_entry);
-
-                ctx.addr = pte_location;
-                if (VMI_FAILURE == vmi_read(vmi, &ctx, VMI_PS_4KB, page_table, NULL))
-                    goto done;
-
-                uint32_t pt_index;
-                for (pt_index = 0; pt_index < PTRS_PER_PAE_PTE; pt_index++, pte_location += entry_size) {
-                    uint64_t pte_entry = page_table[pt_index];
-
-                    if (ENTRY_PRESENT(vmi->os_type, pte_entry)) {
-                        page_info_t *p = g_try_malloc0(sizeof(page_info_t));
-                        if ( !p )
-                            goto done;
-
-                        p->vaddr = pd_base_va + pt_index * VMI_PS_4KB;
-                        p->pt = dtb;
-                        p->paddr = get_paddr_pae(p->vaddr, pte_entry);
-                        p->size = VMI_PS_4KB;
-                        p->x86_pae.pdpe_location = pdpi_location;
-                        p->x86_pae.pdpe_value = pdp_entry;
-                        p->x86_pae.pgd_location = pde_location;
-                        p->x86_pae.pgd_value = pd_entry;
-                        p->x86_pae.pte_location = pte_location;
-                        p->x86_pae.pte_value = pte_entry;
-                        ret = g_slist_prepend(ret, p);
-                    }
-                }
 
+                info = (page_info_t) {
+                    .vaddr = vaddr,
+                    .pt = dtb,
+                    .paddr = get_paddr_pae(vaddr, pte_entry),
+                    .size = VMI_PS_4KB,
+                    .x86_pae = {
+                        .pdpe_location = pdpi_location,
+                        .pdpe_value = pdp_entry,
+                        .pgd_location = pde_location,
+                        .pgd_value = pd_entry,
+                        .pte_location = pte_location,
+                        .pte_value = pte_entry,
+                    },
+                };
+                if (!cb(&info, data))
+                    goto stop;
             }
         }
     }
 
+stop:
+    ret = VMI_SUCCESS;
+
 done:
     g_free(page_directory);
     g_free(page_table);
@@ -30,8 +30,10 @@
 status_t v2p_nopae (vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t pt, addr_t vaddr, page_info_t *info);
 status_t v2p_pae (vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t pt, addr_t vaddr, page_info_t *info);
 
-GSList* get_pages_nopae(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t dtb);
-GSList* get_pages_pae(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t dtb);
+status_t walk_pages_nopae(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t pt,
+                          addr_t start, addr_t end, arch_page_cb_t cb, void *data);
+status_t walk_pages_pae(vmi_instance_t vmi, addr_t npt, page_mode_t npm, addr_t pt,
+                        addr_t start, addr_t end, arch_page_cb_t cb, void *data);
 
 /* checks for EPT misconfiguration in page_access_flag */
 status_t intel_mem_access_sanity_check(vmi_mem_access_t page_access_flag);
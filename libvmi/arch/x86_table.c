@@ -0,0 +1,227 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "private.h"
+#include "x86.h"
+#include "arch/x86_table.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define X86_TABLE_AVX2
+#endif
+
+/*
+ * Table scan kernels. The vector versions move the bits they test into the
+ * sign bit of each 64-bit lane and collect them with movemask, two (SSE2)
+ * or four (AVX2) entries at a time. The scalar one is for other hosts.
+ */
+
+#define TABLE_WORDS (X86_TABLE_ENTRIES / 64)
+
+#if !defined(__SSE2__)
+static void
+table_scan_scalar(
+    const uint64_t *table,
+    bool transition_pages,
+    uint64_t reserved_bits,
+    x86_table_masks_t *masks)
+{
+    int w, i;
+
+    for (w = 0; w < TABLE_WORDS; w++) {
+        uint64_t present = 0, large = 0, reserved = 0;
+
+        for (i = 0; i < 64; i++) {
+            uint64_t entry = table[w * 64 + i];
+
+            present |= (uint64_t) ENTRY_PRESENT(transition_pages, entry) << i;
+            large |= (uint64_t) PAGE_SIZE(entry) << i;
+            reserved |= (uint64_t) !!(entry & reserved_bits) << i;
+        }
+
+        masks->present[w] = present;
+        masks->large[w] = large;
+        masks->reserved[w] = reserved;
+    }
+}
+#endif
+
+#if defined(__SSE2__)
+/* Sign bits of the lanes of v */
+static inline uint64_t
+signs_sse2(
+    __m128i v)
+{
+    return _mm_movemask_pd(_mm_castsi128_pd(v));
+}
+
+static void
+table_scan_sse2(
+    const uint64_t *table,
+    bool transition_pages,
+    uint64_t reserved_bits,
+    x86_table_masks_t *masks)
+{
+    const __m128i rmask = _mm_set1_epi64x(reserved_bits);
+    const __m128i zero = _mm_setzero_si128();
+    int w, i;
+
+    for (w = 0; w < TABLE_WORDS; w++) {
+        uint64_t present = 0, large = 0, reserved = 0;
+
+        for (i = 0; i < 64; i += 2) {
+            __m128i v = _mm_loadu_si128((const __m128i *) &table[w * 64 + i]);
+            uint64_t p = signs_sse2(_mm_slli_epi64(v, 63));
+            __m128i z;
+
+            /* TRANSITION and not PROTOTYPE */
+            if (transition_pages)
+                p |= signs_sse2(_mm_andnot_si128(_mm_slli_epi64(v, 53), _mm_slli_epi64(v, 52)));
+
+            /* no 64-bit compare in SSE2: a lane is zero if both its halves are */
+            z = _mm_cmpeq_epi32(_mm_and_si128(v, rmask), zero);
+            z = _mm_and_si128(z, _mm_shuffle_epi32(z, _MM_SHUFFLE(2, 3, 0, 1)));
+
+            present |= p << i;
+            large |= signs_sse2(_mm_slli_epi64(v, 56)) << i;
+            reserved |= (~signs_sse2(z) & 0x3) << i;
+        }
+
+        masks->present[w] = present;
+        masks->large[w] = large;
+        masks->reserved[w] = reserved;
+    }
+}
+#endif
+
+#ifdef X86_TABLE_AVX2
+__attribute__((target("avx2")))
+static inline uint64_t
+signs_avx2(
+    __m256i v)
+{
+    return _mm256_movemask_pd(_mm256_castsi256_pd(v));
+}
+
+__attribute__((target("avx2")))
+static void
+table_scan_avx2(
+    const uint64_t *table,
+    bool transition_pages,
+    uint64_t reserved_bits,
+    x86_table_masks_t *masks)
+{
+    const __m256i rmask = _mm256_set1_epi64x(reserved_bits);
+    const __m256i zero = _mm256_setzero_si256();
+    int w, i;
+
+    for (w = 0; w < TABLE_WORDS; w++) {
+        uint64_t present = 0, large = 0, reserved = 0;
+
+        for (i = 0; i < 64; i += 4) {
+            __m256i v = _mm256_loadu_si256((const __m256i *) &table[w * 64 + i]);
+            uint64_t p = signs_avx2(_mm256_slli_epi64(v, 63));
+
+            /* TRANSITION and not PROTOTYPE */
+            if (transition_pages)
+                p |= signs_avx2(_mm256_andnot_si256(_mm256_slli_epi64(v, 53), _mm256_slli_epi64(v, 52)));
+
+            present |= p << i;
+            large |= signs_avx2(_mm256_slli_epi64(v, 56)) << i;
+            reserved |= (~signs_avx2(_mm256_cmpeq_epi64(_mm256_and_si256(v, rmask), zero)) & 0xf) << i;
+        }
+
+        masks->present[w] = present;
+        masks->large[w] = large;
+        masks->reserved[w] = reserved;
+    }
+}
+#endif
+
+void
+x86_table_scan(
+    const uint64_t *table,
+    bool transition_pages,
+    uint64_t reserved_bits,
+    x86_table_masks_t *masks)
+{
+#ifdef X86_TABLE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        table_scan_avx2(table, transition_pages, reserved_bits, masks);
+        return;
+    }
+#endif
+
+#if defined(__SSE2__)
+    table_scan_sse2(table, transition_pages, reserved_bits, masks);
+#else
+    table_scan_scalar(table, transition_pages, reserved_bits, masks);
+#endif
+}
+
+status_t
+x86_read_pte_group(
+    vmi_instance_t vmi,
+    const access_context_t *ctx,
+    addr_t pt,
+    addr_t vaddr,
+    uint64_t *pte)
+{
+#ifdef ENABLE_ADDRESS_CACHE
+    uint64_t group[X86_PTE_GROUP];
+    access_context_t group_ctx = *ctx;
+    addr_t group_va = vaddr & ~((addr_t) X86_PTE_GROUP * VMI_PS_4KB - 1);
+    unsigned int index = (ctx->addr / sizeof(uint64_t)) % X86_PTE_GROUP;
+    unsigned int i;
+
+    stats_inc(vmi, page_walk_reads);
+
+    /* the neighbors' nested translations would need a lookup each */
+    if (valid_npm(ctx->npm))
+        return vmi_read_64(vmi, ctx, pte);
+
+    group_ctx.addr = ctx->addr & ~(addr_t) (sizeof(group) - 1);
+    if (VMI_FAILURE == vmi_read(vmi, &group_ctx, sizeof(group), group, NULL)) {
+        stats_inc(vmi, page_walk_reads);
+        return vmi_read_64(vmi, ctx, pte);
+    }
+
+    *pte = group[index];
+
+    /* transition PTEs are left to a lookup of their own */
+    for (i = 0; i < X86_PTE_GROUP; i++) {
+        if (i != index && VMI_GET_BIT(group[i], 0))
+            v2p_cache_set(vmi, group_va + i * VMI_PS_4KB, pt, 0,
+                          group[i] & VMI_BIT_MASK(12,51), VMI_PS_4KB);
+    }
+
+    return VMI_SUCCESS;
+#else
+    (void) pt;
+    (void) vaddr;
+    stats_inc(vmi, page_walk_reads);
+    return vmi_read_64(vmi, ctx, pte);
+#endif
+}
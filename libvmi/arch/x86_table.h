@@ -0,0 +1,114 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef X86_TABLE_H
+#define X86_TABLE_H
+
+#include "private.h"
+
+/*
+ * Classifies the 512 entries of a 64-bit x86 paging-structure page at once,
+ * so walks only visit the entries they care about. Bit n of each mask
+ * stands for entry n of the table.
+ */
+#define X86_TABLE_ENTRIES   512
+
+typedef struct x86_table_masks {
+    uint64_t present[X86_TABLE_ENTRIES / 64];   /**< ENTRY_PRESENT */
+    uint64_t large[X86_TABLE_ENTRIES / 64];     /**< PAGE_SIZE */
+    uint64_t reserved[X86_TABLE_ENTRIES / 64];  /**< any of the reserved bits set */
+} x86_table_masks_t;
+
+/*
+ * Fills masks for the table. With transition_pages, entries in transition
+ * count as present. Reserved_bits are the bits that flag an entry in the
+ * reserved mask, 0 if the caller doesn't need it.
+ */
+void x86_table_scan(
+    const uint64_t *table,
+    bool transition_pages,
+    uint64_t reserved_bits,
+    x86_table_masks_t *masks);
+
+/* Returns the first entry >= index set in mask, or -1 */
+static inline int
+x86_table_next(
+    const uint64_t *mask,
+    int index)
+{
+    uint64_t word;
+
+    while (index < X86_TABLE_ENTRIES) {
+        word = mask[index / 64] >> (index % 64);
+        if (word)
+            return index + __builtin_ctzll(word);
+        index = (index | 63) + 1;
+    }
+
+    return -1;
+}
+
+static inline bool
+x86_table_test(
+    const uint64_t *mask,
+    int index)
+{
+    return VMI_GET_BIT(mask[index / 64], index % 64);
+}
+
+static inline bool
+x86_table_any(
+    const uint64_t *mask)
+{
+    int i;
+
+    for (i = 0; i < X86_TABLE_ENTRIES / 64; i++)
+        if (mask[i])
+            return true;
+
+    return false;
+}
+
+/*
+ * Upper-level entries that reference the next table (present and not a
+ * large page), for read_table_entry.
+ */
+#define X86_TABLE_ENTRY_MASK    ((1ull << 7) | 1ull)
+#define X86_TABLE_ENTRY         1ull
+
+/*
+ * PTEs read together: a lookup reads the aligned group (one cache line)
+ * its PTE is in, and the other present PTEs go to the v2p cache.
+ */
+#define X86_PTE_GROUP       8
+
+/*
+ * Reads the 64-bit PTE at ctx->addr for vaddr in pagetable pt, adding the
+ * translations of its group to the v2p cache. Nested lookups read the PTE
+ * alone.
+ */
+status_t x86_read_pte_group(
+    vmi_instance_t vmi,
+    const access_context_t *ctx,
+    addr_t pt,
+    addr_t vaddr,
+    uint64_t *pte);
+
+#endif /* X86_TABLE_H */
@@ -137,14 +137,17 @@ pid_cache_init(
     vmi->pid_cache =
         g_hash_table_new_full(g_int_hash, g_int_equal,
                               pid_cache_key_free, pid_cache_entry_free);
+    pthread_mutex_init(&vmi->pid_cache_lock, NULL);
 }
 
 void
 pid_cache_destroy(
     vmi_instance_t vmi)
 {
-    if ( vmi->pid_cache )
+    if ( vmi->pid_cache ) {
         g_hash_table_destroy(vmi->pid_cache);
+        pthread_mutex_destroy(&vmi->pid_cache_lock);
+    }
 }
 
 status_t
@@ -155,14 +158,17 @@ pid_cache_get(
 {
     pid_cache_entry_t entry = NULL;
     gint key = (gint) pid;
+    status_t ret = VMI_FAILURE;
 
+    vmi_lock(vmi, &vmi->pid_cache_lock);
     if ((entry = g_hash_table_lookup(vmi->pid_cache, &key)) != NULL) {
         *dtb = entry->dtb;
         dbprint(VMI_DEBUG_PIDCACHE, "--PID cache hit %d -- 0x%.16"PRIx64"\n", pid, *dtb);
-        return VMI_SUCCESS;
+        ret = VMI_SUCCESS;
     }
+    vmi_unlock(vmi, &vmi->pid_cache_lock);
 
-    return VMI_FAILURE;
+    return ret;
 }
 
 void
@@ -184,7 +190,9 @@ pid_cache_set(
         goto cleanup;
     }
 
+    vmi_lock(vmi, &vmi->pid_cache_lock);
     (void) g_hash_table_insert_compat(vmi->pid_cache, key, entry);
+    vmi_unlock(vmi, &vmi->pid_cache_lock);
     dbprint(VMI_DEBUG_PIDCACHE, "--PID cache set %d -- 0x%.16"PRIx64"\n", pid, dtb);
     return;
 
@@ -199,20 +207,23 @@ pid_cache_del(
     vmi_pid_t pid)
 {
     gint key = (gint) pid;
+    gboolean removed;
 
     dbprint(VMI_DEBUG_PIDCACHE, "--PID cache del %d\n", pid);
-    if (TRUE == g_hash_table_remove(vmi->pid_cache, &key)) {
-        return VMI_SUCCESS;
-    } else {
-        return VMI_FAILURE;
-    }
+    vmi_lock(vmi, &vmi->pid_cache_lock);
+    removed = g_hash_table_remove(vmi->pid_cache, &key);
+    vmi_unlock(vmi, &vmi->pid_cache_lock);
+
+    return removed ? VMI_SUCCESS : VMI_FAILURE;
 }
 
 void
 pid_cache_flush(
     vmi_instance_t vmi)
 {
+    vmi_lock(vmi, &vmi->pid_cache_lock);
     g_hash_table_remove_all(vmi->pid_cache);
+    vmi_unlock(vmi, &vmi->pid_cache_lock);
     dbprint(VMI_DEBUG_PIDCACHE, "--PID cache flushed\n");
 }
 
@@ -277,14 +288,17 @@ sym_cache_init(
     vmi->sym_cache =
         g_hash_table_new_full((GHashFunc)key_128_hash, key_128_equals, g_free,
                               (GDestroyNotify)g_hash_table_destroy);
+    pthread_mutex_init(&vmi->sym_cache_lock, NULL);
 }
 
 void
 sym_cache_destroy(
     vmi_instance_t vmi)
 {
-    if ( vmi->sym_cache )
+    if ( vmi->sym_cache ) {
         g_hash_table_destroy(vmi->sym_cache);
+        pthread_mutex_destroy(&vmi->sym_cache_lock);
+    }
 }
 
 status_t
@@ -305,8 +319,10 @@ sym_cache_get(
     key_128_t key = &local_key;
     key_128_init(key, (uint64_t)base_addr, (uint64_t)pid);
 
+    vmi_lock(vmi, &vmi->sym_cache_lock);
+
     if ((symbol_table = g_hash_table_lookup(vmi->sym_cache, key)) == NULL) {
-        return ret;
+        goto done;
     }
 
     if ((entry = g_hash_table_lookup(symbol_table, sym)) != NULL) {
@@ -315,6 +331,14 @@ sym_cache_get(
         ret=VMI_SUCCESS;
     }
 
+done:
+    vmi_unlock(vmi, &vmi->sym_cache_lock);
+
+    if (VMI_SUCCESS == ret)
+        stats_inc(vmi, sym_cache_hits);
+    else
+        stats_inc(vmi, sym_cache_misses);
+
     return ret;
 }
 
@@ -333,9 +357,11 @@ sym_cache_set(
 
     key_128_t key = key_128_build((uint64_t)base_addr, (uint64_t)pid);
     if ( !key ) {
-        goto cleanup;
+        return;
     }
 
+    vmi_lock(vmi, &vmi->sym_cache_lock);
+
     symbol_table = g_hash_table_lookup(vmi->sym_cache, key);
     if ( !symbol_table ) {
         symbol_table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
@@ -362,6 +388,7 @@ sym_cache_set(
     }
 
     (void) g_hash_table_insert_compat(symbol_table, sym_dup, entry);
+    vmi_unlock(vmi, &vmi->sym_cache_lock);
     dbprint(VMI_DEBUG_SYMCACHE, "--SYM cache set %s -- 0x%.16"PRIx64"\n", sym, va);
     return;
 
@@ -376,6 +403,7 @@ cleanup:
         symbol_table = NULL;
     }
 
+    vmi_unlock(vmi, &vmi->sym_cache_lock);
     g_free(key);
 }
 
@@ -392,8 +420,10 @@ sym_cache_del(
     key_128_t key = &local_key;
     key_128_init(key, (uint64_t)base_addr, (uint64_t)pid);
 
+    vmi_lock(vmi, &vmi->sym_cache_lock);
+
     if ((symbol_table = g_hash_table_lookup(vmi->sym_cache, key)) == NULL) {
-        return ret;
+        goto done;
     }
 
     dbprint(VMI_DEBUG_SYMCACHE, "--SYM cache del %u:0x%.16"PRIx64":%s\n", pid, base_addr, sym);
@@ -406,6 +436,8 @@ sym_cache_del(
         }
     }
 
+done:
+    vmi_unlock(vmi, &vmi->sym_cache_lock);
     return ret;
 }
 
@@ -413,7 +445,9 @@ void
 sym_cache_flush(
     vmi_instance_t vmi)
 {
+    vmi_lock(vmi, &vmi->sym_cache_lock);
     g_hash_table_remove_all(vmi->sym_cache);
+    vmi_unlock(vmi, &vmi->sym_cache_lock);
     dbprint(VMI_DEBUG_SYMCACHE, "--SYM cache flushed\n");
 }
 
@@ -424,14 +458,17 @@ rva_cache_init(
     vmi->rva_cache =
         g_hash_table_new_full((GHashFunc)key_128_hash, key_128_equals, g_free,
                               (GDestroyNotify)g_hash_table_destroy);
+    pthread_mutex_init(&vmi->rva_cache_lock, NULL);
 }
 
 void
 rva_cache_destroy(
     vmi_instance_t vmi)
 {
-    if ( vmi->rva_cache )
+    if ( vmi->rva_cache ) {
         g_hash_table_destroy(vmi->rva_cache);
+        pthread_mutex_destroy(&vmi->rva_cache_lock);
+    }
 }
 
 status_t
@@ -451,8 +488,10 @@ rva_cache_get(
     key_128_t key = &local_key;
     key_128_init(key, (uint64_t)base_addr, (uint64_t)dtb);
 
+    vmi_lock(vmi, &vmi->rva_cache_lock);
+
     if ((rva_table = g_hash_table_lookup(vmi->rva_cache, key)) == NULL) {
-        return ret;
+        goto done;
     }
 
     if ((entry = g_hash_table_lookup(rva_table, GUINT_TO_POINTER(rva))) != NULL) {
@@ -462,6 +501,14 @@ rva_cache_get(
         ret=VMI_SUCCESS;
     }
 
+done:
+    vmi_unlock(vmi, &vmi->rva_cache_lock);
+
+    if (VMI_SUCCESS == ret)
+        stats_inc(vmi, rva_cache_hits);
+    else
+        stats_inc(vmi, rva_cache_misses);
+
     return ret;
 }
 
@@ -486,11 +533,14 @@ rva_cache_set(
         goto cleanup;
     }
 
+    vmi_lock(vmi, &vmi->rva_cache_lock);
+
     // Given the key from the base and dtb, locate the associated second-level hash table
     if ((rva_table = g_hash_table_lookup(vmi->rva_cache, key)) == NULL) {
         rva_table = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
                                           sym_cache_entry_free);
         if (!rva_table) {
+            vmi_unlock(vmi, &vmi->rva_cache_lock);
             goto cleanup;
         }
 
@@ -501,14 +551,24 @@ rva_cache_set(
         // No need to clear contents -- we're returning
     }
 
-    // Don't care whether value was previously in the table
+    /*
+     * Another thread may have got here first. Keep its entry, the string
+     * vmi_translate_v2sym handed out for it has to stay valid.
+     */
+    if (g_hash_table_lookup(rva_table, GUINT_TO_POINTER(rva))) {
+        vmi_unlock(vmi, &vmi->rva_cache_lock);
+        sym_cache_entry_free(entry);
+        return;
+    }
+
     (void) g_hash_table_insert_compat(rva_table, GUINT_TO_POINTER(rva), entry);
+    vmi_unlock(vmi, &vmi->rva_cache_lock);
     dbprint(VMI_DEBUG_RVACACHE, "--RVA cache set %s -- 0x%.16"PRIx64"\n", sym, rva);
     return;
 
 cleanup:
     // There's no path to this point after successful creation of rva_table
-    g_free(entry);
+    sym_cache_entry_free(entry);
     g_free(key);
 }
 
@@ -525,8 +585,10 @@ rva_cache_del(
     key_128_t key = &local_key;
     key_128_init(key, (uint64_t)base_addr, (uint64_t)dtb);
 
+    vmi_lock(vmi, &vmi->rva_cache_lock);
+
     if ((rva_table = g_hash_table_lookup(vmi->rva_cache, key)) == NULL) {
-        return ret;
+        goto done;
     }
 
     dbprint(VMI_DEBUG_RVACACHE, "--RVA cache del 0x%.16"PRIx64":0x%.16"PRIx64":0x%.16"PRIx64"\n",
@@ -540,6 +602,8 @@ rva_cache_del(
         }
     }
 
+done:
+    vmi_unlock(vmi, &vmi->rva_cache_lock);
     return ret;
 }
 
@@ -547,24 +611,239 @@ void
 rva_cache_flush(
     vmi_instance_t vmi)
 {
+    vmi_lock(vmi, &vmi->rva_cache_lock);
     g_hash_table_remove_all(vmi->rva_cache);
+    vmi_unlock(vmi, &vmi->rva_cache_lock);
     dbprint(VMI_DEBUG_RVACACHE, "--RVA cache flushed\n");
 }
 
+//
+// Virtual address --> physical address cache implementation
+//
+// This is a software TLB: every address space (pagetable + nested pagetable)
+// gets a direct-mapped array of translations. Entries are tagged with the
+// page size of the mapping and with the epoch they were created in. Bumping
+// the epoch invalidates every entry at once without touching memory, so
+// cache hits never have to be re-validated by reading the guest.
+//
+// The v2p and paging-structure caches make up the translation cache. In
+// concurrent mode every thread gets its own, like every CPU has its own TLB,
+// so translating never takes a lock. A flush then can't reach into the other
+// threads' caches; it bumps the generation instead, and each thread drops
+// its whole cache the next time it translates.
+//
+#define V2P_CACHE_BITS      10
+#define V2P_CACHE_ENTRIES   (1u << V2P_CACHE_BITS)
+
+#define PT_CACHE_BITS       10
+#define PT_CACHE_ENTRIES    (1u << PT_CACHE_BITS)
+
+struct v2p_cache_entry {
+    addr_t va;          /**< virtual address, aligned to size */
+    addr_t pa;          /**< physical address, aligned to size */
+    page_size_t size;   /**< size of the mapping */
+    uint32_t epoch;     /**< epoch the entry was created in */
+};
+
+struct v2p_cache_space {
+    addr_t pt;
+    addr_t npt;
+    uint64_t page_shifts; /**< bitmap of the page shifts present in entries */
+    struct v2p_cache_entry entries[V2P_CACHE_ENTRIES];
+};
+typedef struct v2p_cache_space *v2p_cache_space_t;
+
+/* see the paging-structure cache below */
+struct pt_cache_entry {
+    addr_t location;    /**< physical address of the entry */
+    addr_t npt;         /**< nested pagetable the location is in, 0 if none */
+    uint64_t value;
+    uint32_t epoch;     /**< v2p epoch the entry was read in, 0 if unused */
+};
+
+struct translation_cache {
+    translation_threads_t *threads; /**< NULL for the instance's own cache */
+    GHashTable *v2p_cache;          /**< hash table to hold the v2p cache data */
+    v2p_cache_space_t last;         /**< most recently used v2p address space */
+    struct pt_cache_entry *pt_cache; /**< upper-level paging-structure entries, by location */
+    uint32_t generation;            /**< vmi->v2p_generation the cache is valid for */
+};
+
+struct translation_threads {
+    pthread_key_t key;      /**< the calling thread's translation cache */
+    pthread_mutex_t lock;   /**< protects caches */
+    GSList *caches;         /**< every thread's translation cache */
+};
+
+static void pt_cache_flush(translation_cache_t *cache);
+
+static inline uint32_t
+v2p_epoch(
+    vmi_instance_t vmi)
+{
+    return __atomic_load_n(&vmi->v2p_epoch, __ATOMIC_RELAXED);
+}
+
+static translation_cache_t *
+translation_cache_new(
+    translation_threads_t *threads)
+{
+    translation_cache_t *cache = g_try_malloc0(sizeof(translation_cache_t));
+
+    if ( !cache )
+        return NULL;
+
+    cache->threads = threads;
+    cache->v2p_cache = g_hash_table_new_full((GHashFunc)key_128_hash, key_128_equals, g_free, g_free);
+    cache->pt_cache = g_try_malloc0(PT_CACHE_ENTRIES * sizeof(struct pt_cache_entry));
+    return cache;
+}
+
+static void
+translation_cache_free(
+    translation_cache_t *cache)
+{
+    g_hash_table_destroy(cache->v2p_cache);
+    g_free(cache->pt_cache);
+    g_free(cache);
+}
+
+/* A thread exited, its cache goes with it */
+static void
+translation_cache_release(
+    void *data)
+{
+    translation_cache_t *cache = (translation_cache_t *) data;
+    translation_threads_t *threads = cache->threads;
+
+    pthread_mutex_lock(&threads->lock);
+    threads->caches = g_slist_remove(threads->caches, cache);
+    pthread_mutex_unlock(&threads->lock);
+
+    translation_cache_free(cache);
+}
+
+static translation_cache_t *
+translation_cache_get(
+    vmi_instance_t vmi)
+{
+    translation_threads_t *threads = vmi->translation_threads;
+    translation_cache_t *cache;
+    uint32_t generation;
+
+    if ( !threads )
+        return vmi->translation_cache;
+
+    cache = pthread_getspecific(threads->key);
+    if ( !cache ) {
+        cache = translation_cache_new(threads);
+        if ( !cache )
+            return NULL;
+
+        if ( pthread_setspecific(threads->key, cache) ) {
+            translation_cache_free(cache);
+            return NULL;
+        }
+
+        pthread_mutex_lock(&threads->lock);
+        threads->caches = g_slist_prepend(threads->caches, cache);
+        pthread_mutex_unlock(&threads->lock);
+
+        cache->generation = __atomic_load_n(&vmi->v2p_generation, __ATOMIC_ACQUIRE);
+        return cache;
+    }
+
+    generation = __atomic_load_n(&vmi->v2p_generation, __ATOMIC_ACQUIRE);
+    if ( cache->generation != generation ) {
+        cache->last = NULL;
+        g_hash_table_remove_all(cache->v2p_cache);
+        pt_cache_flush(cache);
+        cache->generation = generation;
+        dbprint(VMI_DEBUG_V2PCACHE, "--V2P cache of this thread flushed\n");
+    }
+
+    return cache;
+}
+
+static inline unsigned int
+v2p_cache_index(
+    addr_t va,
+    unsigned int shift)
+{
+    return (((va >> shift) + shift) * 0x9e3779b97f4a7c15ull) >> (64 - V2P_CACHE_BITS);
+}
+
+static inline unsigned int
+page_size_to_shift(
+    page_size_t size)
+{
+    return size ? __builtin_ctzll(size) : 12;
+}
+
+static v2p_cache_space_t
+v2p_cache_get_space(
+    translation_cache_t *cache,
+    addr_t pt,
+    addr_t npt)
+{
+    v2p_cache_space_t space = cache->last;
+    struct key_128 local_key;
+
+    if (space && space->pt == pt && space->npt == npt)
+        return space;
+
+    key_128_init(&local_key, pt, npt);
+    space = g_hash_table_lookup(cache->v2p_cache, &local_key);
+    if (space)
+        cache->last = space;
+
+    return space;
+}
+
 void
 v2p_cache_init(
     vmi_instance_t vmi)
 {
-    vmi->v2p_cache = g_hash_table_new_full((GHashFunc)key_128_hash, key_128_equals, g_free,
-                                           (GDestroyNotify)g_hash_table_destroy);
+    vmi->v2p_epoch = 1;
+    vmi->v2p_generation = 0;
+
+    if ( !vmi->concurrent ) {
+        vmi->translation_cache = translation_cache_new(NULL);
+        return;
+    }
+
+    vmi->translation_threads = g_try_malloc0(sizeof(translation_threads_t));
+    if ( !vmi->translation_threads )
+        return;
+
+    if ( pthread_key_create(&vmi->translation_threads->key, translation_cache_release) ) {
+        g_free(vmi->translation_threads);
+        vmi->translation_threads = NULL;
+        return;
+    }
+
+    pthread_mutex_init(&vmi->translation_threads->lock, NULL);
 }
 
 void
 v2p_cache_destroy(
     vmi_instance_t vmi)
 {
-    if ( vmi->v2p_cache )
-        g_hash_table_destroy(vmi->v2p_cache);
+    translation_threads_t *threads = vmi->translation_threads;
+
+    if ( vmi->translation_cache )
+        translation_cache_free(vmi->translation_cache);
+    vmi->translation_cache = NULL;
+
+    if ( !threads )
+        return;
+
+    /* the threads still holding a cache don't get to free it anymore */
+    pthread_key_delete(threads->key);
+    g_slist_free_full(threads->caches, (GDestroyNotify)translation_cache_free);
+    pthread_mutex_destroy(&threads->lock);
+    g_free(threads);
+    vmi->translation_threads = NULL;
 }
 
 status_t
@@ -573,33 +852,47 @@ v2p_cache_get(
     addr_t va,
     addr_t pt,
     addr_t npt,
-    addr_t *pa)
+    addr_t *pa,
+    page_size_t *size)
 {
-    struct key_128 local_key;
-    key_128_t key = &local_key;
-    key_128_init(key, pt, npt);
+    translation_cache_t *cache = translation_cache_get(vmi);
+    v2p_cache_space_t space;
+    uint32_t epoch = v2p_epoch(vmi);
+    uint64_t shifts;
+
+    if ( !cache )
+        return VMI_FAILURE;
 
-    GHashTable *v = g_hash_table_lookup(vmi->v2p_cache, key);
-    if ( !v ) {
+    space = v2p_cache_get_space(cache, pt, npt);
+    if ( !space ) {
         dbprint(VMI_DEBUG_V2PCACHE, "--V2P cache miss (no address space) 0x%.16"PRIx64" 0x%.16"PRIx64"\n", pt, npt);
+        stats_inc(vmi, v2p_misses);
         return VMI_FAILURE;
     }
 
-    addr_t offset = VMI_BIT_MASK(0,11) & va;
-    va = (va >> 12) << 12;
+    /* probe the smallest page size first, then the larger ones */
+    for (shifts = space->page_shifts; shifts; shifts &= shifts - 1) {
+        unsigned int shift = __builtin_ctzll(shifts);
+        addr_t mask = (1ull << shift) - 1;
+        struct v2p_cache_entry *entry = &space->entries[v2p_cache_index(va, shift)];
 
-    gpointer _pa = g_hash_table_lookup(v, &va);
-    if ( !_pa ) {
-        dbprint(VMI_DEBUG_V2PCACHE, "--V2P cache miss (no page) 0x%.16"PRIx64"\n", va);
-        return VMI_FAILURE;
-    }
+        if (entry->epoch != epoch || entry->va != (va & ~mask) ||
+                page_size_to_shift(entry->size) != shift)
+            continue;
 
-    *pa = GPOINTER_TO_SIZE(_pa);
-    *pa |= offset;
-    dbprint(VMI_DEBUG_V2PCACHE, "--V2P cache hit 0x%.16"PRIx64" -- 0x%.16"PRIx64"\n",
-            va | offset, *pa);
+        *pa = entry->pa | (va & mask);
+        if (size)
+            *size = entry->size;
 
-    return VMI_SUCCESS;
+        dbprint(VMI_DEBUG_V2PCACHE, "--V2P cache hit 0x%.16"PRIx64" -- 0x%.16"PRIx64"\n",
+                va, *pa);
+        stats_inc(vmi, v2p_hits);
+        return VMI_SUCCESS;
+    }
+
+    dbprint(VMI_DEBUG_V2PCACHE, "--V2P cache miss (no page) 0x%.16"PRIx64"\n", va);
+    stats_inc(vmi, v2p_misses);
+    return VMI_FAILURE;
 }
 
 void
@@ -608,52 +901,53 @@ v2p_cache_set(
     addr_t va,
     addr_t pt,
     addr_t npt,
-    addr_t pa)
+    addr_t pa,
+    page_size_t size)
 {
 #ifdef ENABLE_SAFETY_CHECKS
     if (!va || !pt || !pa)
         return;
 #endif
 
-    key_128_t key = key_128_build(pt, npt);
-    if ( !key )
+    translation_cache_t *cache = translation_cache_get(vmi);
+    if ( !cache )
         return;
 
-    GHashTable *v = g_hash_table_lookup(vmi->v2p_cache, key);
-    gboolean new_process_space = FALSE;
-    addr_t * _va = NULL;
+    v2p_cache_space_t space = v2p_cache_get_space(cache, pt, npt);
 
-    if ( !v ) {
-        new_process_space = TRUE;
+    if ( !space ) {
+        key_128_t key = key_128_build(pt, npt);
+        if ( !key )
+            return;
 
-        v = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
-        if ( !v )
-            goto cleanup;
+        space = g_try_malloc0(sizeof(struct v2p_cache_space));
+        if ( !space ) {
+            g_free(key);
+            return;
+        }
 
-        (void) g_hash_table_insert_compat(vmi->v2p_cache, key, v);
-    } else {
-        g_free(key);
-        key = NULL;
-    }
+        space->pt = pt;
+        space->npt = npt;
 
-    /* bundle the cache entries per page */
-    va = (va >> 12) << 12;
-    pa = (pa >> 12) << 12;
+        (void) g_hash_table_insert_compat(cache->v2p_cache, key, space);
+        cache->last = space;
+    }
 
-    _va = g_memdup(&va, sizeof(addr_t));
-    if ( !_va )
-        goto cleanup;
+    if ( !size )
+        size = VMI_PS_4KB;
 
-    (void) g_hash_table_insert_compat(v, _va, GSIZE_TO_POINTER(pa));
+    unsigned int shift = page_size_to_shift(size);
+    addr_t mask = (1ull << shift) - 1;
+    struct v2p_cache_entry *entry = &space->entries[v2p_cache_index(va, shift)];
 
-    dbprint(VMI_DEBUG_V2PCACHE, "--V2P cache set for page 0x%.16"PRIx64" -- 0x%.16"PRIx64"\n",
-            va, pa);
-    return;
+    entry->va = va & ~mask;
+    entry->pa = pa & ~mask;
+    entry->size = size;
+    entry->epoch = v2p_epoch(vmi);
+    space->page_shifts |= 1ull << shift;
 
-cleanup:
-    if ( new_process_space )
-        g_hash_table_remove(vmi->v2p_cache, key);
-    g_free(key);
+    dbprint(VMI_DEBUG_V2PCACHE, "--V2P cache set for page 0x%.16"PRIx64" -- 0x%.16"PRIx64" (size 0x%"PRIx64")\n",
+            entry->va, entry->pa, (uint64_t)size);
 }
 
 status_t
@@ -663,19 +957,30 @@ v2p_cache_del(
     addr_t pt,
     addr_t npt)
 {
-    struct key_128 local_key;
-    key_128_t key = &local_key;
-    key_128_init(key, npt, pt);
+    v2p_cache_space_t space;
+    uint64_t shifts;
+
+    if ( vmi->translation_threads ) {
+        __atomic_add_fetch(&vmi->v2p_generation, 1, __ATOMIC_RELEASE);
+        dbprint(VMI_DEBUG_V2PCACHE, "--V2P cache del 0x%.16"PRIx64" (all threads flushed)\n", va);
+        return VMI_SUCCESS;
+    }
 
-    GHashTable *v = g_hash_table_lookup(vmi->v2p_cache, key);
-    if ( !v )
+    if ( !vmi->translation_cache )
         return VMI_SUCCESS;
 
-    va = (va >> 12) << 12;
-    (void) g_hash_table_remove(v, &va);
+    space = v2p_cache_get_space(vmi->translation_cache, pt, npt);
+    if ( !space )
+        return VMI_SUCCESS;
 
-    if (!g_hash_table_size(v))
-        g_hash_table_remove(vmi->v2p_cache, key);
+    for (shifts = space->page_shifts; shifts; shifts &= shifts - 1) {
+        unsigned int shift = __builtin_ctzll(shifts);
+        addr_t mask = (1ull << shift) - 1;
+        struct v2p_cache_entry *entry = &space->entries[v2p_cache_index(va, shift)];
+
+        if (entry->va == (va & ~mask))
+            entry->epoch = 0;
+    }
 
     dbprint(VMI_DEBUG_V2PCACHE, "--V2P cache del 0x%.16"PRIx64"\n", va);
 
@@ -688,13 +993,122 @@ v2p_cache_flush(
     addr_t pt,
     addr_t npt)
 {
+    translation_cache_t *cache = vmi->translation_cache;
+
+    if ( vmi->translation_threads ) {
+        __atomic_add_fetch(&vmi->v2p_generation, 1, __ATOMIC_RELEASE);
+        dbprint(VMI_DEBUG_V2PCACHE, "--V2P cache flushed (all threads)\n");
+        return;
+    }
+
+    if ( !cache )
+        return;
+
+    cache->last = NULL;
+
+    /* the paging structures are shared between address spaces */
+    pt_cache_flush(cache);
+
     if ( ~0ull == pt )
-        g_hash_table_remove_all(vmi->v2p_cache);
+        g_hash_table_remove_all(cache->v2p_cache);
     else {
         struct key_128 local_key;
         key_128_t key = &local_key;
-        key_128_init(key, npt, pt);
-        (void) g_hash_table_remove(vmi->v2p_cache, key);
+        key_128_init(key, pt, npt);
+        (void) g_hash_table_remove(cache->v2p_cache, key);
     }
     dbprint(VMI_DEBUG_V2PCACHE, "--V2P cache flushed\n");
 }
+
+uint32_t
+v2p_cache_bump_epoch(
+    vmi_instance_t vmi)
+{
+    uint32_t epoch = v2p_epoch(vmi);
+    uint32_t next;
+
+    do {
+        next = epoch + 1;
+
+        /* on wraparound stale entries could match again, drop them all */
+        if ( !next ) {
+            v2p_cache_flush(vmi, ~0ull, 0);
+            next = 1;
+        }
+    } while ( !__atomic_compare_exchange_n(&vmi->v2p_epoch, &epoch, next, false,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED) );
+
+    dbprint(VMI_DEBUG_V2PCACHE, "--V2P cache epoch %u\n", next);
+    return next;
+}
+
+//
+// Paging-structure cache implementation
+//
+// Like the paging-structure caches of x86 CPUs, this keeps the upper-level
+// entries that point to the next table, keyed by their (nested) physical
+// address, i.e. by table and index. A TLB miss next to a recent lookup then
+// only reads the levels below the last cached entry, usually just the PTE.
+// Address spaces that share tables, like the kernel half on x86-64, share
+// the cached entries. Entries are valid for the v2p epoch they were read in
+// and are dropped with any v2p cache flush.
+//
+static inline unsigned int
+pt_cache_index(
+    addr_t npt,
+    addr_t location)
+{
+    return (((location >> 3) ^ npt) * 0x9e3779b97f4a7c15ull) >> (64 - PT_CACHE_BITS);
+}
+
+status_t
+pt_cache_get(
+    vmi_instance_t vmi,
+    addr_t npt,
+    addr_t location,
+    uint64_t *value)
+{
+    translation_cache_t *cache = translation_cache_get(vmi);
+    struct pt_cache_entry *entry;
+
+    if ( !cache || !cache->pt_cache )
+        return VMI_FAILURE;
+
+    entry = &cache->pt_cache[pt_cache_index(npt, location)];
+    if (entry->epoch != v2p_epoch(vmi) || entry->location != location || entry->npt != npt)
+        return VMI_FAILURE;
+
+    *value = entry->value;
+    stats_inc(vmi, pt_cache_hits);
+    return VMI_SUCCESS;
+}
+
+void
+pt_cache_set(
+    vmi_instance_t vmi,
+    addr_t npt,
+    addr_t location,
+    uint64_t value)
+{
+    translation_cache_t *cache = translation_cache_get(vmi);
+    struct pt_cache_entry *entry;
+
+    if ( !cache || !cache->pt_cache )
+        return;
+
+    entry = &cache->pt_cache[pt_cache_index(npt, location)];
+    entry->location = location;
+    entry->npt = npt;
+    entry->value = value;
+    entry->epoch = v2p_epoch(vmi);
+
+    dbprint(VMI_DEBUG_V2PCACHE, "--PT cache set 0x%.16"PRIx64" -- 0x%.16"PRIx64"\n", location, value);
+}
+
+static void
+pt_cache_flush(
+    translation_cache_t *cache)
+{
+    if ( cache->pt_cache )
+        memset(cache->pt_cache, 0, PT_CACHE_ENTRIES * sizeof(struct pt_cache_entry));
+}
@@ -61,10 +61,14 @@ status_t rva_cache_del(vmi_instance_t vmi, addr_t base_addr, addr_t dtb, addr_t
 
 void v2p_cache_init(vmi_instance_t vmi);
 void v2p_cache_destroy(vmi_instance_t vmi);
-void v2p_cache_set(vmi_instance_t vmi, addr_t va, addr_t pt, addr_t npt, addr_t pa);
+void v2p_cache_set(vmi_instance_t vmi, addr_t va, addr_t pt, addr_t npt, addr_t pa, page_size_t size);
 void v2p_cache_flush(vmi_instance_t vmi, addr_t pt, addr_t npt);
-status_t v2p_cache_get(vmi_instance_t vmi, addr_t va, addr_t pt, addr_t npt, addr_t *pa);
-status_t v2p_cache_del(vmi_instance_t vmi, addr_t va, addr_t np, addr_t npt);
+status_t v2p_cache_get(vmi_instance_t vmi, addr_t va, addr_t pt, addr_t npt, addr_t *pa, page_size_t *size);
+status_t v2p_cache_del(vmi_instance_t vmi, addr_t va, addr_t pt, addr_t npt);
+uint32_t v2p_cache_bump_epoch(vmi_instance_t vmi);
+
+void pt_cache_set(vmi_instance_t vmi, addr_t npt, addr_t location, uint64_t value);
+status_t pt_cache_get(vmi_instance_t vmi, addr_t npt, addr_t location, uint64_t *value);
 
 #else
 
@@ -95,6 +99,10 @@ status_t v2p_cache_del(vmi_instance_t vmi, addr_t va, addr_t np, addr_t npt);
 #define v2p_cache_flush(...)    NOOP
 #define v2p_cache_get(...) VMI_FAILURE
 #define v2p_cache_del(...) VMI_FAILURE
+#define v2p_cache_bump_epoch(...) 0
+
+#define pt_cache_set(...)       NOOP
+#define pt_cache_get(...) VMI_FAILURE
 
 #endif
 
@@ -247,3 +247,13 @@ void free_gint64(gpointer p)
 {
     g_slice_free(gint64, p);
 }
+
+void mutex_init_recursive(pthread_mutex_t *lock)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
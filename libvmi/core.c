@@ -477,6 +477,11 @@ static inline status_t driver_sanity_check(vmi_mode_t mode)
         case VMI_BAREFLANK:
 #ifndef ENABLE_BAREFLANK
             return VMI_FAILURE;
+#endif
+            break;
+        case VMI_MEM:
+#ifndef ENABLE_MEM
+            return VMI_FAILURE;
 #endif
             break;
         default:
@@ -513,8 +518,24 @@ status_t vmi_init(
     dbprint(VMI_DEBUG_CORE, "LibVMI Driver Mode %d\n", _vmi->mode);
 
     _vmi->init_flags = init_flags;
+    _vmi->concurrent = !!(init_flags & VMI_INIT_CONCURRENT);
     _vmi->page_mode = VMI_PM_UNKNOWN;
 
+    /* callbacks register and clear events from within vmi_events_listen */
+    mutex_init_recursive(&_vmi->events_lock);
+#ifdef ENABLE_JSON_PROFILES
+    pthread_mutex_init(&_vmi->json.lock, NULL);
+#endif
+    stats_init(_vmi);
+
+#ifndef ENABLE_PAGE_CACHE
+    /* without it pages are only held one at a time, by whoever read last */
+    if ( _vmi->concurrent ) {
+        errprint("VMI_INIT_CONCURRENT requires LibVMI built with the page cache\n");
+        goto error_exit;
+    }
+#endif
+
     arch_init_lookup_tables(_vmi);
 
     if ( init_data && init_data->count ) {
@@ -526,6 +547,10 @@ status_t vmi_init(
                     if ( !_vmi->memmap )
                         goto error_exit;
                     break;
+                case VMI_INIT_DATA_INIT_CACHE:
+                    g_free(_vmi->init_cache_dir);
+                    _vmi->init_cache_dir = g_strdup(init_data->entry[i].data);
+                    break;
                 default:
                     break;
             };
@@ -589,6 +614,7 @@ status_t vmi_init(
 
     /* setup the caches */
     pid_cache_init(_vmi);
+    process_index_init(_vmi);
     sym_cache_init(_vmi);
     rva_cache_init(_vmi);
     v2p_cache_init(_vmi);
@@ -713,16 +739,62 @@ os_t vmi_init_profile(
     return vmi->os_type;
 }
 
+static status_t os_init(
+    vmi_instance_t vmi,
+    GHashTable *config)
+{
+    switch ( vmi->os_type ) {
+#ifdef ENABLE_LINUX
+        case VMI_OS_LINUX:
+            return linux_init(vmi, config);
+#endif
+#ifdef ENABLE_WINDOWS
+        case VMI_OS_WINDOWS:
+            return windows_init(vmi, config);
+#endif
+#ifdef ENABLE_FREEBSD
+        case VMI_OS_FREEBSD:
+            return freebsd_init(vmi, config);
+#endif
+        default:
+            return VMI_FAILURE;
+    };
+}
+
+/* Undo what an OS init from stale cached values left behind */
+static void os_init_reset(
+    vmi_instance_t vmi)
+{
+    if ( vmi->os_interface )
+        os_destroy(vmi);
+
+    vmi->kpgd = 0;
+    vmi->init_task = 0;
+
+    if ( VMI_FILE == vmi->mode )
+        vmi->page_mode = VMI_PM_UNKNOWN;
+
+    vmi_v2pcache_flush(vmi, ~0ull);
+    vmi_symcache_flush(vmi);
+    vmi_rvacache_flush(vmi);
+    vmi_pidcache_flush(vmi);
+    os_heuristics_reset(vmi);
+}
+
 os_t vmi_init_os(
     vmi_instance_t vmi,
     vmi_config_t config_mode,
     void *config,
     vmi_init_error_t *error)
 {
+    init_cache_t *init_cache;
+    status_t status = VMI_FAILURE;
+
     if (!vmi)
         return VMI_OS_UNKNOWN;
 
     vmi->os_type = VMI_OS_UNKNOWN;
+    os_heuristics_reset(vmi);
     GHashTable *_config = init_config(vmi, config_mode, config, error);
 
     if (!_config)
@@ -742,48 +814,43 @@ os_t vmi_init_os(
         goto error_exit;
     }
 
-    /* setup OS specific stuff */
-    switch ( vmi->os_type ) {
-#ifdef ENABLE_LINUX
-        case VMI_OS_LINUX:
-            if (VMI_FAILURE == linux_init(vmi, _config)) {
-                vmi->os_type = VMI_OS_UNKNOWN;
-                if ( error )
-                    *error = VMI_INIT_ERROR_OS;
+    /* setup OS specific stuff, with what a previous attach found if it still applies */
+    init_cache = init_cache_load(vmi, _config);
+    if ( init_cache ) {
+        status = os_init(vmi, init_cache_config(init_cache));
 
-                goto error_exit;
-            }
-            break;
-#endif
-#ifdef ENABLE_WINDOWS
-        case VMI_OS_WINDOWS:
-            if (VMI_FAILURE == windows_init(vmi, _config)) {
-                vmi->os_type = VMI_OS_UNKNOWN;
-                if ( error )
-                    *error = VMI_INIT_ERROR_OS;
+        if ( VMI_SUCCESS == status && !init_cache_validate(vmi, init_cache) )
+            status = VMI_FAILURE;
 
-                goto error_exit;
-            }
-            break;
-#endif
-#ifdef ENABLE_FREEBSD
-        case VMI_OS_FREEBSD:
-            if (VMI_FAILURE == freebsd_init(vmi, _config)) {
-                vmi->os_type = VMI_OS_UNKNOWN;
-                if ( error )
-                    *error = VMI_INIT_ERROR_OS;
+        init_cache_free(init_cache);
 
-                goto error_exit;
-            }
-            break;
-#endif
-        default:
-            vmi->os_type = VMI_OS_UNKNOWN;
-            if ( error )
-                *error = VMI_INIT_ERROR_OS;
+        if ( VMI_FAILURE == status )
+            os_init_reset(vmi);
+    }
 
-            goto error_exit;
-    };
+    if ( vmi->init_cache_dir ) {
+        if ( VMI_SUCCESS == status )
+            stats_inc(vmi, init_cache_hits);
+        else
+            stats_inc(vmi, init_cache_misses);
+    }
+
+    if ( VMI_FAILURE == status ) {
+        status = os_init(vmi, _config);
+        if ( VMI_SUCCESS == status )
+            init_cache_store(vmi);
+    }
+
+    if ( VMI_FAILURE == status ) {
+        vmi->os_type = VMI_OS_UNKNOWN;
+        if ( error )
+            *error = VMI_INIT_ERROR_OS;
+
+        goto error_exit;
+    }
+
+    /* anything indexed while the OS was being set up is suspect */
+    process_index_invalidate(vmi);
 
 error_exit:
 #ifdef ENABLE_JSON_PROFILES
@@ -843,6 +910,85 @@ error_exit:
     return VMI_FAILURE;
 }
 
+status_t
+vmi_clone(
+    vmi_instance_t vmi,
+    vmi_instance_t *clone)
+{
+    vmi_instance_t _clone;
+
+#ifdef ENABLE_SAFETY_CHECKS
+    if (!vmi || !clone)
+        return VMI_FAILURE;
+#endif
+
+    _clone = (vmi_instance_t) g_try_malloc0(sizeof(struct vmi_instance));
+    if ( !_clone )
+        return VMI_FAILURE;
+
+    /* the clone has no events to listen to */
+    _clone->mode = vmi->mode;
+    _clone->init_flags = vmi->init_flags & ~(VMI_INIT_EVENTS | VMI_INIT_DOMAINWATCH);
+    _clone->concurrent = vmi->concurrent;
+
+    mutex_init_recursive(&_clone->events_lock);
+#ifdef ENABLE_JSON_PROFILES
+    json_profile_clone(vmi, _clone);
+#endif
+    stats_init(_clone);
+
+    /* what the driver and OS init found out about the target */
+    if ( vmi->image_type )
+        _clone->image_type = strdup(vmi->image_type);
+    if ( vmi->image_type_complete )
+        _clone->image_type_complete = strdup(vmi->image_type_complete);
+    if ( vmi->memmap )
+        _clone->memmap = (memory_map_t*)g_memdup(vmi->memmap, sizeof(memory_map_t));
+
+    _clone->page_shift = vmi->page_shift;
+    _clone->page_size = vmi->page_size;
+    _clone->kpgd = vmi->kpgd;
+    _clone->init_task = vmi->init_task;
+    _clone->x86 = vmi->x86;
+    _clone->arm64 = vmi->arm64;
+    _clone->page_mode = vmi->page_mode;
+    _clone->arch_interface = vmi->arch_interface;
+    _clone->allocated_ram_size = vmi->allocated_ram_size;
+    _clone->max_physical_address = vmi->max_physical_address;
+    _clone->vm_type = vmi->vm_type;
+    _clone->os_type = vmi->os_type;
+    _clone->num_vcpus = vmi->num_vcpus;
+
+    if ( vmi->init_methods ) {
+        _clone->init_methods = g_array_new(FALSE, FALSE, sizeof(vmi_init_method_t));
+        g_array_append_vals(_clone->init_methods, vmi->init_methods->data, vmi->init_methods->len);
+    }
+
+    if ( VMI_FAILURE == driver_clone(vmi, _clone) ) {
+        errprint("Failed to clone the driver connection\n");
+        goto error_exit;
+    }
+
+    /* the caches start out empty */
+    pid_cache_init(_clone);
+    process_index_init(_clone);
+    sym_cache_init(_clone);
+    rva_cache_init(_clone);
+    v2p_cache_init(_clone);
+
+    if ( VMI_FAILURE == os_clone(vmi, _clone) )
+        goto error_exit;
+
+    dbprint(VMI_DEBUG_CORE, "**cloned instance %p\n", (void *) vmi);
+
+    *clone = _clone;
+    return VMI_SUCCESS;
+
+error_exit:
+    vmi_destroy(_clone);
+    return VMI_FAILURE;
+}
+
 status_t
 vmi_destroy(
     vmi_instance_t vmi)
@@ -867,6 +1013,8 @@ vmi_destroy(
 #endif
 
     pid_cache_destroy(vmi);
+    process_index_destroy(vmi);
+    os_heuristics_destroy(vmi);
     sym_cache_destroy(vmi);
     rva_cache_destroy(vmi);
     v2p_cache_destroy(vmi);
@@ -875,6 +1023,12 @@ vmi_destroy(
     if (vmi->image_type)
         free(vmi->image_type);
     g_free(vmi->memmap);
+    g_free(vmi->init_cache_dir);
+#ifdef ENABLE_JSON_PROFILES
+    pthread_mutex_destroy(&vmi->json.lock);
+#endif
+    pthread_mutex_destroy(&vmi->events_lock);
+    stats_destroy(vmi);
     g_free(vmi);
     return VMI_SUCCESS;
 }
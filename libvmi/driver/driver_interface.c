@@ -47,6 +47,10 @@
 #include "driver/bareflank/bareflank.h"
 #endif
 
+#ifdef ENABLE_MEM
+#include "driver/mem/mem.h"
+#endif
+
 status_t driver_init_mode(const char *name,
                           uint64_t domainid,
                           uint64_t init_flags,
@@ -55,7 +59,7 @@ status_t driver_init_mode(const char *name,
 {
     unsigned long count = 0;
 
-    /* see what systems are accessable */
+    /* see what systems are accessable, VMI_MEM has to be asked for explicitly */
 #ifdef ENABLE_XEN
     if (VMI_SUCCESS == xen_test(domainid, name, init_flags, init_data)) {
         dbprint(VMI_DEBUG_DRIVER, "--found Xen\n");
@@ -131,11 +135,23 @@ status_t driver_init(vmi_instance_t vmi,
         case VMI_BAREFLANK:
             rc = driver_bareflank_setup(vmi);
             break;
+#endif
+#ifdef ENABLE_MEM
+        case VMI_MEM:
+            rc = driver_mem_setup(vmi);
+            break;
 #endif
         default:
             break;
     };
 
+    /* in concurrent mode the page cache calls into the driver from any thread */
+    if (rc == VMI_SUCCESS && vmi->concurrent && !vmi->driver.thread_safe) {
+        errprint("The selected LibVMI mode doesn't support VMI_INIT_CONCURRENT.\n");
+        bzero(&vmi->driver, sizeof(driver_interface_t));
+        return VMI_FAILURE;
+    }
+
     if (rc == VMI_SUCCESS && vmi->driver.init_ptr)
         rc = vmi->driver.init_ptr(vmi, init_flags, init_data);
 
@@ -162,3 +178,40 @@ status_t driver_domainwatch_init(vmi_instance_t vmi,
 
     return rc;
 }
+
+/*
+ * Drivers with a clone_ptr share their connection with the clone. The others
+ * open a new one to the same domain, with the clone's init flags and without
+ * init data, so without events.
+ */
+status_t driver_clone(vmi_instance_t vmi,
+                      vmi_instance_t clone)
+{
+    status_t rc;
+    char *name = NULL;
+
+    if (vmi->driver.clone_ptr) {
+        clone->driver = vmi->driver;
+        clone->driver.driver_data = NULL;
+
+        rc = vmi->driver.clone_ptr(vmi, clone);
+        if (VMI_FAILURE == rc)
+            bzero(&clone->driver, sizeof(driver_interface_t));
+
+        return rc;
+    }
+
+    if (VMI_FAILURE == driver_init(clone, clone->init_flags, NULL))
+        return VMI_FAILURE;
+
+    if (vmi->driver.get_id_ptr && clone->driver.set_id_ptr)
+        clone->driver.set_id_ptr(clone, vmi->driver.get_id_ptr(vmi));
+
+    if (vmi->driver.get_name_ptr && clone->driver.set_name_ptr &&
+            VMI_SUCCESS == vmi->driver.get_name_ptr(vmi, &name)) {
+        clone->driver.set_name_ptr(clone, name);
+        free(name);
+    }
+
+    return driver_init_vmi(clone, clone->init_flags, NULL);
+}
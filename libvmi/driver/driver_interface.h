@@ -42,6 +42,9 @@ typedef struct driver_interface {
     status_t (*domainwatch_init_ptr) (
         vmi_instance_t vmi,
         uint32_t init_flags);
+    status_t (*clone_ptr) (
+        vmi_instance_t vmi,
+        vmi_instance_t clone);
     void (*destroy_ptr) (
         vmi_instance_t);
     uint64_t (*get_id_from_name_ptr) (
@@ -112,6 +115,10 @@ typedef struct driver_interface {
     void *(*read_page_ptr) (
         vmi_instance_t,
         addr_t);
+    status_t (*read_pages_ptr) (
+        vmi_instance_t,
+        const addr_t *,
+        unsigned int);
     void *(*mmap_guest) (
         vmi_instance_t,
         unsigned long *,
@@ -196,6 +203,9 @@ typedef struct driver_interface {
     status_t (*set_access_required_ptr)(
         vmi_instance_t vmi,
         bool required);
+    status_t (*set_access_hint_ptr)(
+        vmi_instance_t vmi,
+        access_hint_t hint);
 
     /* Driver-specific data storage. */
     void* driver_data;
@@ -203,6 +213,9 @@ typedef struct driver_interface {
     /* Set to true once driver is initialized. */
     bool initialized;
 
+    /* Set by drivers that may be called from several threads at once. */
+    bool thread_safe;
+
 } driver_interface_t;
 
 status_t driver_init_mode(
@@ -226,5 +239,9 @@ status_t driver_domainwatch_init(
     vmi_instance_t vmi,
     uint32_t init_flags);
 
+status_t driver_clone(
+    vmi_instance_t vmi,
+    vmi_instance_t clone);
+
 #endif /* DRIVER_INTERFACE_H */
 
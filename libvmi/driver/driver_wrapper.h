@@ -333,6 +333,22 @@ driver_read_page(
     return vmi->driver.read_page_ptr(vmi, page);
 }
 
+/*
+ * Batching is optional, callers fall back to driver_read_page
+ * so a missing implementation is not worth a warning.
+ */
+static inline status_t
+driver_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *pages,
+    unsigned int count)
+{
+    if (!vmi->driver.initialized || !vmi->driver.read_pages_ptr)
+        return VMI_FAILURE;
+
+    return vmi->driver.read_pages_ptr(vmi, pages, count);
+}
+
 static inline void *
 driver_mmap_guest(
     vmi_instance_t vmi,
@@ -363,7 +379,13 @@ driver_write(
     }
 #endif
 
-    return vmi->driver.write_ptr(vmi, paddr, buf, length);
+    vmi_stats_t *stats = stats_get(vmi);
+    uint64_t start = stats_clock();
+    status_t ret = vmi->driver.write_ptr(vmi, paddr, buf, length);
+
+    stats_counter_add(&stats->driver_nsec, stats_clock() - start);
+    stats_counter_add(&stats->driver_writes, 1);
+    return ret;
 }
 
 static inline int
@@ -741,5 +763,17 @@ driver_set_access_listener_required(
     return vmi->driver.set_access_required_ptr (vmi, required);
 }
 
+/* Access hints are advisory, a driver without them is not an error */
+static inline status_t
+driver_set_access_hint(
+    vmi_instance_t vmi,
+    access_hint_t hint)
+{
+    if (!vmi->driver.initialized || !vmi->driver.set_access_hint_ptr)
+        return VMI_FAILURE;
+
+    return vmi->driver.set_access_hint_ptr(vmi, hint);
+}
+
 #endif /* DRIVER_WRAPPER_H */
 
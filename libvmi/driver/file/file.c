@@ -37,17 +37,13 @@
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <limits.h>
 
-// Use mmap() if this evaluates to true; otherwise, use a file pointer with
-// seek/read
-#define USE_MMAP 0
-
-// Avoid errors on systems that don't have MAP_POPULATE defined
-#ifndef MAP_POPULATE
-#define MAP_POPULATE 0
-#endif
+// Max number of pages gathered into a single preadv() call
+#define FILE_BATCH_IOV 64
 
 //----------------------------------------------------------------------------
 // File-Specific Interface Functions
@@ -60,7 +56,7 @@ file_get_memory(
 {
     void *memory = 0;
 
-    if (paddr + length >= vmi->max_physical_address) {
+    if (paddr + length > vmi->max_physical_address) {
         dbprint
         (VMI_DEBUG_FILE, "--%s: request for PA range [0x%.16"PRIx64"-0x%.16"PRIx64"] reads past end of file\n",
          __FUNCTION__, paddr, paddr + length);
@@ -72,20 +68,11 @@ file_get_memory(
     if ( !memory )
         return NULL;
 
-#if USE_MMAP
-    (void) memcpy(memory,
-                  ((uint8_t *) file_get_instance(vmi)->map) + paddr,
-                  length);
-#else
-    off_t rc = lseek(file_get_instance(vmi)->fd, paddr, SEEK_SET);
-    if ( rc < 0 || (addr_t)rc != paddr ) {
-        goto error_print;
-    }
-    ssize_t rc2 = read(file_get_instance(vmi)->fd, memory, length);
-    if ( rc2 < 0 || (size_t)rc2 != length ) {
+    /* no shared file offset, threads may fetch pages at the same time */
+    ssize_t rc = pread(file_get_instance(vmi)->fd, memory, length, paddr);
+    if ( rc < 0 || (size_t)rc != length ) {
         goto error_print;
     }
-#endif // USE_MMAP
 
     return memory;
 
@@ -99,6 +86,61 @@ error_noprint:
     return NULL;
 }
 
+/*
+ * Fetch a sorted batch of pages. Physically contiguous pages are read
+ * with a single preadv() each; pages that can't be read are left NULL.
+ */
+void
+file_get_memory_batch(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    void **data,
+    uint32_t count,
+    uint32_t length)
+{
+    struct iovec iov[FILE_BATCH_IOV];
+    uint32_t i = 0, j;
+
+    while (i < count) {
+        addr_t start = paddrs[i];
+        uint32_t run = 0;
+
+        while (i + run < count && run < FILE_BATCH_IOV &&
+                paddrs[i + run] == start + (addr_t)run * length &&
+                paddrs[i + run] + length <= vmi->max_physical_address) {
+
+            void *memory = g_try_malloc0(length);
+            if (!memory)
+                break;
+
+            data[i + run] = memory;
+            iov[run].iov_base = memory;
+            iov[run].iov_len = length;
+            run++;
+        }
+
+        if (!run) {
+            i++;
+            continue;
+        }
+
+        ssize_t rc = preadv(file_get_instance(vmi)->fd, iov, run, start);
+        if ( rc < 0 ) {
+            dbprint(VMI_DEBUG_FILE, "%s: failed to read %u pages at PA (offset) 0x%.16"PRIx64"\n",
+                    __FUNCTION__, run, start);
+            rc = 0;
+        }
+
+        /* drop the pages at the tail of a short read */
+        for (j = rc / length; j < run; j++) {
+            free(data[i + j]);
+            data[i + j] = NULL;
+        }
+
+        i += run;
+    }
+}
+
 void
 file_release_memory(
     vmi_instance_t UNUSED(vmi),
@@ -109,6 +151,105 @@ file_release_memory(
         free(memory);
 }
 
+/*
+ * In mmap mode pages are served straight out of the mapping, there is
+ * nothing to copy and nothing to release.
+ */
+void *
+file_get_memory_mapped(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    uint32_t length)
+{
+    file_instance_t *fi = file_get_instance(vmi);
+
+    if (paddr + length > fi->map_size) {
+        dbprint(VMI_DEBUG_FILE, "--%s: request for PA range [0x%.16"PRIx64"-0x%.16"PRIx64"] reads past end of file\n",
+                __FUNCTION__, paddr, paddr + length);
+        return NULL;
+    }
+
+    return ((uint8_t *) fi->map) + paddr;
+}
+
+void
+file_release_memory_mapped(
+    vmi_instance_t UNUSED(vmi),
+    void *UNUSED(memory),
+    size_t UNUSED(length))
+{
+}
+
+static status_t
+file_setup_mmap(
+    vmi_instance_t vmi,
+    uint32_t mode)
+{
+    file_instance_t *fi = file_get_instance(vmi);
+    struct stat s;
+    void *map;
+
+    if (fstat(fi->fd, &s) == -1 || !s.st_size)
+        return VMI_FAILURE;
+
+    /*
+     * Pages are faulted in on first access, populating the mapping up front
+     * would read the whole dump before we know which parts are needed.
+     */
+    map = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE | MAP_NORESERVE, fi->fd, 0);
+    if (MAP_FAILED == map) {
+        dbprint(VMI_DEBUG_FILE, "--%s: mmap failed: %s\n", __FUNCTION__, strerror(errno));
+        return VMI_FAILURE;
+    }
+
+    if (mode & VMI_FILE_MMAP_HUGEPAGE) {
+#ifdef MADV_HUGEPAGE
+        if (madvise(map, s.st_size, MADV_HUGEPAGE))
+            dbprint(VMI_DEBUG_FILE, "--%s: transparent huge pages not available: %s\n",
+                    __FUNCTION__, strerror(errno));
+#else
+        dbprint(VMI_DEBUG_FILE, "--%s: transparent huge pages not supported\n", __FUNCTION__);
+#endif
+    }
+
+    fi->map = map;
+    fi->map_size = s.st_size;
+
+    return VMI_SUCCESS;
+}
+
+static void
+file_setup_cache(
+    vmi_instance_t vmi)
+{
+    if (file_get_instance(vmi)->map) {
+        /* the page cache is only needed for vmi_pin_page here */
+        memory_cache_init(vmi, file_get_memory_mapped, file_release_memory_mapped,
+                          ULONG_MAX);
+    } else {
+        memory_cache_init(vmi, file_get_memory, file_release_memory,
+                          ULONG_MAX);
+        memory_cache_set_batch(vmi, file_get_memory_batch);
+    }
+}
+
+static uint32_t
+file_get_mode(
+    vmi_init_data_t *init_data)
+{
+    uint64_t i;
+
+    if (!init_data)
+        return 0;
+
+    for (i = 0; i < init_data->count; i++) {
+        if (init_data->entry[i].type == VMI_INIT_DATA_FILE_MODE && init_data->entry[i].data)
+            return *(uint32_t *) init_data->entry[i].data;
+    }
+
+    return 0;
+}
+
 //----------------------------------------------------------------------------
 // General Interface Functions (1-1 mapping to driver_* function)
 
@@ -118,7 +259,13 @@ file_init(
     uint32_t UNUSED(init_flags),
     vmi_init_data_t *UNUSED(init_data))
 {
-    vmi->driver.driver_data = g_try_malloc0(sizeof(file_instance_t));
+    file_instance_t *fi = g_try_malloc0(sizeof(file_instance_t));
+
+    if (!fi)
+        return VMI_FAILURE;
+
+    fi->refs = 1;
+    vmi->driver.driver_data = fi;
     return VMI_SUCCESS;
 }
 
@@ -126,9 +273,10 @@ status_t
 file_init_vmi(
     vmi_instance_t vmi,
     uint32_t UNUSED(init_flags),
-    vmi_init_data_t *UNUSED(init_data))
+    vmi_init_data_t *init_data)
 {
     file_instance_t *fi = file_get_instance(vmi);
+    uint32_t mode = file_get_mode(init_data);
     FILE *fhandle = NULL;
     int fd = -1;
     /* open handle to memory file */
@@ -140,41 +288,11 @@ file_init_vmi(
 
     fi->fhandle = fhandle;
     fi->fd = fd;
-    memory_cache_init(vmi, file_get_memory, file_release_memory,
-                      ULONG_MAX);
-    //    memory_cache_init(vmi, file_get_memory, file_release_memory, 0);
 
-#if USE_MMAP
-    /* try memory mapped file I/O */
-    uint64_t size = 0;
+    if ((mode & VMI_FILE_MMAP) && VMI_FAILURE == file_setup_mmap(vmi, mode))
+        errprint("Failed to mmap file '%s', falling back to read().\n", fi->filename);
 
-    if (VMI_FAILURE == file_get_memsize(vmi, &size)) {
-        goto fail;
-    }   // if
-
-    int mmap_flags = (MAP_PRIVATE | MAP_NORESERVE | MAP_POPULATE);
-
-#ifdef MMAP_HUGETLB // since kernel 2.6.32
-    mmap_flags |= MMAP_HUGETLB;
-#endif // MMAP_HUGETLB
-
-    void *map = mmap(NULL,  // addr
-                     size,  // len
-                     PROT_READ, // prot
-                     mmap_flags,    // flags
-                     fd,    // file descriptor
-                     (off_t) 0);    // offset
-
-    if (MAP_FAILED == map) {
-        perror("Failed to mmap file");
-        goto fail;
-    }
-    fi->map = map;
-
-    // Note: madvise(.., MADV_SEQUENTIAL | MADV_WILLNEED) does not seem to
-    // improve performance
-
-#endif // USE_MMAP
+    file_setup_cache(vmi);
 
     vmi->vm_type = NORMAL;
     return VMI_SUCCESS;
@@ -184,18 +302,41 @@ fail:
     return VMI_FAILURE;
 }
 
+/*
+ * The file is only ever read, with pread or through a read-only mapping,
+ * so clones share the open file and the mapping.
+ */
+status_t
+file_clone(
+    vmi_instance_t vmi,
+    vmi_instance_t clone)
+{
+    file_instance_t *fi = file_get_instance(vmi);
+
+    __atomic_add_fetch(&fi->refs, 1, __ATOMIC_RELAXED);
+    clone->driver.driver_data = fi;
+
+    file_setup_cache(clone);
+
+    clone->vm_type = vmi->vm_type;
+    return VMI_SUCCESS;
+}
+
 void
 file_destroy(
     vmi_instance_t vmi)
 {
     file_instance_t *fi = file_get_instance(vmi);
 
-#if USE_MMAP
+    vmi->driver.driver_data = NULL;
+    if (!fi || __atomic_sub_fetch(&fi->refs, 1, __ATOMIC_ACQ_REL))
+        return;
+
     if (fi->map) {
-        (void) munmap(fi->map, vmi->size);
-        fi->map = 0;
+        (void) munmap(fi->map, fi->map_size);
+        fi->map = NULL;
+        fi->map_size = 0;
     }
-#endif // USE_MMAP
     // fi->fhandle refers to fi->fd; closing both would be an error
     if (fi->fhandle) {
         fclose(fi->fhandle);
@@ -267,9 +408,78 @@ file_read_page(
 {
     addr_t paddr = page << vmi->page_shift;
 
+    if (file_get_instance(vmi)->map)
+        return file_get_memory_mapped(vmi, paddr, vmi->page_size);
+
     return memory_cache_insert(vmi, paddr);
 }
 
+status_t
+file_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *pages,
+    unsigned int count)
+{
+    file_instance_t *fi = file_get_instance(vmi);
+    unsigned int i = 0;
+
+    if (!fi->map)
+        return memory_cache_prefetch(vmi, pages, count);
+
+    /* have the kernel start reading each contiguous run of the batch */
+    while (i < count) {
+        unsigned int run = 1;
+        addr_t paddr = pages[i] << vmi->page_shift;
+
+        while (i + run < count && pages[i + run] == pages[i] + run)
+            run++;
+
+        if (paddr < fi->map_size) {
+            size_t length = (size_t) run << vmi->page_shift;
+
+            if (paddr + length > fi->map_size)
+                length = fi->map_size - paddr;
+
+            (void) madvise(((uint8_t *) fi->map) + paddr, length, MADV_WILLNEED);
+        }
+
+        i += run;
+    }
+
+    return VMI_SUCCESS;
+}
+
+status_t
+file_set_access_hint(
+    vmi_instance_t vmi,
+    access_hint_t hint)
+{
+    file_instance_t *fi = file_get_instance(vmi);
+    int advice, fadvice;
+
+    switch (hint) {
+        case VMI_ACCESS_HINT_NORMAL:
+            advice = MADV_NORMAL;
+            fadvice = POSIX_FADV_NORMAL;
+            break;
+        case VMI_ACCESS_HINT_SEQUENTIAL:
+            advice = MADV_SEQUENTIAL;
+            fadvice = POSIX_FADV_SEQUENTIAL;
+            break;
+        case VMI_ACCESS_HINT_RANDOM:
+            advice = MADV_RANDOM;
+            fadvice = POSIX_FADV_RANDOM;
+            break;
+        default:
+            return VMI_FAILURE;
+    }
+
+    if (fi->map)
+        return madvise(fi->map, fi->map_size, advice) ? VMI_FAILURE : VMI_SUCCESS;
+
+    return posix_fadvise(fi->fd, 0, 0, fadvice) ? VMI_FAILURE : VMI_SUCCESS;
+}
+
 //TODO decide if this functionality makes sense for files
 status_t
 file_write(
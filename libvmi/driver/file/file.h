@@ -31,6 +31,9 @@ status_t file_init_vmi(
     vmi_instance_t vmi,
     uint32_t init_flags,
     vmi_init_data_t *init_data);
+status_t file_clone(
+    vmi_instance_t vmi,
+    vmi_instance_t clone);
 void file_destroy(
     vmi_instance_t vmi);
 status_t file_get_name(
@@ -51,6 +54,13 @@ status_t file_get_vcpureg(
 void *file_read_page(
     vmi_instance_t vmi,
     addr_t page);
+status_t file_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *pages,
+    unsigned int count);
+status_t file_set_access_hint(
+    vmi_instance_t vmi,
+    access_hint_t hint);
 status_t file_write(
     vmi_instance_t vmi,
     addr_t paddr,
@@ -73,18 +83,22 @@ driver_file_setup(vmi_instance_t vmi)
 {
     driver_interface_t driver = { 0 };
     driver.initialized = true;
+    driver.thread_safe = true;
     driver.init_ptr = &file_init;
     driver.init_vmi_ptr = &file_init_vmi;
+    driver.clone_ptr = &file_clone;
     driver.destroy_ptr = &file_destroy;
     driver.get_name_ptr = &file_get_name;
     driver.set_name_ptr = &file_set_name;
     driver.get_memsize_ptr = &file_get_memsize;
     driver.get_vcpureg_ptr = &file_get_vcpureg;
     driver.read_page_ptr = &file_read_page;
+    driver.read_pages_ptr = &file_read_pages;
     driver.write_ptr = &file_write;
     driver.is_pv_ptr = &file_is_pv;
     driver.pause_vm_ptr = &file_pause_vm;
     driver.resume_vm_ptr = &file_resume_vm;
+    driver.set_access_hint_ptr = &file_set_access_hint;
     vmi->driver = driver;
     return VMI_SUCCESS;
 }
@@ -39,7 +39,11 @@ typedef struct file_instance {
 
     char *filename;      /**< name of the file being accessed */
 
-    void *map;           /**< memory mapped file */
+    void *map;           /**< memory mapped file, iff VMI_FILE_MMAP */
+
+    size_t map_size;     /**< size of the mapping */
+
+    unsigned int refs;   /**< instances sharing the file, see file_clone */
 } file_instance_t;
 
 static inline file_instance_t*
@@ -233,7 +233,7 @@ call_event_callback(
 {
     event_response_t response;
     vmi->event_callback = 1;
-    response = libvmi_event->callback(vmi, libvmi_event);
+    response = vmi_event_callback(vmi, libvmi_event);
     vmi->event_callback = 0;
     return response;
 }
@@ -898,6 +898,17 @@ kvm_events_destroy(
         errprint("--Failed to resume VM while destroying events\n");
 }
 
+/* The LibVMI event type of each KVMI event, for the stats; PAUSE_VCPU is internal */
+static const uint8_t event_reason_type[KVMI_NUM_EVENTS] = {
+    [KVMI_EVENT_CR] = VMI_EVENT_REGISTER,
+    [KVMI_EVENT_MSR] = VMI_EVENT_REGISTER,
+    [KVMI_EVENT_BREAKPOINT] = VMI_EVENT_INTERRUPT,
+    [KVMI_EVENT_PF] = VMI_EVENT_MEMORY,
+    [KVMI_EVENT_DESCRIPTOR] = VMI_EVENT_DESCRIPTOR_ACCESS,
+    [KVMI_EVENT_SINGLESTEP] = VMI_EVENT_SINGLESTEP,
+    [KVMI_EVENT_CPUID] = VMI_EVENT_CPUID,
+};
+
 status_t
 kvm_events_listen(
     vmi_instance_t vmi,
@@ -954,6 +965,9 @@ kvm_events_listen(
             goto error_exit;
         }
 #endif
+        if (ev_reason < KVMI_NUM_EVENTS && event_reason_type[ev_reason])
+            stats_inc(vmi, events_received[event_reason_type[ev_reason]]);
+
         if (!vmi->shutting_down) {
             // call handler
             if (VMI_FAILURE == kvm->process_event[ev_reason](vmi, event))
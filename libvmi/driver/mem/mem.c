@@ -0,0 +1,549 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A synthetic guest held in RAM: the memory image is loaded up front and
+ * the vCPU registers come from the description file, the name the instance
+ * is opened with. Every call into the driver can be made to take a fixed
+ * time plus a random jitter, which models the cost of the hypercalls or
+ * socket round trips of a real backend:
+ *
+ *   [memory]
+ *   image=guest.raw        # relative to the description file
+ *
+ *   [latency]
+ *   nsec=2000              # per driver call, a batch of pages is one call
+ *   jitter=500             # up to this many more nanoseconds
+ *   seed=1                 # of the jitter
+ *
+ *   [vcpu0]
+ *   cr0=0x80050033
+ *   cr3=0x1001000
+ *   cr4=0x6f0
+ *   msr_efer=0xd01
+ *
+ * Pages are handed out as copies through the page cache, as with the other
+ * live drivers, so cache sizes, batching and prefetching have the effect
+ * they would have against a hypervisor.
+ */
+
+#include "private.h"
+#include "driver/mem/mem.h"
+#include "driver/mem/mem_private.h"
+#include "driver/driver_interface.h"
+#include "driver/memory_cache.h"
+
+#include <string.h>
+#include <limits.h>
+
+typedef struct mem_reg_name {
+    const char *name;
+    reg_t reg;
+} mem_reg_name_t;
+
+static const mem_reg_name_t mem_reg_names[] = {
+    { "rax", RAX }, { "rbx", RBX }, { "rcx", RCX }, { "rdx", RDX },
+    { "rbp", RBP }, { "rsi", RSI }, { "rdi", RDI }, { "rsp", RSP },
+    { "r8", R8 }, { "r9", R9 }, { "r10", R10 }, { "r11", R11 },
+    { "r12", R12 }, { "r13", R13 }, { "r14", R14 }, { "r15", R15 },
+    { "rip", RIP }, { "rflags", RFLAGS },
+    { "cr0", CR0 }, { "cr2", CR2 }, { "cr3", CR3 }, { "cr4", CR4 },
+    { "xcr0", XCR0 }, { "dr7", DR7 },
+    { "fs_base", FS_BASE }, { "gs_base", GS_BASE }, { "shadow_gs", SHADOW_GS },
+    { "idtr_base", IDTR_BASE }, { "gdtr_base", GDTR_BASE },
+    { "sysenter_cs", SYSENTER_CS }, { "sysenter_esp", SYSENTER_ESP }, { "sysenter_eip", SYSENTER_EIP },
+    { "msr_efer", MSR_EFER }, { "msr_lstar", MSR_LSTAR }, { "msr_cstar", MSR_CSTAR },
+    { "msr_star", MSR_STAR }, { "msr_syscall_mask", MSR_SYSCALL_MASK },
+    { "msr_shadow_gs_base", MSR_SHADOW_GS_BASE },
+    { "sctlr", SCTLR }, { "cpsr", CPSR }, { "ttbcr", TTBCR }, { "tcr_el1", TCR_EL1 },
+    { "ttbr0", TTBR0 }, { "ttbr1", TTBR1 }, { "pc", PC },
+    { "sp_el0", SP_EL0 }, { "sp_el1", SP_EL1 }, { "elr_el1", ELR_EL1 },
+};
+
+//----------------------------------------------------------------------------
+// Mem-Specific Interface Functions
+
+/*
+ * Busy-waits for the latency of a driver call. Sleeping would add the
+ * wakeup latency of the scheduler, which is larger than what is modelled.
+ */
+static void
+mem_delay(
+    mem_instance_t *mi)
+{
+    uint64_t nsec = mi->latency, start, x;
+
+    if (mi->jitter) {
+        /* splitmix64, the state is shared by concurrent callers */
+        x = __atomic_add_fetch(&mi->jitter_state, 0x9e3779b97f4a7c15ull, __ATOMIC_RELAXED);
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        nsec += (x ^ (x >> 31)) % (mi->jitter + 1);
+    }
+
+    if (!nsec)
+        return;
+
+    start = stats_clock();
+    while (stats_clock() - start < nsec)
+        ;
+}
+
+static void *
+mem_get_memory(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    uint32_t length)
+{
+    mem_instance_t *mi = mem_get_instance(vmi);
+    void *memory;
+
+    mem_delay(mi);
+
+    if (paddr + length > mi->size) {
+        dbprint(VMI_DEBUG_DRIVER, "--%s: request for PA range [0x%.16"PRIx64"-0x%.16"PRIx64"] past the image\n",
+                __FUNCTION__, paddr, paddr + length);
+        return NULL;
+    }
+
+    memory = g_try_malloc(length);
+    if (memory)
+        memcpy(memory, mi->image + paddr, length);
+
+    return memory;
+}
+
+/* A batch is one call into the backend, and pays for one */
+static void
+mem_get_memory_batch(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    void **data,
+    uint32_t count,
+    uint32_t length)
+{
+    mem_instance_t *mi = mem_get_instance(vmi);
+    uint32_t i;
+
+    mem_delay(mi);
+
+    for (i = 0; i < count; i++) {
+        if (paddrs[i] + length > mi->size)
+            continue;
+
+        data[i] = g_try_malloc(length);
+        if (data[i])
+            memcpy(data[i], mi->image + paddrs[i], length);
+    }
+}
+
+static void
+mem_release_memory(
+    vmi_instance_t UNUSED(vmi),
+    void *memory,
+    size_t UNUSED(length))
+{
+    g_free(memory);
+}
+
+static void
+mem_setup_cache(
+    vmi_instance_t vmi)
+{
+    /* guest memory only changes through mem_write, which drops the page */
+    memory_cache_init(vmi, mem_get_memory, mem_release_memory, ULONG_MAX);
+    memory_cache_set_batch(vmi, mem_get_memory_batch);
+}
+
+static status_t
+mem_parse_vcpu(
+    GKeyFile *keyfile,
+    const char *group,
+    mem_vcpu_t *vcpu)
+{
+    status_t ret = VMI_FAILURE;
+    gchar **keys = g_key_file_get_keys(keyfile, group, NULL, NULL);
+    gchar *value, *end;
+    reg_t reg;
+    size_t i, j;
+
+    for (i = 0; keys && keys[i]; i++) {
+        for (j = 0; j < G_N_ELEMENTS(mem_reg_names); j++) {
+            if (!g_ascii_strcasecmp(keys[i], mem_reg_names[j].name))
+                break;
+        }
+
+        if (j == G_N_ELEMENTS(mem_reg_names)) {
+            errprint("Unknown register '%s' in [%s].\n", keys[i], group);
+            goto done;
+        }
+
+        value = g_key_file_get_value(keyfile, group, keys[i], NULL);
+        reg = mem_reg_names[j].reg;
+        vcpu->regs[reg] = g_ascii_strtoull(value ? value : "", &end, 0);
+
+        if (!value || end == value || *end) {
+            errprint("Invalid value of %s in [%s].\n", keys[i], group);
+            g_free(value);
+            goto done;
+        }
+
+        vcpu->valid[reg / 64] |= 1ull << (reg % 64);
+        g_free(value);
+    }
+
+    ret = VMI_SUCCESS;
+
+done:
+    g_strfreev(keys);
+    return ret;
+}
+
+static status_t
+mem_parse(
+    mem_instance_t *mi,
+    GKeyFile *keyfile)
+{
+    gchar *image = NULL, *path = NULL, *dir = NULL, *group;
+    GError *error = NULL;
+    gsize size;
+    status_t ret = VMI_FAILURE;
+    unsigned int i;
+
+    image = g_key_file_get_string(keyfile, "memory", "image", NULL);
+    if (!image) {
+        errprint("No [memory] image in '%s'.\n", mi->name);
+        goto done;
+    }
+
+    if (g_path_is_absolute(image)) {
+        path = g_strdup(image);
+    } else {
+        dir = g_path_get_dirname(mi->name);
+        path = g_build_filename(dir, image, NULL);
+    }
+
+    if (!g_file_get_contents(path, (gchar **) &mi->image, &size, &error)) {
+        errprint("Failed to load '%s': %s\n", path, error->message);
+        g_error_free(error);
+        goto done;
+    }
+    mi->size = size;
+
+    /* all optional, no latency by default */
+    mi->latency = g_key_file_get_uint64(keyfile, "latency", "nsec", NULL);
+    mi->jitter = g_key_file_get_uint64(keyfile, "latency", "jitter", NULL);
+    mi->jitter_state = g_key_file_get_uint64(keyfile, "latency", "seed", NULL);
+
+    /* vcpu0, vcpu1, ... up to the first one missing */
+    while (1) {
+        group = g_strdup_printf("vcpu%u", mi->num_vcpus);
+        if (!g_key_file_has_group(keyfile, group)) {
+            g_free(group);
+            break;
+        }
+
+        g_free(group);
+        mi->num_vcpus++;
+    }
+
+    mi->vcpus = g_try_new0(mem_vcpu_t, mi->num_vcpus);
+    if (mi->num_vcpus && !mi->vcpus)
+        goto done;
+
+    for (i = 0; i < mi->num_vcpus; i++) {
+        group = g_strdup_printf("vcpu%u", i);
+        ret = mem_parse_vcpu(keyfile, group, &mi->vcpus[i]);
+        g_free(group);
+
+        if (VMI_FAILURE == ret)
+            goto done;
+    }
+
+    dbprint(VMI_DEBUG_DRIVER, "--mem: %zu bytes, %u vCPUs, %"PRIu64"ns latency, %"PRIu64"ns jitter\n",
+            mi->size, mi->num_vcpus, mi->latency, mi->jitter);
+    ret = VMI_SUCCESS;
+
+done:
+    g_free(image);
+    g_free(path);
+    g_free(dir);
+    return ret;
+}
+
+//----------------------------------------------------------------------------
+// General Interface Functions (1-1 mapping to driver_* function)
+
+status_t
+mem_init(
+    vmi_instance_t vmi,
+    uint32_t UNUSED(init_flags),
+    vmi_init_data_t *UNUSED(init_data))
+{
+    mem_instance_t *mi = g_try_malloc0(sizeof(mem_instance_t));
+
+    if (!mi)
+        return VMI_FAILURE;
+
+    mi->refs = 1;
+    vmi->driver.driver_data = mi;
+    return VMI_SUCCESS;
+}
+
+status_t
+mem_init_vmi(
+    vmi_instance_t vmi,
+    uint32_t UNUSED(init_flags),
+    vmi_init_data_t *UNUSED(init_data))
+{
+    mem_instance_t *mi = mem_get_instance(vmi);
+    GKeyFile *keyfile = g_key_file_new();
+    GError *error = NULL;
+    status_t ret = VMI_FAILURE;
+
+    if (!g_key_file_load_from_file(keyfile, mi->name, G_KEY_FILE_NONE, &error)) {
+        errprint("Failed to read guest description '%s': %s\n", mi->name, error->message);
+        g_error_free(error);
+        goto done;
+    }
+
+    if (VMI_FAILURE == mem_parse(mi, keyfile))
+        goto done;
+
+    mem_setup_cache(vmi);
+
+    vmi->num_vcpus = mi->num_vcpus;
+    vmi->vm_type = NORMAL;
+    ret = VMI_SUCCESS;
+
+done:
+    g_key_file_free(keyfile);
+    return ret;
+}
+
+/*
+ * Clones share the image and the registers. Each has a page cache of its
+ * own, so writes through one are not seen by pages the others have cached,
+ * as with clones of the Xen driver.
+ */
+status_t
+mem_clone(
+    vmi_instance_t vmi,
+    vmi_instance_t clone)
+{
+    mem_instance_t *mi = mem_get_instance(vmi);
+
+    __atomic_add_fetch(&mi->refs, 1, __ATOMIC_RELAXED);
+    clone->driver.driver_data = mi;
+
+    mem_setup_cache(clone);
+
+    clone->num_vcpus = vmi->num_vcpus;
+    clone->vm_type = vmi->vm_type;
+    return VMI_SUCCESS;
+}
+
+void
+mem_destroy(
+    vmi_instance_t vmi)
+{
+    mem_instance_t *mi = mem_get_instance(vmi);
+
+    vmi->driver.driver_data = NULL;
+    if (!mi || __atomic_sub_fetch(&mi->refs, 1, __ATOMIC_ACQ_REL))
+        return;
+
+    g_free(mi->image);
+    g_free(mi->vcpus);
+    g_free(mi->name);
+    g_free(mi);
+}
+
+/* There is a single guest per instance, the description names it */
+uint64_t
+mem_get_id_from_name(
+    vmi_instance_t UNUSED(vmi),
+    const char *name)
+{
+    return g_file_test(name, G_FILE_TEST_IS_REGULAR) ? 0 : VMI_INVALID_DOMID;
+}
+
+uint64_t
+mem_get_id(
+    vmi_instance_t UNUSED(vmi))
+{
+    return 0;
+}
+
+void
+mem_set_id(
+    vmi_instance_t UNUSED(vmi),
+    uint64_t UNUSED(id))
+{
+}
+
+status_t
+mem_check_id(
+    vmi_instance_t UNUSED(vmi),
+    uint64_t id)
+{
+    return id ? VMI_FAILURE : VMI_SUCCESS;
+}
+
+status_t
+mem_get_name(
+    vmi_instance_t vmi,
+    char **name)
+{
+    *name = strdup(mem_get_instance(vmi)->name);
+    return *name ? VMI_SUCCESS : VMI_FAILURE;
+}
+
+void
+mem_set_name(
+    vmi_instance_t vmi,
+    const char *name)
+{
+    mem_instance_t *mi = mem_get_instance(vmi);
+
+    g_free(mi->name);
+    mi->name = g_strdup(name);
+}
+
+status_t
+mem_get_memsize(
+    vmi_instance_t vmi,
+    uint64_t *allocated_ram_size,
+    addr_t *max_physical_address)
+{
+    mem_instance_t *mi = mem_get_instance(vmi);
+
+    *allocated_ram_size = mi->size;
+    *max_physical_address = mi->size;
+    return VMI_SUCCESS;
+}
+
+status_t
+mem_get_vcpureg(
+    vmi_instance_t vmi,
+    uint64_t *value,
+    reg_t reg,
+    unsigned long vcpu)
+{
+    mem_instance_t *mi = mem_get_instance(vmi);
+    mem_vcpu_t *v;
+
+    mem_delay(mi);
+
+    if (vcpu >= mi->num_vcpus || reg >= MEM_REGS)
+        return VMI_FAILURE;
+
+    v = &mi->vcpus[vcpu];
+    if (!(v->valid[reg / 64] & (1ull << (reg % 64))))
+        return VMI_FAILURE;
+
+    *value = v->regs[reg];
+    return VMI_SUCCESS;
+}
+
+status_t
+mem_set_vcpureg(
+    vmi_instance_t vmi,
+    uint64_t value,
+    reg_t reg,
+    unsigned long vcpu)
+{
+    mem_instance_t *mi = mem_get_instance(vmi);
+    mem_vcpu_t *v;
+
+    mem_delay(mi);
+
+    if (vcpu >= mi->num_vcpus || reg >= MEM_REGS)
+        return VMI_FAILURE;
+
+    v = &mi->vcpus[vcpu];
+    v->regs[reg] = value;
+    v->valid[reg / 64] |= 1ull << (reg % 64);
+    return VMI_SUCCESS;
+}
+
+void *
+mem_read_page(
+    vmi_instance_t vmi,
+    addr_t page)
+{
+    return memory_cache_insert(vmi, page << vmi->page_shift);
+}
+
+status_t
+mem_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *pages,
+    unsigned int count)
+{
+    return memory_cache_prefetch(vmi, pages, count);
+}
+
+status_t
+mem_write(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    void *buf,
+    uint32_t length)
+{
+    mem_instance_t *mi = mem_get_instance(vmi);
+    addr_t page;
+
+    mem_delay(mi);
+
+    if (!length)
+        return VMI_SUCCESS;
+    if (paddr + length > mi->size)
+        return VMI_FAILURE;
+
+    memcpy(mi->image + paddr, buf, length);
+
+    /* the page cache holds copies */
+    for (page = paddr >> vmi->page_shift; page <= (paddr + length - 1) >> vmi->page_shift; page++)
+        memory_cache_remove(vmi, page << vmi->page_shift);
+
+    return VMI_SUCCESS;
+}
+
+int
+mem_is_pv(
+    vmi_instance_t UNUSED(vmi))
+{
+    return 0;
+}
+
+status_t
+mem_pause_vm(
+    vmi_instance_t UNUSED(vmi))
+{
+    return VMI_SUCCESS;
+}
+
+status_t
+mem_resume_vm(
+    vmi_instance_t UNUSED(vmi))
+{
+    return VMI_SUCCESS;
+}
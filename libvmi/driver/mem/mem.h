@@ -0,0 +1,116 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEM_DRIVER_H
+#define MEM_DRIVER_H
+
+status_t mem_init(
+    vmi_instance_t vmi,
+    uint32_t init_flags,
+    vmi_init_data_t *init_data);
+status_t mem_init_vmi(
+    vmi_instance_t vmi,
+    uint32_t init_flags,
+    vmi_init_data_t *init_data);
+status_t mem_clone(
+    vmi_instance_t vmi,
+    vmi_instance_t clone);
+void mem_destroy(
+    vmi_instance_t vmi);
+uint64_t mem_get_id_from_name(
+    vmi_instance_t vmi,
+    const char *name);
+uint64_t mem_get_id(
+    vmi_instance_t vmi);
+void mem_set_id(
+    vmi_instance_t vmi,
+    uint64_t id);
+status_t mem_check_id(
+    vmi_instance_t vmi,
+    uint64_t id);
+status_t mem_get_name(
+    vmi_instance_t vmi,
+    char **name);
+void mem_set_name(
+    vmi_instance_t vmi,
+    const char *name);
+status_t mem_get_memsize(
+    vmi_instance_t vmi,
+    uint64_t *allocated_ram_size,
+    addr_t *maximum_physical_address);
+status_t mem_get_vcpureg(
+    vmi_instance_t vmi,
+    uint64_t *value,
+    reg_t reg,
+    unsigned long vcpu);
+status_t mem_set_vcpureg(
+    vmi_instance_t vmi,
+    uint64_t value,
+    reg_t reg,
+    unsigned long vcpu);
+void *mem_read_page(
+    vmi_instance_t vmi,
+    addr_t page);
+status_t mem_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *pages,
+    unsigned int count);
+status_t mem_write(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    void *buf,
+    uint32_t length);
+int mem_is_pv(
+    vmi_instance_t vmi);
+status_t mem_pause_vm(
+    vmi_instance_t vmi);
+status_t mem_resume_vm(
+    vmi_instance_t vmi);
+
+static inline status_t
+driver_mem_setup(vmi_instance_t vmi)
+{
+    driver_interface_t driver = { 0 };
+    driver.initialized = true;
+    driver.thread_safe = true;
+    driver.init_ptr = &mem_init;
+    driver.init_vmi_ptr = &mem_init_vmi;
+    driver.clone_ptr = &mem_clone;
+    driver.destroy_ptr = &mem_destroy;
+    driver.get_id_from_name_ptr = &mem_get_id_from_name;
+    driver.get_id_ptr = &mem_get_id;
+    driver.set_id_ptr = &mem_set_id;
+    driver.check_id_ptr = &mem_check_id;
+    driver.get_name_ptr = &mem_get_name;
+    driver.set_name_ptr = &mem_set_name;
+    driver.get_memsize_ptr = &mem_get_memsize;
+    driver.get_vcpureg_ptr = &mem_get_vcpureg;
+    driver.set_vcpureg_ptr = &mem_set_vcpureg;
+    driver.read_page_ptr = &mem_read_page;
+    driver.read_pages_ptr = &mem_read_pages;
+    driver.write_ptr = &mem_write;
+    driver.is_pv_ptr = &mem_is_pv;
+    driver.pause_vm_ptr = &mem_pause_vm;
+    driver.resume_vm_ptr = &mem_resume_vm;
+    vmi->driver = driver;
+    return VMI_SUCCESS;
+}
+
+#endif /* MEM_DRIVER_H */
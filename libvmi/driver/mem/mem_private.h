@@ -0,0 +1,64 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEM_PRIVATE_H
+#define MEM_PRIVATE_H
+
+#include "private.h"
+#include "driver/mem/mem.h"
+
+/* Every reg_t below MSR_ANY can be given a value */
+#define MEM_REGS    MSR_ANY
+
+typedef struct mem_vcpu {
+
+    uint64_t regs[MEM_REGS];    /**< register values, indexed by reg_t */
+
+    uint64_t valid[(MEM_REGS + 63) / 64]; /**< bitmap of the registers given a value */
+} mem_vcpu_t;
+
+typedef struct mem_instance {
+
+    char *name;                 /**< path of the description file */
+
+    uint8_t *image;             /**< guest physical memory */
+
+    size_t size;                /**< size of the image */
+
+    mem_vcpu_t *vcpus;
+
+    unsigned int num_vcpus;
+
+    uint64_t latency;           /**< nanoseconds every driver call takes */
+
+    uint64_t jitter;            /**< up to this many more, uniformly distributed */
+
+    uint64_t jitter_state;      /**< splitmix64 state of the jitter */
+
+    unsigned int refs;          /**< instances sharing the image, see mem_clone */
+} mem_instance_t;
+
+static inline mem_instance_t*
+mem_get_instance(vmi_instance_t vmi)
+{
+    return ((mem_instance_t *) vmi->driver.driver_data);
+}
+
+#endif /* MEM_PRIVATE_H */
@@ -30,14 +30,20 @@
 
 #include "private.h"
 #include "glib_compat.h"
+#include "driver/memory_cache.h"
 
 struct memory_cache_entry {
-    vmi_instance_t vmi;
     addr_t paddr;
     uint32_t length;
     time_t last_updated;
     time_t last_used;
     void *data;
+    uint32_t pins;                      /**< number of outstanding vmi_pin_page borrows */
+    bool detached;                      /**< dropped from the cache while pinned */
+
+    struct memory_cache_entry *hnext;   /**< next entry in the hash bucket */
+    struct memory_cache_entry *prev;    /**< LRU list, towards most recently used */
+    struct memory_cache_entry *next;    /**< LRU list, towards least recently used */
 };
 typedef struct memory_cache_entry *memory_cache_entry_t;
 
@@ -47,68 +53,324 @@ void *get_memory_data(
     addr_t paddr,
     uint32_t length)
 {
-    return vmi->get_data_callback(vmi, paddr, length);
+    vmi_stats_t *stats = stats_get(vmi);
+    uint64_t start = stats_clock();
+    void *data = vmi->get_data_callback(vmi, paddr, length);
+
+    stats_counter_add(&stats->driver_nsec, stats_clock() - start);
+    if (data) {
+        stats_counter_add(&stats->driver_page_fetches, 1);
+        stats_counter_add(&stats->driver_bytes, length);
+    }
+
+    return data;
 }
 
 #ifdef ENABLE_PAGE_CACHE
+/*
+ * The page cache is split into a fixed number of shards selected by the
+ * hash of the physical address. Each shard holds its own open hash table,
+ * an intrusive LRU list and a slab allocator for its entries, so hits,
+ * inserts and evictions are all O(1) and never touch the other shards.
+ *
+ * In concurrent mode every shard has its own lock, so threads reading
+ * different pages rarely wait for each other. A page handed out without a
+ * pin can be evicted by another thread at any time, which is why the read
+ * path pins pages in concurrent mode.
+ */
+#define MEMORY_CACHE_SHARDS         16
+#define MEMORY_CACHE_SLAB_ENTRIES   64
+
+/*
+ * Read-ahead: misses on consecutive frames start a stream, which then keeps
+ * one window of frames prefetched ahead of the scan. The window starts at
+ * MEMORY_CACHE_RA_MIN pages and doubles every time the scan reaches it, up
+ * to the configured maximum (and never more than a quarter of the cache).
+ */
+#define MEMORY_CACHE_RA_STREAMS     4
+#define MEMORY_CACHE_RA_MIN         8
+#define MEMORY_CACHE_RA_DEFAULT     128
+#define MEMORY_CACHE_RA_LIMIT       256
+
+struct memory_cache_slab {
+    struct memory_cache_slab *next;
+    struct memory_cache_entry entries[MEMORY_CACHE_SLAB_ENTRIES];
+};
+
+struct memory_cache_shard {
+    memory_cache_entry_t *buckets;      /**< hash buckets (power of two) */
+    uint32_t bucket_mask;
+
+    struct memory_cache_entry lru;      /**< sentinel, lru.next is the MRU entry */
+    uint32_t count;                     /**< number of entries in use */
+    uint32_t size_max;                  /**< max number of entries in this shard */
+
+    memory_cache_entry_t free_list;     /**< unused entries, linked via hnext */
+    struct memory_cache_slab *slabs;    /**< slabs backing the entries */
+
+    pthread_mutex_t lock;               /**< taken in concurrent mode */
+};
+
+struct memory_cache_stream {
+    addr_t next;                        /**< frame whose miss continues the stream */
+    addr_t trigger;                     /**< frame whose access prefetches the next window */
+    addr_t end;                         /**< first frame past the prefetched window */
+    uint32_t window;                    /**< pages in the last window, 0 for a candidate */
+    uint64_t last_used;
+};
+
+struct memory_cache {
+    struct memory_cache_shard shards[MEMORY_CACHE_SHARDS];
+    uint32_t size_max;                  /**< max number of pages in the cache */
+    uint32_t age;                       /**< max age of an entry in seconds */
+
+    uint32_t ra_max;                    /**< max read-ahead window in pages, 0 disables */
+    uint64_t ra_clock;
+    struct memory_cache_stream streams[MEMORY_CACHE_RA_STREAMS];
+    pthread_mutex_t ra_lock;            /**< protects the streams in concurrent mode */
+};
+
 //---------------------------------------------------------
 // Internal implementation functions
 
+static inline uint64_t
+memory_cache_hash(
+    addr_t paddr)
+{
+    // Fibonacci hashing, the low bits of paddr are always zero
+    return (paddr >> 12) * 0x9e3779b97f4a7c15ull;
+}
+
+static inline struct memory_cache_shard *
+memory_cache_get_shard(
+    struct memory_cache *cache,
+    uint64_t hash)
+{
+    return &cache->shards[hash >> 60];
+}
+
+static inline memory_cache_entry_t *
+memory_cache_get_bucket(
+    struct memory_cache_shard *shard,
+    uint64_t hash)
+{
+    return &shard->buckets[(uint32_t)(hash >> 20) & shard->bucket_mask];
+}
+
+static inline void
+lru_unlink(
+    memory_cache_entry_t entry)
+{
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+}
+
+static inline void
+lru_push_head(
+    struct memory_cache_shard *shard,
+    memory_cache_entry_t entry)
+{
+    entry->prev = &shard->lru;
+    entry->next = shard->lru.next;
+    shard->lru.next->prev = entry;
+    shard->lru.next = entry;
+}
+
+static memory_cache_entry_t
+entry_alloc(
+    struct memory_cache_shard *shard)
+{
+    memory_cache_entry_t entry = shard->free_list;
+
+    if (!entry) {
+        unsigned int i;
+        struct memory_cache_slab *slab = g_try_malloc0(sizeof(struct memory_cache_slab));
+
+        if (!slab)
+            return NULL;
+
+        slab->next = shard->slabs;
+        shard->slabs = slab;
+
+        for (i = 1; i < MEMORY_CACHE_SLAB_ENTRIES; i++) {
+            slab->entries[i].hnext = shard->free_list;
+            shard->free_list = &slab->entries[i];
+        }
+
+        entry = &slab->entries[0];
+    } else
+        shard->free_list = entry->hnext;
+
+    return entry;
+}
+
+static inline void
+entry_free(
+    struct memory_cache_shard *shard,
+    memory_cache_entry_t entry)
+{
+    entry->data = NULL;
+    entry->hnext = shard->free_list;
+    shard->free_list = entry;
+}
+
+static memory_cache_entry_t
+shard_lookup(
+    struct memory_cache_shard *shard,
+    uint64_t hash,
+    addr_t paddr)
+{
+    memory_cache_entry_t entry = *memory_cache_get_bucket(shard, hash);
+
+    while (entry && entry->paddr != paddr)
+        entry = entry->hnext;
+
+    return entry;
+}
+
+/*
+ * Unlink entry from its bucket and the LRU list and release its data.
+ * A pinned entry is only detached, it is released when the last pin goes.
+ */
 static void
-memory_cache_entry_free(
-    gpointer data)
+shard_remove(
+    vmi_instance_t vmi,
+    struct memory_cache_shard *shard,
+    memory_cache_entry_t entry)
 {
-    memory_cache_entry_t entry = (memory_cache_entry_t) data;
+    memory_cache_entry_t *link = memory_cache_get_bucket(shard, memory_cache_hash(entry->paddr));
 
-    if (entry) {
-        entry->vmi->release_data_callback(entry->vmi, entry->data, entry->length);
-        g_slice_free(struct memory_cache_entry, entry);
+    while (*link != entry)
+        link = &(*link)->hnext;
+    *link = entry->hnext;
+
+    lru_unlink(entry);
+    shard->count--;
+
+    if (entry->pins) {
+        entry->detached = true;
+        return;
     }
+
+    if (entry->data)
+        vmi->release_data_callback(vmi, entry->data, entry->length);
+
+    entry_free(shard, entry);
 }
 
 static void
-clean_cache(
-    vmi_instance_t vmi)
+shard_evict(
+    vmi_instance_t vmi,
+    struct memory_cache_shard *shard,
+    uint32_t size_max)
 {
-    while (g_queue_get_length(vmi->memory_cache_lru) > vmi->memory_cache_size_max / 2) {
-        gint64 *paddr = g_queue_pop_tail(vmi->memory_cache_lru);
+    memory_cache_entry_t victim = shard->lru.prev;
 
-        g_hash_table_remove(vmi->memory_cache, paddr);
-        g_slice_free(gint64, paddr);
+    while (shard->count > size_max && victim != &shard->lru) {
+        memory_cache_entry_t prev = victim->prev;
+
+        /* borrowed pages stay until they are unpinned */
+        if (!victim->pins) {
+            dbprint(VMI_DEBUG_MEMCACHE, "--MEMORY cache evict 0x%"PRIx64"\n", victim->paddr);
+            shard_remove(vmi, shard, victim);
+            stats_inc(vmi, page_cache_evictions);
+        }
+
+        victim = prev;
     }
+}
 
-    dbprint(VMI_DEBUG_MEMCACHE, "--MEMORY cache cleanup round complete (cache size = %u)\n",
-            g_hash_table_size(vmi->memory_cache));
+static void
+shard_clear(
+    vmi_instance_t vmi,
+    struct memory_cache_shard *shard)
+{
+    while (shard->lru.prev != &shard->lru)
+        shard_remove(vmi, shard, shard->lru.prev);
+}
+
+/* Size the buckets to keep the load factor at or below one */
+static status_t
+shard_resize(
+    struct memory_cache_shard *shard,
+    uint32_t size_max)
+{
+    uint32_t i, nbuckets = 1;
+    memory_cache_entry_t *buckets;
+    struct memory_cache_slab *slab;
+
+    while (nbuckets < size_max)
+        nbuckets <<= 1;
+
+    if (shard->buckets && nbuckets == shard->bucket_mask + 1) {
+        shard->size_max = size_max;
+        return VMI_SUCCESS;
+    }
+
+    buckets = g_try_malloc0(nbuckets * sizeof(memory_cache_entry_t));
+    if (!buckets)
+        return VMI_FAILURE;
+
+    /* rehash the entries that are currently in use */
+    for (slab = shard->slabs; slab; slab = slab->next) {
+        for (i = 0; i < MEMORY_CACHE_SLAB_ENTRIES; i++) {
+            memory_cache_entry_t entry = &slab->entries[i];
+            uint64_t hash;
+
+            if (!entry->data || entry->detached)
+                continue;
+
+            hash = memory_cache_hash(entry->paddr);
+            entry->hnext = buckets[(uint32_t)(hash >> 20) & (nbuckets - 1)];
+            buckets[(uint32_t)(hash >> 20) & (nbuckets - 1)] = entry;
+        }
+    }
+
+    g_free(shard->buckets);
+    shard->buckets = buckets;
+    shard->bucket_mask = nbuckets - 1;
+    shard->size_max = size_max;
+
+    return VMI_SUCCESS;
 }
 
 static void *
 validate_and_return_data(
     vmi_instance_t vmi,
+    struct memory_cache_shard *shard,
     memory_cache_entry_t entry)
 {
     time_t now = time(NULL);
 
-    if (vmi->memory_cache_age &&
-            (now - entry->last_updated > vmi->memory_cache_age)) {
+    /* a pinned page can't be swapped out from under its borrower */
+    if (vmi->memory_cache->age && !entry->pins &&
+            (now - entry->last_updated > vmi->memory_cache->age)) {
         dbprint(VMI_DEBUG_MEMCACHE, "--MEMORY cache refresh 0x%"PRIx64"\n", entry->paddr);
         vmi->release_data_callback(vmi, entry->data, entry->length);
         entry->data = get_memory_data(vmi, entry->paddr, entry->length);
         entry->last_updated = now;
 
-        GList* lru_entry = g_queue_find_custom(vmi->memory_cache_lru,
-                                               &entry->paddr, g_int64_equal);
-        g_queue_unlink(vmi->memory_cache_lru,
-                       lru_entry);
-        g_queue_push_head_link(vmi->memory_cache_lru, lru_entry);
+        if (!entry->data) {
+            shard_remove(vmi, shard, entry);
+            return NULL;
+        }
     }
+
+    if (shard->lru.next != entry) {
+        lru_unlink(entry);
+        lru_push_head(shard, entry);
+    }
+
     entry->last_used = now;
     return entry->data;
 }
 
-static memory_cache_entry_t create_new_entry (vmi_instance_t vmi, addr_t paddr,
-        uint32_t length)
+static bool
+is_valid_paddr(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    uint32_t length)
 {
-
     // sanity check - are we getting memory outside of the physical memory range?
     //
     // This does not work with a Xen PV VM during page table lookups, because
@@ -141,20 +403,266 @@ static memory_cache_entry_t create_new_entry (vmi_instance_t vmi, addr_t paddr,
         }
     }
 
-    memory_cache_entry_t entry = g_slice_new(struct memory_cache_entry);
-    entry->vmi = vmi;
+    return true;
+
+err_exit:
+    dbprint(VMI_DEBUG_MEMCACHE, "--requested PA [0x%"PRIx64"-0x%"PRIx64"] is outside valid physical memory\n",
+            paddr, paddr + length);
+    return false;
+}
+
+static memory_cache_entry_t
+insert_entry(
+    vmi_instance_t vmi,
+    struct memory_cache_shard *shard,
+    uint64_t hash,
+    addr_t paddr,
+    uint32_t length,
+    void *data)
+{
+    memory_cache_entry_t entry, *bucket;
+
+    /* make room before taking a new entry from the slab */
+    shard_evict(vmi, shard, shard->size_max - 1);
+
+    entry = entry_alloc(shard);
+    if (!entry) {
+        vmi->release_data_callback(vmi, data, length);
+        return NULL;
+    }
+
     entry->paddr = paddr;
     entry->length = length;
+    entry->pins = 0;
+    entry->detached = false;
     entry->last_updated = time(NULL);
     entry->last_used = entry->last_updated;
-    entry->data = get_memory_data(vmi, paddr, length);
+    entry->data = data;
+
+    bucket = memory_cache_get_bucket(shard, hash);
+    entry->hnext = *bucket;
+    *bucket = entry;
+
+    lru_push_head(shard, entry);
+    shard->count++;
 
     return entry;
+}
 
-err_exit:
-    dbprint(VMI_DEBUG_MEMCACHE, "--requested PA [0x%"PRIx64"-0x%"PRIx64"] is outside valid physical memory\n",
-            paddr, paddr + length);
-    return NULL;
+static memory_cache_entry_t
+create_new_entry(
+    vmi_instance_t vmi,
+    struct memory_cache_shard *shard,
+    uint64_t hash,
+    addr_t paddr,
+    uint32_t length)
+{
+    void *data;
+
+    if (!is_valid_paddr(vmi, paddr, length))
+        return NULL;
+
+    data = get_memory_data(vmi, paddr, length);
+    if (!data)
+        return NULL;
+
+    return insert_entry(vmi, shard, hash, paddr, length, data);
+}
+
+static void
+readahead_window(
+    vmi_instance_t vmi,
+    struct memory_cache_stream *stream,
+    addr_t start,
+    uint32_t window)
+{
+    stream->trigger = start;
+    stream->end = start + window;
+    stream->next = stream->end;
+    stream->window = window;
+    stream->last_used = ++vmi->memory_cache->ra_clock;
+}
+
+static void
+readahead_fetch(
+    vmi_instance_t vmi,
+    addr_t start,
+    uint32_t window)
+{
+    addr_t frames[MEMORY_CACHE_RA_LIMIT];
+    uint32_t i;
+
+    for (i = 0; i < window; i++)
+        frames[i] = start + i;
+
+    dbprint(VMI_DEBUG_MEMCACHE, "--MEMORY cache read-ahead %u pages at 0x%"PRIx64"\n",
+            window, start << vmi->page_shift);
+
+    (void) memory_cache_prefetch(vmi, frames, window);
+}
+
+/*
+ * Returns true if it prefetched, which may have evicted the page that was
+ * looked up before. In concurrent mode the read-ahead is only a hint: a
+ * thread that finds another one deciding on it skips it.
+ */
+static bool
+readahead(
+    vmi_instance_t vmi,
+    addr_t frame,
+    bool hit)
+{
+    struct memory_cache *cache = vmi->memory_cache;
+    struct memory_cache_stream *stream, *victim = NULL;
+    uint32_t ra_max = __atomic_load_n(&cache->ra_max, __ATOMIC_RELAXED);
+    uint32_t size_max = __atomic_load_n(&cache->size_max, __ATOMIC_RELAXED);
+    uint32_t window = 0, i;
+    addr_t start = 0;
+
+    if (ra_max > size_max / 4)
+        ra_max = size_max / 4;
+
+    if (ra_max < MEMORY_CACHE_RA_MIN || !vmi->get_data_batch_callback)
+        return false;
+
+    if (vmi->concurrent && pthread_mutex_trylock(&cache->ra_lock))
+        return false;
+
+    for (i = 0; i < MEMORY_CACHE_RA_STREAMS; i++) {
+        stream = &cache->streams[i];
+
+        /* the scan reached the last window, fetch the one after it */
+        if (stream->window && frame == stream->trigger) {
+            start = stream->end;
+            window = MIN(stream->window * 2, ra_max);
+            break;
+        }
+
+        /* consecutive misses, or the scan outran the read-ahead */
+        if (!hit && frame == stream->next) {
+            start = frame + 1;
+            window = stream->window ? MIN(stream->window * 2, ra_max) : MEMORY_CACHE_RA_MIN;
+            break;
+        }
+
+        if (!victim || stream->last_used < victim->last_used)
+            victim = stream;
+    }
+
+    if (window)
+        readahead_window(vmi, stream, start, window);
+    else if (!hit) {
+        /* a miss nobody expected may be the start of a new stream */
+        victim->next = frame + 1;
+        victim->trigger = ~0ull;
+        victim->end = 0;
+        victim->window = 0;
+        victim->last_used = ++cache->ra_clock;
+    }
+
+    vmi_unlock(vmi, &cache->ra_lock);
+
+    if (!window)
+        return false;
+
+    readahead_fetch(vmi, start, window);
+    return true;
+}
+
+static status_t
+memory_cache_resize(
+    vmi_instance_t vmi,
+    uint32_t size_max)
+{
+    struct memory_cache *cache = vmi->memory_cache;
+    uint32_t i, shard_max;
+
+    if (!size_max)
+        size_max = 1;
+
+    shard_max = (size_max + MEMORY_CACHE_SHARDS - 1) / MEMORY_CACHE_SHARDS;
+
+    for (i = 0; i < MEMORY_CACHE_SHARDS; i++) {
+        struct memory_cache_shard *shard = &cache->shards[i];
+        status_t ret;
+
+        vmi_lock(vmi, &shard->lock);
+        shard_evict(vmi, shard, shard_max);
+        ret = shard_resize(shard, shard_max);
+        vmi_unlock(vmi, &shard->lock);
+
+        if (VMI_FAILURE == ret)
+            return VMI_FAILURE;
+    }
+
+    __atomic_store_n(&cache->size_max, size_max, __ATOMIC_RELAXED);
+
+    dbprint(VMI_DEBUG_MEMCACHE, "--MEMORY cache resized to %u pages\n", size_max);
+    return VMI_SUCCESS;
+}
+
+/*
+ * Looks the page up, fetching it on a miss, and pins it if asked to. The
+ * shard stays locked while a missing page is fetched, so two threads
+ * missing the same page don't both fetch it.
+ */
+static void *
+memory_cache_get(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    page_pin_t *pin)
+{
+    memory_cache_entry_t entry;
+    struct memory_cache_shard *shard;
+    addr_t paddr_aligned = paddr & ~(((addr_t) vmi->page_size) - 1);
+    uint64_t hash;
+    void *data;
+    bool prefetched;
+
+    if (paddr != paddr_aligned) {
+        errprint("Memory cache request for non-aligned page\n");
+        return NULL;
+    }
+
+    if (!vmi->memory_cache)
+        return NULL;
+
+    hash = memory_cache_hash(paddr);
+    shard = memory_cache_get_shard(vmi->memory_cache, hash);
+
+    vmi_lock(vmi, &shard->lock);
+    entry = shard_lookup(shard, hash, paddr);
+    vmi_unlock(vmi, &shard->lock);
+
+    prefetched = readahead(vmi, paddr >> vmi->page_shift, !!entry);
+
+    vmi_lock(vmi, &shard->lock);
+
+    /* the read-ahead may have evicted it, and so may other threads */
+    if (prefetched || vmi->concurrent)
+        entry = shard_lookup(shard, hash, paddr);
+
+    if (entry) {
+        dbprint(VMI_DEBUG_MEMCACHE, "--MEMORY cache hit 0x%"PRIx64"\n", paddr);
+        stats_inc(vmi, page_cache_hits);
+        data = validate_and_return_data(vmi, shard, entry);
+    } else {
+        dbprint(VMI_DEBUG_MEMCACHE, "--MEMORY cache set 0x%"PRIx64"\n", paddr);
+        stats_inc(vmi, page_cache_misses);
+
+        entry = create_new_entry(vmi, shard, hash, paddr, vmi->page_size);
+        data = entry ? entry->data : NULL;
+        if (!entry)
+            dbprint(VMI_DEBUG_MEMCACHE, "create_new_entry failed\n");
+    }
+
+    if (data && pin) {
+        entry->pins++;
+        *pin = (page_pin_t) entry;
+    }
+
+    vmi_unlock(vmi, &shard->lock);
+    return data;
 }
 
 //---------------------------------------------------------
@@ -170,15 +678,35 @@ memory_cache_init(
                           size_t),
     unsigned long age_limit)
 {
-    vmi->memory_cache =
-        g_hash_table_new_full(g_int64_hash, g_int64_equal,
-                              free_gint64,
-                              memory_cache_entry_free);
-    vmi->memory_cache_lru = g_queue_new();
-    vmi->memory_cache_age = age_limit;
-    vmi->memory_cache_size_max = MAX_PAGE_CACHE_SIZE;
+    unsigned int i;
+    struct memory_cache *cache = g_try_malloc0(sizeof(struct memory_cache));
+
     vmi->get_data_callback = get_data;
     vmi->release_data_callback = release_data;
+    vmi->get_data_batch_callback = NULL;
+
+    if (!cache) {
+        errprint("Failed to allocate memory cache\n");
+        return;
+    }
+
+    for (i = 0; i < MEMORY_CACHE_SHARDS; i++) {
+        cache->shards[i].lru.next = &cache->shards[i].lru;
+        cache->shards[i].lru.prev = &cache->shards[i].lru;
+        pthread_mutex_init(&cache->shards[i].lock, NULL);
+    }
+
+    pthread_mutex_init(&cache->ra_lock, NULL);
+    cache->age = age_limit;
+    cache->ra_max = MEMORY_CACHE_RA_DEFAULT;
+    vmi->memory_cache = cache;
+
+    if (VMI_FAILURE == memory_cache_resize(vmi, MAX_PAGE_CACHE_SIZE)) {
+        errprint("Failed to allocate memory cache\n");
+        memory_cache_destroy(vmi);
+        vmi->get_data_callback = get_data;
+        vmi->release_data_callback = release_data;
+    }
 }
 
 void *
@@ -186,100 +714,246 @@ memory_cache_insert(
     vmi_instance_t vmi,
     addr_t paddr)
 {
-    memory_cache_entry_t entry = NULL;
-    addr_t paddr_aligned = paddr & ~(((addr_t) vmi->page_size) - 1);
-
-    if (paddr != paddr_aligned) {
-        errprint("Memory cache request for non-aligned page\n");
-        return NULL;
-    }
-
-    gint64 *key = (gint64*)&paddr;
-    if ((entry = g_hash_table_lookup(vmi->memory_cache, key)) != NULL) {
-        dbprint(VMI_DEBUG_MEMCACHE, "--MEMORY cache hit 0x%"PRIx64"\n", paddr);
-        return validate_and_return_data(vmi, entry);
-    } else {
-        if (g_queue_get_length(vmi->memory_cache_lru) >= vmi->memory_cache_size_max) {
-            clean_cache(vmi);
-        }
-
-        dbprint(VMI_DEBUG_MEMCACHE, "--MEMORY cache set 0x%"PRIx64"\n", paddr);
+    return memory_cache_get(vmi, paddr, NULL);
+}
 
-        entry = create_new_entry(vmi, paddr, vmi->page_size);
-        if (!entry) {
-            dbprint(VMI_DEBUG_MEMCACHE, "create_new_entry failed\n");
-            return 0;
-        }
+void *
+memory_cache_pin(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    page_pin_t *pin)
+{
+    return memory_cache_get(vmi, paddr, pin);
+}
 
-        key = g_slice_new(gint64);
-        *key = paddr;
+void
+memory_cache_unpin(
+    vmi_instance_t vmi,
+    page_pin_t pin)
+{
+    memory_cache_entry_t entry = (memory_cache_entry_t) pin;
+    struct memory_cache_shard *shard;
 
-        g_hash_table_insert(vmi->memory_cache, key, entry);
+    if (!entry || !vmi->memory_cache)
+        return;
 
-        gint64 *key2 = g_slice_new(gint64);
-        *key2 = paddr;
-        g_queue_push_head(vmi->memory_cache_lru, key2);
+    shard = memory_cache_get_shard(vmi->memory_cache, memory_cache_hash(entry->paddr));
+    vmi_lock(vmi, &shard->lock);
 
-        return entry->data;
+    /* the entry was dropped from the cache while borrowed, finish the job */
+    if (entry->pins && !--entry->pins && entry->detached) {
+        vmi->release_data_callback(vmi, entry->data, entry->length);
+        entry->detached = false;
+        entry_free(shard, entry);
     }
+
+    vmi_unlock(vmi, &shard->lock);
 }
 
 void memory_cache_remove(
     vmi_instance_t vmi,
     addr_t paddr)
 {
+    memory_cache_entry_t entry;
+    struct memory_cache_shard *shard;
     addr_t paddr_aligned = paddr & ~(((addr_t) vmi->page_size) - 1);
+    uint64_t hash;
 
     if (paddr != paddr_aligned) {
         errprint("Memory cache request for non-aligned page\n");
         return;
     }
 
-    gint64 *key = (gint64*)&paddr;
+    if (!vmi->memory_cache)
+        return;
+
+    hash = memory_cache_hash(paddr);
+    shard = memory_cache_get_shard(vmi->memory_cache, hash);
+
+    vmi_lock(vmi, &shard->lock);
+    if ((entry = shard_lookup(shard, hash, paddr)) != NULL)
+        shard_remove(vmi, shard, entry);
+    vmi_unlock(vmi, &shard->lock);
+}
+
+void
+memory_cache_set_batch(
+    vmi_instance_t vmi,
+    void (*get_data_batch) (vmi_instance_t,
+                            const addr_t *,
+                            void **,
+                            uint32_t,
+                            uint32_t))
+{
+    vmi->get_data_batch_callback = get_data_batch;
+}
+
+status_t
+memory_cache_prefetch(
+    vmi_instance_t vmi,
+    const addr_t *frames,
+    uint32_t count)
+{
+    addr_t *paddrs = NULL;
+    void **data = NULL;
+    uint32_t i, missing = 0;
+    status_t ret = VMI_FAILURE;
+
+    if (!vmi->memory_cache || !vmi->get_data_batch_callback)
+        return VMI_FAILURE;
+
+    if (!count)
+        return VMI_SUCCESS;
+
+    paddrs = g_try_new(addr_t, count);
+    data = g_try_new0(void *, count);
+    if (!paddrs || !data)
+        goto done;
+
+    /* only ask the driver for the pages we don't hold already */
+    for (i = 0; i < count; i++) {
+        addr_t paddr = frames[i] << vmi->page_shift;
+        uint64_t hash = memory_cache_hash(paddr);
+        struct memory_cache_shard *shard = memory_cache_get_shard(vmi->memory_cache, hash);
+        bool cached;
+
+        vmi_lock(vmi, &shard->lock);
+        cached = !!shard_lookup(shard, hash, paddr);
+        vmi_unlock(vmi, &shard->lock);
+
+        if (cached)
+            continue;
+
+        if (!is_valid_paddr(vmi, paddr, vmi->page_size))
+            continue;
+
+        paddrs[missing++] = paddr;
+    }
+
+    if (missing) {
+        uint64_t start = stats_clock();
+
+        dbprint(VMI_DEBUG_MEMCACHE, "--MEMORY cache prefetch %u of %u pages\n", missing, count);
+        vmi->get_data_batch_callback(vmi, paddrs, data, missing, vmi->page_size);
+        stats_add(vmi, driver_nsec, stats_clock() - start);
+    }
+
+    /* pages the driver could not fetch are left to the regular path */
+    for (i = 0; i < missing; i++) {
+        struct memory_cache_shard *shard;
+        uint64_t hash;
+
+        if (!data[i])
+            continue;
+
+        stats_inc(vmi, driver_page_fetches);
+        stats_add(vmi, driver_bytes, vmi->page_size);
+
+        hash = memory_cache_hash(paddrs[i]);
+        shard = memory_cache_get_shard(vmi->memory_cache, hash);
+
+        vmi_lock(vmi, &shard->lock);
+
+        /* another thread may have fetched it in the meantime */
+        if (shard_lookup(shard, hash, paddrs[i]))
+            vmi->release_data_callback(vmi, data[i], vmi->page_size);
+        else
+            insert_entry(vmi, shard, hash, paddrs[i], vmi->page_size, data[i]);
+
+        vmi_unlock(vmi, &shard->lock);
+    }
+
+    ret = VMI_SUCCESS;
 
-    g_hash_table_remove(vmi->memory_cache, key);
+done:
+    g_free(paddrs);
+    g_free(data);
+    return ret;
 }
 
-void free_lru_entry(void *p1, void *UNUSED(p2))
+status_t
+memory_cache_set_size(
+    vmi_instance_t vmi,
+    uint32_t size_max)
 {
-    free_gint64(p1);
+    if (!vmi->memory_cache)
+        return VMI_FAILURE;
+
+    return memory_cache_resize(vmi, size_max);
+}
+
+status_t
+memory_cache_set_readahead(
+    vmi_instance_t vmi,
+    uint32_t max_pages)
+{
+    if (!vmi->memory_cache || max_pages > MEMORY_CACHE_RA_LIMIT)
+        return VMI_FAILURE;
+
+    vmi_lock(vmi, &vmi->memory_cache->ra_lock);
+    __atomic_store_n(&vmi->memory_cache->ra_max, max_pages, __ATOMIC_RELAXED);
+    memset(vmi->memory_cache->streams, 0, sizeof(vmi->memory_cache->streams));
+    vmi_unlock(vmi, &vmi->memory_cache->ra_lock);
+
+    return VMI_SUCCESS;
 }
 
 void
 memory_cache_destroy(
     vmi_instance_t vmi)
 {
-    vmi->memory_cache_size_max = 0;
+    struct memory_cache *cache = vmi->memory_cache;
+    unsigned int i;
 
-    if (vmi->memory_cache_lru) {
-        g_queue_foreach(vmi->memory_cache_lru, (GFunc)free_lru_entry, NULL);
-        g_queue_free(vmi->memory_cache_lru);
-        vmi->memory_cache_lru = NULL;
-    }
+    if (cache) {
+        for (i = 0; i < MEMORY_CACHE_SHARDS; i++) {
+            struct memory_cache_shard *shard = &cache->shards[i];
+
+            shard_clear(vmi, shard);
+
+            while (shard->slabs) {
+                struct memory_cache_slab *slab = shard->slabs;
+                unsigned int j;
+
+                /* pins don't survive the cache, drop what is still borrowed */
+                for (j = 0; j < MEMORY_CACHE_SLAB_ENTRIES; j++)
+                    if (slab->entries[j].detached && slab->entries[j].data)
+                        vmi->release_data_callback(vmi, slab->entries[j].data, slab->entries[j].length);
+
+                shard->slabs = slab->next;
+                g_free(slab);
+            }
+
+            g_free(shard->buckets);
+            pthread_mutex_destroy(&shard->lock);
+        }
 
-    if (vmi->memory_cache) {
-        g_hash_table_destroy(vmi->memory_cache);
+        pthread_mutex_destroy(&cache->ra_lock);
+        g_free(cache);
         vmi->memory_cache = NULL;
     }
 
-    vmi->memory_cache_age = 0;
-    vmi->memory_cache_size_max = 0;
     vmi->get_data_callback = NULL;
     vmi->release_data_callback = NULL;
+    vmi->get_data_batch_callback = NULL;
 }
 
 void
 memory_cache_flush(
     vmi_instance_t vmi)
 {
-    if (vmi->memory_cache_lru) {
-        g_queue_foreach(vmi->memory_cache_lru, (GFunc)free_lru_entry, NULL);
-        g_queue_free(vmi->memory_cache_lru);
-        vmi->memory_cache_lru = g_queue_new();
-    }
+    unsigned int i;
+
+    if (!vmi->memory_cache)
+        return;
+
+    for (i = 0; i < MEMORY_CACHE_SHARDS; i++) {
+        struct memory_cache_shard *shard = &vmi->memory_cache->shards[i];
 
-    if (vmi->memory_cache)
-        g_hash_table_remove_all(vmi->memory_cache);
+        vmi_lock(vmi, &shard->lock);
+        shard_clear(vmi, shard);
+        vmi_unlock(vmi, &shard->lock);
+    }
 }
 
 #else
@@ -296,6 +970,7 @@ memory_cache_init(
 {
     vmi->get_data_callback = get_data;
     vmi->release_data_callback = release_data;
+    vmi->get_data_batch_callback = NULL;
 }
 
 void *
@@ -304,8 +979,10 @@ memory_cache_insert(
     addr_t paddr)
 {
     if (paddr == vmi->last_used_page_key && vmi->last_used_page) {
+        stats_inc(vmi, page_cache_hits);
         return vmi->last_used_page;
     } else {
+        stats_inc(vmi, page_cache_misses);
         if (vmi->last_used_page) {
             vmi->release_data_callback(vmi, vmi->last_used_page, vmi->page_size);
         }
@@ -315,6 +992,52 @@ memory_cache_insert(
     }
 }
 
+/*
+ * Without a page cache the pinned page is a private copy of the page held
+ * for as long as it is borrowed.
+ */
+void *
+memory_cache_pin(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    page_pin_t *pin)
+{
+    memory_cache_entry_t entry;
+
+    if (!vmi->get_data_callback)
+        return NULL;
+
+    entry = g_try_malloc0(sizeof(struct memory_cache_entry));
+    if (!entry)
+        return NULL;
+
+    entry->paddr = paddr;
+    entry->length = vmi->page_size;
+    entry->data = get_memory_data(vmi, paddr, vmi->page_size);
+    if (!entry->data) {
+        g_free(entry);
+        return NULL;
+    }
+
+    entry->pins = 1;
+    *pin = (page_pin_t) entry;
+    return entry->data;
+}
+
+void
+memory_cache_unpin(
+    vmi_instance_t vmi,
+    page_pin_t pin)
+{
+    memory_cache_entry_t entry = (memory_cache_entry_t) pin;
+
+    if (!entry)
+        return;
+
+    vmi->release_data_callback(vmi, entry->data, entry->length);
+    g_free(entry);
+}
+
 void memory_cache_remove(
     vmi_instance_t vmi,
     addr_t paddr)
@@ -324,6 +1047,44 @@ void memory_cache_remove(
     }
 }
 
+void
+memory_cache_set_batch(
+    vmi_instance_t vmi,
+    void (*get_data_batch) (vmi_instance_t,
+                            const addr_t *,
+                            void **,
+                            uint32_t,
+                            uint32_t))
+{
+    vmi->get_data_batch_callback = get_data_batch;
+}
+
+status_t
+memory_cache_prefetch(
+    vmi_instance_t UNUSED(vmi),
+    const addr_t *UNUSED(frames),
+    uint32_t UNUSED(count))
+{
+    /* a single page is held at a time, there is nowhere to put the batch */
+    return VMI_FAILURE;
+}
+
+status_t
+memory_cache_set_size(
+    vmi_instance_t UNUSED(vmi),
+    uint32_t UNUSED(size_max))
+{
+    return VMI_FAILURE;
+}
+
+status_t
+memory_cache_set_readahead(
+    vmi_instance_t UNUSED(vmi),
+    uint32_t UNUSED(max_pages))
+{
+    return VMI_FAILURE;
+}
+
 void
 memory_cache_destroy(
     vmi_instance_t vmi)
@@ -335,6 +1096,7 @@ memory_cache_destroy(
     vmi->last_used_page = NULL;
     vmi->get_data_callback = NULL;
     vmi->release_data_callback = NULL;
+    vmi->get_data_batch_callback = NULL;
 }
 
 void
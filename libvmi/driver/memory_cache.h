@@ -43,10 +43,40 @@ void *memory_cache_insert(
     vmi_instance_t vmi,
     addr_t paddr);
 
+void *memory_cache_pin(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    page_pin_t *pin);
+
+void memory_cache_unpin(
+    vmi_instance_t vmi,
+    page_pin_t pin);
+
 void memory_cache_remove(
     vmi_instance_t vmi,
     addr_t paddr);
 
+void memory_cache_set_batch(
+    vmi_instance_t vmi,
+    void (*get_data_batch) (vmi_instance_t,
+                            const addr_t *,
+                            void **,
+                            uint32_t,
+                            uint32_t));
+
+status_t memory_cache_prefetch(
+    vmi_instance_t vmi,
+    const addr_t *frames,
+    uint32_t count);
+
+status_t memory_cache_set_size(
+    vmi_instance_t vmi,
+    uint32_t size_max);
+
+status_t memory_cache_set_readahead(
+    vmi_instance_t vmi,
+    uint32_t max_pages);
+
 void memory_cache_destroy(
     vmi_instance_t vmi);
 
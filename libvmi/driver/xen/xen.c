@@ -33,6 +33,7 @@
 #include "driver/driver_interface.h"
 #include "driver/memory_cache.h"
 #include "driver/xen/altp2m_private.h"
+#include "driver/xen/xen_memory_private.h"
 
 //----------------------------------------------------------------------------
 // Helper functions
@@ -80,16 +81,31 @@ xen_get_memory(
     //TODO assuming length == page size is safe for now, but isn't the most clean approach
     addr_t pfn = paddr >> vmi->page_shift;
 
-    return xen_get_memory_pfn(vmi, pfn, PROT_READ);
+    return xen_memory_get(vmi, pfn);
+}
+
+/*
+ * Pages of a sorted batch share their mapping windows, so the whole batch
+ * costs one foreign mapping call per window not mapped already.
+ */
+void
+xen_get_memory_batch(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    void **data,
+    uint32_t count,
+    uint32_t UNUSED(length))
+{
+    xen_memory_get_batch(vmi, paddrs, data, count);
 }
 
 void
 xen_release_memory(
-    vmi_instance_t UNUSED(vmi),
+    vmi_instance_t vmi,
     void *memory,
-    size_t length)
+    size_t UNUSED(length))
 {
-    munmap(memory, length);
+    xen_memory_put(vmi, memory);
 }
 
 status_t
@@ -155,11 +171,12 @@ xen_put_memory(
          * old (origin) page.
          */
         memory_cache_remove(vmi, (phys_address >> vmi->page_shift) << vmi->page_shift);
+        xen_memory_invalidate(vmi, pfn);
 
         /* set variables for next loop */
         count -= write_len;
         buf_offset += write_len;
-        xen_release_memory(vmi, memory, vmi->page_size);
+        munmap(memory, vmi->page_size);
     }
 
     return VMI_SUCCESS;
@@ -450,7 +467,12 @@ xen_setup_live_mode(
 {
     dbprint(VMI_DEBUG_XEN, "--xen: setup live mode\n");
     memory_cache_destroy(vmi);
+
+    if (!xen_get_instance(vmi)->memory && VMI_FAILURE == xen_memory_init(vmi))
+        return VMI_FAILURE;
+
     memory_cache_init(vmi, xen_get_memory, xen_release_memory, 0);
+    memory_cache_set_batch(vmi, xen_get_memory_batch);
     return VMI_SUCCESS;
 }
 
@@ -682,6 +704,10 @@ xen_destroy(
         xen_events_destroy(vmi);
     }
 
+    /* cached pages are released into the mapping windows, drop them first */
+    memory_cache_destroy(vmi);
+    xen_memory_destroy(vmi);
+
     xc_interface *xchandle = xen_get_xchandle(vmi);
     if ( xchandle )
         xen->libxcw.xc_interface_close(xchandle);
@@ -2655,6 +2681,15 @@ xen_read_page(
     return memory_cache_insert(vmi, paddr);
 }
 
+status_t
+xen_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *pages,
+    unsigned int count)
+{
+    return memory_cache_prefetch(vmi, pages, count);
+}
+
 void *
 xen_mmap_guest(
     vmi_instance_t vmi,
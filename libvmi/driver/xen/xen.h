@@ -147,6 +147,10 @@ status_t xen_set_vcpuregs(
 void *xen_read_page(
     vmi_instance_t vmi,
     addr_t page);
+status_t xen_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *pages,
+    unsigned int count);
 void *xen_mmap_guest(
     vmi_instance_t vmi,
     unsigned long *pfns,
@@ -180,6 +184,7 @@ driver_xen_setup(vmi_instance_t vmi)
 {
     driver_interface_t driver = { 0 };
     driver.initialized = true;
+    driver.thread_safe = true;
     driver.init_ptr = &xen_init;
     driver.init_vmi_ptr = &xen_init_vmi;
     driver.domainwatch_init_ptr = &xen_domainwatch_init;
@@ -202,6 +207,7 @@ driver_xen_setup(vmi_instance_t vmi)
     driver.set_vcpureg_ptr = &xen_set_vcpureg;
     driver.set_vcpuregs_ptr = &xen_set_vcpuregs;
     driver.read_page_ptr = &xen_read_page;
+    driver.read_pages_ptr = &xen_read_pages;
     driver.mmap_guest = &xen_mmap_guest;
     driver.write_ptr = &xen_write;
     driver.is_pv_ptr = &xen_is_pv;
@@ -694,7 +694,7 @@ status_t process_software_breakpoint(vmi_instance_t vmi, vm_event_compat_t *vmec
     event->page_mode = vmec->pm;
 
     vmi->event_callback = 1;
-    process_response( event->callback(vmi, event), event, vmec );
+    process_response( vmi_event_callback(vmi, event), event, vmec );
     vmi->event_callback = 0;
 
     /* Reinject (callback may decide) */
@@ -770,7 +770,7 @@ status_t process_interrupt(vmi_instance_t vmi, vm_event_compat_t *vmec)
     event->page_mode = vmec->pm;
 
     vmi->event_callback = 1;
-    process_response( event->callback(vmi, event), event, vmec );
+    process_response( vmi_event_callback(vmi, event), event, vmec );
     vmi->event_callback = 0;
 
     return VMI_SUCCESS;
@@ -821,7 +821,7 @@ status_t process_register(vmi_instance_t vmi, vm_event_compat_t *vmec)
     event->page_mode = vmec->pm;
 
     vmi->event_callback = 1;
-    process_response ( event->callback(vmi, event), event, vmec );
+    process_response ( vmi_event_callback(vmi, event), event, vmec );
     vmi->event_callback = 0;
 
     return VMI_SUCCESS;
@@ -855,7 +855,7 @@ status_t process_msr(vmi_instance_t vmi, vm_event_compat_t *vmec)
     event->page_mode = vmec->pm;
 
     vmi->event_callback = 1;
-    process_response ( event->callback(vmi, event), event, vmec );
+    process_response ( vmi_event_callback(vmi, event), event, vmec );
     vmi->event_callback = 0;
 
     return VMI_SUCCESS;
@@ -884,7 +884,7 @@ status_t process_singlestep(vmi_instance_t vmi, vm_event_compat_t *vmec)
     event->page_mode = vmec->pm;
 
     vmi->event_callback = 1;
-    process_response ( event->callback(vmi, event), event, vmec );
+    process_response ( vmi_event_callback(vmi, event), event, vmec );
     vmi->event_callback = 0;
 
     return VMI_SUCCESS;
@@ -908,7 +908,7 @@ event_response_t issue_mem_cb(vmi_instance_t vmi,
     event->mem_event.out_access = out_access;
     event->vcpu_id = vmec->vcpu_id;
 
-    return event->callback(vmi, event);
+    return vmi_event_callback(vmi, event);
 }
 
 static
@@ -998,7 +998,7 @@ status_t process_debug_exception(vmi_instance_t vmi, vm_event_compat_t *vmec)
     event->page_mode = vmec->pm;
 
     vmi->event_callback = 1;
-    process_response ( event->callback(vmi, event),
+    process_response ( vmi_event_callback(vmi, event),
                        event, vmec );
     vmi->event_callback = 0;
 
@@ -1048,7 +1048,7 @@ status_t process_cpuid(vmi_instance_t vmi, vm_event_compat_t *vmec)
     event->page_mode = vmec->pm;
 
     vmi->event_callback = 1;
-    process_response ( event->callback(vmi, event),
+    process_response ( vmi_event_callback(vmi, event),
                        event, vmec );
     vmi->event_callback = 0;
 
@@ -1087,7 +1087,7 @@ status_t process_privcall(vmi_instance_t vmi, vm_event_compat_t *vmec)
     event->page_mode = vmec->pm;
 
     vmi->event_callback = 1;
-    process_response ( event->callback(vmi, event),
+    process_response ( vmi_event_callback(vmi, event),
                        event, vmec );
     vmi->event_callback = 0;
 
@@ -1121,7 +1121,7 @@ status_t process_guest_request(vmi_instance_t vmi, vm_event_compat_t *vmec)
     event->page_mode = vmec->pm;
 
     vmi->event_callback = 1;
-    process_response ( event->callback(vmi, event),
+    process_response ( vmi_event_callback(vmi, event),
                        event, vmec );
     vmi->event_callback = 0;
 
@@ -1146,7 +1146,7 @@ status_t process_unimplemented_emul(vmi_instance_t vmi, vm_event_compat_t *vmec)
     event->page_mode = vmec->pm;
 
     vmi->event_callback = 1;
-    process_response ( event->callback(vmi, event),
+    process_response ( vmi_event_callback(vmi, event),
                        event, vmec );
     vmi->event_callback = 0;
 
@@ -1176,7 +1176,7 @@ status_t process_desc_access(vmi_instance_t vmi, vm_event_compat_t *vmec)
     event->page_mode = vmec->pm;
 
     vmi->event_callback = 1;
-    process_response ( event->callback(vmi, event),
+    process_response ( vmi_event_callback(vmi, event),
                        event, vmec );
     vmi->event_callback = 0;
 
@@ -1238,7 +1238,8 @@ status_t process_domain_watch(vmi_instance_t vmi, vm_event_compat_t* UNUSED(vmec
                         vmi->watch_domain_event->watch_event.domain = *domid;
                         vmi->watch_domain_event->watch_event.created = true;
                         vmi->watch_domain_event->watch_event.uuid = uuid;
-                        vmi->watch_domain_event->callback(vmi, vmi->watch_domain_event);
+                        stats_inc(vmi, events_received[VMI_EVENT_DOMAIN_WATCH]);
+                        vmi_event_callback(vmi, vmi->watch_domain_event);
                         ret = VMI_SUCCESS;
                     }
                     free(tmp);
@@ -1259,7 +1260,8 @@ status_t process_domain_watch(vmi_instance_t vmi, vm_event_compat_t* UNUSED(vmec
                 vmi->watch_domain_event->watch_event.domain = data.domain;
                 vmi->watch_domain_event->watch_event.created = false;
                 vmi->watch_domain_event->watch_event.uuid = data.uuid;
-                vmi->watch_domain_event->callback(vmi, vmi->watch_domain_event);
+                stats_inc(vmi, events_received[VMI_EVENT_DOMAIN_WATCH]);
+                vmi_event_callback(vmi, vmi->watch_domain_event);
                 g_tree_remove (xen->domains, &data.domain);
                 data.domain = 0;
                 ret = VMI_SUCCESS;
@@ -1272,6 +1274,22 @@ status_t process_domain_watch(vmi_instance_t vmi, vm_event_compat_t* UNUSED(vmec
 }
 #endif
 
+/* The LibVMI event type of each vm_event reason, for the stats */
+static const uint8_t event_reason_type[__VM_EVENT_REASON_MAX] = {
+    [VM_EVENT_REASON_MEM_ACCESS] = VMI_EVENT_MEMORY,
+    [VM_EVENT_REASON_WRITE_CTRLREG] = VMI_EVENT_REGISTER,
+    [VM_EVENT_REASON_MOV_TO_MSR] = VMI_EVENT_REGISTER,
+    [VM_EVENT_REASON_SOFTWARE_BREAKPOINT] = VMI_EVENT_INTERRUPT,
+    [VM_EVENT_REASON_SINGLESTEP] = VMI_EVENT_SINGLESTEP,
+    [VM_EVENT_REASON_GUEST_REQUEST] = VMI_EVENT_GUEST_REQUEST,
+    [VM_EVENT_REASON_DEBUG_EXCEPTION] = VMI_EVENT_DEBUG_EXCEPTION,
+    [VM_EVENT_REASON_CPUID] = VMI_EVENT_CPUID,
+    [VM_EVENT_REASON_PRIVILEGED_CALL] = VMI_EVENT_PRIVILEGED_CALL,
+    [VM_EVENT_REASON_INTERRUPT] = VMI_EVENT_INTERRUPT,
+    [VM_EVENT_REASON_DESCRIPTOR_ACCESS] = VMI_EVENT_DESCRIPTOR_ACCESS,
+    [VM_EVENT_REASON_EMUL_UNIMPLEMENTED] = VMI_EVENT_FAILED_EMULATION,
+};
+
 static
 status_t process_request(vmi_instance_t vmi, vm_event_compat_t *vmec)
 {
@@ -1282,6 +1300,9 @@ status_t process_request(vmi_instance_t vmi, vm_event_compat_t *vmec)
         return VMI_FAILURE;
 #endif
 
+    if ( vmec->reason < __VM_EVENT_REASON_MAX && event_reason_type[vmec->reason] )
+        stats_inc(vmi, events_received[event_reason_type[vmec->reason]]);
+
     if ( !(vmec->flags & VM_EVENT_FLAG_ALTERNATE_P2M) )
         vmec->altp2m_idx = 0;
 
@@ -3228,7 +3249,11 @@ status_t wait_for_event_or_timeout(vmi_instance_t vmi, unsigned long ms, bool *n
     return VMI_FAILURE;
 }
 
-status_t xen_events_listen(vmi_instance_t vmi, uint32_t timeout)
+/*
+ * Handles what the wait found, with the events lock held: callbacks run
+ * from here, and events may not be registered or cleared meanwhile.
+ */
+static status_t xen_events_dispatch(vmi_instance_t vmi, bool needs_unmasking)
 {
     xen_events_t *xe = xen_get_events(vmi);
     xen_instance_t *xen = xen_get_instance(vmi);
@@ -3236,29 +3261,6 @@ status_t xen_events_listen(vmi_instance_t vmi, uint32_t timeout)
     int rc;
     status_t vrc = VMI_SUCCESS;
     uint32_t requests_processed = 0;
-    bool needs_unmasking = 0;
-
-#ifdef ENABLE_SAFETY_CHECKS
-    if ( !xen ) {
-        errprint("%s error: invalid xen_instance_t handle\n", __FUNCTION__);
-        return VMI_FAILURE;
-    }
-    if ( !xe ) {
-        errprint("%s error: invalid xen_events_t handle\n", __FUNCTION__);
-        return VMI_FAILURE;
-    }
-#endif
-
-    if (!vmi->shutting_down) {
-        if ( !xe->external_poll ) {
-            dbprint(VMI_DEBUG_XEN, "--Waiting for xen events...(%"PRIu32" ms)\n", timeout);
-            if ( VMI_FAILURE == wait_for_event_or_timeout(vmi, timeout, &needs_unmasking) ) {
-                errprint("Error while waiting for event.\n");
-                return VMI_FAILURE;
-            }
-        } else
-            needs_unmasking = timeout;
-    }
 
 #ifdef HAVE_LIBXENSTORE
     if ( (xe->fd[1].revents & POLLIN) && (vmi->init_flags & VMI_INIT_DOMAINWATCH) ) {
@@ -3344,6 +3346,44 @@ status_t xen_events_listen(vmi_instance_t vmi, uint32_t timeout)
     return VMI_SUCCESS;
 }
 
+status_t xen_events_listen(vmi_instance_t vmi, uint32_t timeout)
+{
+    xen_events_t *xe = xen_get_events(vmi);
+    xen_instance_t *xen = xen_get_instance(vmi);
+
+    status_t vrc;
+    bool needs_unmasking = 0;
+
+#ifdef ENABLE_SAFETY_CHECKS
+    if ( !xen ) {
+        errprint("%s error: invalid xen_instance_t handle\n", __FUNCTION__);
+        return VMI_FAILURE;
+    }
+    if ( !xe ) {
+        errprint("%s error: invalid xen_events_t handle\n", __FUNCTION__);
+        return VMI_FAILURE;
+    }
+#endif
+
+    /* the wait is done without the events lock, so other threads can change the events */
+    if (!vmi->shutting_down) {
+        if ( !xe->external_poll ) {
+            dbprint(VMI_DEBUG_XEN, "--Waiting for xen events...(%"PRIu32" ms)\n", timeout);
+            if ( VMI_FAILURE == wait_for_event_or_timeout(vmi, timeout, &needs_unmasking) ) {
+                errprint("Error while waiting for event.\n");
+                return VMI_FAILURE;
+            }
+        } else
+            needs_unmasking = timeout;
+    }
+
+    vmi_lock(vmi, &vmi->events_lock);
+    vrc = xen_events_dispatch(vmi, needs_unmasking);
+    vmi_unlock(vmi, &vmi->events_lock);
+
+    return vrc;
+}
+
 status_t xen_domainwatch_init_events(
     vmi_instance_t vmi,
     uint32_t init_flags)
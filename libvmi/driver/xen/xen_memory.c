@@ -0,0 +1,382 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/mman.h>
+
+#include "private.h"
+#include "glib_compat.h"
+#include "driver/xen/xen.h"
+#include "driver/xen/xen_private.h"
+#include "driver/xen/xen_memory_private.h"
+
+/*
+ * A window is an aligned run of XEN_WINDOW_PAGES gfns that is mapped with
+ * a single xc_map_foreign_pages() call. Pages handed out reference their
+ * window; once a window is no longer referenced it moves to the idle queue,
+ * where it stays mapped and can be picked up again without a hypercall.
+ * Only when more than XEN_IDLE_MAX windows sit idle are the oldest ones
+ * unmapped, XEN_UNMAP_BATCH at a time.
+ *
+ * The page cache fetches pages from several threads at once in concurrent
+ * mode, so all of the bookkeeping below is done under the lock.
+ */
+#define XEN_WINDOW_SHIFT    6
+#define XEN_WINDOW_PAGES    (1u << XEN_WINDOW_SHIFT)
+#define XEN_IDLE_MAX        64
+#define XEN_UNMAP_BATCH     16
+
+#define XEN_NO_WINDOW       (~0ull)
+
+typedef struct xen_mapping {
+    uint8_t *base;
+    size_t size;
+    addr_t window;      /**< window index, XEN_NO_WINDOW for single pages */
+    uint32_t refs;      /**< pages of the mapping handed out */
+    bool stale;         /**< not in the window table anymore, unmap once unused */
+    GList *idle;        /**< link in the idle queue while unreferenced */
+} xen_mapping_t;
+
+struct xen_memory {
+    GHashTable *windows;    /**< window index -> xen_mapping_t */
+    GHashTable *holes;      /**< windows that can't be mapped as a whole */
+    GTree *mappings;        /**< all mappings, ordered by base address */
+    GQueue idle;            /**< unreferenced windows, oldest first */
+    pthread_mutex_t lock;   /**< taken in concurrent mode */
+};
+
+static gint
+mapping_compare(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const xen_mapping_t *ma = a;
+    const xen_mapping_t *mb = b;
+
+    if (ma->base == mb->base)
+        return 0;
+
+    return ma->base < mb->base ? -1 : 1;
+}
+
+/* Find the mapping an address handed out by xen_memory_get belongs to */
+static gint
+mapping_search(
+    gconstpointer key,
+    gconstpointer data)
+{
+    const xen_mapping_t *mapping = key;
+    const uint8_t *addr = data;
+
+    if (addr < mapping->base)
+        return -1;
+    if (addr >= mapping->base + mapping->size)
+        return 1;
+
+    return 0;
+}
+
+static xen_mapping_t *
+mapping_new(
+    xen_memory_t *mem,
+    void *base,
+    size_t size,
+    addr_t window)
+{
+    xen_mapping_t *mapping = g_try_malloc0(sizeof(xen_mapping_t));
+
+    if (!mapping) {
+        munmap(base, size);
+        return NULL;
+    }
+
+    mapping->base = base;
+    mapping->size = size;
+    mapping->window = window;
+    mapping->stale = (window == XEN_NO_WINDOW);
+
+    g_tree_insert(mem->mappings, mapping, mapping);
+    if (!mapping->stale)
+        g_hash_table_insert(mem->windows, &mapping->window, mapping);
+
+    return mapping;
+}
+
+static void
+mapping_unmap(
+    xen_memory_t *mem,
+    xen_mapping_t *mapping)
+{
+    dbprint(VMI_DEBUG_XEN, "--xen: unmapping %zu pages at %p\n",
+            mapping->size / XC_PAGE_SIZE, mapping->base);
+
+    if (mapping->idle)
+        g_queue_delete_link(&mem->idle, mapping->idle);
+    if (!mapping->stale)
+        g_hash_table_remove(mem->windows, &mapping->window);
+
+    g_tree_remove(mem->mappings, mapping);
+    munmap(mapping->base, mapping->size);
+    g_free(mapping);
+}
+
+static void
+mapping_get(
+    xen_memory_t *mem,
+    xen_mapping_t *mapping)
+{
+    if (mapping->idle) {
+        g_queue_delete_link(&mem->idle, mapping->idle);
+        mapping->idle = NULL;
+    }
+
+    mapping->refs++;
+}
+
+static void
+mapping_put(
+    xen_memory_t *mem,
+    xen_mapping_t *mapping)
+{
+    unsigned int i;
+
+    if (--mapping->refs)
+        return;
+
+    if (mapping->stale) {
+        mapping_unmap(mem, mapping);
+        return;
+    }
+
+    g_queue_push_tail(&mem->idle, mapping);
+    mapping->idle = g_queue_peek_tail_link(&mem->idle);
+
+    if (g_queue_get_length(&mem->idle) <= XEN_IDLE_MAX)
+        return;
+
+    for (i = 0; i < XEN_UNMAP_BATCH && !g_queue_is_empty(&mem->idle); i++)
+        mapping_unmap(mem, g_queue_peek_head(&mem->idle));
+}
+
+static xen_mapping_t *
+window_map(
+    vmi_instance_t vmi,
+    addr_t window)
+{
+    xen_instance_t *xen = xen_get_instance(vmi);
+    xen_pfn_t pfns[XEN_WINDOW_PAGES];
+    addr_t first = window << XEN_WINDOW_SHIFT;
+    unsigned int i;
+    void *base;
+
+    /* a window reaching past the end of the guest would fail anyway */
+    if (first + XEN_WINDOW_PAGES - 1 > xen->max_gpfn)
+        return NULL;
+
+    for (i = 0; i < XEN_WINDOW_PAGES; i++)
+        pfns[i] = first + i;
+
+    base = xen->libxcw.xc_map_foreign_pages(xen->xchandle, xen->domainid,
+                                            PROT_READ, pfns, XEN_WINDOW_PAGES);
+
+    if (MAP_FAILED == base || NULL == base) {
+        dbprint(VMI_DEBUG_XEN, "--xen: failed to map window at pfn=0x%"PRIx64"\n", first);
+        return NULL;
+    }
+
+    return mapping_new(xen->memory, base, XEN_WINDOW_PAGES * XC_PAGE_SIZE, window);
+}
+
+static void *
+memory_get(
+    vmi_instance_t vmi,
+    xen_memory_t *mem,
+    addr_t pfn)
+{
+    addr_t window = pfn >> XEN_WINDOW_SHIFT;
+    xen_mapping_t *mapping;
+    void *memory;
+
+    mapping = g_hash_table_lookup(mem->windows, &window);
+
+    if (!mapping && !g_hash_table_lookup(mem->holes, &window)) {
+        mapping = window_map(vmi, window);
+
+        if (!mapping) {
+            addr_t *key = g_try_malloc(sizeof(addr_t));
+
+            if (key) {
+                *key = window;
+                g_hash_table_insert(mem->holes, key, key);
+            }
+        }
+    }
+
+    if (mapping) {
+        mapping_get(mem, mapping);
+        return mapping->base + ((pfn & (XEN_WINDOW_PAGES - 1)) * XC_PAGE_SIZE);
+    }
+
+    /* part of the window is not mapped in the guest, map the page alone */
+    memory = xen_get_memory_pfn(vmi, pfn, PROT_READ);
+    if (!memory)
+        return NULL;
+
+    mapping = mapping_new(mem, memory, XC_PAGE_SIZE, XEN_NO_WINDOW);
+    if (!mapping)
+        return NULL;
+
+    mapping_get(mem, mapping);
+    return memory;
+}
+
+void *
+xen_memory_get(
+    vmi_instance_t vmi,
+    addr_t pfn)
+{
+    xen_memory_t *mem = xen_get_instance(vmi)->memory;
+    void *memory;
+
+    vmi_lock(vmi, &mem->lock);
+    memory = memory_get(vmi, mem, pfn);
+    vmi_unlock(vmi, &mem->lock);
+
+    return memory;
+}
+
+void
+xen_memory_get_batch(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    void **data,
+    uint32_t count)
+{
+    xen_memory_t *mem = xen_get_instance(vmi)->memory;
+    uint32_t i;
+
+    vmi_lock(vmi, &mem->lock);
+    for (i = 0; i < count; i++)
+        data[i] = memory_get(vmi, mem, paddrs[i] >> vmi->page_shift);
+    vmi_unlock(vmi, &mem->lock);
+}
+
+void
+xen_memory_put(
+    vmi_instance_t vmi,
+    void *memory)
+{
+    xen_memory_t *mem = xen_get_instance(vmi)->memory;
+    xen_mapping_t *mapping;
+
+    vmi_lock(vmi, &mem->lock);
+
+    mapping = g_tree_search(mem->mappings, mapping_search, memory);
+    if (mapping)
+        mapping_put(mem, mapping);
+
+    vmi_unlock(vmi, &mem->lock);
+
+    if (!mapping)
+        errprint("%s: %p was not mapped by the xen driver\n", __FUNCTION__, memory);
+}
+
+void
+xen_memory_invalidate(
+    vmi_instance_t vmi,
+    addr_t pfn)
+{
+    xen_memory_t *mem = xen_get_instance(vmi)->memory;
+    addr_t window = pfn >> XEN_WINDOW_SHIFT;
+    xen_mapping_t *mapping;
+
+    if (!mem)
+        return;
+
+    vmi_lock(vmi, &mem->lock);
+
+    mapping = g_hash_table_lookup(mem->windows, &window);
+    if (mapping && !mapping->refs) {
+        mapping_unmap(mem, mapping);
+    } else if (mapping) {
+        /* pages of it are still in use, it goes away with the last of them */
+        g_hash_table_remove(mem->windows, &mapping->window);
+        mapping->stale = true;
+    }
+
+    vmi_unlock(vmi, &mem->lock);
+}
+
+status_t
+xen_memory_init(
+    vmi_instance_t vmi)
+{
+    xen_instance_t *xen = xen_get_instance(vmi);
+    xen_memory_t *mem = g_try_malloc0(sizeof(xen_memory_t));
+
+    if (!mem)
+        return VMI_FAILURE;
+
+    mem->windows = g_hash_table_new(g_int64_hash, g_int64_equal);
+    mem->holes = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+    mem->mappings = g_tree_new(mapping_compare);
+    g_queue_init(&mem->idle);
+    pthread_mutex_init(&mem->lock, NULL);
+
+    xen->memory = mem;
+    return VMI_SUCCESS;
+}
+
+static gboolean
+mapping_collect(
+    gpointer key,
+    gpointer UNUSED(value),
+    gpointer data)
+{
+    GSList **list = data;
+
+    *list = g_slist_prepend(*list, key);
+    return FALSE;
+}
+
+void
+xen_memory_destroy(
+    vmi_instance_t vmi)
+{
+    xen_instance_t *xen = xen_get_instance(vmi);
+    xen_memory_t *mem = xen->memory;
+    GSList *mappings = NULL, *loop;
+
+    if (!mem)
+        return;
+
+    /* whatever is still referenced at this point is unmapped regardless */
+    g_tree_foreach(mem->mappings, mapping_collect, &mappings);
+    for (loop = mappings; loop; loop = loop->next)
+        mapping_unmap(mem, loop->data);
+    g_slist_free(mappings);
+
+    g_hash_table_destroy(mem->windows);
+    g_hash_table_destroy(mem->holes);
+    g_tree_destroy(mem->mappings);
+    pthread_mutex_destroy(&mem->lock);
+    g_free(mem);
+
+    xen->memory = NULL;
+}
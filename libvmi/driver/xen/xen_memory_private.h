@@ -0,0 +1,62 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file xen_memory_private.h
+ * @brief Foreign memory mapping for the Xen driver. Guest frames are mapped
+ * in aligned windows of contiguous gfns, and windows nobody references are
+ * kept mapped for reuse and only unmapped in batches.
+ */
+
+#ifndef XEN_MEMORY_PRIVATE_H
+#define XEN_MEMORY_PRIVATE_H
+
+#include "private.h"
+
+typedef struct xen_memory xen_memory_t;
+
+status_t xen_memory_init(
+    vmi_instance_t vmi);
+
+void xen_memory_destroy(
+    vmi_instance_t vmi);
+
+/* Returns a read-only pointer to the page, release it with xen_memory_put */
+void *xen_memory_get(
+    vmi_instance_t vmi,
+    addr_t pfn);
+
+/* xen_memory_get for a sorted batch of addresses, pages that can't be mapped are NULL */
+void xen_memory_get_batch(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    void **data,
+    uint32_t count);
+
+void xen_memory_put(
+    vmi_instance_t vmi,
+    void *memory);
+
+/* Stop handing out the current mapping of pfn, e.g. after it was written to */
+void xen_memory_invalidate(
+    vmi_instance_t vmi,
+    addr_t pfn);
+
+#endif /* XEN_MEMORY_PRIVATE_H */
@@ -71,6 +71,8 @@ typedef struct xen_instance {
 
     GTree *domains; /**< tree for running xen domains */
 
+    struct xen_memory *memory; /**< foreign mapping windows */
+
 } xen_instance_t;
 
 #ifdef HAVE_LIBXENSTORE
@@ -101,4 +103,9 @@ xen_get_events(vmi_instance_t vmi)
 {
     return xen_get_instance(vmi)->events;
 }
+
+void *xen_get_memory_pfn(
+    vmi_instance_t vmi,
+    addr_t pfn,
+    int prot);
 #endif /* XEN_PRIVATE_H */
@@ -654,9 +654,9 @@ status_t swap_events(vmi_instance_t vmi, vmi_event_t *swap_from, vmi_event_t *sw
 }
 
 //----------------------------------------------------------------------------
-// Public event functions.
+// Public event functions, run with the event lock held (see below).
 
-vmi_event_t *vmi_get_reg_event(vmi_instance_t vmi, reg_t reg)
+static vmi_event_t *vmi_get_reg_event_locked(vmi_instance_t vmi, reg_t reg)
 {
     if (!vmi)
         return NULL;
@@ -664,7 +664,7 @@ vmi_event_t *vmi_get_reg_event(vmi_instance_t vmi, reg_t reg)
     return g_hash_table_lookup(vmi->reg_events, &reg);
 }
 
-vmi_event_t *vmi_get_mem_event(vmi_instance_t vmi, addr_t gfn, vmi_mem_access_t access)
+static vmi_event_t *vmi_get_mem_event_locked(vmi_instance_t vmi, addr_t gfn, vmi_mem_access_t access)
 {
     if (!vmi)
         return NULL;
@@ -676,8 +676,8 @@ vmi_event_t *vmi_get_mem_event(vmi_instance_t vmi, addr_t gfn, vmi_mem_access_t
     return g_hash_table_lookup(vmi->mem_events_on_gfn, &gfn);
 }
 
-status_t
-vmi_set_mem_event(
+static status_t
+vmi_set_mem_event_locked(
     vmi_instance_t vmi,
     addr_t gfn,
     vmi_mem_access_t access,
@@ -717,8 +717,8 @@ vmi_set_mem_event(
     return VMI_FAILURE;
 }
 
-status_t
-vmi_swap_events(
+static status_t
+vmi_swap_events_locked(
     vmi_instance_t vmi,
     vmi_event_t* swap_from,
     vmi_event_t *swap_to,
@@ -773,8 +773,8 @@ vmi_swap_events(
     return VMI_FAILURE;
 }
 
-status_t
-vmi_register_event(
+static status_t
+vmi_register_event_locked(
     vmi_instance_t vmi,
     vmi_event_t* event)
 {
@@ -856,7 +856,7 @@ vmi_register_event(
     return rc;
 }
 
-status_t vmi_clear_event(
+static status_t vmi_clear_event_locked(
     vmi_instance_t vmi,
     vmi_event_t* event,
     vmi_event_free_t free_routine)
@@ -937,8 +937,8 @@ status_t vmi_clear_event(
     return rc;
 }
 
-status_t
-vmi_step_event(
+static status_t
+vmi_step_event_locked(
     vmi_instance_t vmi,
     vmi_event_t *event,
     uint32_t vcpu_id,
@@ -1000,7 +1000,7 @@ done:
     return rc;
 }
 
-int vmi_are_events_pending(vmi_instance_t vmi)
+static int vmi_are_events_pending_locked(vmi_instance_t vmi)
 {
 #ifdef ENABLE_SAFETY_CHECKS
     if (!vmi)
@@ -1014,7 +1014,7 @@ int vmi_are_events_pending(vmi_instance_t vmi)
 }
 
 
-status_t vmi_events_listen(vmi_instance_t vmi, uint32_t timeout)
+static status_t vmi_events_listen_unlocked(vmi_instance_t vmi, uint32_t timeout)
 {
 #ifdef ENABLE_SAFETY_CHECKS
     if (!vmi)
@@ -1027,7 +1027,7 @@ status_t vmi_events_listen(vmi_instance_t vmi, uint32_t timeout)
     return driver_events_listen(vmi, timeout);
 }
 
-status_t vmi_event_listener_required(vmi_instance_t vmi, bool required)
+static status_t vmi_event_listener_required_locked(vmi_instance_t vmi, bool required)
 {
 #ifdef ENABLE_SAFETY_CHECKS
     if (!vmi)
@@ -1040,7 +1040,7 @@ status_t vmi_event_listener_required(vmi_instance_t vmi, bool required)
     return driver_set_access_listener_required(vmi, required);
 }
 
-vmi_event_t *vmi_get_singlestep_event(vmi_instance_t vmi, uint32_t vcpu)
+static vmi_event_t *vmi_get_singlestep_event_locked(vmi_instance_t vmi, uint32_t vcpu)
 {
     if (!vmi)
         return NULL;
@@ -1048,8 +1048,8 @@ vmi_event_t *vmi_get_singlestep_event(vmi_instance_t vmi, uint32_t vcpu)
     return g_hash_table_lookup(vmi->ss_events, &vcpu);
 }
 
-status_t
-vmi_stop_single_step_vcpu(
+static status_t
+vmi_stop_single_step_vcpu_locked(
     vmi_instance_t vmi,
     vmi_event_t* event,
     uint32_t vcpu)
@@ -1069,8 +1069,8 @@ vmi_stop_single_step_vcpu(
     return driver_stop_single_step(vmi, vcpu);
 }
 
-status_t
-vmi_toggle_single_step_vcpu(
+static status_t
+vmi_toggle_single_step_vcpu_locked(
     vmi_instance_t vmi,
     vmi_event_t* event,
     uint32_t vcpu,
@@ -1115,7 +1115,7 @@ vmi_toggle_single_step_vcpu(
     }
 }
 
-status_t vmi_shutdown_single_step(vmi_instance_t vmi)
+static status_t vmi_shutdown_single_step_locked(vmi_instance_t vmi)
 {
 #ifdef ENABLE_SAFETY_CHECKS
     if (!vmi)
@@ -1139,6 +1139,229 @@ status_t vmi_shutdown_single_step(vmi_instance_t vmi)
     return VMI_FAILURE;
 }
 
+//----------------------------------------------------------------------------
+// Locked entry points of the public event functions. The event API is
+// serialized in concurrent mode; the lock is recursive because callbacks,
+// which run within vmi_events_listen, use the API too. vmi_events_listen
+// itself leaves the locking to the driver, which only holds the lock while
+// it dispatches, not while it waits for events.
+
+static inline void events_lock(vmi_instance_t vmi)
+{
+    if (vmi)
+        vmi_lock(vmi, &vmi->events_lock);
+}
+
+static inline void events_unlock(vmi_instance_t vmi)
+{
+    if (vmi)
+        vmi_unlock(vmi, &vmi->events_lock);
+}
+
+vmi_event_t *
+vmi_get_reg_event(
+    vmi_instance_t vmi,
+    reg_t reg)
+{
+    vmi_event_t *event;
+
+    events_lock(vmi);
+    event = vmi_get_reg_event_locked(vmi, reg);
+    events_unlock(vmi);
+
+    return event;
+}
+
+vmi_event_t *
+vmi_get_mem_event(
+    vmi_instance_t vmi,
+    addr_t gfn,
+    vmi_mem_access_t access)
+{
+    vmi_event_t *event;
+
+    events_lock(vmi);
+    event = vmi_get_mem_event_locked(vmi, gfn, access);
+    events_unlock(vmi);
+
+    return event;
+}
+
+status_t
+vmi_set_mem_event(
+    vmi_instance_t vmi,
+    addr_t gfn,
+    vmi_mem_access_t access,
+    uint16_t slat_id)
+{
+    status_t rc;
+
+    events_lock(vmi);
+    rc = vmi_set_mem_event_locked(vmi, gfn, access, slat_id);
+    events_unlock(vmi);
+
+    return rc;
+}
+
+status_t
+vmi_swap_events(
+    vmi_instance_t vmi,
+    vmi_event_t *swap_from,
+    vmi_event_t *swap_to,
+    vmi_event_free_t free_routine)
+{
+    status_t rc;
+
+    events_lock(vmi);
+    rc = vmi_swap_events_locked(vmi, swap_from, swap_to, free_routine);
+    events_unlock(vmi);
+
+    return rc;
+}
+
+status_t
+vmi_register_event(
+    vmi_instance_t vmi,
+    vmi_event_t *event)
+{
+    status_t rc;
+
+    events_lock(vmi);
+    rc = vmi_register_event_locked(vmi, event);
+    events_unlock(vmi);
+
+    return rc;
+}
+
+status_t
+vmi_clear_event(
+    vmi_instance_t vmi,
+    vmi_event_t *event,
+    vmi_event_free_t free_routine)
+{
+    status_t rc;
+
+    events_lock(vmi);
+    rc = vmi_clear_event_locked(vmi, event, free_routine);
+    events_unlock(vmi);
+
+    return rc;
+}
+
+status_t
+vmi_step_event(
+    vmi_instance_t vmi,
+    vmi_event_t *event,
+    uint32_t vcpu_id,
+    uint64_t steps,
+    event_callback_t cb)
+{
+    status_t rc;
+
+    events_lock(vmi);
+    rc = vmi_step_event_locked(vmi, event, vcpu_id, steps, cb);
+    events_unlock(vmi);
+
+    return rc;
+}
+
+int
+vmi_are_events_pending(
+    vmi_instance_t vmi)
+{
+    int rc;
+
+    events_lock(vmi);
+    rc = vmi_are_events_pending_locked(vmi);
+    events_unlock(vmi);
+
+    return rc;
+}
+
+status_t
+vmi_events_listen(
+    vmi_instance_t vmi,
+    uint32_t timeout)
+{
+    /*
+     * Not locked here, a listen blocks for up to timeout. The driver takes
+     * the lock once it has something to dispatch.
+     */
+    return vmi_events_listen_unlocked(vmi, timeout);
+}
+
+status_t
+vmi_event_listener_required(
+    vmi_instance_t vmi,
+    bool required)
+{
+    status_t rc;
+
+    events_lock(vmi);
+    rc = vmi_event_listener_required_locked(vmi, required);
+    events_unlock(vmi);
+
+    return rc;
+}
+
+vmi_event_t *
+vmi_get_singlestep_event(
+    vmi_instance_t vmi,
+    uint32_t vcpu)
+{
+    vmi_event_t *event;
+
+    events_lock(vmi);
+    event = vmi_get_singlestep_event_locked(vmi, vcpu);
+    events_unlock(vmi);
+
+    return event;
+}
+
+status_t
+vmi_stop_single_step_vcpu(
+    vmi_instance_t vmi,
+    vmi_event_t *event,
+    uint32_t vcpu)
+{
+    status_t rc;
+
+    events_lock(vmi);
+    rc = vmi_stop_single_step_vcpu_locked(vmi, event, vcpu);
+    events_unlock(vmi);
+
+    return rc;
+}
+
+status_t
+vmi_toggle_single_step_vcpu(
+    vmi_instance_t vmi,
+    vmi_event_t *event,
+    uint32_t vcpu,
+    bool enabled)
+{
+    status_t rc;
+
+    events_lock(vmi);
+    rc = vmi_toggle_single_step_vcpu_locked(vmi, event, vcpu, enabled);
+    events_unlock(vmi);
+
+    return rc;
+}
+
+status_t
+vmi_shutdown_single_step(
+    vmi_instance_t vmi)
+{
+    status_t rc;
+
+    events_lock(vmi);
+    rc = vmi_shutdown_single_step_locked(vmi);
+    events_unlock(vmi);
+
+    return rc;
+}
+
 uint32_t vmi_events_version(void)
 {
     return VMI_EVENTS_VERSION;
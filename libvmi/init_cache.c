@@ -0,0 +1,437 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "private.h"
+#ifdef ENABLE_WINDOWS
+#include "peparse.h"
+#endif
+
+/*
+ * Persistent OS init cache.
+ *
+ * Enabled by passing a directory with VMI_INIT_DATA_INIT_CACHE. After the
+ * OS was set up the hard way, the values the heuristics found (kernel page
+ * directory, kernel base, KASLR offset, KDBG address, structure offsets)
+ * are written to a file named after the VM. The next attach feeds them to
+ * the OS init as config entries, which makes it skip the searches, and then
+ * checks with a few reads that they still describe the running kernel.
+ *
+ * The check is a fingerprint of the kernel build read through the cached
+ * values: the linux_banner string on Linux, the PE header of ntoskrnl on
+ * Windows. A reboot into another kernel, or the same kernel at another
+ * KASLR slide, changes it or makes the reads fail, and the OS is set up
+ * from scratch and the entry rewritten. Entries from the user's config
+ * always take precedence over cached ones.
+ *
+ * The file is plain text, one "key value" pair per line, and is replaced
+ * atomically so concurrent attaches to the same VM never see half of it.
+ */
+
+#define INIT_CACHE_VERSION      1
+#define INIT_CACHE_KEY_LEN      64
+#define INIT_CACHE_BANNER_LEN   256
+#define INIT_CACHE_PE_HEADER    1024
+
+struct init_cache {
+    GHashTable *entries;    /**< cached key -> uint64_t, owned */
+    GHashTable *config;     /**< user config with the cached entries added */
+    uint64_t fingerprint;
+    page_mode_t page_mode;
+};
+
+/* Config keys worth caching, read back with vmi_get_offset */
+static const char *linux_keys[] = {
+    "kpgd", "linux_init_task", "linux_kaslr", "linux_tasks",
+    "linux_mm", "linux_pid", "linux_name", "linux_pgd", NULL
+};
+
+static const char *windows_keys[] = {
+    "kpgd", "win_ntoskrnl", "win_ntoskrnl_va", "win_sysproc", "win_kdvb",
+    "win_kdbg", "win_kpcr", "win_tasks", "win_pdbase", "win_pid",
+    "win_pname", NULL
+};
+
+static const char **
+init_cache_keys(
+    vmi_instance_t vmi)
+{
+    switch (vmi->os_type) {
+        case VMI_OS_LINUX:
+            return linux_keys;
+        case VMI_OS_WINDOWS:
+            return windows_keys;
+        default:
+            /* FreeBSD init runs no heuristics worth caching */
+            return NULL;
+    }
+}
+
+static inline uint64_t
+fnv1a(
+    uint64_t hash,
+    const void *data,
+    size_t len)
+{
+    const uint8_t *p = data;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+#ifdef ENABLE_LINUX
+static status_t
+linux_fingerprint(
+    vmi_instance_t vmi,
+    uint64_t *fingerprint)
+{
+    char banner[INIT_CACHE_BANNER_LEN];
+    addr_t banner_va, pid_offset;
+    vmi_pid_t pid;
+    size_t len = 0;
+    ACCESS_CONTEXT(ctx,
+                   .translate_mechanism = VMI_TM_PROCESS_DTB,
+                   .pt = vmi->kpgd);
+
+    if ( VMI_FAILURE == vmi_translate_ksym2v(vmi, "linux_banner", &banner_va) )
+        return VMI_FAILURE;
+
+    ctx.addr = banner_va;
+    if ( VMI_FAILURE == vmi_read(vmi, &ctx, sizeof(banner), banner, &len) && !len )
+        return VMI_FAILURE;
+
+    len = strnlen(banner, len);
+    if ( len < sizeof("Linux version") - 1 || strncmp(banner, "Linux version", sizeof("Linux version") - 1) )
+        return VMI_FAILURE;
+
+    /* init_task is the idle task, pid 0 */
+    if ( VMI_FAILURE == vmi_get_offset(vmi, "linux_pid", &pid_offset) )
+        return VMI_FAILURE;
+
+    ctx.addr = vmi->init_task + pid_offset;
+    if ( VMI_FAILURE == vmi_read_32(vmi, &ctx, (uint32_t *) &pid) || pid )
+        return VMI_FAILURE;
+
+    *fingerprint = fnv1a(*fingerprint, banner, len);
+    return VMI_SUCCESS;
+}
+#endif
+
+#ifdef ENABLE_WINDOWS
+static status_t
+windows_fingerprint(
+    vmi_instance_t vmi,
+    uint64_t *fingerprint)
+{
+    uint8_t image[INIT_CACHE_PE_HEADER];
+    struct pe_header *pe_header = NULL;
+    struct optional_header_pe32 *oh_pe32 = NULL;
+    struct optional_header_pe32plus *oh_pe32plus = NULL;
+    addr_t ntoskrnl, ntoskrnl_va, pa, sysproc, pdbase, dtb = 0;
+    uint32_t time_date_stamp, size_of_image;
+    ACCESS_CONTEXT(ctx,
+                   .translate_mechanism = VMI_TM_PROCESS_DTB,
+                   .pt = vmi->kpgd);
+
+    if ( VMI_FAILURE == vmi_get_offset(vmi, "win_ntoskrnl", &ntoskrnl) ||
+            VMI_FAILURE == vmi_get_offset(vmi, "win_ntoskrnl_va", &ntoskrnl_va) )
+        return VMI_FAILURE;
+
+    /* the kernel page directory maps the kernel where it is expected */
+    if ( VMI_FAILURE == vmi_pagetable_lookup(vmi, vmi->kpgd, ntoskrnl_va, &pa) || pa != ntoskrnl )
+        return VMI_FAILURE;
+
+    ctx.addr = ntoskrnl_va;
+    if ( VMI_FAILURE == peparse_get_image(vmi, &ctx, sizeof(image), image) )
+        return VMI_FAILURE;
+
+    peparse_assign_headers(image, NULL, &pe_header, NULL, NULL, &oh_pe32, &oh_pe32plus);
+    time_date_stamp = pe_header->time_date_stamp;
+    size_of_image = oh_pe32plus ? oh_pe32plus->size_of_image : oh_pe32->size_of_image;
+
+    /* and is the one of the System process */
+    if ( VMI_SUCCESS == vmi_get_offset(vmi, "win_sysproc", &sysproc) && sysproc &&
+            VMI_SUCCESS == vmi_get_offset(vmi, "win_pdbase", &pdbase) ) {
+        ctx.addr = sysproc + pdbase;
+        if ( VMI_FAILURE == vmi_read_addr(vmi, &ctx, &dtb) )
+            return VMI_FAILURE;
+    }
+
+    *fingerprint = fnv1a(*fingerprint, &time_date_stamp, sizeof(time_date_stamp));
+    *fingerprint = fnv1a(*fingerprint, &size_of_image, sizeof(size_of_image));
+    *fingerprint = fnv1a(*fingerprint, &dtb, sizeof(dtb));
+    return VMI_SUCCESS;
+}
+#endif
+
+/*
+ * Identifies the kernel the instance was set up for. The reads go through
+ * the values the OS init settled on, so stale values don't reproduce it.
+ */
+static status_t
+init_cache_fingerprint(
+    vmi_instance_t vmi,
+    uint64_t *fingerprint)
+{
+    *fingerprint = fnv1a(0xcbf29ce484222325ull, &vmi->kpgd, sizeof(vmi->kpgd));
+
+    switch (vmi->os_type) {
+#ifdef ENABLE_LINUX
+        case VMI_OS_LINUX:
+            return linux_fingerprint(vmi, fingerprint);
+#endif
+#ifdef ENABLE_WINDOWS
+        case VMI_OS_WINDOWS:
+            return windows_fingerprint(vmi, fingerprint);
+#endif
+        default:
+            return VMI_FAILURE;
+    }
+}
+
+/* The cache file of the VM, named after its identity */
+static char *
+init_cache_path(
+    vmi_instance_t vmi)
+{
+    char *identity, *checksum, *path;
+
+    if (!vmi->init_cache_dir || !vmi->image_type || !init_cache_keys(vmi))
+        return NULL;
+
+    identity = g_strdup_printf("%d:%s", vmi->mode, vmi->image_type);
+    checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA1, identity, -1);
+    path = g_strdup_printf("%s/%s.init", vmi->init_cache_dir, checksum);
+
+    g_free(checksum);
+    g_free(identity);
+    return path;
+}
+
+static void
+init_cache_overlay(
+    gpointer key,
+    gpointer value,
+    gpointer data)
+{
+    g_hash_table_insert((GHashTable *) data, key, value);
+}
+
+init_cache_t *
+init_cache_load(
+    vmi_instance_t vmi,
+    GHashTable *config)
+{
+    init_cache_t *cache = NULL;
+    char *path = init_cache_path(vmi);
+    char line[INIT_CACHE_KEY_LEN + 32], key[INIT_CACHE_KEY_LEN], number[32], *end;
+    const char **keys, **k;
+    uint64_t value, *entry;
+    uint64_t version = 0;
+    bool have_os = false, have_fingerprint = false;
+    FILE *f;
+
+    if (!path)
+        return NULL;
+
+    f = fopen(path, "r");
+    if (!f) {
+        dbprint(VMI_DEBUG_CORE, "--init cache: no entry at %s\n", path);
+        g_free(path);
+        return NULL;
+    }
+
+    cache = g_malloc0(sizeof(init_cache_t));
+    cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    cache->page_mode = VMI_PM_UNKNOWN;
+    keys = init_cache_keys(vmi);
+
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%63s %31s", key, number) != 2)
+            continue;
+
+        value = g_ascii_strtoull(number, &end, 0);
+        if (*end)
+            continue;
+
+        if (!strcmp(key, "version")) {
+            version = value;
+        } else if (!strcmp(key, "os")) {
+            have_os = value == vmi->os_type;
+        } else if (!strcmp(key, "fingerprint")) {
+            cache->fingerprint = value;
+            have_fingerprint = true;
+        } else if (!strcmp(key, "page_mode")) {
+            if (value > VMI_PM_UNKNOWN && value <= VMI_PM_AARCH64)
+                cache->page_mode = value;
+        } else {
+            /* only keys the OS init knows about, nothing else from the file */
+            for (k = keys; *k && strcmp(*k, key); k++);
+            if (!*k)
+                continue;
+
+            entry = g_malloc(sizeof(uint64_t));
+            *entry = value;
+            g_hash_table_insert(cache->entries, g_strdup(key), entry);
+        }
+    }
+
+    fclose(f);
+
+    if (version != INIT_CACHE_VERSION || !have_os || !have_fingerprint ||
+            !g_hash_table_size(cache->entries)) {
+        dbprint(VMI_DEBUG_CORE, "--init cache: ignoring unusable entry %s\n", path);
+        init_cache_free(cache);
+        g_free(path);
+        return NULL;
+    }
+
+    /* the user's config wins over the cache */
+    cache->config = g_hash_table_new(g_str_hash, g_str_equal);
+    g_hash_table_foreach(cache->entries, init_cache_overlay, cache->config);
+    g_hash_table_foreach(config, init_cache_overlay, cache->config);
+
+    /* file mode finds the page mode with the same heuristics */
+    if (VMI_FILE == vmi->mode && VMI_PM_UNKNOWN == vmi->page_mode)
+        vmi->page_mode = cache->page_mode;
+
+    dbprint(VMI_DEBUG_CORE, "--init cache: loaded %u entries from %s\n",
+            g_hash_table_size(cache->entries), path);
+
+    g_free(path);
+    return cache;
+}
+
+GHashTable *
+init_cache_config(
+    init_cache_t *cache)
+{
+    return cache->config;
+}
+
+bool
+init_cache_validate(
+    vmi_instance_t vmi,
+    init_cache_t *cache)
+{
+    uint64_t fingerprint;
+
+    if ( VMI_FAILURE == init_cache_fingerprint(vmi, &fingerprint) ) {
+        dbprint(VMI_DEBUG_CORE, "--init cache: the cached values don't match the guest\n");
+        return false;
+    }
+
+    if ( fingerprint != cache->fingerprint ) {
+        dbprint(VMI_DEBUG_CORE, "--init cache: the guest runs a different kernel\n");
+        return false;
+    }
+
+    return true;
+}
+
+void
+init_cache_free(
+    init_cache_t *cache)
+{
+    if (cache->config)
+        g_hash_table_destroy(cache->config);
+    g_hash_table_destroy(cache->entries);
+    g_free(cache);
+}
+
+void
+init_cache_store(
+    vmi_instance_t vmi)
+{
+    char *path = init_cache_path(vmi);
+    char *tmp_path = NULL;
+    const char **k;
+    uint64_t fingerprint;
+    addr_t value;
+    bool ok = false;
+    FILE *f = NULL;
+    int fd = -1;
+
+    if (!path)
+        return;
+
+    if ( VMI_FAILURE == init_cache_fingerprint(vmi, &fingerprint) ) {
+        dbprint(VMI_DEBUG_CORE, "--init cache: can't fingerprint the guest kernel, not caching\n");
+        goto done;
+    }
+
+    if (g_mkdir_with_parents(vmi->init_cache_dir, 0700)) {
+        errprint("Failed to create the init cache directory %s\n", vmi->init_cache_dir);
+        goto done;
+    }
+
+    /* written next to the entry and moved over it, readers see either one */
+    tmp_path = g_strdup_printf("%s.XXXXXX", path);
+    fd = mkstemp(tmp_path);
+    if (fd < 0) {
+        errprint("Failed to create %s\n", tmp_path);
+        goto done;
+    }
+
+    f = fdopen(fd, "w");
+    if (!f) {
+        close(fd);
+        goto done;
+    }
+
+    fprintf(f, "# LibVMI init cache for %s\n", vmi->image_type);
+    fprintf(f, "version %u\n", INIT_CACHE_VERSION);
+    fprintf(f, "os %u\n", vmi->os_type);
+    fprintf(f, "fingerprint 0x%"PRIx64"\n", fingerprint);
+    fprintf(f, "page_mode %u\n", vmi->page_mode);
+
+    for (k = init_cache_keys(vmi); *k; k++) {
+        /* zero means "not known" to the OS init, it searches again anyway */
+        if ( VMI_SUCCESS == vmi_get_offset(vmi, *k, &value) && value )
+            fprintf(f, "%s 0x%"PRIx64"\n", *k, value);
+    }
+
+    if (fflush(f) || ferror(f))
+        goto done;
+
+    if (rename(tmp_path, path)) {
+        errprint("Failed to move the init cache entry to %s\n", path);
+        goto done;
+    }
+
+    ok = true;
+    dbprint(VMI_DEBUG_CORE, "--init cache: stored %s\n", path);
+
+done:
+    if (f)
+        fclose(f);
+    if (!ok && fd >= 0)
+        unlink(tmp_path);
+    g_free(tmp_path);
+    g_free(path);
+}
@@ -0,0 +1,737 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "private.h"
+#include "json_profiles.h"
+
+struct binary_profile {
+    const uint8_t *map;
+    size_t size;
+
+    const bp_header_t *header;
+    const char *strings;
+    const bp_symbol_t *symbols;
+    const bp_struct_t *structs;
+    const bp_member_t *members;
+    const bp_enum_t *enums;
+    const bp_constant_t *constants;
+
+    unsigned int refs;      /**< instances sharing the profile, see vmi_clone */
+};
+
+static const char *
+bp_string(
+    const binary_profile_t *profile,
+    uint32_t offset)
+{
+    return offset < profile->header->strings.count ? profile->strings + offset : "";
+}
+
+/* Every record starts with the string offset of its name */
+static const void *
+bp_find(
+    const binary_profile_t *profile,
+    const void *records,
+    uint32_t count,
+    size_t record_size,
+    const char *name)
+{
+    uint32_t low = 0, high = count, mid;
+    const void *record;
+    int cmp;
+
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        record = (const uint8_t *) records + (size_t) mid * record_size;
+        cmp = strcmp(name, bp_string(profile, *(const uint32_t *) record));
+
+        if (!cmp)
+            return record;
+        if (cmp < 0)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+
+    return NULL;
+}
+
+static bool
+bp_section_valid(
+    size_t size,
+    const bp_section_t *section,
+    size_t record_size)
+{
+    if (section->offset & 7 || section->offset > size)
+        return false;
+
+    return section->count <= (size - section->offset) / record_size;
+}
+
+bool
+binary_profile_detect(
+    const char *path)
+{
+    char magic[BINARY_PROFILE_MAGIC_LEN];
+    bool ret = false;
+    FILE *f = fopen(path, "rb");
+
+    if (!f)
+        return false;
+
+    if (fread(magic, sizeof(magic), 1, f) == 1)
+        ret = !memcmp(magic, BINARY_PROFILE_MAGIC, sizeof(magic));
+
+    fclose(f);
+    return ret;
+}
+
+binary_profile_t *
+binary_profile_open(
+    const char *path)
+{
+    binary_profile_t *profile = NULL;
+    const bp_header_t *header;
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        errprint("Binary profile at %s couldn't be opened!\n", path);
+        return NULL;
+    }
+
+    if (fstat(fd, &st) || (size_t) st.st_size < sizeof(bp_header_t)) {
+        errprint("Binary profile at %s is truncated\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    /* read-only and shared: every instance uses the same page cache pages */
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        errprint("Failed to map binary profile %s\n", path);
+        return NULL;
+    }
+
+    header = map;
+
+    if (memcmp(header->magic, BINARY_PROFILE_MAGIC, BINARY_PROFILE_MAGIC_LEN) ||
+            header->version != BINARY_PROFILE_VERSION) {
+        errprint("Binary profile %s has an unsupported version\n", path);
+        goto err;
+    }
+
+    if (!bp_section_valid(st.st_size, &header->strings, 1) ||
+            !bp_section_valid(st.st_size, &header->symbols, sizeof(bp_symbol_t)) ||
+            !bp_section_valid(st.st_size, &header->structs, sizeof(bp_struct_t)) ||
+            !bp_section_valid(st.st_size, &header->members, sizeof(bp_member_t)) ||
+            !bp_section_valid(st.st_size, &header->enums, sizeof(bp_enum_t)) ||
+            !bp_section_valid(st.st_size, &header->constants, sizeof(bp_constant_t))) {
+        errprint("Binary profile %s is corrupt\n", path);
+        goto err;
+    }
+
+    /* string lookups rely on the table being terminated */
+    if (!header->strings.count || ((const char *) map)[header->strings.offset + header->strings.count - 1]) {
+        errprint("Binary profile %s has a corrupt string table\n", path);
+        goto err;
+    }
+
+    profile = g_try_malloc0(sizeof(binary_profile_t));
+    if (!profile)
+        goto err;
+
+    profile->refs = 1;
+    profile->map = map;
+    profile->size = st.st_size;
+    profile->header = header;
+    profile->strings = (const char *) profile->map + header->strings.offset;
+    profile->symbols = (const bp_symbol_t *) (profile->map + header->symbols.offset);
+    profile->structs = (const bp_struct_t *) (profile->map + header->structs.offset);
+    profile->members = (const bp_member_t *) (profile->map + header->members.offset);
+    profile->enums = (const bp_enum_t *) (profile->map + header->enums.offset);
+    profile->constants = (const bp_constant_t *) (profile->map + header->constants.offset);
+
+    dbprint(VMI_DEBUG_MISC, "Binary profile %s: %u symbols, %u structs, %u enums\n",
+            path, header->symbols.count, header->structs.count, header->enums.count);
+
+    return profile;
+
+err:
+    munmap(map, st.st_size);
+    return NULL;
+}
+
+binary_profile_t *
+binary_profile_ref(
+    binary_profile_t *profile)
+{
+    __atomic_add_fetch(&profile->refs, 1, __ATOMIC_RELAXED);
+    return profile;
+}
+
+void
+binary_profile_close(
+    binary_profile_t *profile)
+{
+    if (__atomic_sub_fetch(&profile->refs, 1, __ATOMIC_ACQ_REL))
+        return;
+
+    munmap((void *) profile->map, profile->size);
+    g_free(profile);
+}
+
+const char *
+binary_profile_get_os_type(
+    vmi_instance_t vmi)
+{
+    const char *os_type = bp_string(vmi->json.binary, vmi->json.binary->header->os_type);
+
+    return *os_type ? os_type : NULL;
+}
+
+status_t
+binary_profile_symbol(
+    binary_profile_t *profile,
+    const char *symbol,
+    addr_t *rva)
+{
+    const bp_symbol_t *found;
+
+    if (!symbol)
+        return VMI_FAILURE;
+
+    found = bp_find(profile, profile->symbols, profile->header->symbols.count, sizeof(bp_symbol_t), symbol);
+    if (!found) {
+        dbprint(VMI_DEBUG_MISC, "Binary profile: symbol '%s' not found\n", symbol);
+        return VMI_FAILURE;
+    }
+
+    *rva = found->rva;
+    return VMI_SUCCESS;
+}
+
+static const bp_struct_t *
+binary_profile_struct(
+    binary_profile_t *profile,
+    const char *struct_name)
+{
+    if (!struct_name)
+        return NULL;
+
+    return bp_find(profile, profile->structs, profile->header->structs.count, sizeof(bp_struct_t), struct_name);
+}
+
+status_t
+binary_profile_struct_size(
+    binary_profile_t *profile,
+    const char *struct_name,
+    size_t *size)
+{
+    const bp_struct_t *found = binary_profile_struct(profile, struct_name);
+
+    if (!found)
+        return VMI_FAILURE;
+
+    *size = found->size;
+    return VMI_SUCCESS;
+}
+
+bool
+binary_profile_member(
+    binary_profile_t *profile,
+    const char *struct_name,
+    const char *struct_member,
+    json_member_t *member)
+{
+    const bp_struct_t *jstruct = binary_profile_struct(profile, struct_name);
+    const bp_member_t *found;
+
+    if (!jstruct || !struct_member)
+        return false;
+
+    if ((uint64_t) jstruct->members + jstruct->num_members > profile->header->members.count)
+        return false;
+
+    found = bp_find(profile, profile->members + jstruct->members, jstruct->num_members,
+                    sizeof(bp_member_t), struct_member);
+    if (!found)
+        return false;
+
+    member->offset = found->offset;
+    member->size = found->size;
+    member->type_name = found->type_name ? bp_string(profile, found->type_name) : NULL;
+    member->bitfield = !!(found->flags & BINARY_PROFILE_BITFIELD);
+    member->start_bit = found->start_bit;
+    member->end_bit = found->end_bit;
+    return true;
+}
+
+status_t
+binary_profile_enum_value(
+    binary_profile_t *profile,
+    const char *enum_name,
+    const char *constant,
+    int64_t *value)
+{
+    const bp_enum_t *jenum;
+    const bp_constant_t *found;
+
+    if (!enum_name || !constant)
+        return VMI_FAILURE;
+
+    jenum = bp_find(profile, profile->enums, profile->header->enums.count, sizeof(bp_enum_t), enum_name);
+    if (!jenum)
+        return VMI_FAILURE;
+
+    if ((uint64_t) jenum->constants + jenum->num_constants > profile->header->constants.count)
+        return VMI_FAILURE;
+
+    found = bp_find(profile, profile->constants + jenum->constants, jenum->num_constants,
+                    sizeof(bp_constant_t), constant);
+    if (!found) {
+        dbprint(VMI_DEBUG_MISC, "Binary profile: %s has no constant %s\n", enum_name, constant);
+        return VMI_FAILURE;
+    }
+
+    *value = found->value;
+    return VMI_SUCCESS;
+}
+
+/*
+ * Conversion from JSON.
+ *
+ * The JSON profile is loaded into a scratch instance so the struct index
+ * does the flattening of embedded structs, and the format backends do the
+ * enumeration. Records are collected in memory and written out in one go.
+ */
+
+/* symbols, structs, members, enums and enum constants, in file order */
+#define BP_WRITER_SECTIONS 5
+
+typedef struct bp_writer_constant {
+    const char *enum_name;
+    const char *name;
+    int64_t value;
+    guint order;            /**< position in the profile, the first definition wins */
+} bp_writer_constant_t;
+
+typedef struct bp_writer {
+    vmi_instance_t vmi;
+
+    GString *strings;
+    GHashTable *string_offsets;     /**< string -> offset in the string table */
+
+    GHashTable *symbols;            /**< name -> addr_t */
+    GPtrArray *struct_names;
+    GArray *constants;              /**< bp_writer_constant_t */
+} bp_writer_t;
+
+static uint32_t
+bp_writer_string(
+    bp_writer_t *writer,
+    const char *str)
+{
+    gpointer offset;
+
+    if (!str || !*str)
+        return 0;
+
+    if (g_hash_table_lookup_extended(writer->string_offsets, str, NULL, &offset))
+        return GPOINTER_TO_UINT(offset);
+
+    offset = GUINT_TO_POINTER(writer->strings->len);
+    g_string_append_len(writer->strings, str, strlen(str) + 1);
+    g_hash_table_insert(writer->string_offsets, (gpointer) str, offset);
+
+    return GPOINTER_TO_UINT(offset);
+}
+
+static void
+bp_writer_add_symbol(
+    const char *name,
+    addr_t rva,
+    void *data)
+{
+    bp_writer_t *writer = data;
+    addr_t *value;
+
+    /* the first definition wins, like in the JSON lookups */
+    if (g_hash_table_lookup(writer->symbols, name))
+        return;
+
+    value = g_malloc(sizeof(addr_t));
+    *value = rva;
+    g_hash_table_insert(writer->symbols, (gpointer) name, value);
+}
+
+static void
+bp_writer_add_struct(
+    const char *name,
+    void *data)
+{
+    bp_writer_t *writer = data;
+
+    g_ptr_array_add(writer->struct_names, (gpointer) name);
+}
+
+static void
+bp_writer_add_constant(
+    const char *enum_name,
+    const char *name,
+    int64_t value,
+    void *data)
+{
+    bp_writer_t *writer = data;
+    bp_writer_constant_t constant = { enum_name, name, value, writer->constants->len };
+
+    if (name)
+        g_array_append_val(writer->constants, constant);
+}
+
+static int
+compare_names(
+    const void *a,
+    const void *b)
+{
+    return strcmp(*(const char * const *) a, *(const char * const *) b);
+}
+
+static gint
+compare_constants(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const bp_writer_constant_t *ca = a, *cb = b;
+    int cmp = strcmp(ca->enum_name, cb->enum_name);
+
+    if (!cmp)
+        cmp = strcmp(ca->name, cb->name);
+
+    return cmp ? cmp : (ca->order > cb->order) - (ca->order < cb->order);
+}
+
+/* Sorted array of the keys of a table, freed with g_free */
+static const char **
+sorted_keys(
+    GHashTable *table,
+    guint *count)
+{
+    const char **keys;
+    GHashTableIter iter;
+    gpointer key;
+    guint i = 0;
+
+    *count = g_hash_table_size(table);
+    keys = g_malloc0((*count + 1) * sizeof(char *));
+
+    g_hash_table_iter_init(&iter, table);
+    while (g_hash_table_iter_next(&iter, &key, NULL))
+        keys[i++] = key;
+
+    qsort(keys, *count, sizeof(char *), compare_names);
+    return keys;
+}
+
+static void
+bp_writer_symbols(
+    bp_writer_t *writer,
+    GArray *symbols)
+{
+    const char **names;
+    bp_symbol_t symbol = { 0 };
+    guint count, i;
+
+    names = sorted_keys(writer->symbols, &count);
+
+    for (i = 0; i < count; i++) {
+        symbol.name = bp_writer_string(writer, names[i]);
+        symbol.rva = *(addr_t *) g_hash_table_lookup(writer->symbols, names[i]);
+        g_array_append_val(symbols, symbol);
+    }
+
+    g_free(names);
+}
+
+static void
+bp_writer_structs(
+    bp_writer_t *writer,
+    GArray *structs,
+    GArray *members)
+{
+    GHashTable *table;
+    const char **names;
+    const char *name;
+    const json_member_t *jmember;
+    bp_struct_t jstruct = { 0 };
+    bp_member_t member = { 0 };
+    size_t size;
+    guint count, i, j;
+
+    g_ptr_array_sort(writer->struct_names, compare_names);
+
+    for (i = 0; i < writer->struct_names->len; i++) {
+        name = g_ptr_array_index(writer->struct_names, i);
+
+        size = 0;
+        table = json_profile_struct_members(writer->vmi, name, &size);
+        if (!table)
+            continue;
+
+        jstruct.name = bp_writer_string(writer, name);
+        jstruct.members = members->len;
+        jstruct.size = size;
+
+        names = sorted_keys(table, &count);
+        for (j = 0; j < count; j++) {
+            jmember = g_hash_table_lookup(table, names[j]);
+
+            member.name = bp_writer_string(writer, names[j]);
+            member.type_name = bp_writer_string(writer, jmember->type_name);
+            member.offset = jmember->offset;
+            member.size = jmember->size;
+            member.flags = jmember->bitfield ? BINARY_PROFILE_BITFIELD : 0;
+            member.start_bit = jmember->start_bit;
+            member.end_bit = jmember->end_bit;
+            g_array_append_val(members, member);
+        }
+        g_free(names);
+
+        jstruct.num_members = members->len - jstruct.members;
+        g_array_append_val(structs, jstruct);
+    }
+}
+
+static void
+bp_writer_enums(
+    bp_writer_t *writer,
+    GArray *enums,
+    GArray *constants)
+{
+    const bp_writer_constant_t *current, *prev = NULL;
+    bp_enum_t jenum = { 0 };
+    bp_constant_t constant = { 0 };
+    guint i;
+
+    g_array_sort(writer->constants, compare_constants);
+
+    for (i = 0; i < writer->constants->len; i++) {
+        current = &g_array_index(writer->constants, bp_writer_constant_t, i);
+
+        if (!prev || strcmp(prev->enum_name, current->enum_name)) {
+            if (prev)
+                g_array_append_val(enums, jenum);
+
+            jenum.name = bp_writer_string(writer, current->enum_name);
+            jenum.constants = constants->len;
+            jenum.num_constants = 0;
+        } else if (!strcmp(prev->name, current->name)) {
+            continue;
+        }
+
+        constant.name = bp_writer_string(writer, current->name);
+        constant.value = current->value;
+        g_array_append_val(constants, constant);
+        jenum.num_constants++;
+        prev = current;
+    }
+
+    if (prev)
+        g_array_append_val(enums, jenum);
+}
+
+static void
+bp_section(
+    bp_section_t *section,
+    uint32_t *offset,
+    GArray *records,
+    size_t record_size)
+{
+    section->offset = *offset;
+    section->count = records->len;
+    *offset += records->len * record_size;
+}
+
+static status_t
+bp_write_file(
+    const char *path,
+    const bp_header_t *header,
+    GArray **sections,
+    const size_t *record_sizes,
+    unsigned int num_sections,
+    GString *strings)
+{
+    char *tmp_path = g_strdup_printf("%s.XXXXXX", path);
+    status_t ret = VMI_FAILURE;
+    FILE *f = NULL;
+    unsigned int i;
+    int fd;
+
+    /*
+     * Write to a temporary file and rename it over the target: instances
+     * that have the old profile mapped keep using the old pages.
+     */
+    fd = mkstemp(tmp_path);
+    if (fd < 0) {
+        errprint("Failed to create %s\n", tmp_path);
+        goto done;
+    }
+
+    f = fdopen(fd, "wb");
+    if (!f) {
+        close(fd);
+        goto done;
+    }
+
+    if (fwrite(header, sizeof(*header), 1, f) != 1)
+        goto done;
+
+    for (i = 0; i < num_sections; i++) {
+        if (sections[i]->len &&
+                fwrite(sections[i]->data, record_sizes[i], sections[i]->len, f) != sections[i]->len)
+            goto done;
+    }
+
+    if (fwrite(strings->str, 1, strings->len, f) != strings->len)
+        goto done;
+
+    if (fchmod(fd, 0644) || fflush(f))
+        goto done;
+
+    if (rename(tmp_path, path)) {
+        errprint("Failed to move the binary profile to %s\n", path);
+        goto done;
+    }
+
+    ret = VMI_SUCCESS;
+
+done:
+    if (f)
+        fclose(f);
+    if (VMI_FAILURE == ret && fd >= 0)
+        unlink(tmp_path);
+    g_free(tmp_path);
+    return ret;
+}
+
+status_t
+vmi_convert_json_profile(
+    const char *json_path,
+    const char *output_path)
+{
+    status_t ret = VMI_FAILURE;
+    bp_writer_t writer = { 0 };
+    bp_header_t header = { 0 };
+    GArray *sections[BP_WRITER_SECTIONS];
+    const size_t record_sizes[BP_WRITER_SECTIONS] = {
+        sizeof(bp_symbol_t),
+        sizeof(bp_struct_t),
+        sizeof(bp_member_t),
+        sizeof(bp_enum_t),
+        sizeof(bp_constant_t)
+    };
+    bp_section_t *headers[BP_WRITER_SECTIONS] = {
+        &header.symbols,
+        &header.structs,
+        &header.members,
+        &header.enums,
+        &header.constants
+    };
+    uint32_t offset = sizeof(header);
+    unsigned int i;
+
+#ifdef ENABLE_SAFETY_CHECKS
+    if (!json_path || !output_path)
+        return VMI_FAILURE;
+#endif
+
+    writer.vmi = g_try_malloc0(sizeof(struct vmi_instance));
+    if (!writer.vmi)
+        return VMI_FAILURE;
+
+    if (!json_profile_init(writer.vmi, json_path) || !writer.vmi->json.root) {
+        errprint("%s is not a JSON profile\n", json_path);
+        goto done;
+    }
+
+    writer.strings = g_string_new_len("", 1);
+    writer.string_offsets = g_hash_table_new(g_str_hash, g_str_equal);
+    writer.symbols = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+    writer.struct_names = g_ptr_array_new();
+    writer.constants = g_array_new(FALSE, FALSE, sizeof(bp_writer_constant_t));
+
+    for (i = 0; i < BP_WRITER_SECTIONS; i++)
+        sections[i] = g_array_new(FALSE, FALSE, record_sizes[i]);
+
+    writer.vmi->json.foreach_symbol(writer.vmi->json.root, bp_writer_add_symbol, &writer);
+    writer.vmi->json.foreach_struct(writer.vmi->json.root, bp_writer_add_struct, &writer);
+    writer.vmi->json.foreach_enum(writer.vmi->json.root, bp_writer_add_constant, &writer);
+
+    bp_writer_symbols(&writer, sections[0]);
+    bp_writer_structs(&writer, sections[1], sections[2]);
+    bp_writer_enums(&writer, sections[3], sections[4]);
+
+    memcpy(header.magic, BINARY_PROFILE_MAGIC, BINARY_PROFILE_MAGIC_LEN);
+    header.version = BINARY_PROFILE_VERSION;
+    header.os_type = bp_writer_string(&writer, writer.vmi->json.get_os_type(writer.vmi));
+
+    for (i = 0; i < BP_WRITER_SECTIONS; i++) {
+        if (sections[i]->len > (UINT32_MAX - offset) / record_sizes[i])
+            break;
+        bp_section(headers[i], &offset, sections[i], record_sizes[i]);
+    }
+
+    if (i < BP_WRITER_SECTIONS || writer.strings->len > UINT32_MAX - offset) {
+        errprint("%s is too large for the binary profile format\n", json_path);
+    } else {
+        header.strings.offset = offset;
+        header.strings.count = writer.strings->len;
+
+        ret = bp_write_file(output_path, &header, sections, record_sizes, BP_WRITER_SECTIONS, writer.strings);
+        if (VMI_SUCCESS == ret)
+            dbprint(VMI_DEBUG_MISC, "Binary profile %s: %u symbols, %u structs, %u members, %u enums\n",
+                    output_path, header.symbols.count, header.structs.count,
+                    header.members.count, header.enums.count);
+    }
+
+    for (i = 0; i < BP_WRITER_SECTIONS; i++)
+        g_array_free(sections[i], TRUE);
+
+    g_array_free(writer.constants, TRUE);
+    g_ptr_array_free(writer.struct_names, TRUE);
+    g_hash_table_destroy(writer.symbols);
+    g_hash_table_destroy(writer.string_offsets);
+    g_string_free(writer.strings, TRUE);
+
+done:
+    json_profile_destroy(writer.vmi);
+    g_free(writer.vmi);
+    return ret;
+}
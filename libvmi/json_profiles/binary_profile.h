@@ -0,0 +1,147 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBVMI_BINARY_PROFILE_H
+#define LIBVMI_BINARY_PROFILE_H
+
+#include <stdint.h>
+
+/*
+ * Binary profile format.
+ *
+ * A precompiled Rekall profile or Volatility IST that is mapped read-only
+ * instead of parsed, so every instance on the host shares the same page
+ * cache pages. Integers are in host byte order (a file written on a host
+ * of the other byte order fails the version check), every section starts
+ * 8-byte aligned and section offsets are relative to the start of the file.
+ *
+ * Names are offsets into the string table, which starts with an empty
+ * string so that offset 0 means "no name". Symbols, structs and enums are
+ * sorted by name, and so are the members of a struct and the constants of
+ * an enum, so every lookup is a binary search. Struct members are stored
+ * flattened: the members of embedded and anonymous structs are listed at
+ * their offset from the outer struct, as the JSON struct index does.
+ */
+
+#define BINARY_PROFILE_MAGIC        "LVMIPROF"
+#define BINARY_PROFILE_MAGIC_LEN    8
+#define BINARY_PROFILE_VERSION      4
+
+#define BINARY_PROFILE_BITFIELD     (1u << 0)
+
+typedef struct bp_section {
+    uint32_t offset;
+    uint32_t count;         /**< number of records, or bytes for the string table */
+} bp_section_t;
+
+typedef struct bp_header {
+    char magic[BINARY_PROFILE_MAGIC_LEN];
+    uint32_t version;
+    uint32_t os_type;       /**< string */
+    bp_section_t strings;
+    bp_section_t symbols;
+    bp_section_t structs;
+    bp_section_t members;
+    bp_section_t enums;
+    bp_section_t constants;
+} bp_header_t;
+
+typedef struct bp_symbol {
+    uint32_t name;
+    uint32_t reserved;
+    uint64_t rva;
+} bp_symbol_t;
+
+typedef struct bp_struct {
+    uint32_t name;
+    uint32_t members;       /**< index of the first member */
+    uint32_t num_members;
+    uint32_t reserved;
+    uint64_t size;
+} bp_struct_t;
+
+typedef struct bp_member {
+    uint32_t name;
+    uint32_t type_name;
+    uint64_t offset;
+    uint32_t start_bit;
+    uint32_t end_bit;
+    uint32_t flags;
+    uint32_t size;          /**< bytes, 0 if unknown */
+} bp_member_t;
+
+typedef struct bp_enum {
+    uint32_t name;
+    uint32_t constants;     /**< index of the first constant */
+    uint32_t num_constants;
+    uint32_t reserved;
+} bp_enum_t;
+
+typedef struct bp_constant {
+    uint32_t name;
+    uint32_t reserved;
+    int64_t value;
+} bp_constant_t;
+
+#ifdef ENABLE_JSON_PROFILES
+
+typedef struct binary_profile binary_profile_t;
+
+/* Returns true if the file at path starts with the binary profile magic */
+bool binary_profile_detect(
+    const char *path);
+
+binary_profile_t *binary_profile_open(
+    const char *path);
+
+/* Takes another reference, the profile is unmapped by the last close */
+binary_profile_t *binary_profile_ref(
+    binary_profile_t *profile);
+
+void binary_profile_close(
+    binary_profile_t *profile);
+
+const char *binary_profile_get_os_type(
+    vmi_instance_t vmi);
+
+status_t binary_profile_symbol(
+    binary_profile_t *profile,
+    const char *symbol,
+    addr_t *rva);
+
+status_t binary_profile_struct_size(
+    binary_profile_t *profile,
+    const char *struct_name,
+    size_t *size);
+
+bool binary_profile_member(
+    binary_profile_t *profile,
+    const char *struct_name,
+    const char *struct_member,
+    json_member_t *member);
+
+status_t binary_profile_enum_value(
+    binary_profile_t *profile,
+    const char *enum_name,
+    const char *constant,
+    int64_t *value);
+
+#endif
+#endif /* LIBVMI_BINARY_PROFILE_H */
@@ -21,6 +21,7 @@
  */
 
 #include <stdbool.h>
+#include <string.h>
 
 #include "private.h"
 #include "json_profiles.h"
@@ -31,6 +32,354 @@ typedef enum json_profile_type {
     JPT_VOLATILITY_IST
 } json_profile_type_t;
 
+/*
+ * Struct index.
+ *
+ * The first struct query on a profile object flattens every struct of it
+ * into a hash table of its members, including the members of embedded and
+ * anonymous structs at their offset from the outer struct, along with each
+ * member's size. Later queries on the object are a single probe. Direct
+ * members win over embedded ones, and embedded structs are searched in the
+ * order the profile lists them.
+ *
+ * An index is never changed once built, so it is probed without locking
+ * and shared by reference between an instance and its clones. Each instance
+ * keeps one index per profile object in vmi->json.indexes, and the last
+ * instance to drop an index drops its reference on the object.
+ */
+
+#define JSON_INDEX_MAX_DEPTH 16
+
+typedef struct json_struct {
+    size_t size;
+    GHashTable *members;    /**< member name -> json_member_t */
+} json_struct_t;
+
+typedef struct json_index {
+    unsigned int refs;      /**< instances sharing the index, see vmi_clone */
+    json_object *json;
+    GHashTable *structs;    /**< struct name -> json_struct_t, or the not-a-struct marker */
+} json_index_t;
+
+static json_struct_t not_a_struct;
+
+/*
+ * Clones share the profile's objects, whose reference counts json-c doesn't
+ * update atomically. Every reference libvmi takes or drops is made under
+ * this lock.
+ */
+static pthread_mutex_t json_ref_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static json_object *
+json_ref(
+    json_object *json)
+{
+    pthread_mutex_lock(&json_ref_lock);
+    json_object_get(json);
+    pthread_mutex_unlock(&json_ref_lock);
+
+    return json;
+}
+
+static void
+json_unref(
+    json_object *json)
+{
+    pthread_mutex_lock(&json_ref_lock);
+    json_object_put(json);
+    pthread_mutex_unlock(&json_ref_lock);
+}
+
+static void
+json_struct_free(
+    gpointer data)
+{
+    json_struct_t *jstruct = data;
+
+    if (jstruct == &not_a_struct)
+        return;
+
+    g_hash_table_destroy(jstruct->members);
+    g_free(jstruct);
+}
+
+static json_index_t *
+json_index_ref(
+    json_index_t *index)
+{
+    __atomic_add_fetch(&index->refs, 1, __ATOMIC_RELAXED);
+    return index;
+}
+
+static void
+json_index_unref(
+    gpointer data)
+{
+    json_index_t *index = data;
+
+    if (__atomic_sub_fetch(&index->refs, 1, __ATOMIC_ACQ_REL))
+        return;
+
+    g_hash_table_destroy(index->structs);
+    json_unref(index->json);
+    g_free(index);
+}
+
+static json_struct_t *
+json_index_struct(
+    vmi_instance_t vmi,
+    json_index_t *index,
+    const char *struct_name,
+    unsigned int depth)
+{
+    json_interface_t *ji = &vmi->json;
+    json_struct_t *jstruct, *embedded;
+    json_object *fields;
+    json_field_info_t info;
+    json_member_t *member;
+    struct json_object_iterator iter, iend;
+    GHashTableIter members;
+    gpointer name, value;
+    size_t size = 0;
+
+    jstruct = g_hash_table_lookup(index->structs, struct_name);
+    if (jstruct)
+        return jstruct == &not_a_struct ? NULL : jstruct;
+
+    fields = ji->struct_fields(index->json, struct_name, &size);
+    if (!fields) {
+        g_hash_table_insert(index->structs, g_strdup(struct_name), &not_a_struct);
+        return NULL;
+    }
+
+    jstruct = g_malloc0(sizeof(json_struct_t));
+    jstruct->size = size;
+    jstruct->members = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+    g_hash_table_insert(index->structs, g_strdup(struct_name), jstruct);
+
+    iend = json_object_iter_end(fields);
+
+    for (iter = json_object_iter_begin(fields); !json_object_iter_equal(&iter, &iend); json_object_iter_next(&iter)) {
+        memset(&info, 0, sizeof(info));
+        if (!ji->field_info(index->json, json_object_iter_peek_value(&iter), &info))
+            continue;
+
+        member = g_malloc(sizeof(json_member_t));
+        member->offset = info.offset;
+        member->size = info.size;
+        member->type_name = info.type_name;
+        member->bitfield = info.bitfield;
+        member->start_bit = info.start_bit;
+        member->end_bit = info.end_bit;
+        g_hash_table_insert(jstruct->members, (gpointer) json_object_iter_peek_name(&iter), member);
+    }
+
+    if (depth >= JSON_INDEX_MAX_DEPTH)
+        return jstruct;
+
+    for (iter = json_object_iter_begin(fields); !json_object_iter_equal(&iter, &iend); json_object_iter_next(&iter)) {
+        memset(&info, 0, sizeof(info));
+        if (!ji->field_info(index->json, json_object_iter_peek_value(&iter), &info) || !info.embedded)
+            continue;
+
+        embedded = json_index_struct(vmi, index, info.embedded, depth + 1);
+        if (!embedded || embedded == jstruct)
+            continue;
+
+        g_hash_table_iter_init(&members, embedded->members);
+        while (g_hash_table_iter_next(&members, &name, &value)) {
+            if (g_hash_table_lookup(jstruct->members, name))
+                continue;
+
+            member = g_malloc(sizeof(json_member_t));
+            *member = *(json_member_t *) value;
+            member->offset += info.offset;
+            g_hash_table_insert(jstruct->members, name, member);
+        }
+    }
+
+    dbprint(VMI_DEBUG_MISC, "JSON profile: indexed %s with %u members\n",
+            struct_name, g_hash_table_size(jstruct->members));
+
+    return jstruct;
+}
+
+/* profile object -> json_index_t */
+static GHashTable *
+json_indexes_new(void)
+{
+    return g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, json_index_unref);
+}
+
+typedef struct json_index_build {
+    vmi_instance_t vmi;
+    json_index_t *index;
+} json_index_build_t;
+
+static void
+json_index_build_cb(
+    const char *struct_name,
+    void *data)
+{
+    json_index_build_t *build = data;
+
+    json_index_struct(build->vmi, build->index, struct_name, 0);
+}
+
+static json_index_t *
+json_index_new(
+    vmi_instance_t vmi,
+    json_object *json)
+{
+    json_index_t *index = g_malloc0(sizeof(json_index_t));
+    json_index_build_t build = { .vmi = vmi, .index = index };
+
+    index->refs = 1;
+    index->json = json_ref(json);
+    index->structs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, json_struct_free);
+
+    vmi->json.foreach_struct(json, json_index_build_cb, &build);
+
+    dbprint(VMI_DEBUG_MISC, "JSON profile: indexed %u types\n", g_hash_table_size(index->structs));
+
+    return index;
+}
+
+static json_struct_t *
+json_profile_struct(
+    vmi_instance_t vmi,
+    json_object *json,
+    const char *struct_name)
+{
+    json_index_t *index;
+    json_struct_t *jstruct;
+
+    if (!json || !struct_name || !vmi->json.struct_fields)
+        return NULL;
+
+    vmi_lock(vmi, &vmi->json.lock);
+    if (!vmi->json.indexes)
+        vmi->json.indexes = json_indexes_new();
+
+    index = g_hash_table_lookup(vmi->json.indexes, json);
+    if (!index) {
+        index = json_index_new(vmi, json);
+        g_hash_table_insert(vmi->json.indexes, json, index);
+    }
+    vmi_unlock(vmi, &vmi->json.lock);
+
+    jstruct = g_hash_table_lookup(index->structs, struct_name);
+
+    return jstruct == &not_a_struct ? NULL : jstruct;
+}
+
+GHashTable *
+json_profile_struct_members(
+    vmi_instance_t vmi,
+    const char *struct_name,
+    size_t *size)
+{
+    json_struct_t *jstruct = json_profile_struct(vmi, vmi->json.root, struct_name);
+
+    if (!jstruct)
+        return NULL;
+
+    if (size)
+        *size = jstruct->size;
+
+    return jstruct->members;
+}
+
+static bool
+json_profile_member(
+    vmi_instance_t vmi,
+    json_object *json,
+    const char *struct_name,
+    const char *struct_member,
+    json_member_t *member)
+{
+    const json_member_t *found = NULL;
+    json_struct_t *jstruct;
+
+    if (!json && vmi->json.binary)
+        return binary_profile_member(vmi->json.binary, struct_name, struct_member, member);
+
+    jstruct = json_profile_struct(vmi, json, struct_name);
+    if (jstruct && struct_member)
+        found = g_hash_table_lookup(jstruct->members, struct_member);
+    if (found)
+        *member = *found;
+
+    return !!found;
+}
+
+status_t
+json_profile_query(
+    vmi_instance_t vmi,
+    json_object *json,
+    const char *symbol,
+    const char *subsymbol,
+    addr_t *rva,
+    size_t *size)
+{
+    json_member_t member;
+    json_struct_t *jstruct;
+
+    if (!subsymbol && !size) {
+        if (!json && vmi->json.binary)
+            return binary_profile_symbol(vmi->json.binary, symbol, rva);
+
+        if (!vmi->json.handler || !json || !symbol)
+            return VMI_FAILURE;
+
+        return vmi->json.handler(json, symbol, rva);
+    }
+
+    if (size && !subsymbol) {
+        if (!json && vmi->json.binary)
+            return binary_profile_struct_size(vmi->json.binary, symbol, size);
+
+        jstruct = json_profile_struct(vmi, json, symbol);
+        if (jstruct)
+            *size = jstruct->size;
+
+        return jstruct ? VMI_SUCCESS : VMI_FAILURE;
+    }
+
+    if (!json_profile_member(vmi, json, symbol, subsymbol, &member)) {
+        dbprint(VMI_DEBUG_MISC, "JSON profile: %s.%s not found\n", symbol, subsymbol);
+        return VMI_FAILURE;
+    }
+
+    /* with both a member and a size, the member's size is asked for */
+    if (size) {
+        if (!member.size)
+            return VMI_FAILURE;
+        *size = member.size;
+    }
+    if (rva)
+        *rva = member.offset;
+
+    return VMI_SUCCESS;
+}
+
+status_t
+json_profile_enum_value(
+    vmi_instance_t vmi,
+    json_object *json,
+    const char *enum_name,
+    const char *constant,
+    int64_t *value)
+{
+    if (!json && vmi->json.binary)
+        return binary_profile_enum_value(vmi->json.binary, enum_name, constant, value);
+
+    if (!vmi->json.enum_value || !json || !enum_name || !constant)
+        return VMI_FAILURE;
+
+    return vmi->json.enum_value(json, enum_name, constant, value);
+}
+
 bool json_profile_init(vmi_instance_t vmi, const char* path)
 {
     json_interface_t *json = &vmi->json;
@@ -41,6 +390,19 @@ bool json_profile_init(vmi_instance_t vmi, const char* path)
     }
 
     json->path = g_strdup(path);
+
+    if (binary_profile_detect(path)) {
+        json->binary = binary_profile_open(path);
+        if (!json->binary) {
+            g_free((char*)json->path);
+            json->path = NULL;
+            return false;
+        }
+
+        json->get_os_type = binary_profile_get_os_type;
+        return true;
+    }
+
     json->root = json_object_from_file(json->path);
 
     if (!json->root) {
@@ -61,14 +423,23 @@ bool json_profile_init(vmi_instance_t vmi, const char* path)
     switch ( type ) {
         case JPT_VOLATILITY_IST:
             json->handler = volatility_ist_symbol_to_rva;
-            json->bitfield_offset_and_size = volatility_profile_bitfield_offset_and_size;
+            json->struct_fields = volatility_ist_struct_fields;
+            json->field_info = volatility_ist_field_info;
+            json->enum_value = volatility_ist_enum_value;
             json->get_os_type = volatility_get_os_type;
-            json->struct_field_type_name = volatility_struct_field_type_name;
+            json->foreach_symbol = volatility_ist_foreach_symbol;
+            json->foreach_struct = volatility_ist_foreach_struct;
+            json->foreach_enum = volatility_ist_foreach_enum;
             break;
         case JPT_REKALL_PROFILE:
             json->handler = rekall_profile_symbol_to_rva;
-            json->bitfield_offset_and_size = rekall_profile_bitfield_offset_and_size;
+            json->struct_fields = rekall_profile_struct_fields;
+            json->field_info = rekall_profile_field_info;
+            json->enum_value = rekall_profile_enum_value;
             json->get_os_type = rekall_get_os_type;
+            json->foreach_symbol = rekall_profile_foreach_symbol;
+            json->foreach_struct = rekall_profile_foreach_struct;
+            json->foreach_enum = rekall_profile_foreach_enum;
             break;
         default:
             return false;
@@ -79,12 +450,44 @@ bool json_profile_init(vmi_instance_t vmi, const char* path)
 
 void json_profile_destroy(vmi_instance_t vmi)
 {
+    if ( vmi->json.indexes )
+        g_hash_table_destroy(vmi->json.indexes);
+    vmi->json.indexes = NULL;
+
     g_free((char*)vmi->json.path);
     if ( vmi->json.root )
-        json_object_put(vmi->json.root);
+        json_unref(vmi->json.root);
+    if ( vmi->json.binary )
+        binary_profile_close(vmi->json.binary);
 
     vmi->json.path = NULL;
     vmi->json.root = NULL;
+    vmi->json.binary = NULL;
+}
+
+void json_profile_clone(vmi_instance_t vmi, vmi_instance_t clone)
+{
+    GHashTableIter iter;
+    gpointer json, index;
+
+    clone->json = vmi->json;
+    pthread_mutex_init(&clone->json.lock, NULL);
+
+    /* the profile and the struct indexes built so far are shared */
+    clone->json.indexes = NULL;
+    vmi_lock(vmi, &vmi->json.lock);
+    if ( vmi->json.indexes ) {
+        clone->json.indexes = json_indexes_new();
+        g_hash_table_iter_init(&iter, vmi->json.indexes);
+        while ( g_hash_table_iter_next(&iter, &json, &index) )
+            g_hash_table_insert(clone->json.indexes, json, json_index_ref(index));
+    }
+    vmi_unlock(vmi, &vmi->json.lock);
+    clone->json.path = g_strdup(vmi->json.path);
+    if ( vmi->json.root )
+        json_ref(vmi->json.root);
+    if ( vmi->json.binary )
+        binary_profile_ref(vmi->json.binary);
 }
 
 json_object* vmi_get_kernel_json(vmi_instance_t vmi)
@@ -94,42 +497,55 @@ json_object* vmi_get_kernel_json(vmi_instance_t vmi)
 
 status_t vmi_get_symbol_addr_from_json(vmi_instance_t vmi, json_object* json, const char* symbol, addr_t* addr)
 {
-    if ( !vmi->json.handler )
-        return VMI_FAILURE;
-
-    return vmi->json.handler(json, symbol, NULL, addr, NULL);
+    return json_profile_query(vmi, json, symbol, NULL, addr, NULL);
 }
 
 status_t vmi_get_struct_size_from_json(vmi_instance_t vmi, json_object* json, const char* struct_name, size_t* size)
 {
-    if ( !vmi->json.handler )
-        return VMI_FAILURE;
-
-    return vmi->json.handler(json, struct_name, NULL, NULL, size);
+    return json_profile_query(vmi, json, struct_name, NULL, NULL, size);
 }
 
 status_t vmi_get_struct_member_offset_from_json(vmi_instance_t vmi, json_object* json, const char* struct_name, const char* struct_member, addr_t* offset)
 {
-    if ( !vmi->json.handler )
-        return VMI_FAILURE;
+    return json_profile_query(vmi, json, struct_name, struct_member, offset, NULL);
+}
 
-    return vmi->json.handler(json, struct_name, struct_member, offset, NULL);
+status_t
+vmi_get_struct_member_size_from_json(vmi_instance_t vmi, json_object *json, const char *struct_name, const char *struct_member, size_t *size)
+{
+    return json_profile_query(vmi, json, struct_name, struct_member, NULL, size);
+}
+
+status_t
+vmi_get_enum_value_from_json(vmi_instance_t vmi, json_object *json, const char *enum_name, const char *constant, int64_t *value)
+{
+    return json_profile_enum_value(vmi, json, enum_name, constant, value);
 }
 
 status_t
 vmi_get_bitfield_offset_and_size_from_json(vmi_instance_t vmi, json_object *json, const char *struct_name, const char *struct_member, addr_t *offset, size_t *start_bit, size_t *end_bit)
 {
-    if ( !vmi->json.bitfield_offset_and_size )
+    json_member_t member;
+
+    if ( !json_profile_member(vmi, json, struct_name, struct_member, &member) || !member.bitfield )
         return VMI_FAILURE;
 
-    return vmi->json.bitfield_offset_and_size(json, struct_name, struct_member, offset, start_bit, end_bit);
+    *offset = member.offset;
+    *start_bit = member.start_bit;
+    *end_bit = member.end_bit;
+    return VMI_SUCCESS;
 }
 
 status_t
-vmi_get_struct_field_type_name(vmi_instance_t vmi, json_object *json, const char *struct_name, const char *struct_member, const char **member_type_name)
+vmi_get_struct_field_type_name_from_json(vmi_instance_t vmi, json_object *json, const char *struct_name, const char *struct_member, const char **member_type_name)
 {
-    if ( !vmi->json.struct_field_type_name )
+    json_member_t member;
+
+    *member_type_name = NULL;
+
+    if ( !json_profile_member(vmi, json, struct_name, struct_member, &member) || !member.type_name )
         return VMI_FAILURE;
 
-    return vmi->json.struct_field_type_name(json, struct_name, struct_member, member_type_name);
+    *member_type_name = member.type_name;
+    return VMI_SUCCESS;
 }
@@ -28,44 +28,118 @@
 
 #include <json-c/json.h>
 #include "private.h"
-#include "json_profiles/rekall.h"
-#include "json_profiles/volatility_ist.h"
+
+/* What a profile says about a single struct member */
+typedef struct json_field_info {
+    addr_t offset;
+    const char *type_name;  /**< name of the member's type, NULL if it has none */
+    const char *embedded;   /**< type whose members are searched as well, NULL if none */
+    size_t size;            /**< size of the member in bytes, 0 if unknown */
+    bool bitfield;
+    size_t start_bit;
+    size_t end_bit;
+} json_field_info_t;
+
+/* Flattened struct member, offset relative to the struct being indexed */
+typedef struct json_member {
+    addr_t offset;
+    size_t size;
+    const char *type_name;
+    bool bitfield;
+    size_t start_bit;
+    size_t end_bit;
+} json_member_t;
+
+/* Callbacks used to enumerate a profile when converting it */
+typedef void (*json_symbol_cb_t)(const char *name, addr_t rva, void *data);
+typedef void (*json_struct_cb_t)(const char *name, void *data);
+typedef void (*json_enum_cb_t)(const char *enum_name, const char *constant, int64_t value, void *data);
 
 typedef struct json_interface {
     const char *path; /**< JSON profile's path for domain's running kernel */
 
     json_object *root;
 
+    /* set instead of root when the profile is in the binary format */
+    struct binary_profile *binary;
+
+    /* struct indexes keyed by the profile object they describe, built on demand */
+    GHashTable *indexes;
+
+    pthread_mutex_t lock; /**< protects indexes in concurrent mode */
+
     status_t (*handler)(
         json_object *json,
         const char *symbol,
-        const char *subsymbol,
-        addr_t *rva,
+        addr_t *rva);
+
+    /* returns the member dictionary of a struct and its size */
+    json_object *(*struct_fields)(
+        json_object *json,
+        const char *struct_name,
         size_t *size);
 
-    status_t
-    (*bitfield_offset_and_size)(
+    bool (*field_info)(
         json_object *json,
-        const char *symbol,
-        const char *subsymbol,
-        addr_t *rva,
-        size_t *start_bit,
-        size_t *end_bit);
+        json_object *field,
+        json_field_info_t *info);
 
-    status_t
-    (*struct_field_type_name)(
+    status_t (*enum_value)(
         json_object *json,
-        const char *struct_name,
-        const char *struct_member,
-        const char **member_type_name);
+        const char *enum_name,
+        const char *constant,
+        int64_t *value);
 
     const char* (*get_os_type)(
         vmi_instance_t vmi);
+
+    void (*foreach_symbol)(
+        json_object *json,
+        json_symbol_cb_t cb,
+        void *data);
+
+    void (*foreach_struct)(
+        json_object *json,
+        json_struct_cb_t cb,
+        void *data);
+
+    void (*foreach_enum)(
+        json_object *json,
+        json_enum_cb_t cb,
+        void *data);
 } json_interface_t;
 
+#include "json_profiles/rekall.h"
+#include "json_profiles/volatility_ist.h"
+#include "json_profiles/binary_profile.h"
+
 bool json_profile_init(vmi_instance_t vmi, const char* path);
 
 void json_profile_destroy(vmi_instance_t vmi);
 
+/* Shares the profile of the instance with the clone and sets up its lock */
+void json_profile_clone(vmi_instance_t vmi, vmi_instance_t clone);
+
+status_t json_profile_query(
+    vmi_instance_t vmi,
+    json_object *json,
+    const char *symbol,
+    const char *subsymbol,
+    addr_t *rva,
+    size_t *size);
+
+status_t json_profile_enum_value(
+    vmi_instance_t vmi,
+    json_object *json,
+    const char *enum_name,
+    const char *constant,
+    int64_t *value);
+
+/* Flattened members of a struct of root, member name -> json_member_t */
+GHashTable *json_profile_struct_members(
+    vmi_instance_t vmi,
+    const char *struct_name,
+    size_t *size);
+
 #endif
 #endif /* LIBVMI_JSON_PROFILES_H */
@@ -24,252 +24,284 @@
 #include <stdio.h>
 #include <json-c/json.h>
 
-// Perform recursive search for subsymbol under symbol
-static status_t
-rekall_find_offset(
+status_t
+rekall_profile_symbol_to_rva(
     json_object *json,
     const char *symbol,
-    const char *subsymbol,
     addr_t *rva)
 {
     status_t ret = VMI_FAILURE;
-    json_object *structs = NULL, *jstruct = NULL, *jstruct2 = NULL, *jmember = NULL, *jvalue = NULL;
-    struct json_object_iterator iter, iend;
+    json_object *constants = NULL, *functions = NULL, *jsymbol = NULL;
 
-    if (!json_object_object_get_ex(json, "$STRUCTS", &structs)) {
-        dbprint(VMI_DEBUG_MISC, "Rekall profile: no $STRUCTS section found\n");
-        goto exit;
-    }
-    if (!json_object_object_get_ex(structs, symbol, &jstruct)) {
-        dbprint(VMI_DEBUG_MISC, "Rekall profile: no %s found\n", symbol);
-        goto exit;
+    if (!json || !symbol) {
+        return ret;
     }
 
-    jstruct2 = json_object_array_get_idx(jstruct, 1);
-    if (!jstruct2) {
-        dbprint(VMI_DEBUG_MISC, "Rekall profile: struct %s has no second element\n", symbol);
-        goto exit;
-    }
+    if (json_object_object_get_ex(json, "$CONSTANTS", &constants)) {
+        if (json_object_object_get_ex(constants, symbol, &jsymbol)) {
+            *rva = json_object_get_int64(jsymbol);
 
-    // symbol.subsymbol is defined
-    if (json_object_object_get_ex(jstruct2, subsymbol, &jmember)) {
-        jvalue = json_object_array_get_idx(jmember, 0);
-        if (!jvalue) {
-            dbprint(VMI_DEBUG_MISC, "Rekall profile: %s.%s exists but has no RVA defined\n", symbol, subsymbol);
+            ret = VMI_SUCCESS;
             goto exit;
+        } else {
+            dbprint(VMI_DEBUG_MISC, "Rekall profile: symbol '%s' not found in $CONSTANTS\n", symbol);
         }
-        // terminal success case
-        ret = VMI_SUCCESS;
-        *rva += json_object_get_int64(jvalue);
-        dbprint(VMI_DEBUG_MISC, "Rekall profile: %s.%s @ offset 0x%lx\n", symbol, subsymbol, *rva);
-        goto exit;
+    } else {
+        dbprint(VMI_DEBUG_MISC, "Rekall profile: no $CONSTANTS section found\n");
     }
 
-    // subsymbol not found; search down all anonymous or embedded structures in symbol.
-    // example: "mm_struct": [1032, {
-    //                           ....
-    //                        "u1": [0, ["__unnamed_178927"]] .... }]
-    //           "__unnamed_178927": [1032, {
-    //                           ....
-    //                         "flags": [880, ["long unsigned int"]],
-    //                           .... }]
-    iter = json_object_iter_begin (jstruct2);
-    iend = json_object_iter_end (jstruct2);
-
-    while (!json_object_iter_equal(&iter, &iend)) {
-        json_object *subval = NULL, *subval2 = NULL, *subval3 = NULL;
-        const char *subname1 = NULL;
-        const char *embedded = NULL;
-
-        subval = json_object_iter_peek_value(&iter);
-        subname1 = json_object_iter_peek_name(&iter);
-        (void) subname1; // only used in dbprint()
-
-        // get the top-level array from the value, e.g. ["__unnamed_178927"]
-        subval2 = json_object_array_get_idx(subval, 1);
-        if (!subval)
-            goto next;
-
-        // extract the name from the array, e.g. "__unnamed_178927"
-        subval3 = json_object_array_get_idx(subval2, 0);
-        if (!subval3)
-            goto next;
-
-        // finally, convert the object to a name
-        embedded = json_object_get_string (subval3);
-        if (!embedded)
-            goto next;
-
-        // now recurse into embedded, still looking for original subsymbol
-        ret = rekall_find_offset (json, embedded, subsymbol, rva);
-        if (VMI_SUCCESS == ret) {
-            // the field was found in the anonymous struct. tack on that struct's offset; in example: 0.
-            json_object *jofs = NULL;
-            jofs = json_object_array_get_idx(subval, 0);
-            if (!jofs) {
-                ret = VMI_FAILURE;
-                dbprint(VMI_DEBUG_MISC, "Rekall profile: anonymous/embedded struct %s has no offset in %s\n", subname1, symbol);
-                goto exit;
-            }
-
-            *rva += json_object_get_int64(jofs);
-            dbprint(VMI_DEBUG_MISC, "Rekall profile: %s.%s @ offset 0x%lx\n", symbol, subname1, *rva);
+    if (json_object_object_get_ex(json, "$FUNCTIONS", &functions)) {
+        if (json_object_object_get_ex(functions, symbol, &jsymbol)) {
+            *rva = json_object_get_int64(jsymbol);
+
+            ret = VMI_SUCCESS;
             goto exit;
+        } else {
+            dbprint(VMI_DEBUG_MISC, "Rekall profile: symbol '%s' not found in $FUNCTIONS\n", symbol);
         }
-
-next:
-        json_object_iter_next (&iter);
+    } else {
+        dbprint(VMI_DEBUG_MISC, "Rekall profile: no $FUNCTIONS section found\n");
     }
 
 exit:
+    dbprint(VMI_DEBUG_MISC, "Rekall profile lookup %s: 0x%lx\n", symbol, ret == VMI_SUCCESS ? *rva : 0);
+
     return ret;
 }
 
-
-status_t
-rekall_profile_symbol_to_rva(
+// "task_struct": [size, { "member": [offset, ["type", {args}]], ... }]
+json_object *
+rekall_profile_struct_fields(
     json_object *json,
-    const char *symbol,
-    const char *subsymbol,
-    addr_t *rva,
+    const char *struct_name,
     size_t *size)
 {
-    status_t ret = VMI_FAILURE;
-    if (!json || !symbol) {
-        return ret;
+    json_object *structs = NULL, *jstruct = NULL, *fields = NULL;
+
+    if (!json_object_object_get_ex(json, "$STRUCTS", &structs)) {
+        dbprint(VMI_DEBUG_MISC, "Rekall profile: no $STRUCTS section found\n");
+        return NULL;
+    }
+    if (!json_object_object_get_ex(structs, struct_name, &jstruct)) {
+        dbprint(VMI_DEBUG_MISC, "Rekall profile: no %s found\n", struct_name);
+        return NULL;
     }
 
-    if (!subsymbol && !size) {
-        json_object *constants = NULL, *functions = NULL, *jsymbol = NULL;
-        if (json_object_object_get_ex(json, "$CONSTANTS", &constants)) {
-            if (json_object_object_get_ex(constants, symbol, &jsymbol)) {
-                *rva = json_object_get_int64(jsymbol);
-
-                ret = VMI_SUCCESS;
-                goto exit;
-            } else {
-                dbprint(VMI_DEBUG_MISC, "Rekall profile: symbol '%s' not found in $CONSTANTS\n", symbol);
-            }
-        } else {
-            dbprint(VMI_DEBUG_MISC, "Rekall profile: no $CONSTANTS section found\n");
-        }
+    fields = json_object_array_get_idx(jstruct, 1);
+    if (!fields || !json_object_is_type(fields, json_type_object)) {
+        dbprint(VMI_DEBUG_MISC, "Rekall profile: struct %s has no second element\n", struct_name);
+        return NULL;
+    }
 
-        if (json_object_object_get_ex(json, "$FUNCTIONS", &functions)) {
-            if (json_object_object_get_ex(functions, symbol, &jsymbol)) {
-                *rva = json_object_get_int64(jsymbol);
+    *size = json_object_get_int64(json_object_array_get_idx(jstruct, 0));
+    return fields;
+}
 
-                ret = VMI_SUCCESS;
-                goto exit;
-            } else {
-                dbprint(VMI_DEBUG_MISC, "Rekall profile: symbol '%s' not found in $FUNCTIONS\n", symbol);
-            }
-        } else {
-            dbprint(VMI_DEBUG_MISC, "Rekall profile: no $FUNCTIONS section found\n");
-        }
-    } else {
-        json_object *structs = NULL, *jstruct = NULL;
+/* Types that are nested deeper than this, through arrays, are not sized */
+#define REKALL_TYPE_MAX_DEPTH 16
+
+static const struct {
+    const char *name;
+    size_t size;
+} rekall_base_types[] = {
+    { "char", 1 }, { "signed char", 1 }, { "unsigned char", 1 }, { "bool", 1 },
+    { "short", 2 }, { "unsigned short", 2 }, { "wchar", 2 },
+    { "int", 4 }, { "unsigned int", 4 }, { "float", 4 },
+    { "long long", 8 }, { "unsigned long long", 8 }, { "double", 8 },
+};
+
+static bool
+rekall_profile_metadata_is(
+    json_object *json,
+    const char *key,
+    const char *value)
+{
+    json_object *metadata = NULL, *jvalue = NULL;
 
-        if (!json_object_object_get_ex(json, "$STRUCTS", &structs)) {
-            dbprint(VMI_DEBUG_MISC, "Rekall profile: no $STRUCTS section found\n");
-            goto exit;
-        }
-        if (!json_object_object_get_ex(structs, symbol, &jstruct)) {
-            dbprint(VMI_DEBUG_MISC, "Rekall profile: no %s found\n", symbol);
-            goto exit;
-        }
+    return json_object_object_get_ex(json, "$METADATA", &metadata) &&
+           json_object_object_get_ex(metadata, key, &jvalue) &&
+           !strcmp(json_object_get_string(jvalue), value);
+}
 
-        if (size) {
-            json_object* jsize = json_object_array_get_idx(jstruct, 0);
-            *size = json_object_get_int64(jsize);
+/*
+ * Size of a type given as ["name", {args}], 0 if unknown. Longs are 4 bytes
+ * on Windows and as large as a pointer on Linux.
+ */
+static size_t
+rekall_profile_type_size(
+    json_object *json,
+    const char *name,
+    json_object *jargs,
+    unsigned int depth)
+{
+    json_object *structs = NULL, *jstruct = NULL, *jcount = NULL, *jtarget = NULL, *jtarget_args = NULL;
+    unsigned int i;
+    size_t size;
 
-            ret = VMI_SUCCESS;
-            goto exit;
-        }
+    if (!name || depth > REKALL_TYPE_MAX_DEPTH)
+        return 0;
+
+    if (!strcmp(name, "Pointer"))
+        return rekall_profile_metadata_is(json, "arch", "AMD64") ? 8 : 4;
 
-        // looking for offset, perform recursive search for subsymbol under symbol
-        *rva = 0;
-        ret = rekall_find_offset(json, symbol, subsymbol, rva);
+    if (!strcmp(name, "long") || !strcmp(name, "unsigned long"))
+        return rekall_profile_metadata_is(json, "arch", "AMD64") &&
+               rekall_profile_metadata_is(json, "ProfileClass", "Linux") ? 8 : 4;
+
+    for (i = 0; i < sizeof(rekall_base_types) / sizeof(rekall_base_types[0]); i++) {
+        if (!strcmp(name, rekall_base_types[i].name))
+            return rekall_base_types[i].size;
     }
 
-exit:
-    dbprint(VMI_DEBUG_MISC, "Rekall profile lookup %s %s: 0x%lx\n", symbol ?: NULL, subsymbol ?: NULL, rva ? *rva : 0);
+    if (json_object_object_get_ex(json, "$STRUCTS", &structs) &&
+            json_object_object_get_ex(structs, name, &jstruct))
+        return json_object_get_int64(json_object_array_get_idx(jstruct, 0));
 
-    return ret;
+    /* Array, BitField and Enumeration take the size of their target */
+    if (!json_object_object_get_ex(jargs, "target", &jtarget))
+        return 0;
+
+    json_object_object_get_ex(jargs, "target_args", &jtarget_args);
+    size = rekall_profile_type_size(json, json_object_get_string(jtarget), jtarget_args, depth + 1);
+
+    if (!strcmp(name, "Array")) {
+        if (!json_object_object_get_ex(jargs, "count", &jcount))
+            return 0;
+        size *= json_object_get_int64(jcount);
+    }
+
+    return size;
 }
 
-status_t
-rekall_profile_bitfield_offset_and_size(
+// "member": [offset, ["type", {args}]]
+// Any named type is searched for embedded members, e.g.
+//   "u1": [0, ["__unnamed_178927"]]
+// Bitfields are declared as
+//   "flags": [4, ["BitField", {"start_bit": 0, "end_bit": 3, "target": "unsigned int"}]]
+bool
+rekall_profile_field_info(
     json_object *json,
-    const char *symbol,
-    const char *subsymbol,
-    addr_t *rva,
-    size_t *start_bit,
-    size_t *end_bit)
+    json_object *field,
+    json_field_info_t *info)
 {
-    status_t ret = VMI_FAILURE;
-    if (!json || !symbol) {
-        return ret;
-    }
+    json_object *jofs, *jtype, *jname, *jargs, *jvalue;
 
-    json_object *structs = NULL, *jstruct = NULL, *jstruct2 = NULL, *jstruct3 = NULL, *jmember = NULL, *jvalue = NULL;
-    if (!json_object_object_get_ex(json, "$STRUCTS", &structs)) {
-        dbprint(VMI_DEBUG_MISC, "Rekall profile: no $STRUCTS section found\n");
-        goto exit;
-    }
-    if (!json_object_object_get_ex(structs, symbol, &jstruct)) {
-        dbprint(VMI_DEBUG_MISC, "Rekall profile: no %s found\n", symbol);
-        goto exit;
-    }
+    jofs = json_object_array_get_idx(field, 0);
+    if (!jofs)
+        return false;
 
-    jstruct2 = json_object_array_get_idx(jstruct, 1);
-    if (!jstruct2) {
-        dbprint(VMI_DEBUG_MISC, "Rekall profile: struct %s has no second element\n", symbol);
-        goto exit;
-    }
+    info->offset = json_object_get_int64(jofs);
 
-    if (!json_object_object_get_ex(jstruct2, subsymbol, &jmember)) {
-        dbprint(VMI_DEBUG_MISC, "Rekall profile: %s has no %s member\n", symbol, subsymbol);
-        goto exit;
-    }
+    jtype = json_object_array_get_idx(field, 1);
+    jname = json_object_array_get_idx(jtype, 0);
+    if (!jname)
+        return true;
 
-    jvalue = json_object_array_get_idx(jmember, 0);
-    if (!jvalue) {
-        dbprint(VMI_DEBUG_MISC, "Rekall profile: %s.%s has no RVA defined\n", symbol, subsymbol);
-        goto exit;
-    }
+    info->type_name = json_object_get_string(jname);
+    info->embedded = info->type_name;
 
-    *rva = json_object_get_int64(jvalue);
+    jargs = json_object_array_get_idx(jtype, 1);
+    info->size = rekall_profile_type_size(json, info->type_name, jargs, 0);
 
-    jvalue = json_object_array_get_idx(jmember, 1);
-    if (!jvalue) {
-        dbprint(VMI_DEBUG_MISC, "Rekall profile: %s.%s has no BitField declaration\n", symbol, subsymbol);
-        goto exit;
+    if (!info->type_name || strcmp(info->type_name, "BitField"))
+        return true;
+
+    if (json_object_object_get_ex(jargs, "start_bit", &jvalue)) {
+        info->start_bit = json_object_get_int64(jvalue);
+        if (json_object_object_get_ex(jargs, "end_bit", &jvalue)) {
+            info->end_bit = json_object_get_int64(jvalue);
+            info->bitfield = true;
+        }
     }
 
-    jstruct3 = json_object_array_get_idx(jvalue, 1);
-    if (!jvalue) {
-        dbprint(VMI_DEBUG_MISC, "Rekall profile: %s.%s has no BitField definition\n", symbol, subsymbol);
-        goto exit;
+    return true;
+}
+
+void
+rekall_profile_foreach_symbol(
+    json_object *json,
+    json_symbol_cb_t cb,
+    void *data)
+{
+    static const char *sections[] = { "$CONSTANTS", "$FUNCTIONS" };
+    json_object *symbols = NULL;
+    unsigned int i;
+
+    for (i = 0; i < sizeof(sections) / sizeof(sections[0]); i++) {
+        if (!json_object_object_get_ex(json, sections[i], &symbols))
+            continue;
+
+        json_object_object_foreach(symbols, name, jsymbol) {
+            cb(name, json_object_get_int64(jsymbol), data);
+        }
     }
+}
+
+void
+rekall_profile_foreach_struct(
+    json_object *json,
+    json_struct_cb_t cb,
+    void *data)
+{
+    json_object *structs = NULL;
 
-    if (!json_object_object_get_ex(jstruct3, "start_bit", &jvalue)) {
-        dbprint(VMI_DEBUG_MISC, "Rekall profile: %s.%s has no member start_bit\n", symbol, subsymbol);
-        goto exit;
+    if (!json_object_object_get_ex(json, "$STRUCTS", &structs))
+        return;
+
+    json_object_object_foreach(structs, name, jstruct) {
+        (void) jstruct;
+        cb(name, data);
     }
-    *start_bit = json_object_get_int64(jvalue);
+}
+
+// "$ENUMS": { "_POOL_TYPE": { "0": "NonPagedPool", ... } }
+void
+rekall_profile_foreach_enum(
+    json_object *json,
+    json_enum_cb_t cb,
+    void *data)
+{
+    json_object *enums = NULL;
+
+    if (!json_object_object_get_ex(json, "$ENUMS", &enums))
+        return;
 
-    if (!json_object_object_get_ex(jstruct3, "end_bit", &jvalue)) {
-        dbprint(VMI_DEBUG_MISC, "Rekall profile: %s.%s has no member end_bit\n", symbol, subsymbol);
-        goto exit;
+    json_object_object_foreach(enums, enum_name, jenum) {
+        if (!json_object_is_type(jenum, json_type_object))
+            continue;
+
+        json_object_object_foreach(jenum, value, jconstant) {
+            cb(enum_name, json_object_get_string(jconstant), strtoll(value, NULL, 0), data);
+        }
     }
-    *end_bit = json_object_get_int64(jvalue);
+}
+
+// "$ENUMS": { "_POOL_TYPE": { "0": "NonPagedPool", ... } }, keyed by value
+status_t
+rekall_profile_enum_value(
+    json_object *json,
+    const char *enum_name,
+    const char *constant,
+    int64_t *value)
+{
+    json_object *enums = NULL, *jenum = NULL;
 
-    ret = VMI_SUCCESS;
+    if (!json_object_object_get_ex(json, "$ENUMS", &enums) ||
+            !json_object_object_get_ex(enums, enum_name, &jenum) ||
+            !json_object_is_type(jenum, json_type_object)) {
+        dbprint(VMI_DEBUG_MISC, "Rekall profile: no enum %s found\n", enum_name);
+        return VMI_FAILURE;
+    }
 
-exit:
-    dbprint(VMI_DEBUG_MISC, "Rekall profile lookup %s %s: offset 0x%lx, start bit %ld, end bit %ld\n", symbol ?: NULL, subsymbol ?: NULL, *rva, *start_bit, *end_bit);
+    json_object_object_foreach(jenum, jvalue, jconstant) {
+        if (!strcmp(constant, json_object_get_string(jconstant))) {
+            *value = strtoll(jvalue, NULL, 0);
+            return VMI_SUCCESS;
+        }
+    }
 
-    return ret;
+    dbprint(VMI_DEBUG_MISC, "Rekall profile: %s has no constant %s\n", enum_name, constant);
+    return VMI_FAILURE;
 }
 
 const char* rekall_get_os_type(vmi_instance_t vmi)
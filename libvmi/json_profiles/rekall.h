@@ -29,48 +29,114 @@ status_t
 rekall_profile_symbol_to_rva(
     json_object *json,
     const char *symbol,
-    const char *subsymbol,
-    addr_t *rva,
+    addr_t *rva);
+
+json_object *
+rekall_profile_struct_fields(
+    json_object *json,
+    const char *struct_name,
     size_t *size);
 
+bool
+rekall_profile_field_info(
+    json_object *json,
+    json_object *field,
+    json_field_info_t *info);
+
 const char* rekall_get_os_type(vmi_instance_t vmi);
 
+void
+rekall_profile_foreach_symbol(
+    json_object *json,
+    json_symbol_cb_t cb,
+    void *data);
+
+void
+rekall_profile_foreach_struct(
+    json_object *json,
+    json_struct_cb_t cb,
+    void *data);
+
+void
+rekall_profile_foreach_enum(
+    json_object *json,
+    json_enum_cb_t cb,
+    void *data);
+
 status_t
-rekall_profile_bitfield_offset_and_size(
+rekall_profile_enum_value(
     json_object *json,
-    const char *symbol,
-    const char *subsymbol,
-    addr_t *rva,
-    size_t *start_bit,
-    size_t *end_bit);
+    const char *enum_name,
+    const char *constant,
+    int64_t *value);
+
 #else
 
-static inline status_t rekall_profile_symbol_to_rva(
-    json_object *json,
-    const char *symbol,
-    const char *subsymbol,
-    addr_t *rva,
-    size_t *size)
+static inline status_t
+rekall_profile_symbol_to_rva(
+    __attribute__((__unused__)) json_object *json,
+    __attribute__((__unused__)) const char *symbol,
+    __attribute__((__unused__)) addr_t *rva)
 {
     return VMI_FAILURE;
 }
 
-static inline status_t
-rekall_profile_bitfield_offset_and_size(
-    json_object *json,
-    const char *symbol,
-    const char *subsymbol,
-    addr_t *rva,
-    size_t *start_bit,
-    size_t *end_bit)
+static inline json_object *
+rekall_profile_struct_fields(
+    __attribute__((__unused__)) json_object *json,
+    __attribute__((__unused__)) const char *struct_name,
+    __attribute__((__unused__)) size_t *size)
 {
-    return VMI_FAILURE;
+    return NULL;
+}
+
+static inline bool
+rekall_profile_field_info(
+    __attribute__((__unused__)) json_object *json,
+    __attribute__((__unused__)) json_object *field,
+    __attribute__((__unused__)) json_field_info_t *info)
+{
+    return false;
 }
 
-static inline const char *rekall_get_os_type(vmi_instance_t vmi)
+static inline const char *rekall_get_os_type(__attribute__((__unused__)) vmi_instance_t vmi)
 {
     return NULL;
 }
 
+static inline void
+rekall_profile_foreach_symbol(
+    __attribute__((__unused__)) json_object *json,
+    __attribute__((__unused__)) json_symbol_cb_t cb,
+    __attribute__((__unused__)) void *data)
+{
+}
+
+static inline void
+rekall_profile_foreach_struct(
+    __attribute__((__unused__)) json_object *json,
+    __attribute__((__unused__)) json_struct_cb_t cb,
+    __attribute__((__unused__)) void *data)
+{
+}
+
+static inline void
+rekall_profile_foreach_enum(
+    __attribute__((__unused__)) json_object *json,
+    __attribute__((__unused__)) json_enum_cb_t cb,
+    __attribute__((__unused__)) void *data)
+{
+}
+
+static inline status_t
+rekall_profile_enum_value(
+    __attribute__((__unused__)) json_object *json,
+    __attribute__((__unused__)) const char *enum_name,
+    __attribute__((__unused__)) const char *constant,
+    __attribute__((__unused__)) int64_t *value)
+{
+    return VMI_FAILURE;
+}
+
 #endif
 #endif /* LIBVMI_REKALL_H */
@@ -24,380 +24,280 @@
 #include <stdio.h>
 #include <json-c/json.h>
 
-// Perform recursive search for subsymbol under symbol
-static status_t
-volatility_ist_find_offset(
+status_t
+volatility_ist_symbol_to_rva(
     json_object *json,
     const char *symbol,
-    const char *subsymbol,
     addr_t *rva)
 {
     status_t ret = VMI_FAILURE;
-    json_object *user_types = NULL, *jstruct = NULL, *jstruct2 = NULL, *jmember = NULL, *jvalue = NULL;
-    struct json_object_iterator iter, iend;
+    json_object *symbols = NULL, *jsymbol = NULL, *address = NULL;
 
-    if (!json_object_object_get_ex(json, "user_types", &user_types)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: no user_types section found\n");
-        goto exit;
+    if (!json || !symbol) {
+        return ret;
     }
-    if (!json_object_object_get_ex(user_types, symbol, &jstruct)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: no %s found\n", symbol);
+
+    if (!json_object_object_get_ex(json, "symbols", &symbols)) {
+        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: no symbols section found\n");
         goto exit;
     }
-
-    if (!json_object_object_get_ex(jstruct, "fields", &jstruct2)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: struct %s has no fields element\n", symbol);
+    if (!json_object_object_get_ex(symbols, symbol, &jsymbol)) {
+        dbprint(VMI_DEBUG_MISC, "Volatility IST: symbol '%s' not found in symbols\n", symbol);
         goto exit;
     }
-
-    // check for terminal success case
-    if (json_object_object_get_ex(jstruct2, subsymbol, &jmember)) {
-        if (!json_object_object_get_ex(jmember, "offset", &jvalue)) {
-            dbprint(VMI_DEBUG_MISC, "Volatility IST profile: %s.%s has no offset\n", symbol, subsymbol);
-            goto exit;
-        }
-        ret = VMI_SUCCESS;
-#ifdef JSONC_UINT64_SUPPORT
-        *rva += json_object_get_uint64(jvalue);
-#else
-        *rva += json_object_get_int64(jvalue);
-#endif
+    if (!json_object_object_get_ex(jsymbol, "address", &address)) {
+        dbprint(VMI_DEBUG_MISC, "Volatility IST: no address found for %s\n", symbol);
         goto exit;
     }
 
-    // subsymbol not found; search down all anonymous or embedded structures in symbol.
-    // example:
-    // "mm_struct": {
-    //   "size": 1032,
-    //   "fields": {
-    //     ...
-    //     "unnamed_field_0": {
-    //       "type": {
-    //         "kind": "struct",
-    //         "name": "unnamed_8216149fbf604e93"
-    //       },
-    //       "offset": 0,
-    //       "anonymous": true
-    //     }
-    //   },
-    //   "kind": "struct"
-    // },
-
-    iter = json_object_iter_begin (jstruct2);
-    iend = json_object_iter_end (jstruct2);
-
-    while (!json_object_iter_equal(&iter, &iend)) {
-        json_object *subval = NULL, *subval2 = NULL, *subval3 = NULL;
-        const char *subname1 = NULL;
-        const char *embedded = NULL;
-
-        subval = json_object_iter_peek_value(&iter);
-        subname1 = json_object_iter_peek_name(&iter);
-        (void) subname1; // only used in dprint
-
-        // get the type dict for the subfield, e.g. "type": {"kind": "struct", "name": "unnamed_8216149fbf604e93" },
-        if (!json_object_object_get_ex (subval, "type", &subval2))
-            goto next;
-
-        // get the name
-        if (!json_object_object_get_ex (subval2, "name", &subval3))
-            goto next;
-
-        // finally, convert the object to a name
-        embedded = json_object_get_string (subval3);
-        if (!embedded)
-            goto next;
-
-        // now recurse into embedded, still looking for original subsymbol
-        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: exploring anonymous/embedded struct %s (%s) for offset for %s\n",
-                subname1, embedded, subsymbol);
-        ret = volatility_ist_find_offset(json, embedded, subsymbol, rva);
-        if (VMI_SUCCESS == ret) {
-            // the field was found in the anonymous struct. tack on that struct's offset; in example: 0.
-            json_object *jofs = NULL;
-            if (!json_object_object_get_ex(subval, "offset", &jofs)) {
-                ret = VMI_FAILURE;
-                dbprint(VMI_DEBUG_MISC, "Volatility IST profile: anonymous struct %s has no offset in %s\n", subname1, symbol);
-                goto exit;
-            }
-
 #ifdef JSONC_UINT64_SUPPORT
-            *rva += json_object_get_uint64(jofs);
+    *rva = json_object_get_uint64(address);
 #else
-            *rva += json_object_get_int64(jofs);
+    *rva = json_object_get_int64(address);
 #endif
-            dbprint(VMI_DEBUG_MISC, "Volatility IST profile: %s.%s @ offset %ld\n", symbol, subname1, *rva);
-            goto exit;
-        }
-
-next:
-        json_object_iter_next (&iter);
-    }
-
+    ret = VMI_SUCCESS;
 
 exit:
+    dbprint(VMI_DEBUG_MISC, "Volatility IST profile lookup %s: 0x%lx\n",
+            symbol, ret == VMI_SUCCESS ? *rva : 0);
     return ret;
 }
 
-status_t
-volatility_ist_symbol_to_rva(
+// "user_types": { "mm_struct": { "size": 1032, "fields": { ... }, "kind": "struct" } }
+json_object *
+volatility_ist_struct_fields(
     json_object *json,
-    const char *symbol,
-    const char *subsymbol,
-    addr_t *rva,
+    const char *struct_name,
     size_t *size)
 {
-    status_t ret = VMI_FAILURE;
+    json_object *user_types = NULL, *jstruct = NULL, *fields = NULL, *jsize = NULL;
 
-    if (!json || !symbol) {
-        return ret;
+    if (!json_object_object_get_ex(json, "user_types", &user_types)) {
+        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: no user_types section found\n");
+        return NULL;
+    }
+    if (!json_object_object_get_ex(user_types, struct_name, &jstruct)) {
+        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: no %s found\n", struct_name);
+        return NULL;
+    }
+    if (!json_object_object_get_ex(jstruct, "fields", &fields)) {
+        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: struct %s has no fields element\n", struct_name);
+        return NULL;
     }
 
-    if (!subsymbol && !size) {
-        json_object *symbols = NULL, *jsymbol = NULL, *address = NULL;
-        if (!json_object_object_get_ex(json, "symbols", &symbols)) {
-            dbprint(VMI_DEBUG_MISC, "Volatility IST profile: no symbols section found\n");
-            goto exit;
-        }
-        if (!json_object_object_get_ex(symbols, symbol, &jsymbol)) {
-            dbprint(VMI_DEBUG_MISC, "Volatility IST: symbol '%s' not found in symbols\n", symbol);
-            goto exit;
-        }
-        if (!json_object_object_get_ex(jsymbol, "address", &address)) {
-            dbprint(VMI_DEBUG_MISC, "Volatility IST: no address found for %s\n", symbol);
-            goto exit;
-        }
-
+    if (json_object_object_get_ex(jstruct, "size", &jsize)) {
 #ifdef JSONC_UINT64_SUPPORT
-        *rva = json_object_get_uint64(address);
+        *size = json_object_get_uint64(jsize);
 #else
-        *rva = json_object_get_int64(address);
+        *size = json_object_get_int64(jsize);
 #endif
-        ret = VMI_SUCCESS;
-    } else {
-        json_object *user_types = NULL, *jstruct = NULL;
-        if (!json_object_object_get_ex(json, "user_types", &user_types)) {
-            dbprint(VMI_DEBUG_MISC, "Volatility IST profile: no user_types section found\n");
-            goto exit;
-        }
-        if (!json_object_object_get_ex(user_types, symbol, &jstruct)) {
-            dbprint(VMI_DEBUG_MISC, "Volatility IST profile: no %s found\n", symbol);
-            goto exit;
-        }
+    }
 
-        if (size) {
-            json_object* jsize = NULL;
+    return fields;
+}
 
-            if (!json_object_object_get_ex(jstruct, "size", &jsize)) {
-                dbprint(VMI_DEBUG_MISC, "Volatility IST profile: Struct '%s' size not found\n", symbol);
-                goto exit;
-            }
+/* Types that are nested deeper than this, through arrays, are not sized */
+#define VOLATILITY_IST_TYPE_MAX_DEPTH 16
 
-#ifdef JSONC_UINT64_SUPPORT
-            *size = json_object_get_uint64(jsize);
-#else
-            *size = json_object_get_int64(jsize);
-#endif
-            ret = VMI_SUCCESS;
-            goto exit;
-        }
+static size_t
+volatility_ist_section_size(
+    json_object *json,
+    const char *section,
+    const char *name)
+{
+    json_object *types = NULL, *jtype = NULL, *jsize = NULL;
 
-        // look for offset by performing recursive search for subsymbol under symbol
-        *rva = 0;
-        ret = volatility_ist_find_offset(json, symbol, subsymbol, rva);
-    }
+    if (!name ||
+            !json_object_object_get_ex(json, section, &types) ||
+            !json_object_object_get_ex(types, name, &jtype) ||
+            !json_object_object_get_ex(jtype, "size", &jsize))
+        return 0;
 
-exit:
-    dbprint(VMI_DEBUG_MISC, "Volatility IST profile lookup %s %s: 0x%lx\n",
-            symbol ?: NULL, subsymbol ?: NULL, rva ? *rva : 0);
-    return ret;
+    return json_object_get_int64(jsize);
 }
 
-const char *volatility_get_os_type(vmi_instance_t vmi)
+/*
+ * Size of a type description, 0 if unknown:
+ *   { "kind": "array", "count": 16, "subtype": { ... } }
+ *   { "kind": "pointer", "subtype": { ... } }
+ *   { "kind": "base" | "struct" | "union" | "class" | "enum", "name": "..." }
+ */
+static size_t
+volatility_ist_type_size(
+    json_object *json,
+    json_object *jtype,
+    unsigned int depth)
 {
-    json_object *metadata = NULL, *os = NULL;
-
-    if (!json_object_object_get_ex(vmi->json.root, "metadata", &metadata)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: no metadata section found\n");
-        return NULL;
+    json_object *jkind = NULL, *jname = NULL, *jsubtype = NULL, *jcount = NULL;
+    const char *kind, *name = NULL;
+
+    if (depth > VOLATILITY_IST_TYPE_MAX_DEPTH || !json_object_object_get_ex(jtype, "kind", &jkind))
+        return 0;
+
+    kind = json_object_get_string(jkind);
+    if (json_object_object_get_ex(jtype, "name", &jname))
+        name = json_object_get_string(jname);
+
+    if (!strcmp(kind, "base"))
+        return volatility_ist_section_size(json, "base_types", name);
+    if (!strcmp(kind, "pointer"))
+        return volatility_ist_section_size(json, "base_types", "pointer");
+    if (!strcmp(kind, "enum"))
+        return volatility_ist_section_size(json, "enums", name);
+    if (!strcmp(kind, "struct") || !strcmp(kind, "union") || !strcmp(kind, "class"))
+        return volatility_ist_section_size(json, "user_types", name);
+
+    /* arrays and bitfields are sized by the type they wrap */
+    if (!json_object_object_get_ex(jtype, !strcmp(kind, "array") ? "subtype" : "type", &jsubtype))
+        return 0;
+
+    if (!strcmp(kind, "array")) {
+        if (!json_object_object_get_ex(jtype, "count", &jcount))
+            return 0;
+        return json_object_get_int64(jcount) * volatility_ist_type_size(json, jsubtype, depth + 1);
     }
 
-    if (json_object_object_get_ex(metadata, "windows", &os))
-        return "Windows";
-
-    return "Linux";
+    return volatility_ist_type_size(json, jsubtype, depth + 1);
 }
 
-status_t
-volatility_profile_bitfield_offset_and_size(
+// "member": { "type": { "kind": "struct", "name": "unnamed_8216149fbf604e93" }, "offset": 0 }
+// Any named type is searched for embedded members. Bitfields are declared as
+//   "type": { "kind": "bitfield", "bit_position": 0, "bit_length": 3, "type": { ... } }
+bool
+volatility_ist_field_info(
     json_object *json,
-    const char *symbol,
-    const char *subsymbol,
-    addr_t *rva,
-    size_t *start_bit,
-    size_t *end_bit)
+    json_object *field,
+    json_field_info_t *info)
 {
-    status_t ret = VMI_FAILURE;
-    if (!json || !symbol) {
-        return ret;
-    }
+    json_object *jofs = NULL, *jtype = NULL, *jvalue = NULL, *jlength = NULL;
 
-    json_object *user_types = NULL, *jstruct = NULL, *fields = NULL, *type = NULL, *jmember = NULL, *jvalue = NULL;
-    if (!json_object_object_get_ex(json, "user_types", &user_types)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility profile: no user_types section found\n");
-        goto exit;
-    }
-    if (!json_object_object_get_ex(user_types, symbol, &jstruct)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility profile: no %s found\n", symbol);
-        goto exit;
-    }
-    if (!json_object_object_get_ex(jstruct, "fields", &fields)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility profile: no fields found\n");
-        goto exit;
-    }
-    if (!json_object_object_get_ex(fields, subsymbol, &jmember)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility profile: %s has no %s member\n", symbol, subsymbol);
-        goto exit;
-    }
-    if (!json_object_object_get_ex(jmember, "offset", &jvalue)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: %s.%s has no offset defined\n", symbol, subsymbol);
-        goto exit;
-    }
+    if (!json_object_object_get_ex(field, "offset", &jofs))
+        return false;
 
 #ifdef JSONC_UINT64_SUPPORT
-    *rva = json_object_get_uint64(jvalue);
+    info->offset = json_object_get_uint64(jofs);
 #else
-    *rva = json_object_get_int64(jvalue);
+    info->offset = json_object_get_int64(jofs);
 #endif
 
-    if (!json_object_object_get_ex(jmember, "type", &type)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility profile: no type found\n");
-        goto exit;
-    }
+    if (!json_object_object_get_ex(field, "type", &jtype))
+        return true;
 
-    if (!json_object_object_get_ex(type, "bit_position", &jvalue)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility profile: %s.%s has no member bit_position\n", symbol, subsymbol);
-        goto exit;
+    if (json_object_object_get_ex(jtype, "name", &jvalue)) {
+        info->type_name = json_object_get_string(jvalue);
+        info->embedded = info->type_name;
     }
 
-#ifdef JSONC_UINT64_SUPPORT
-    *start_bit = json_object_get_uint64(jvalue);
-#else
-    *start_bit = json_object_get_int64(jvalue);
-#endif
+    info->size = volatility_ist_type_size(json, jtype, 0);
 
-    if (!json_object_object_get_ex(type, "bit_length", &jvalue)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility profile: %s.%s has no member bit_length\n", symbol, subsymbol);
-        goto exit;
+    if (json_object_object_get_ex(jtype, "bit_position", &jvalue) &&
+            json_object_object_get_ex(jtype, "bit_length", &jlength)) {
+        info->start_bit = json_object_get_int64(jvalue);
+        info->end_bit = info->start_bit + json_object_get_int64(jlength);
+        info->bitfield = true;
     }
 
+    return true;
+}
+
+void
+volatility_ist_foreach_symbol(
+    json_object *json,
+    json_symbol_cb_t cb,
+    void *data)
+{
+    json_object *symbols = NULL, *address = NULL;
+
+    if (!json_object_object_get_ex(json, "symbols", &symbols))
+        return;
+
+    json_object_object_foreach(symbols, name, jsymbol) {
+        if (!json_object_object_get_ex(jsymbol, "address", &address))
+            continue;
+
 #ifdef JSONC_UINT64_SUPPORT
-    size_t bit_length = json_object_get_uint64(jvalue);
+        cb(name, json_object_get_uint64(address), data);
 #else
-    size_t bit_length = json_object_get_int64(jvalue);
+        cb(name, json_object_get_int64(address), data);
 #endif
+    }
+}
 
-    *end_bit = *start_bit + bit_length;
+void
+volatility_ist_foreach_struct(
+    json_object *json,
+    json_struct_cb_t cb,
+    void *data)
+{
+    json_object *user_types = NULL;
 
-    ret = VMI_SUCCESS;
+    if (!json_object_object_get_ex(json, "user_types", &user_types))
+        return;
 
-exit:
-    dbprint(VMI_DEBUG_MISC, "Volatility profile lookup %s %s: offset 0x%lx, start bit %ld, end bit %ld\n", symbol ?: NULL, subsymbol ?: NULL, *rva, *start_bit, *end_bit);
+    json_object_object_foreach(user_types, name, jstruct) {
+        (void) jstruct;
+        cb(name, data);
+    }
+}
 
-    return ret;
+// "enums": { "pid_type": { "size": 4, "base": "unsigned int", "constants": { "PIDTYPE_PID": 0, ... } } }
+void
+volatility_ist_foreach_enum(
+    json_object *json,
+    json_enum_cb_t cb,
+    void *data)
+{
+    json_object *enums = NULL, *constants = NULL;
+
+    if (!json_object_object_get_ex(json, "enums", &enums))
+        return;
+
+    json_object_object_foreach(enums, enum_name, jenum) {
+        if (!json_object_object_get_ex(jenum, "constants", &constants))
+            continue;
+
+        json_object_object_foreach(constants, constant, jvalue) {
+            cb(enum_name, constant, json_object_get_int64(jvalue), data);
+        }
+    }
 }
 
+// "enums": { "pid_type": { "size": 4, "base": "unsigned int", "constants": { "PIDTYPE_PID": 0, ... } } }
 status_t
-volatility_struct_field_type_name(
-    json_object *json_profile,
-    const char* struct_name,
-    const char* field_name,
-    const char** member_type_name)
+volatility_ist_enum_value(
+    json_object *json,
+    const char *enum_name,
+    const char *constant,
+    int64_t *value)
 {
-    *member_type_name = NULL;
+    json_object *enums = NULL, *jenum = NULL, *constants = NULL, *jvalue = NULL;
 
-    struct json_object* json_user_types;
-    if (!json_object_object_get_ex(json_profile, "user_types", &json_user_types)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility profile: no user_types section found.\n");
+    if (!json_object_object_get_ex(json, "enums", &enums) ||
+            !json_object_object_get_ex(enums, enum_name, &jenum) ||
+            !json_object_object_get_ex(jenum, "constants", &constants)) {
+        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: no enum %s found\n", enum_name);
         return VMI_FAILURE;
     }
-
-    struct json_object* json_struct;
-    if (!json_object_object_get_ex(json_user_types, struct_name, &json_struct)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: no %s found\n", struct_name);
+    if (!json_object_object_get_ex(constants, constant, &jvalue)) {
+        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: %s has no constant %s\n", enum_name, constant);
         return VMI_FAILURE;
     }
 
-    struct json_object* json_fields;
-    if (!json_object_object_get_ex(json_struct, "fields", &json_fields)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: %s has no `fields` key.\n", struct_name);
-        return VMI_FAILURE;
-    }
+    *value = json_object_get_int64(jvalue);
+    return VMI_SUCCESS;
+}
 
-    struct json_object* json_field = NULL;
-    if (!json_object_object_get_ex(json_fields, field_name, &json_field)) {
-        // Check recursively all unnamed structure fields aswell, as many fields in linux are wrapped in anonymous structures for structure randomization.
-        struct json_object_iterator it = json_object_iter_begin(json_fields);
-        struct json_object_iterator it_end = json_object_iter_end(json_fields);
-        for (; !json_object_iter_equal(&it, &it_end); json_object_iter_next(&it)) {
-            if (strncmp(json_object_iter_peek_name(&it), "unnamed", strlen("unnamed")) != 0)
-                continue;
-
-            json_object* json_field_val = json_object_iter_peek_value(&it);
-
-            struct json_object* json_field_subtype;
-            if (!json_object_object_get_ex(json_field_val, "type", &json_field_subtype)) {
-                dbprint(VMI_DEBUG_MISC, "Volatility IST profile: Failed to find `type` key.\n");
-                return VMI_FAILURE;
-            }
-
-            struct json_object* json_field_subkind;
-            if (!json_object_object_get_ex(json_field_subtype, "kind", &json_field_subkind)) {
-                dbprint(VMI_DEBUG_MISC, "Volatility IST profile: Failed to find `kind` key.\n");
-                return VMI_FAILURE;
-            }
-            if (strcmp(json_object_get_string(json_field_subkind), "struct") != 0)
-                continue;
-
-            struct json_object* json_anonymous_struct_name;
-            if (!json_object_object_get_ex(json_field_subtype, "name", &json_anonymous_struct_name)) {
-                dbprint(VMI_DEBUG_MISC, "Volatility IST profile: Failed to find `name` key\n");
-                return VMI_FAILURE;
-            }
-
-            struct json_object *json_anonymous_struct;
-            if (!json_object_object_get_ex(json_user_types, json_object_get_string(json_anonymous_struct_name), &json_anonymous_struct)) {
-                dbprint(VMI_DEBUG_MISC, "Volatility IST profile: Failed to find %s in user_types.\n", json_object_get_string(json_anonymous_struct_name));
-                return VMI_FAILURE;
-            }
-
-            struct json_object* json_anonymous_struct_fields;
-            if (!json_object_object_get_ex(json_anonymous_struct, "fields", &json_anonymous_struct_fields)) {
-                dbprint(VMI_DEBUG_MISC, "Volatility IST profile: Failed to find `fields` key.\n");
-                return VMI_FAILURE;
-            }
-
-            if (json_object_object_get_ex(json_anonymous_struct_fields, field_name, &json_field))
-                break;
-        }
-    }
-    if (!json_field) {
-        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: Failed to find %s\n", field_name);
-        return VMI_FAILURE;
-    }
+const char *volatility_get_os_type(vmi_instance_t vmi)
+{
+    json_object *metadata = NULL, *os = NULL;
 
-    struct json_object* json_struct_type;
-    if (!json_object_object_get_ex(json_field, "type", &json_struct_type)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: Failed to find `type` key.\n");
-        return VMI_FAILURE;
+    if (!json_object_object_get_ex(vmi->json.root, "metadata", &metadata)) {
+        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: no metadata section found\n");
+        return NULL;
     }
 
-    struct json_object* json_type_name;
-    if (!json_object_object_get_ex(json_struct_type, "name", &json_type_name)) {
-        dbprint(VMI_DEBUG_MISC, "Volatility IST profile: Failed to find `name` key.\n");
-        return VMI_FAILURE;
-    }
+    if (json_object_object_get_ex(metadata, "windows", &os))
+        return "Windows";
 
-    *member_type_name = json_object_get_string(json_type_name);
-    return VMI_SUCCESS;
+    return "Linux";
 }
@@ -61,6 +61,28 @@ extern "C" {
 
 #define VMI_INIT_DOMAINWATCH (1u << 4) /**< initialize using a domain watcher */
 
+/**
+ * Make the instance safe to use from several threads at once. The page
+ * cache is sharded and locked, every thread translates with its own v2p and
+ * paging-structure caches, and the symbol, PID and process caches are
+ * locked, so any number of threads can read memory, translate addresses and
+ * look up symbols, PIDs and DTBs in parallel.
+ *
+ * The event API is serialized. vmi_events_listen only holds the event lock
+ * while it dispatches events, not while it waits for them, so other threads
+ * can register or clear events during a listen. Listen from one thread only.
+ * Callbacks run on the listening thread and may use the whole API. Strings returned by vmi_translate_v2sym stay valid until the
+ * symbol caches are flushed. Init, vmi_destroy and the settings that
+ * reconfigure the instance (page mode, OS, JSON profile) must not race with
+ * anything else; join the other threads before vmi_destroy.
+ *
+ * Without the flag nothing is locked and the instance must only be used by
+ * one thread at a time. Needs LibVMI built with the page cache, and a driver
+ * that can be called from several threads: Xen, file and mem. Init fails
+ * for KVM and Bareflank.
+ */
+#define VMI_INIT_CONCURRENT (1u << 5)
+
 typedef enum vmi_mode {
 
     VMI_XEN, /**< libvmi is monitoring a Xen VM */
@@ -69,7 +91,9 @@ typedef enum vmi_mode {
 
     VMI_FILE, /**< libvmi is viewing a file on disk */
 
-    VMI_BAREFLANK /** <libvmi is monitoring a Bareflank VM */
+    VMI_BAREFLANK, /** <libvmi is monitoring a Bareflank VM */
+
+    VMI_MEM /**< libvmi is viewing a synthetic guest held in RAM, named by its description file; never detected by vmi_get_access_mode */
 } vmi_mode_t;
 
 typedef enum vmi_config {
@@ -210,9 +234,31 @@ typedef enum {
 
     VMI_INIT_DATA_MEMMAP,    /**< memory_map_t pointer */
 
-    VMI_INIT_DATA_KVMI_SOCKET     /**< kvmi socket path */
+    VMI_INIT_DATA_KVMI_SOCKET,    /**< kvmi socket path */
+
+    VMI_INIT_DATA_FILE_MODE, /**< uint32_t pointer, VMI_FILE_* access flags for the file driver */
+
+    VMI_INIT_DATA_INIT_CACHE /**< directory path, enables the persistent OS init cache */
 } vmi_init_data_type_t;
 
+/**
+ * File driver access flags, passed with VMI_INIT_DATA_FILE_MODE
+ */
+#define VMI_FILE_MMAP           (1u << 0) /**< serve pages straight out of a mapping of the file */
+
+#define VMI_FILE_MMAP_HUGEPAGE  (1u << 1) /**< ask for transparent huge pages on the mapping */
+
+/**
+ * Hints about the way guest memory is about to be accessed
+ */
+typedef enum access_hint {
+    VMI_ACCESS_HINT_NORMAL,     /**< no particular access pattern */
+
+    VMI_ACCESS_HINT_SEQUENTIAL, /**< memory is about to be read in ascending order */
+
+    VMI_ACCESS_HINT_RANDOM      /**< memory is read in no particular order, e.g. pointer chasing */
+} access_hint_t;
+
 /**
  * Structures used to pass initialization data to LibVMI
  */
@@ -791,6 +837,16 @@ typedef struct {
     };
 } access_context_t;
 
+/**
+ * A single read within a vmi_readv batch
+ */
+typedef struct {
+    const access_context_t *ctx; /**< where to read from */
+    size_t count;                /**< number of bytes to read */
+    void *buf;                   /**< buffer to hold at least count bytes */
+    size_t bytes_read;           /**< set to the number of bytes read */
+} read_request_t;
+
 /**
  * Macro to test bitfield values (up to 64-bits)
  */
@@ -823,6 +879,105 @@ typedef struct _ustring {
  */
 typedef struct vmi_instance *vmi_instance_t;
 
+/**
+ * Handle to a guest page borrowed with vmi_pin_page.
+ */
+typedef struct page_pin *page_pin_t;
+
+/**
+ * A byte pattern to look for with vmi_scan_memory
+ */
+typedef struct {
+    const uint8_t *data; /**< bytes to match */
+    size_t length;       /**< number of bytes in data */
+} scan_pattern_t;
+
+/**
+ * Called by vmi_scan_memory for every match, in address order.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] addr Address of the first byte of the match, in the address space of the scan
+ * @param[in] pattern Index of the matching pattern
+ * @param[in] data User data passed to vmi_scan_memory
+ * @return true to continue the scan, false to stop it
+ */
+typedef bool (*scan_callback_t)(vmi_instance_t vmi, addr_t addr, unsigned int pattern, void *data);
+
+#define VMI_PROCESS_NAME_LEN        32  /**< size of vmi_process_t.name */
+
+#define VMI_PROCESS_KERNEL_THREAD   (1u << 0) /**< runs on an address space it borrowed (Linux active_mm) */
+
+/**
+ * A process, as returned by vmi_get_process_list
+ */
+typedef struct {
+    addr_t addr;        /**< virtual address of the task_struct, EPROCESS or proc */
+    vmi_pid_t pid;      /**< process id */
+    vmi_pid_t ppid;     /**< parent process id, -1 if unknown */
+    addr_t dtb;         /**< directory table base, 0 if unknown */
+    char name[VMI_PROCESS_NAME_LEN]; /**< NUL-terminated short name (comm/ImageFileName) */
+    uint32_t flags;     /**< VMI_PROCESS_* */
+} vmi_process_t;
+
+/**
+ * An OS init heuristic that succeeded, as returned by vmi_get_init_methods
+ */
+typedef struct {
+    const char *name;   /**< name of the heuristic */
+    uint64_t nsec;      /**< time from the start of the search until it succeeded */
+} vmi_init_method_t;
+
+#define VMI_STATS_EVENT_TYPES   16 /**< room for every VMI_EVENT_* type */
+
+/**
+ * Performance counters of an instance, as returned by vmi_get_stats.
+ * Every member is a uint64_t counter.
+ */
+typedef struct {
+    uint64_t page_cache_hits;       /**< page reads served from the page cache */
+    uint64_t page_cache_misses;     /**< page reads that went to the driver */
+    uint64_t page_cache_evictions;  /**< pages dropped to make room for others */
+    uint64_t driver_page_fetches;   /**< pages read or mapped by the driver, read-ahead included */
+    uint64_t driver_bytes;          /**< bytes read or mapped by the driver */
+    uint64_t driver_writes;         /**< writes to guest memory through the driver */
+    uint64_t driver_nsec;           /**< time spent in driver fetches and writes */
+    uint64_t v2p_hits;              /**< translations found in the v2p cache */
+    uint64_t v2p_misses;            /**< translations that needed a page table walk */
+    uint64_t pt_cache_hits;         /**< page table entries found in the paging-structure cache */
+    uint64_t page_walk_reads;       /**< page table entries read from guest memory */
+    uint64_t sym_cache_hits;
+    uint64_t sym_cache_misses;
+    uint64_t rva_cache_hits;
+    uint64_t rva_cache_misses;
+    uint64_t init_cache_hits;       /**< OS inits done with the values of the init cache */
+    uint64_t init_cache_misses;     /**< OS inits the init cache had no valid entry for */
+    uint64_t events_received[VMI_STATS_EVENT_TYPES]; /**< events delivered by the hypervisor, by VMI_EVENT_* type */
+    uint64_t events_handled[VMI_STATS_EVENT_TYPES];  /**< event callbacks run, by VMI_EVENT_* type */
+} vmi_stats_t;
+
+#define VMI_VA_RANGE_WRITE      (1u << 0) /**< writable */
+#define VMI_VA_RANGE_USER       (1u << 1) /**< accessible from user mode */
+#define VMI_VA_RANGE_EXEC       (1u << 2) /**< executable */
+
+#define VMI_WALK_COALESCE       (1u << 0) /**< merge contiguous mappings into runs */
+
+/**
+ * A mapping reported by vmi_walk_va_pages
+ */
+typedef struct {
+    addr_t vaddr;       /**< virtual address of the first page */
+    addr_t paddr;       /**< physical address vaddr maps to */
+    uint64_t size;      /**< length of the range, the page size unless runs are coalesced */
+    uint32_t perms;     /**< VMI_VA_RANGE_* */
+    const page_info_t *info; /**< paging structures of the first page, valid during the callback */
+} vmi_va_range_t;
+
+/**
+ * Called for each mapping found by vmi_walk_va_pages.
+ * Return true to continue the walk, false to stop it.
+ */
+typedef bool (*vmi_va_range_cb_t)(vmi_instance_t vmi, const vmi_va_range_t *range, void *data);
+
 /*---------------------------------------------------------
  * Initialization and Destruction functions from core.c
  */
@@ -926,6 +1081,18 @@ page_mode_t vmi_init_paging(
  * such as vmi_*_ksym. If the user hasn't called vmi_init_paging yet, this
  * function will do that automatically.
  *
+ * If the instance was created with VMI_INIT_DATA_INIT_CACHE, the values the
+ * OS heuristics find are saved in that directory and reused on the next
+ * initialization of the same VM, after a few reads confirm that the guest
+ * still runs the same kernel. Values in the configuration take precedence.
+ *
+ * Where the OS has several heuristics for the same value (such as the
+ * KdDebuggerDataBlock search methods on Windows), they run at the same time
+ * on clones of the instance, each in its own thread, and the first one
+ * that succeeds wins and stops the others; see vmi_get_init_methods. With
+ * drivers that are neither thread-safe nor share their connection with a
+ * clone (see vmi_clone), they are tried cheapest first instead.
+ *
  * @param[in] vmi LibVMI instance
  * @param[in] config_mode The type of OS configuration that is provided.
  * @param[in] config Configuration is passed directly to LibVMI (ie. in a string
@@ -942,6 +1109,48 @@ os_t vmi_init_os(
     void *config,
     vmi_init_error_t *error) NOEXCEPT;
 
+/**
+ * Lists the OS heuristics that won during the last vmi_init_os, in the
+ * order they finished, with the time each took to win. Useful to find which
+ * configuration values would make the initialization faster. The list is
+ * empty if the configuration or the init cache made the heuristics
+ * unnecessary. The array belongs to the instance and remains valid until
+ * the next vmi_init_os or vmi_destroy.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[out] methods Array of the heuristics that succeeded
+ * @param[out] count Number of entries in the array
+ * @return VMI_SUCCESS or VMI_FAILURE
+ */
+status_t vmi_get_init_methods(
+    vmi_instance_t vmi,
+    const vmi_init_method_t **methods,
+    size_t *count) NOEXCEPT;
+
+/**
+ * Creates a new instance for the same target as an initialized one, without
+ * repeating the driver and OS initialization. The clone shares what the
+ * initialization found out with the instance: the paging mode, kernel page
+ * directory and KASLR offset, the OS offsets, and the parsed profile and
+ * System.map by reference. It gets its own empty caches, and can be used
+ * from another thread than the instance (see also VMI_INIT_CONCURRENT).
+ *
+ * The file driver shares the open file with the clone. The other drivers
+ * open a new connection to the domain, which fails for KVM introspection.
+ * Clones don't get events, whatever init flags the instance was created with.
+ *
+ * The clone stays valid after the instance is destroyed, and is destroyed
+ * with vmi_destroy. Cloning must not race with a reconfiguration of the
+ * instance, such as vmi_init_os.
+ *
+ * @param[in] vmi Initialized LibVMI instance
+ * @param[out] clone The new instance
+ * @return VMI_SUCCESS or VMI_FAILURE
+ */
+status_t vmi_clone(
+    vmi_instance_t vmi,
+    vmi_instance_t *clone) NOEXCEPT;
+
 /**
  * Destroys an instance by freeing memory and closing any open handles.
  *
@@ -1076,10 +1285,31 @@ status_t vmi_pid_to_dtb(
     vmi_pid_t pid,
     addr_t *dtb) NOEXCEPT;
 
+/**
+ * Takes a snapshot of the guest's process list. Every process costs a
+ * single read of its task_struct (Linux), EPROCESS (Windows) or proc
+ * (FreeBSD); the directory table bases that are not part of those structs
+ * are then fetched with one batched read. The parent process id is only
+ * known when the OS profile has the offsets to find it. The walk also
+ * refreshes the process index behind vmi_pid_to_dtb and vmi_dtb_to_pid.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[out] processes Array of processes in list order, free with free()
+ * @param[out] count Number of processes in the array
+ * @return VMI_SUCCESS or VMI_FAILURE
+ */
+status_t vmi_get_process_list(
+    vmi_instance_t vmi,
+    vmi_process_t **processes,
+    size_t *count) NOEXCEPT;
+
 /**
  * Given a dtb, this function returns the PID corresponding to the
  * virtual address of the directory table base.
- * This function does NOT implement caching as to avoid false mappings.
+ * Lookups go through LibVMI's process index, which is rebuilt from the
+ * process list whenever the dtb is not found in it and after the guest
+ * was resumed (see vmi_pidcache_refresh). A dtb seen before costs a hash
+ * lookup, which makes this function cheap enough for CR3 write events.
  *
  * Note: this function uses OS internal linked-lists to find a match but
  * these lists are not guaranteed to be complete and accurate. Use of
@@ -1187,6 +1417,43 @@ status_t vmi_nested_pagetable_lookup_extended(
     addr_t vaddr,
     page_info_t *info) NOEXCEPT;
 
+/**
+ * Walks the pages mapped in an address space and reports them to a callback
+ * as they are found, in ascending virtual address order, without building a
+ * list of every page first. Pages that overlap [start, end] are reported
+ * whole.
+ *
+ * With VMI_WALK_COALESCE, pages that are contiguous both virtually and
+ * physically and have the same access rights are reported as a single range.
+ * The access rights are the ones the paging structures grant at every level.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] npt address of the nested pagetable
+ * @param[in] npm page mode of the nested pagetable, VMI_PM_NONE if not used
+ * @param[in] pt address of the pagetable
+ * @param[in] pm page mode of the pagetable
+ * @param[in] start first virtual address of interest
+ * @param[in] end last virtual address of interest, inclusive
+ * @param[in] flags VMI_WALK_* flags
+ * @param[in] callback called for each mapping
+ * @param[in] data passed to the callback
+ * @return VMI_SUCCESS if the walk completed or the callback stopped it,
+ *         VMI_FAILURE if a paging structure could not be read (the mappings
+ *         that could be read were still reported) or the page mode is not
+ *         supported
+ */
+status_t vmi_walk_va_pages(
+    vmi_instance_t vmi,
+    addr_t npt,
+    page_mode_t npm,
+    addr_t pt,
+    page_mode_t pm,
+    addr_t start,
+    addr_t end,
+    uint32_t flags,
+    vmi_va_range_cb_t callback,
+    void *data) NOEXCEPT;
+
 /*---------------------------------------------------------
  * Memory access functions
  */
@@ -1194,6 +1461,10 @@ status_t vmi_nested_pagetable_lookup_extended(
 /**
  * Reads count bytes from memory and stores the output in a buf.
  *
+ * The address is translated once per mapping it falls in, so a read within
+ * a large page costs a single page table lookup and its frames are fetched
+ * from the driver in batches.
+ *
  * @param[in] vmi LibVMI instance
  * @param[in] ctx Access context
  * @param[in] count The number of bytes to read
@@ -1208,6 +1479,88 @@ status_t vmi_read(
     void *buf,
     size_t *bytes_read) NOEXCEPT;
 
+/**
+ * Performs a batch of reads at once. All addresses are translated first,
+ * then the frames backing them are sorted, deduplicated and requested from
+ * the driver in as few operations as it supports (a single foreign mapping
+ * call on Xen, one preadv per contiguous run for files). Drivers without
+ * batching support are read page by page, same as vmi_read.
+ *
+ * Every request has its bytes_read field set to the number of bytes read
+ * from its start up to the first page that could not be accessed.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in,out] reqs Array of read requests
+ * @param[in] num_reqs Number of requests in the array
+ * @return VMI_SUCCESS if every read is complete, VMI_FAILURE otherwise
+ */
+status_t vmi_readv(
+    vmi_instance_t vmi,
+    read_request_t *reqs,
+    size_t num_reqs) NOEXCEPT;
+
+/**
+ * Borrows the cached guest page backing the address in the access context
+ * without copying it. The page is held in the page cache until it is
+ * released with vmi_unpin_page and is not refreshed in the meantime, so
+ * the data reflects guest memory at the time the page was fetched.
+ * All pins have to be released before vmi_destroy.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] ctx Access context
+ * @param[out] data Read-only pointer to the byte at the address
+ * @param[out] length Optional. Number of bytes available at data until the end of the page
+ * @param[out] pin Handle to pass to vmi_unpin_page
+ * @return VMI_SUCCESS or VMI_FAILURE
+ */
+status_t vmi_pin_page(
+    vmi_instance_t vmi,
+    const access_context_t *ctx,
+    const void **data,
+    size_t *length,
+    page_pin_t *pin) NOEXCEPT;
+
+/**
+ * Releases a page borrowed with vmi_pin_page. The data pointer returned with
+ * the pin must not be used afterwards.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] pin Handle returned by vmi_pin_page
+ */
+void vmi_unpin_page(
+    vmi_instance_t vmi,
+    page_pin_t pin) NOEXCEPT;
+
+/**
+ * Scans a range of guest memory for any number of byte patterns at once.
+ * The range starts at the address in the access context and may be
+ * physical or virtual; pages that can't be read are skipped, and a match
+ * can span any two readable pages that are adjacent in the range.
+ *
+ * Memory is read on the calling thread, while matching is spread over a
+ * pool of worker threads. The callback is always invoked on the calling
+ * thread, in address order, so it is free to use the LibVMI instance.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] ctx Access context for the start of the range
+ * @param[in] length Number of bytes to scan
+ * @param[in] patterns Array of patterns
+ * @param[in] num_patterns Number of patterns in the array
+ * @param[in] threads Number of matching threads, 0 for one per online CPU
+ * @param[in] cb Callback invoked for each match
+ * @param[in] data User data passed to the callback
+ * @return VMI_SUCCESS if the range was scanned or the callback stopped the scan, VMI_FAILURE otherwise
+ */
+status_t vmi_scan_memory(
+    vmi_instance_t vmi,
+    const access_context_t *ctx,
+    size_t length,
+    const scan_pattern_t *patterns,
+    unsigned int num_patterns,
+    unsigned int threads,
+    scan_callback_t cb,
+    void *data) NOEXCEPT;
+
 /**
  * Reads 8 bits from memory.
  *
@@ -2469,7 +2822,8 @@ status_t vmi_resume_vm(
 /**
  * Removes all entries from LibVMI's internal virtual to physical address
  * cache.  This is generally only useful if you believe that an entry in
- * the cache is incorrect, or out of date.
+ * the cache is incorrect, or out of date. The cached paging-structure
+ * entries, which are shared by all address spaces, are always dropped.
  *
  * @param[in] vmi LibVMI instance
  * @param[in] dtb The process address space to flush, or ~0ull for all.
@@ -2493,6 +2847,21 @@ void vmi_v2pcache_nested_flush(
     addr_t pt,
     addr_t npt) NOEXCEPT;
 
+/**
+ * Invalidates every entry in LibVMI's internal virtual to physical address
+ * cache, and the paging-structure entries cached for page table walks, by
+ * starting a new cache epoch. Cached translations are not
+ * re-validated against guest memory, so call this whenever the guest may
+ * have changed its pagetables while LibVMI was not watching (for example
+ * after single-stepping or from a CR3/pagetable write event callback).
+ * The epoch is bumped automatically by vmi_resume_vm.
+ *
+ * @param[in] vmi LibVMI instance
+ * @return The new epoch, or 0 if the address cache is disabled
+ */
+uint32_t vmi_v2pcache_bump_epoch(
+    vmi_instance_t vmi) NOEXCEPT;
+
 /**
  * Adds one entry to LibVMI's internal virtual to physical address
  * cache.
@@ -2587,7 +2956,8 @@ void vmi_rvacache_add(
 /**
  * Removes all entries from LibVMI's internal pid to directory table base
  * cache.  This is generally only useful if you believe that an entry in
- * the cache is incorrect, or out of date.
+ * the cache is incorrect, or out of date. The process index is rebuilt on
+ * the next lookup as well.
  *
  * @param[in] vmi LibVMI instance
  * @return VMI_SUCCESS or VMI_FAILURE
@@ -2595,6 +2965,22 @@ void vmi_rvacache_add(
 void vmi_pidcache_flush(
     vmi_instance_t vmi) NOEXCEPT;
 
+/**
+ * Rebuilds LibVMI's internal process index from the guest's process list,
+ * reading each process once. vmi_pid_to_dtb and vmi_dtb_to_pid refresh the
+ * index on their own when they miss and after vmi_resume_vm or
+ * vmi_v2pcache_bump_epoch; call this to pay for the walk up front, for
+ * example before enabling CR3 write events, or when processes may have
+ * exited. Entries of the pid to directory table base cache take precedence
+ * over the index, use vmi_pidcache_flush to drop them.
+ *
+ * @param[in] vmi LibVMI instance
+ * @return VMI_SUCCESS, or VMI_FAILURE if the OS has no process index or
+ *         the process list could not be read
+ */
+status_t vmi_pidcache_refresh(
+    vmi_instance_t vmi) NOEXCEPT;
+
 /**
  * Adds one entry to LibVMI's internal pid to directory table base
  * cache.
@@ -2620,6 +3006,76 @@ void vmi_pidcache_add(
 void vmi_pagecache_flush(
     vmi_instance_t vmi) NOEXCEPT;
 
+/**
+ * Sets the maximum number of pages held in LibVMI's internal page cache.
+ * The default is MAX_PAGE_CACHE_SIZE, chosen at build time. If the cache
+ * currently holds more pages than the new limit, the least recently used
+ * pages are evicted right away.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] size Maximum number of pages to keep cached
+ * @return VMI_SUCCESS or VMI_FAILURE (also if the page cache is disabled)
+ */
+status_t vmi_pagecache_set_size(
+    vmi_instance_t vmi,
+    uint32_t size) NOEXCEPT;
+
+/**
+ * Sets the maximum read-ahead window of LibVMI's internal page cache.
+ * When the cache sees misses on consecutive physical pages it starts
+ * prefetching the pages that follow in batches, doubling the batch each
+ * time the scan catches up with it until this limit is reached. Only
+ * drivers that can fetch several pages at once take part in read-ahead.
+ * The default is 128 pages; the window never exceeds a quarter of the
+ * page cache size.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] max_pages Largest read-ahead window in pages (at most 256), 0 disables read-ahead
+ * @return VMI_SUCCESS or VMI_FAILURE (also if the page cache is disabled)
+ */
+status_t vmi_pagecache_set_readahead(
+    vmi_instance_t vmi,
+    uint32_t max_pages) NOEXCEPT;
+
+/**
+ * Tells the driver how guest memory is about to be accessed, so it can tune
+ * read-ahead accordingly. The hint stays in effect until it is changed, set
+ * it back to VMI_ACCESS_HINT_NORMAL once the operation is done.
+ * Currently only the file driver makes use of it.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] hint The expected access pattern
+ * @return VMI_SUCCESS or VMI_FAILURE if the driver doesn't support hints
+ */
+status_t vmi_set_access_hint(
+    vmi_instance_t vmi,
+    access_hint_t hint) NOEXCEPT;
+
+/**
+ * Returns the performance counters of the instance: page cache and driver
+ * traffic, address translation and symbol caches, and events. The counters
+ * are always on and cheap enough for production use; they count from
+ * vmi_init, vmi_clone or the last vmi_reset_stats. In concurrent mode every
+ * thread counts separately and the returned values are the sum over all of
+ * them, including threads that exited.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[out] stats The counters
+ * @return VMI_SUCCESS or VMI_FAILURE
+ */
+status_t vmi_get_stats(
+    vmi_instance_t vmi,
+    vmi_stats_t *stats) NOEXCEPT;
+
+/**
+ * Sets the performance counters returned by vmi_get_stats back to zero.
+ *
+ * @param[in] vmi LibVMI instance
+ * @return VMI_SUCCESS or VMI_FAILURE
+ */
+status_t vmi_reset_stats(
+    vmi_instance_t vmi) NOEXCEPT;
+
 /**
  * Returns the path of the Linux system map file for the given vmi instance
  *
@@ -50,6 +50,7 @@ extern "C" {
  *
  * @return GSList of page_info_t structures, or NULL on error.
  * The caller is responsible for freeing the list and the structs.
+ * vmi_walk_va_pages reports the same pages without building the list.
  */
 GSList* vmi_get_va_pages(
     vmi_instance_t vmi,
@@ -102,7 +103,9 @@ os_t vmi_init_profile(
  * Retrieve the kernel's open json_object
  * @param[in] vmi Instance
  *
- * @return The json_object* open for the VM or NULL on error.
+ * @return The json_object* open for the VM or NULL on error. NULL is also
+ *         returned when the profile is in the binary format; the *_from_json
+ *         functions query the binary profile when passed a NULL json_object.
  */
 json_object* vmi_get_kernel_json(
     vmi_instance_t vmi) NOEXCEPT;
@@ -154,6 +157,40 @@ status_t vmi_get_struct_member_offset_from_json(
     const char* struct_member,
     addr_t* offset) NOEXCEPT;
 
+/**
+ * Look up the size of a structure member from the json
+ * @param[in] vmi Instance
+ * @param[in] json The open json_object* to use
+ * @param[in] struct_name The structure's name
+ * @param[in] struct_member The structure's member
+ * @param[out] size The structure member's size in bytes
+ *
+ * @return VMI_SUCCESS or VMI_FAILURE
+ */
+status_t vmi_get_struct_member_size_from_json(
+    vmi_instance_t vmi,
+    json_object* json,
+    const char* struct_name,
+    const char* struct_member,
+    size_t* size) NOEXCEPT;
+
+/**
+ * Look up the value of an enumeration constant from the json
+ * @param[in] vmi Instance
+ * @param[in] json The open json_object* to use
+ * @param[in] enum_name The enumeration's name
+ * @param[in] constant The constant's name
+ * @param[out] value The constant's value
+ *
+ * @return VMI_SUCCESS or VMI_FAILURE
+ */
+status_t vmi_get_enum_value_from_json(
+    vmi_instance_t vmi,
+    json_object *json,
+    const char *enum_name,
+    const char *constant,
+    int64_t *value) NOEXCEPT;
+
 /**
  * Look up the provided symbol's address and bit position from the json
  * @param[in] vmi Instance
@@ -190,6 +227,24 @@ status_t vmi_get_struct_field_type_name_from_json(
     const char *struct_name,
     const char *struct_member,
     const char **member_type_name) NOEXCEPT;
+
+/**
+ * Convert a Rekall profile or Volatility IST into LibVMI's binary profile
+ * format. Binary profiles are mapped instead of parsed, which makes
+ * initialization considerably faster and lets every instance on the host
+ * share the same memory for the profile. They are used in place of the JSON
+ * profile in the configuration, under the same keys.
+ *
+ * The output file is replaced atomically, so instances using an older
+ * version of it are not affected.
+ *
+ * @param[in] json_path Path of the JSON profile
+ * @param[in] output_path Path of the binary profile to write
+ * @return VMI_SUCCESS or VMI_FAILURE
+ */
+status_t vmi_convert_json_profile(
+    const char *json_path,
+    const char *output_path) NOEXCEPT;
 #endif
 
 #pragma GCC visibility pop
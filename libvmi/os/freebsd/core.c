@@ -28,6 +28,7 @@
 #include "config/config_parser.h"
 #include "driver/driver_wrapper.h"
 #include "os/freebsd/freebsd.h"
+#include "os/sysmap.h"
 
 void freebsd_read_config_ghashtable_entries(char* key, gpointer value,
         vmi_instance_t vmi);
@@ -98,6 +99,10 @@ status_t freebsd_init(vmi_instance_t vmi, GHashTable *config)
     g_hash_table_foreach(config, (GHFunc)freebsd_read_config_ghashtable_entries,
                          vmi);
 
+    freebsd_instance_t freebsd_instance = vmi->os_data;
+    if (freebsd_instance->sysmap)
+        freebsd_instance->symbols = sysmap_load(freebsd_instance->sysmap);
+
     if ( VMI_FAILURE == (rc = init_from_json_profile(vmi)) )
         rc = freebsd_symbol_to_address(vmi, "allproc", NULL, &vmi->init_task);
 
@@ -132,14 +137,15 @@ status_t freebsd_init(vmi_instance_t vmi, GHashTable *config)
     os_interface->os_v2sym = freebsd_system_map_address_to_symbol;
     os_interface->os_read_unicode_struct = NULL;
     os_interface->os_teardown = freebsd_teardown;
+    os_interface->os_clone = freebsd_clone;
+    os_interface->os_process_list = freebsd_process_list;
 
     vmi->os_interface = os_interface;
 
     return VMI_SUCCESS;
 
 _exit:
-    g_free(vmi->os_data);
-    vmi->os_data = NULL;
+    freebsd_teardown(vmi);
     return VMI_FAILURE;
 }
 
@@ -232,6 +238,28 @@ status_t freebsd_get_offset(vmi_instance_t vmi, const char* offset_name, addr_t
     return VMI_FAILURE;
 }
 
+status_t freebsd_clone(vmi_instance_t vmi, vmi_instance_t clone)
+{
+    freebsd_instance_t freebsd_instance;
+
+    if (vmi->os_data == NULL) {
+        return VMI_SUCCESS;
+    }
+
+    freebsd_instance = g_memdup(vmi->os_data, sizeof(struct freebsd_instance));
+    if (!freebsd_instance) {
+        return VMI_FAILURE;
+    }
+
+    /* the System.map index is shared, see sysmap_ref */
+    if (freebsd_instance->sysmap)
+        freebsd_instance->sysmap = strdup(freebsd_instance->sysmap);
+    freebsd_instance->symbols = sysmap_ref(freebsd_instance->symbols);
+
+    clone->os_data = freebsd_instance;
+    return VMI_SUCCESS;
+}
+
 status_t freebsd_teardown(vmi_instance_t vmi)
 {
     freebsd_instance_t freebsd_instance = vmi->os_data;
@@ -241,6 +269,7 @@ status_t freebsd_teardown(vmi_instance_t vmi)
     }
 
     free(freebsd_instance->sysmap);
+    sysmap_destroy(freebsd_instance->symbols);
     free(vmi->os_data);
 
     vmi->os_data = NULL;
@@ -25,6 +25,8 @@
 struct freebsd_instance {
     char *sysmap; /**< system map file for domain's running kernel */
 
+    struct sysmap *symbols; /**< index of the system map, if configured */
+
     addr_t pmap_offset; /**< task_struct->tasks */
 
     addr_t vmspace_offset; /**< task_struct->mm */
@@ -51,6 +53,10 @@ status_t freebsd_pid_to_pgd(vmi_instance_t vmi, vmi_pid_t pid, addr_t *dtb);
 
 status_t freebsd_pgd_to_pid(vmi_instance_t vmi, addr_t pgd, vmi_pid_t *pid);
 
+status_t freebsd_process_list(vmi_instance_t vmi, GArray *procs);
+
+status_t freebsd_clone(vmi_instance_t vmi, vmi_instance_t clone);
+
 status_t freebsd_teardown(vmi_instance_t vmi);
 
 #endif /* OS_FREEBSD_H_ */
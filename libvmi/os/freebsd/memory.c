@@ -178,3 +178,82 @@ freebsd_pgd_to_pid(
     /* now follow the pointer to the memory descriptor and grab the pid value */
     return vmi_read_32_va(vmi, proc_addr + pid_offset, 0, (uint32_t*)pid);
 }
+
+/* MAXCOMLEN + 1 */
+#define FREEBSD_COMM_LEN 20
+
+/*
+ * Walks allproc reading proc->p_list, ->p_pid, ->p_vmspace, ->p_comm and
+ * ->p_pptr with one read per process. The pmaps are read after the walk,
+ * once per vmspace and all in one batch.
+ */
+status_t
+freebsd_process_list(
+    vmi_instance_t vmi,
+    GArray *procs)
+{
+    status_t ret = VMI_FAILURE;
+    freebsd_instance_t freebsd_instance = vmi->os_data;
+    uint8_t *buf = NULL;
+    uint8_t width = vmi_get_address_width(vmi);
+    addr_t span, curr, parent_offset = 0;
+    addr_t pid_offset, vmspace_offset, name_offset;
+    size_t name_len = MIN(FREEBSD_COMM_LEN, VMI_PROCESS_NAME_LEN - 1);
+    uint64_t next, vmspace, parent;
+
+    if (!freebsd_instance || !width || !vmi->init_task)
+        return VMI_FAILURE;
+
+    pid_offset = freebsd_instance->pid_offset;
+    vmspace_offset = freebsd_instance->vmspace_offset;
+    name_offset = freebsd_instance->name_offset;
+
+    /* p_list.le_next is the first member */
+    span = MAX(width, MAX(vmspace_offset + width, pid_offset + sizeof(vmi_pid_t)));
+
+    if (name_offset)
+        span = MAX(span, name_offset + name_len);
+
+    if (VMI_SUCCESS == json_profile_lookup(vmi, "proc", "p_pptr", &parent_offset))
+        span = MAX(span, parent_offset + width);
+
+    buf = g_try_malloc0(span);
+    if (!buf)
+        return VMI_FAILURE;
+
+    curr = vmi->init_task;
+    do {
+        os_process_t proc = { .info.addr = curr, .info.ppid = -1 };
+
+        if (procs->len >= OS_PROCESS_LIST_MAX)
+            goto done;
+
+        if ( VMI_FAILURE == vmi_read_va(vmi, curr, 0, span, buf, NULL) )
+            goto done;
+
+        next = vmspace = parent = 0;
+        memcpy(&next, buf, width);
+        memcpy(&vmspace, buf + vmspace_offset, width);
+        memcpy(&proc.info.pid, buf + pid_offset, sizeof(vmi_pid_t));
+        proc.aspace = vmspace;
+
+        if (name_offset)
+            memcpy(proc.info.name, buf + name_offset, name_len);
+
+        if (parent_offset) {
+            memcpy(&parent, buf + parent_offset, width);
+            proc.parent = parent;
+        }
+
+        g_array_append_val(procs, proc);
+        curr = next;
+    } while (curr);
+
+    os_process_list_read_dtbs(vmi, procs,
+                              freebsd_instance->pmap_offset + freebsd_instance->pgd_offset, false);
+    ret = VMI_SUCCESS;
+
+done:
+    g_free(buf);
+    return ret;
+}
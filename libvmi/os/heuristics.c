@@ -0,0 +1,265 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <pthread.h>
+
+#include "private.h"
+
+/*
+ * OS init heuristics.
+ *
+ * The OS init often has several ways of finding the same thing (the KDBG,
+ * the kernel base, the KASLR offset). os_heuristics_run races them: the
+ * first method runs on the instance in the calling thread, every other one
+ * on a clone of the instance (see vmi_clone) in a thread of its own, so
+ * none of them shares a driver connection or cache with another. The first
+ * method to succeed wins. The long searches poll os_heuristics_cancelled
+ * between pages or pieces of memory and give up once there is a winner.
+ * Every method stores its result in its own data, and the caller only
+ * reads the winner's after all of them returned.
+ *
+ * A clone is only cheap and safe with drivers that share their connection
+ * with it or are thread-safe (file, memory and Xen); KVM introspection, for
+ * one, allows a single connection per domain. With the other drivers, if
+ * cloning fails, and in os_heuristics_first, the methods are tried in
+ * order, cheapest first, until one succeeds.
+ *
+ * The methods that won and the time they took are kept for
+ * vmi_get_init_methods.
+ */
+
+/* heuristics_race couldn't clone the instance and ran nothing */
+#define HEURISTICS_NO_RACE  (-2)
+
+typedef struct heuristics_race {
+    pthread_mutex_t lock;
+    int winner;             /**< first method that succeeded, -1 until one did */
+    uint64_t start;
+    uint64_t nsec;          /**< time until the winner succeeded */
+    int cancel;             /**< set with the winner, see os_heuristics_cancelled */
+} heuristics_race_t;
+
+typedef struct heuristics_runner {
+    heuristics_race_t *race;
+    vmi_instance_t vmi;     /**< the instance for the first method, a clone for the others */
+    const os_heuristic_method_t *method;
+    int index;
+    pthread_t thread;
+    bool started;
+} heuristics_runner_t;
+
+static void
+record_winner(
+    vmi_instance_t vmi,
+    const char *name,
+    uint64_t nsec)
+{
+    vmi_init_method_t method = { .name = name, .nsec = nsec };
+
+    dbprint(VMI_DEBUG_MISC, "--%s succeeded after %"PRIu64" us\n", name, nsec / 1000);
+
+    if (!vmi->init_methods)
+        vmi->init_methods = g_array_new(FALSE, FALSE, sizeof(vmi_init_method_t));
+
+    g_array_append_val(vmi->init_methods, method);
+}
+
+bool
+os_heuristics_cancelled(
+    vmi_instance_t vmi)
+{
+    return vmi->heuristics_cancel && __atomic_load_n(vmi->heuristics_cancel, __ATOMIC_RELAXED);
+}
+
+static void *
+heuristics_runner(
+    void *arg)
+{
+    heuristics_runner_t *runner = (heuristics_runner_t *) arg;
+    heuristics_race_t *race = runner->race;
+    status_t status = VMI_FAILURE;
+
+    if (!os_heuristics_cancelled(runner->vmi))
+        status = runner->method->fn(runner->vmi, runner->method->data);
+
+    pthread_mutex_lock(&race->lock);
+    if (VMI_SUCCESS == status && race->winner < 0) {
+        race->winner = runner->index;
+        race->nsec = stats_clock() - race->start;
+        __atomic_store_n(&race->cancel, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&race->lock);
+
+    return NULL;
+}
+
+static bool
+heuristics_can_race(
+    vmi_instance_t vmi,
+    unsigned int num_methods)
+{
+    /* a method that runs heuristics of its own runs them in order */
+    if (num_methods < 2 || vmi->heuristics_cancel)
+        return false;
+
+    return vmi->driver.clone_ptr || vmi->driver.thread_safe;
+}
+
+/* Returns the winner, -1 if every method failed or HEURISTICS_NO_RACE */
+static int
+heuristics_race(
+    vmi_instance_t vmi,
+    const os_heuristic_method_t *methods,
+    unsigned int num_methods,
+    uint64_t *nsec)
+{
+    heuristics_race_t race = { .winner = -1 };
+    heuristics_runner_t *runners = g_new0(heuristics_runner_t, num_methods);
+    int winner = HEURISTICS_NO_RACE;
+    unsigned int i;
+
+    for (i = 1; i < num_methods; i++) {
+        if ( VMI_FAILURE == vmi_clone(vmi, &runners[i].vmi) ) {
+            dbprint(VMI_DEBUG_MISC, "--failed to clone the instance, trying the heuristics in order\n");
+            goto done;
+        }
+    }
+
+    pthread_mutex_init(&race.lock, NULL);
+    runners[0].vmi = vmi;
+
+    for (i = 0; i < num_methods; i++) {
+        runners[i].race = &race;
+        runners[i].method = &methods[i];
+        runners[i].index = i;
+        runners[i].vmi->heuristics_cancel = &race.cancel;
+    }
+
+    race.start = stats_clock();
+
+    for (i = 1; i < num_methods; i++)
+        runners[i].started = !pthread_create(&runners[i].thread, NULL, heuristics_runner, &runners[i]);
+
+    /* the methods that didn't get a thread run after the first one, unless it won */
+    for (i = 0; i < num_methods; i++) {
+        if (!runners[i].started)
+            heuristics_runner(&runners[i]);
+    }
+
+    for (i = 1; i < num_methods; i++) {
+        if (runners[i].started)
+            pthread_join(runners[i].thread, NULL);
+    }
+
+    vmi->heuristics_cancel = NULL;
+    pthread_mutex_destroy(&race.lock);
+
+    winner = race.winner;
+    *nsec = race.nsec;
+
+done:
+    for (i = 1; i < num_methods; i++) {
+        if (runners[i].vmi)
+            vmi_destroy(runners[i].vmi);
+    }
+    g_free(runners);
+
+    return winner;
+}
+
+int
+os_heuristics_first(
+    vmi_instance_t vmi,
+    const os_heuristic_method_t *methods,
+    unsigned int num_methods)
+{
+    unsigned int i;
+
+    for (i = 0; i < num_methods; i++) {
+        if (VMI_SUCCESS == methods[i].fn(vmi, methods[i].data))
+            return i;
+    }
+
+    return -1;
+}
+
+int
+os_heuristics_run(
+    vmi_instance_t vmi,
+    const os_heuristic_method_t *methods,
+    unsigned int num_methods)
+{
+    uint64_t start = stats_clock();
+    uint64_t nsec = 0;
+    int winner = HEURISTICS_NO_RACE;
+
+    if (heuristics_can_race(vmi, num_methods))
+        winner = heuristics_race(vmi, methods, num_methods, &nsec);
+
+    if (HEURISTICS_NO_RACE == winner) {
+        winner = os_heuristics_first(vmi, methods, num_methods);
+        nsec = stats_clock() - start;
+    }
+
+    if (winner >= 0)
+        record_winner(vmi, methods[winner].name, nsec);
+
+    return winner;
+}
+
+void
+os_heuristics_reset(
+    vmi_instance_t vmi)
+{
+    if (vmi->init_methods)
+        g_array_set_size(vmi->init_methods, 0);
+}
+
+void
+os_heuristics_destroy(
+    vmi_instance_t vmi)
+{
+    if (vmi->init_methods)
+        g_array_free(vmi->init_methods, TRUE);
+    vmi->init_methods = NULL;
+}
+
+status_t
+vmi_get_init_methods(
+    vmi_instance_t vmi,
+    const vmi_init_method_t **methods,
+    size_t *count)
+{
+#ifdef ENABLE_SAFETY_CHECKS
+    if (!vmi || !methods || !count)
+        return VMI_FAILURE;
+#endif
+
+    if (!vmi->init_methods || !vmi->init_methods->len) {
+        *methods = NULL;
+        *count = 0;
+        return VMI_SUCCESS;
+    }
+
+    *methods = (const vmi_init_method_t *) vmi->init_methods->data;
+    *count = vmi->init_methods->len;
+    return VMI_SUCCESS;
+}
@@ -28,6 +28,8 @@
 #include "config/config_parser.h"
 #include "driver/driver_wrapper.h"
 #include "os/linux/linux.h"
+#include "os/sysmap.h"
+#include "arch/x86_table.h"
 
 
 void linux_read_config_ghashtable_entries(char* key, gpointer value,
@@ -35,7 +37,7 @@ void linux_read_config_ghashtable_entries(char* key, gpointer value,
 
 static status_t init_task_kaslr_test(vmi_instance_t vmi, addr_t page_vaddr);
 
-static status_t init_kaslr(vmi_instance_t vmi);
+static status_t init_kaslr(vmi_instance_t vmi, bool record);
 
 static status_t brute_force_find_kern_mem (vmi_instance_t vmi);
 
@@ -48,47 +50,37 @@ static status_t verify_linux_paging (vmi_instance_t vmi);
 */
 static bool is_x86_64_pd (vmi_instance_t vmi, addr_t pa)
 {
-    bool rc = false;
     status_t status = VMI_FAILURE;
-    size_t i = 0;
+    int i;
 
-#define PD_ENTRIES (VMI_PS_4KB / sizeof(uint64_t))
-    uint64_t pdes[PD_ENTRIES];
+    uint64_t pdes[X86_TABLE_ENTRIES];
+    x86_table_masks_t masks;
     addr_t maxframe = vmi_get_max_physical_address (vmi) >> 12;
 
     status = vmi_read_pa (vmi, pa, sizeof(pdes), (void *)pdes, NULL);
     if (VMI_FAILURE == status)
-        goto exit;
-
-    for (i = 0; i < PD_ENTRIES; ++i) {
-        uint64_t pde = pdes[i];
-
-        if (VMI_GET_BIT (pde, 7) || VMI_GET_BIT (pde, 63) ) {
-            /* ... reserved bit 7 or XD3 bit is asserted so reject entire page immediately */
-            rc = false;
-            goto exit;
-        }
-
-        /* Any test on the GFN requires that P=1 */
-        if (!(VMI_GET_BIT (pde, 0)))
-            continue;
+        return false;
 
-        /* P = 1, and ... */
+    /* Reserved bit 7 or XD bit asserted anywhere rejects the entire page */
+    x86_table_scan(pdes, false, (1ULL << 7) | (1ULL << 63), &masks);
+    if (x86_table_any(masks.reserved))
+        return false;
 
-        addr_t gfn = pde >> 12;
+    /* Any test on the GFN requires that P=1, and there has to be one */
+    i = x86_table_next(masks.present, 0);
+    if (i < 0)
+        return false;
 
-        if (0 == gfn || gfn > maxframe) {
-            /* ... this is not a valid GFN, so fail the whole page.  */
-            rc = false;
-            goto exit;
-        }
+    for (; i >= 0; i = x86_table_next(masks.present, i + 1)) {
+        addr_t gfn = pdes[i] >> 12;
 
-        /* ... the page has a valid-looking PDE, so for now, it passes. */
-        rc = true;
+        /* ... this is not a valid GFN, so fail the whole page.  */
+        if (0 == gfn || gfn > maxframe)
+            return false;
     }
 
-exit:
-    return rc;
+    /* ... the page has valid-looking PDEs only */
+    return true;
 }
 
 /*
@@ -372,87 +364,143 @@ static status_t init_task_kaslr_test(vmi_instance_t vmi, addr_t page_vaddr)
     return ret;
 }
 
-static status_t get_kaslr_offset_ia32e(vmi_instance_t vmi)
+/* Output of the KASLR search methods */
+typedef struct kaslr_search {
+    addr_t kaslr_offset;
+    addr_t init_task;
+} kaslr_search_t;
+
+/*
+ * First check whether init_task can be translated as-is.
+ */
+static status_t kaslr_from_init_task(vmi_instance_t vmi, void *data)
 {
+    kaslr_search_t *found = (kaslr_search_t *) data;
+    uint32_t test;
+    addr_t init_task_symbol_addr;
+    ACCESS_CONTEXT(ctx,
+                   .translate_mechanism = VMI_TM_PROCESS_DTB,
+                   .pt = vmi->kpgd,
+                   .addr = vmi->init_task);
+
+    if ( VMI_FAILURE == vmi_read_32(vmi, &ctx, &test) )
+        return VMI_FAILURE;
+
+    /* Provided init_task works fine, let's calculate kaslr from it if necessary */
+    if ( VMI_FAILURE == linux_symbol_to_address(vmi, "init_task", NULL, &init_task_symbol_addr) )
+        return VMI_FAILURE;
+
+    found->kaslr_offset = vmi->init_task - init_task_symbol_addr;
+    found->init_task = vmi->init_task;
+    dbprint(VMI_DEBUG_MISC, "**calculated KASLR offset from pre-defined init_task addr: 0x%"PRIx64"\n", found->kaslr_offset);
+    return VMI_SUCCESS;
+}
+
+static status_t kaslr_from_kernel_text(vmi_instance_t vmi, void *data)
+{
+    kaslr_search_t *found = (kaslr_search_t *) data;
     addr_t va, pa;
     addr_t kernel_text_start = 0xffffffff81000000;
     addr_t kernel_text_end = kernel_text_start + (1024*1024*1024);
 
     linux_instance_t linux_instance = vmi->os_data;
 
-    vmi->init_task = linux_instance->init_task_fixed;
+    if ( vmi->page_mode != VMI_PM_IA32E )
+        return VMI_FAILURE;
 
     for (va = kernel_text_start; va < kernel_text_end; va += 0x200000) {
+        if ( os_heuristics_cancelled(vmi) )
+            return VMI_FAILURE;
+
         if ( vmi_translate_kv2p(vmi, va, &pa) == VMI_SUCCESS ) {
-            linux_instance->kaslr_offset = va - kernel_text_start;
-            vmi->init_task += linux_instance->kaslr_offset;
-            dbprint(VMI_DEBUG_MISC, "**calculated KASLR offset in 64-bit mode: 0x%"PRIx64"\n", linux_instance->kaslr_offset);
+            found->kaslr_offset = va - kernel_text_start;
+            found->init_task = linux_instance->init_task_fixed + found->kaslr_offset;
+            dbprint(VMI_DEBUG_MISC, "**calculated KASLR offset in 64-bit mode: 0x%"PRIx64"\n", found->kaslr_offset);
             return VMI_SUCCESS;
         }
     }
     return VMI_FAILURE;
 }
 
-static status_t init_kaslr(vmi_instance_t vmi)
+typedef struct kaslr_page_search {
+    kaslr_search_t *found;
+    status_t ret;
+} kaslr_page_search_t;
+
+static bool kaslr_test_page(vmi_instance_t vmi, const vmi_va_range_t *range, void *data)
 {
-    /*
-     * First check whether init_task can be translated as-is.
-     */
-    uint32_t test;
+    kaslr_page_search_t *search = (kaslr_page_search_t *) data;
     linux_instance_t linux_instance = vmi->os_data;
-    ACCESS_CONTEXT(ctx,
-                   .translate_mechanism = VMI_TM_PROCESS_DTB,
-                   .pt = vmi->kpgd,
-                   .addr = vmi->init_task);
 
-    if ( VMI_SUCCESS == vmi_read_32(vmi, &ctx, &test) ) {
-        /* Provided init_task works fine, let's calculate kaslr from it if necessary */
-        addr_t init_task_symbol_addr;
-        if ( VMI_FAILURE == linux_symbol_to_address(vmi, "init_task", NULL, &init_task_symbol_addr) )
-            return VMI_FAILURE;
+    if ( os_heuristics_cancelled(vmi) )
+        return false;
 
-        linux_instance->kaslr_offset = vmi->init_task - init_task_symbol_addr;
-        dbprint(VMI_DEBUG_MISC, "**calculated KASLR offset from pre-defined init_task addr: 0x%"PRIx64"\n", linux_instance->kaslr_offset);
-        return VMI_SUCCESS;
-    }
+    if ( VMI_FAILURE == init_task_kaslr_test(vmi, range->vaddr) )
+        return true;
 
-    if ( vmi->page_mode == VMI_PM_IA32E ) {
-        if ( VMI_SUCCESS == get_kaslr_offset_ia32e(vmi) )
-            return VMI_SUCCESS;
+    search->found->kaslr_offset = range->vaddr - (linux_instance->init_task_fixed & ~VMI_BIT_MASK(0,11));
+    search->found->init_task = linux_instance->init_task_fixed + search->found->kaslr_offset;
+    dbprint(VMI_DEBUG_MISC, "**calculated KASLR offset: 0x%"PRIx64"\n", search->found->kaslr_offset);
+    search->ret = VMI_SUCCESS;
+    return false;
+}
+
+static status_t kaslr_from_va_pages(vmi_instance_t vmi, void *data)
+{
+    linux_instance_t linux_instance = vmi->os_data;
+    kaslr_page_search_t search = {
+        .found = (kaslr_search_t *) data,
+        .ret = VMI_FAILURE,
+    };
+    addr_t start = 0;
+
+    /* an earlier pagetable candidate already found an offset that didn't verify */
+    if ( linux_instance->kaslr_offset )
+        return VMI_FAILURE;
+
+    /* the kernel is in the upper half */
+    switch (vmi->page_mode) {
+        case VMI_PM_AARCH64:
+        case VMI_PM_IA32E:
+            start = 0xffff800000000000ull;
+            break;
+        default:
+            break;
     }
 
-    status_t ret = VMI_FAILURE;
-    GSList *loop, *pages = vmi_get_va_pages(vmi, vmi->kpgd);
-    loop = pages;
-    while (loop) {
-        page_info_t *info = loop->data;
-
-        if ( !linux_instance->kaslr_offset ) {
-            switch (vmi->page_mode) {
-                case VMI_PM_AARCH64:
-                case VMI_PM_IA32E:
-                    if ( VMI_GET_BIT(info->vaddr, 47) )
-                        ret = init_task_kaslr_test(vmi, info->vaddr);
-                    break;
-                default:
-                    ret = init_task_kaslr_test(vmi, info->vaddr);
-                    break;
-            }
+    vmi_walk_va_pages(vmi, 0, VMI_PM_NONE, vmi->kpgd, vmi->page_mode, start, ~0ull, 0,
+                      kaslr_test_page, &search);
 
-            if ( VMI_SUCCESS == ret ) {
-                linux_instance->kaslr_offset = info->vaddr - (vmi->init_task & ~VMI_BIT_MASK(0,11));
-                vmi->init_task = linux_instance->init_task_fixed + linux_instance->kaslr_offset;
-                dbprint(VMI_DEBUG_MISC, "**calculated KASLR offset: 0x%"PRIx64"\n", linux_instance->kaslr_offset);
-                break;
-            }
-        }
+    return search.ret;
+}
 
-        g_free(info);
-        loop = loop->next;
-    }
+/*
+ * Finds the KASLR offset and the init task with the current kpgd. The
+ * winner is only recorded when the kpgd is known, not for every candidate
+ * of a brute force search.
+ */
+static status_t init_kaslr(vmi_instance_t vmi, bool record)
+{
+    linux_instance_t linux_instance = vmi->os_data;
+    kaslr_search_t found[3] = {{0}};
+    const os_heuristic_method_t methods[] = {
+        { "kaslr_from_init_task", kaslr_from_init_task, &found[0] },
+        { "kaslr_from_kernel_text", kaslr_from_kernel_text, &found[1] },
+        { "kaslr_from_va_pages", kaslr_from_va_pages, &found[2] },
+    };
+    int winner;
+
+    if ( record )
+        winner = os_heuristics_run(vmi, methods, G_N_ELEMENTS(methods));
+    else
+        winner = os_heuristics_first(vmi, methods, G_N_ELEMENTS(methods));
 
-    g_slist_free(pages);
-    return ret;
+    if ( winner < 0 )
+        return VMI_FAILURE;
+
+    linux_instance->kaslr_offset = found[winner].kaslr_offset;
+    vmi->init_task = found[winner].init_task;
+    return VMI_SUCCESS;
 }
 
 /*
@@ -461,7 +509,7 @@ static status_t init_kaslr(vmi_instance_t vmi)
  */
 static status_t verify_linux_paging (vmi_instance_t vmi)
 {
-    if (VMI_FAILURE == init_kaslr(vmi))
+    if (VMI_FAILURE == init_kaslr(vmi, false))
         return VMI_FAILURE;
 
     return init_task_kaslr_test (vmi, vmi->init_task & ~VMI_BIT_MASK(0,11));
@@ -544,6 +592,31 @@ status_t linux_init(vmi_instance_t vmi, GHashTable *config)
 
     g_hash_table_foreach(config, (GHFunc)linux_read_config_ghashtable_entries, vmi);
 
+    if (linux_instance->sysmap)
+        linux_instance->symbols = sysmap_load(linux_instance->sysmap);
+
+    /* the KASLR heuristics run on clones of the instance, which need it already */
+    os_interface = g_try_malloc0(sizeof(struct os_interface));
+    if ( !os_interface ) {
+        linux_teardown(vmi);
+        return VMI_FAILURE;
+    }
+
+    os_interface->os_get_offset = linux_get_offset;
+    os_interface->os_get_kernel_struct_offset = linux_get_kernel_struct_offset;
+    os_interface->os_pid_to_pgd = linux_pid_to_pgd;
+    os_interface->os_pgd_to_pid = linux_pgd_to_pid;
+    os_interface->os_ksym2v = linux_symbol_to_address;
+    os_interface->os_usym2rva = NULL;
+    os_interface->os_v2sym = NULL;
+    os_interface->os_v2ksym = linux_system_map_address_to_symbol;
+    os_interface->os_read_unicode_struct = NULL;
+    os_interface->os_teardown = linux_teardown;
+    os_interface->os_clone = linux_clone;
+    os_interface->os_process_list = linux_process_list;
+
+    vmi->os_interface = os_interface;
+
     rc = init_from_json_profile(vmi);
 
     if ( VMI_FAILURE == rc && !vmi->init_task )
@@ -578,10 +651,10 @@ status_t linux_init(vmi_instance_t vmi, GHashTable *config)
         goto _exit;
 
     if ( !linux_instance->kaslr_offset ) {
-        if ( VMI_FAILURE == init_kaslr(vmi) ) {
+        if ( VMI_FAILURE == init_kaslr(vmi, true) ) {
             // try without masking Meltdown bit
             vmi->kpgd |= 0x1000ull;
-            if ( VMI_FAILURE == init_kaslr(vmi) ) {
+            if ( VMI_FAILURE == init_kaslr(vmi, true) ) {
                 dbprint(VMI_DEBUG_MISC, "**failed to determine KASLR offset\n");
                 goto _exit;
             }
@@ -591,28 +664,10 @@ status_t linux_init(vmi_instance_t vmi, GHashTable *config)
     dbprint(VMI_DEBUG_MISC, "**set vmi->kpgd (0x%.16"PRIx64").\n", vmi->kpgd);
     dbprint(VMI_DEBUG_MISC, "**set vmi->init_task (0x%.16"PRIx64").\n", vmi->init_task);
 
-    os_interface = g_malloc(sizeof(struct os_interface));
-    if ( !os_interface )
-        goto _exit;
-
-    bzero(os_interface, sizeof(struct os_interface));
-    os_interface->os_get_offset = linux_get_offset;
-    os_interface->os_get_kernel_struct_offset = linux_get_kernel_struct_offset;
-    os_interface->os_pid_to_pgd = linux_pid_to_pgd;
-    os_interface->os_pgd_to_pid = linux_pgd_to_pid;
-    os_interface->os_ksym2v = linux_symbol_to_address;
-    os_interface->os_usym2rva = NULL;
-    os_interface->os_v2sym = NULL;
-    os_interface->os_v2ksym = linux_system_map_address_to_symbol;
-    os_interface->os_read_unicode_struct = NULL;
-    os_interface->os_teardown = linux_teardown;
-
-    vmi->os_interface = os_interface;
-
     return VMI_SUCCESS;
 
 _exit:
-    linux_teardown(vmi);
+    os_destroy(vmi);
     return VMI_FAILURE;
 }
 
@@ -716,6 +771,28 @@ status_t linux_get_offset(vmi_instance_t vmi, const char* offset_name, addr_t *o
     return VMI_FAILURE;
 }
 
+status_t linux_clone(vmi_instance_t vmi, vmi_instance_t clone)
+{
+    linux_instance_t linux_instance;
+
+    if (vmi->os_data == NULL) {
+        return VMI_SUCCESS;
+    }
+
+    linux_instance = g_memdup(vmi->os_data, sizeof(struct linux_instance));
+    if (!linux_instance) {
+        return VMI_FAILURE;
+    }
+
+    /* the System.map index is shared, see sysmap_ref */
+    if (linux_instance->sysmap)
+        linux_instance->sysmap = strdup(linux_instance->sysmap);
+    linux_instance->symbols = sysmap_ref(linux_instance->symbols);
+
+    clone->os_data = linux_instance;
+    return VMI_SUCCESS;
+}
+
 status_t linux_teardown(vmi_instance_t vmi)
 {
     linux_instance_t linux_instance = vmi->os_data;
@@ -725,6 +802,7 @@ status_t linux_teardown(vmi_instance_t vmi)
     }
 
     free(linux_instance->sysmap);
+    sysmap_destroy(linux_instance->symbols);
     g_free(linux_instance);
 
     vmi->os_data = NULL;
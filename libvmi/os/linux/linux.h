@@ -25,6 +25,8 @@
 struct linux_instance {
     char *sysmap; /**< system map file for domain's running kernel */
 
+    struct sysmap *symbols; /**< index of the system map, if configured */
+
     addr_t tasks_offset; /**< task_struct->tasks */
 
     addr_t mm_offset; /**< task_struct->mm */
@@ -58,6 +60,10 @@ status_t linux_pid_to_pgd(vmi_instance_t vmi, vmi_pid_t pid, addr_t *pgd);
 
 status_t linux_pgd_to_pid(vmi_instance_t vmi, addr_t pgd, vmi_pid_t *pid);
 
+status_t linux_process_list(vmi_instance_t vmi, GArray *procs);
+
+status_t linux_clone(vmi_instance_t vmi, vmi_instance_t clone);
+
 status_t linux_teardown(vmi_instance_t vmi);
 
 #endif /* OS_LINUX_H_ */
@@ -238,3 +238,115 @@ linux_pgd_to_pid(
     /* now follow the pointer to the memory descriptor and grab the pid value */
     return vmi_read_32_va(vmi, ts_addr + pid_offset, 0, (uint32_t*)pid);
 }
+
+static inline addr_t
+linux_addr_at(
+    const uint8_t *buf,
+    uint8_t width)
+{
+    uint64_t addr64;
+    uint32_t addr32;
+
+    if (width == 8) {
+        memcpy(&addr64, buf, sizeof(addr64));
+        return addr64;
+    }
+
+    memcpy(&addr32, buf, sizeof(addr32));
+    return addr32;
+}
+
+/* TASK_COMM_LEN */
+#define LINUX_COMM_LEN 16
+
+/*
+ * Walks the task list reading task_struct->tasks, ->pid, ->mm, ->active_mm,
+ * ->comm and ->real_parent with one read per task. The pgds are read after
+ * the walk, once per mm_struct and all in one batch. They are never taken
+ * over from the previous walk: a freed mm_struct can be reused at the same
+ * address for another address space.
+ */
+status_t
+linux_process_list(
+    vmi_instance_t vmi,
+    GArray *procs)
+{
+    status_t ret = VMI_FAILURE;
+    linux_instance_t linux_instance = vmi->os_data;
+    uint8_t *buf = NULL;
+    uint8_t width = vmi_get_address_width(vmi);
+    addr_t lo, hi, curr, parent_offset = 0;
+    addr_t tasks_offset, mm_offset, pid_offset, name_offset;
+    size_t name_len = MIN(LINUX_COMM_LEN, VMI_PROCESS_NAME_LEN - 1);
+
+    if (!linux_instance || !width || !vmi->init_task)
+        return VMI_FAILURE;
+
+    tasks_offset = linux_instance->tasks_offset;
+    mm_offset = linux_instance->mm_offset;
+    pid_offset = linux_instance->pid_offset;
+    name_offset = linux_instance->name_offset;
+
+    /* active_mm follows mm */
+    lo = MIN(tasks_offset, MIN(mm_offset, pid_offset));
+    hi = MAX(tasks_offset + width, MAX(mm_offset + 2 * width, pid_offset + sizeof(vmi_pid_t)));
+
+    if (name_offset) {
+        lo = MIN(lo, name_offset);
+        hi = MAX(hi, name_offset + name_len);
+    }
+
+    if (VMI_SUCCESS == json_profile_lookup(vmi, "task_struct", "real_parent", &parent_offset)) {
+        lo = MIN(lo, parent_offset);
+        hi = MAX(hi, parent_offset + width);
+    }
+
+    buf = g_try_malloc0(hi - lo);
+    if (!buf)
+        return VMI_FAILURE;
+
+    curr = vmi->init_task;
+    do {
+        os_process_t proc = { .info.addr = curr, .info.ppid = -1 };
+        addr_t next;
+
+        if (procs->len >= OS_PROCESS_LIST_MAX)
+            goto done;
+
+        if ( VMI_FAILURE == vmi_read_va(vmi, curr + lo, 0, hi - lo, buf, NULL) )
+            goto done;
+
+        memcpy(&proc.info.pid, buf + pid_offset - lo, sizeof(proc.info.pid));
+        next = linux_addr_at(buf + tasks_offset - lo, width);
+        proc.aspace = linux_addr_at(buf + mm_offset - lo, width);
+
+        if (name_offset)
+            memcpy(proc.info.name, buf + name_offset - lo, name_len);
+
+        if (parent_offset)
+            proc.parent = linux_addr_at(buf + parent_offset - lo, width);
+
+        /*
+         * Kernel threads have no mm and run on the active_mm they borrowed,
+         * which is not theirs to be looked up by.
+         */
+        if (!proc.aspace) {
+            proc.aspace = linux_addr_at(buf + mm_offset + width - lo, width);
+            proc.info.flags |= VMI_PROCESS_KERNEL_THREAD;
+        }
+
+        g_array_append_val(procs, proc);
+
+        if (!next)
+            goto done;
+
+        curr = next - tasks_offset;
+    } while (curr != vmi->init_task);
+
+    os_process_list_read_dtbs(vmi, procs, linux_instance->pgd_offset, true);
+    ret = VMI_SUCCESS;
+
+done:
+    g_free(buf);
+    return ret;
+}
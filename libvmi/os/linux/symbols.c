@@ -27,134 +27,23 @@
 #include "private.h"
 #define _GNU_SOURCE
 #include <stdio.h>
-#include <ctype.h>
 #include <string.h>
 #include "os/linux/linux.h"
-
-#define MAX_ROW_LENGTH 500
-
-static int
-get_symbol_row(
-    FILE * f,
-    char *row,
-    const char *symbol,
-    int position)
-{
-    int ret = VMI_FAILURE;
-
-    while (fgets(row, MAX_ROW_LENGTH, f) != NULL) {
-        char *token = NULL;
-
-        /* find the correct token to check */
-        int curpos = 0;
-        int position_copy = position;
-
-        while (position_copy > 0 && curpos < MAX_ROW_LENGTH) {
-            if (isspace(row[curpos])) {
-                while (isspace(row[curpos])) {
-                    row[curpos] = '\0';
-                    ++curpos;
-                }
-                --position_copy;
-                continue;
-            }
-            ++curpos;
-        }
-        if (position_copy == 0) {
-            token = row + curpos;
-            while (curpos < MAX_ROW_LENGTH) {
-                if (isspace(row[curpos])) {
-                    row[curpos] = '\0';
-                }
-                ++curpos;
-            }
-        } else { /* some went wrong in the loop above */
-            goto error_exit;
-        }
-
-        /* check the token */
-        if (strncmp(token, symbol, MAX_ROW_LENGTH) == 0) {
-            ret = VMI_SUCCESS;
-            break;
-        }
-    }
-
-error_exit:
-    if (ret == VMI_FAILURE) {
-        memset(row, 0, MAX_ROW_LENGTH);
-    }
-    return ret;
-}
-
-static status_t
-linux_system_map_symbol_to_address(
-    vmi_instance_t vmi,
-    const char *symbol,
-    addr_t *address)
-{
-    FILE *f = NULL;
-    char *row = NULL;
-    status_t ret = VMI_FAILURE;
-
-    linux_instance_t linux_instance = vmi->os_data;
-
-    if (linux_instance == NULL) {
-        errprint("VMI_ERROR: OS instance not initialized\n");
-        goto done;
-    }
-
-    if ((NULL == linux_instance->sysmap) || (strlen(linux_instance->sysmap) == 0)) {
-        errprint("VMI_WARNING: No linux sysmap configured\n");
-        goto done;
-    }
-
-    row = g_try_malloc0(MAX_ROW_LENGTH);
-    if ( !row )
-        goto done;
-
-    if ((f = fopen(linux_instance->sysmap, "r")) == NULL) {
-        fprintf(stderr,
-                "ERROR: could not find System.map file after checking:\n");
-        fprintf(stderr, "\t%s\n", linux_instance->sysmap);
-        fprintf(stderr,
-                "To fix this problem, add the correct sysmap entry to /etc/libvmi.conf\n");
-        address = 0;
-        goto done;
-    }
-    if (get_symbol_row(f, row, symbol, 2) == VMI_FAILURE) {
-        address = 0;
-        goto done;
-    }
-
-    (*address) = (addr_t) strtoull(row, NULL, 16);
-
-    ret = VMI_SUCCESS;
-
-done:
-    if (row)
-        free(row);
-    if (f)
-        fclose(f);
-    return ret;
-}
+#include "os/sysmap.h"
 
 char* linux_system_map_address_to_symbol(
     vmi_instance_t vmi,
     addr_t address,
     const access_context_t *ctx)
 {
-    FILE *f = NULL;
-    char *row = NULL;
-    char* address_str = NULL;
-    char* it = NULL;
-    char* symbol = NULL;
-    int size = 0;
+    const char *symbol;
+    addr_t offset = 0;
     linux_instance_t linux_instance = vmi->os_data;
 
 #ifdef ENABLE_SAFETY_CHECKS
     if (!linux_instance) {
         errprint("VMI_ERROR: OS instance not initialized\n");
-        goto done;
+        return NULL;
     }
 #endif
 
@@ -173,45 +62,16 @@ char* linux_system_map_address_to_symbol(
             goto err;
     };
 
-    if ((NULL == linux_instance->sysmap) || (strlen(linux_instance->sysmap) == 0)) {
+    if (!linux_instance->symbols) {
         errprint("VMI_WARNING: No linux sysmap configured\n");
-        goto done;
+        return NULL;
     }
 
-    row = g_try_malloc0(MAX_ROW_LENGTH);
-    if ( !row )
-        goto done;
+    symbol = sysmap_address_to_symbol(linux_instance->symbols, address, &offset);
+    if (!symbol || offset)
+        return NULL;
 
-    if ((f = fopen(linux_instance->sysmap, "r")) == NULL) {
-        fprintf(stderr,
-                "ERROR: could not find System.map file after checking:\n");
-        fprintf(stderr, "\t%s\n", linux_instance->sysmap);
-        fprintf(stderr,
-                "To fix this problem, add the correct sysmap entry to /etc/libvmi.conf\n");
-        goto done;
-    }
-    size = snprintf(NULL,0,"%"PRIx64"", address) + 1;
-    address_str = g_try_malloc0(size);
-    snprintf(address_str, size, "%"PRIx64"", address);
-    if (get_symbol_row(f, row, address_str, 0) == VMI_FAILURE) {
-        goto done;
-    }
-
-    // skip two columns
-    for (it=row; *it!=0; it++);
-    for (it++; *it!=0; it++);
-    it++;
-
-    symbol = strdup(it);
-
-done:
-    if (row)
-        free(row);
-    if (f)
-        fclose(f);
-    if (address_str)
-        free(address_str);
-    return symbol;
+    return strdup(symbol);
 
 err:
     errprint("VMI_WARNING: Lookup is implemented for kernel symbols only\n");
@@ -239,7 +99,7 @@ linux_symbol_to_address(
     }
 
     if (linux_instance->sysmap)
-        ret = linux_system_map_symbol_to_address(vmi, symbol, address);
+        ret = sysmap_symbol_to_address(linux_instance->symbols, symbol, address);
     else
         ret = json_profile_lookup(vmi, symbol, NULL, address);
 
@@ -43,3 +43,102 @@ status_t os_destroy(vmi_instance_t vmi)
 
     return status;
 }
+
+status_t os_clone(vmi_instance_t vmi, vmi_instance_t clone)
+{
+    if (!vmi->os_interface)
+        return VMI_SUCCESS;
+
+    if (!vmi->os_interface->os_clone) {
+        errprint("VMI_ERROR: The OS doesn't support cloning\n");
+        return VMI_FAILURE;
+    }
+
+    clone->os_interface = g_memdup(vmi->os_interface, sizeof(struct os_interface));
+    if (!clone->os_interface)
+        return VMI_FAILURE;
+
+    return vmi->os_interface->os_clone(vmi, clone);
+}
+
+void os_process_list_read_dtbs(vmi_instance_t vmi, GArray *procs,
+                               addr_t offset, bool kv2p)
+{
+    GHashTable *owners;
+    GPtrArray *pending;
+    read_request_t *reqs = NULL;
+    access_context_t *ctxs = NULL;
+    uint64_t *values = NULL;
+    uint8_t width = vmi_get_address_width(vmi);
+    os_process_t *proc, *owner;
+    guint i;
+
+    if (!width)
+        return;
+
+    /* one owner per aspace, preferring processes that know their dtb */
+    owners = g_hash_table_new(g_int64_hash, g_int64_equal);
+    for (i = 0; i < procs->len; i++) {
+        proc = &g_array_index(procs, os_process_t, i);
+        if (!proc->aspace)
+            continue;
+
+        owner = g_hash_table_lookup(owners, &proc->aspace);
+        if (!owner || (!owner->info.dtb && proc->info.dtb))
+            g_hash_table_insert(owners, &proc->aspace, proc);
+    }
+
+    pending = g_ptr_array_new();
+    for (i = 0; i < procs->len; i++) {
+        proc = &g_array_index(procs, os_process_t, i);
+        if (proc->aspace && !proc->info.dtb && proc == g_hash_table_lookup(owners, &proc->aspace))
+            g_ptr_array_add(pending, proc);
+    }
+
+    if (pending->len) {
+        reqs = g_try_malloc0(pending->len * sizeof(read_request_t));
+        ctxs = g_try_malloc0(pending->len * sizeof(access_context_t));
+        values = g_try_malloc0(pending->len * sizeof(uint64_t));
+        if (!reqs || !ctxs || !values)
+            goto done;
+
+        for (i = 0; i < pending->len; i++) {
+            proc = g_ptr_array_index(pending, i);
+            ctxs[i].translate_mechanism = VMI_TM_PROCESS_DTB;
+            ctxs[i].dtb = vmi->kpgd;
+            ctxs[i].addr = proc->aspace + offset;
+            reqs[i].ctx = &ctxs[i];
+            reqs[i].count = width;
+            reqs[i].buf = &values[i];
+        }
+
+        /* partial failure is fine, those processes keep a zero dtb */
+        (void) vmi_readv(vmi, reqs, pending->len);
+
+        for (i = 0; i < pending->len; i++) {
+            proc = g_ptr_array_index(pending, i);
+            if (reqs[i].bytes_read != width || !values[i])
+                continue;
+
+            if (kv2p && VMI_FAILURE == vmi_translate_kv2p(vmi, values[i], &values[i]))
+                continue;
+
+            proc->info.dtb = values[i];
+        }
+    }
+
+    for (i = 0; i < procs->len; i++) {
+        proc = &g_array_index(procs, os_process_t, i);
+        if (proc->aspace && !proc->info.dtb) {
+            owner = g_hash_table_lookup(owners, &proc->aspace);
+            proc->info.dtb = owner->info.dtb;
+        }
+    }
+
+done:
+    g_free(values);
+    g_free(ctxs);
+    g_free(reqs);
+    g_ptr_array_free(pending, TRUE);
+    g_hash_table_destroy(owners);
+}
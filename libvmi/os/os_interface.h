@@ -56,6 +56,24 @@ typedef unicode_string_t* (*os_read_unicode_struct_pm_t)(vmi_instance_t vmi,
 
 typedef status_t (*os_teardown_t)(vmi_instance_t vmi);
 
+/* Sets up the clone's os_data, see vmi_clone */
+typedef status_t (*os_clone_t)(vmi_instance_t vmi, vmi_instance_t clone);
+
+/* Bounds a process list walk in case the list is corrupt */
+#define OS_PROCESS_LIST_MAX     (1u << 20)
+
+typedef struct os_process {
+    vmi_process_t info;
+    addr_t aspace;          /**< object the dtb is read from (mm_struct, vmspace), if any */
+    addr_t parent;          /**< parent task, resolved to info.ppid after the walk */
+} os_process_t;
+
+/*
+ * Walks the process list, appending one os_process_t per process to procs.
+ * Processes with a parent but no ppid get it from the parent's entry.
+ */
+typedef status_t (*os_process_list_t)(vmi_instance_t vmi, GArray *procs);
+
 typedef struct os_interface {
     os_get_kernel_struct_offset_t os_get_kernel_struct_offset;
     os_get_offset_t os_get_offset;
@@ -68,6 +86,8 @@ typedef struct os_interface {
     os_read_unicode_struct_t os_read_unicode_struct;
     os_read_unicode_struct_pm_t os_read_unicode_struct_pm;
     os_teardown_t os_teardown;
+    os_clone_t os_clone;
+    os_process_list_t os_process_list;
 } *os_interface_t;
 
 /**
@@ -78,4 +98,64 @@ typedef struct os_interface {
  */
 status_t os_destroy(vmi_instance_t vmi);
 
+/**
+ * Gives the clone the OS interface of the instance and its own copy of the
+ * OS data. Parsed symbol indexes are shared, OS caches start out empty.
+ *
+ * @param vmi
+ * @param clone
+ * @return
+ */
+status_t os_clone(vmi_instance_t vmi, vmi_instance_t clone);
+
+/**
+ * Fills in the dtb of the walked processes that have an aspace but no dtb
+ * yet. The pointer-sized value at aspace + offset is read once per distinct
+ * aspace, all with a single vmi_readv, and is translated from a kernel
+ * virtual address if kv2p is set.
+ *
+ * @param vmi
+ * @param procs os_process_t array
+ * @param offset
+ * @param kv2p
+ */
+void os_process_list_read_dtbs(vmi_instance_t vmi, GArray *procs,
+                               addr_t offset, bool kv2p);
+
+/*
+ * Alternative heuristics of the OS init for the same value, see
+ * os/heuristics.c. A method gets the data of its os_heuristic_method_t and
+ * stores its result there; only the winner's result is used.
+ */
+typedef status_t (*os_heuristic_fn_t)(vmi_instance_t vmi, void *data);
+
+typedef struct os_heuristic_method {
+    const char *name;
+    os_heuristic_fn_t fn;
+    void *data;
+} os_heuristic_method_t;
+
+/*
+ * Races the methods on clones of the instance, or runs them in order where
+ * it can't, and returns the index of the first one that succeeded or -1.
+ * The winner is recorded for vmi_get_init_methods.
+ */
+int os_heuristics_run(vmi_instance_t vmi, const os_heuristic_method_t *methods,
+                      unsigned int num_methods);
+
+/*
+ * Runs the methods in order until one succeeds, without recording the
+ * winner. For searches that try them for many candidates, where cloning
+ * the instance every time would cost more than it saves.
+ */
+int os_heuristics_first(vmi_instance_t vmi, const os_heuristic_method_t *methods,
+                        unsigned int num_methods);
+
+/* Whether another method already won, long searches poll it to give up early */
+bool os_heuristics_cancelled(vmi_instance_t vmi);
+
+void os_heuristics_reset(vmi_instance_t vmi);
+
+void os_heuristics_destroy(vmi_instance_t vmi);
+
 #endif /* OS_INTERFACE_H_ */
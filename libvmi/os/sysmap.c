@@ -0,0 +1,226 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <ctype.h>
+#include <string.h>
+
+#include "private.h"
+#include "os/sysmap.h"
+
+typedef struct sysmap_entry {
+    addr_t address;
+    const char *name;   /**< points into the file contents */
+    size_t line;        /**< keeps sorting stable, first symbol in the file wins */
+} sysmap_entry_t;
+
+struct sysmap {
+    gchar *contents;
+    sysmap_entry_t *entries;    /**< sorted by address */
+    size_t count;
+    GHashTable *names;          /**< name -> sysmap_entry_t* */
+    unsigned int refs;          /**< instances sharing the index, see vmi_clone */
+};
+
+static int
+compare_entries(
+    const void *a,
+    const void *b)
+{
+    const sysmap_entry_t *ea = a, *eb = b;
+
+    if (ea->address != eb->address)
+        return ea->address < eb->address ? -1 : 1;
+
+    return ea->line < eb->line ? -1 : ea->line > eb->line;
+}
+
+static char *
+next_token(
+    char **cursor)
+{
+    char *token, *p = *cursor;
+
+    while (*p == ' ' || *p == '\t')
+        p++;
+
+    if (!*p || *p == '\n' || *p == '\r')
+        return NULL;
+
+    token = p;
+    while (*p && !isspace((unsigned char) *p))
+        p++;
+
+    *cursor = p;
+    return token;
+}
+
+sysmap_t
+sysmap_load(
+    const char *path)
+{
+    sysmap_t sysmap;
+    gsize length = 0;
+    size_t lines = 1, i;
+    char *line, *eol, *cursor, *addr, *type, *name;
+
+    sysmap = g_try_malloc0(sizeof(struct sysmap));
+    if (!sysmap)
+        return NULL;
+
+    sysmap->refs = 1;
+
+    if (!g_file_get_contents(path, &sysmap->contents, &length, NULL)) {
+        fprintf(stderr,
+                "ERROR: could not find System.map file after checking:\n");
+        fprintf(stderr, "\t%s\n", path);
+        fprintf(stderr,
+                "To fix this problem, add the correct sysmap entry to /etc/libvmi.conf\n");
+        g_free(sysmap);
+        return NULL;
+    }
+
+    for (i = 0; i < length; i++)
+        if (sysmap->contents[i] == '\n')
+            lines++;
+
+    sysmap->entries = g_try_malloc(lines * sizeof(sysmap_entry_t));
+    sysmap->names = g_hash_table_new(g_str_hash, g_str_equal);
+    if (!sysmap->entries)
+        goto error;
+
+    for (line = sysmap->contents; line && *line; line = eol) {
+        eol = strchr(line, '\n');
+        if (eol)
+            *eol++ = '\0';
+
+        cursor = line;
+        addr = next_token(&cursor);
+        type = next_token(&cursor);
+        name = next_token(&cursor);
+        if (!addr || !type || !name)
+            continue;
+
+        /* names are terminated in place, anything after them is ignored */
+        if (*cursor)
+            *cursor = '\0';
+
+        sysmap->entries[sysmap->count].address = strtoull(addr, NULL, 16);
+        sysmap->entries[sysmap->count].name = name;
+        sysmap->entries[sysmap->count].line = sysmap->count;
+        sysmap->count++;
+    }
+
+    qsort(sysmap->entries, sysmap->count, sizeof(sysmap_entry_t), compare_entries);
+
+    for (i = 0; i < sysmap->count; i++) {
+        sysmap_entry_t *entry = &sysmap->entries[i];
+        sysmap_entry_t *first = g_hash_table_lookup(sysmap->names, entry->name);
+
+        if (!first || entry->line < first->line)
+            g_hash_table_insert(sysmap->names, (gpointer) entry->name, entry);
+    }
+
+    dbprint(VMI_DEBUG_MISC, "**Indexed %zu symbols from %s\n", sysmap->count, path);
+    return sysmap;
+
+error:
+    sysmap_destroy(sysmap);
+    return NULL;
+}
+
+status_t
+sysmap_symbol_to_address(
+    sysmap_t sysmap,
+    const char *symbol,
+    addr_t *address)
+{
+    sysmap_entry_t *entry;
+
+    if (!sysmap || !symbol)
+        return VMI_FAILURE;
+
+    entry = g_hash_table_lookup(sysmap->names, symbol);
+    if (!entry)
+        return VMI_FAILURE;
+
+    *address = entry->address;
+    return VMI_SUCCESS;
+}
+
+const char *
+sysmap_address_to_symbol(
+    sysmap_t sysmap,
+    addr_t address,
+    addr_t *offset)
+{
+    size_t lo = 0, hi, mid;
+    sysmap_entry_t *entry;
+
+    if (!sysmap || !sysmap->count)
+        return NULL;
+
+    /* first entry with an address above the one we look for */
+    hi = sysmap->count;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (sysmap->entries[mid].address <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (!lo)
+        return NULL;
+
+    /* step back to the first symbol in the file at that address */
+    entry = &sysmap->entries[lo - 1];
+    while (entry > sysmap->entries && (entry - 1)->address == entry->address)
+        entry--;
+
+    if (offset)
+        *offset = address - entry->address;
+
+    return entry->name;
+}
+
+sysmap_t
+sysmap_ref(
+    sysmap_t sysmap)
+{
+    if (sysmap)
+        __atomic_add_fetch(&sysmap->refs, 1, __ATOMIC_RELAXED);
+
+    return sysmap;
+}
+
+void
+sysmap_destroy(
+    sysmap_t sysmap)
+{
+    if (!sysmap || __atomic_sub_fetch(&sysmap->refs, 1, __ATOMIC_ACQ_REL))
+        return;
+
+    if (sysmap->names)
+        g_hash_table_destroy(sysmap->names);
+    g_free(sysmap->entries);
+    g_free(sysmap->contents);
+    g_free(sysmap);
+}
@@ -0,0 +1,59 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OS_SYSMAP_H_
+#define OS_SYSMAP_H_
+
+#include "private.h"
+
+/*
+ * In-memory index of a System.map style symbol file ("address type name"
+ * per line), shared by the Linux and FreeBSD backends. The file is parsed
+ * once; names are looked up in a hash table and addresses by binary search.
+ */
+typedef struct sysmap *sysmap_t;
+
+sysmap_t sysmap_load(
+    const char *path);
+
+/* Address of the first symbol with the given name in the file */
+status_t sysmap_symbol_to_address(
+    sysmap_t sysmap,
+    const char *symbol,
+    addr_t *address);
+
+/*
+ * Symbol covering an address: the first symbol in the file with the
+ * highest address not above it. The distance from the symbol is returned
+ * in offset. The string is owned by the index.
+ */
+const char *sysmap_address_to_symbol(
+    sysmap_t sysmap,
+    addr_t address,
+    addr_t *offset);
+
+/* Takes another reference, the index is freed by the last sysmap_destroy */
+sysmap_t sysmap_ref(
+    sysmap_t sysmap);
+
+void sysmap_destroy(
+    sysmap_t sysmap);
+
+#endif /* OS_SYSMAP_H_ */
@@ -701,8 +701,17 @@ done:
     return ret;
 }
 
-static status_t kpcr_find1(vmi_instance_t vmi, windows_instance_t windows, reg_t kpcr_reg)
+/* Input and output of the kernel base search methods */
+typedef struct kpcr_search {
+    reg_t kpcr_reg;
+    addr_t ntoskrnl_va;
+} kpcr_search_t;
+
+static status_t kpcr_find1(vmi_instance_t vmi, void *data)
 {
+    kpcr_search_t *search = (kpcr_search_t *) data;
+    reg_t kpcr_reg = search->kpcr_reg;
+
     dbprint(VMI_DEBUG_MISC, "** Trying kpcr_find1\n");
 
     addr_t kpcr_rva;
@@ -725,16 +734,18 @@ static status_t kpcr_find1(vmi_instance_t vmi, windows_instance_t windows, reg_t
     }
 
     // If the JSON profile has KiInitialPCR we have Win 7+
-    windows->ntoskrnl_va = kpcr_reg - kpcr_rva;
+    search->ntoskrnl_va = kpcr_reg - kpcr_rva;
 
     return VMI_SUCCESS;
 }
 
-static status_t kpcr_find2(vmi_instance_t vmi, windows_instance_t windows)
+static status_t kpcr_find2(vmi_instance_t vmi, void *data)
 {
+    kpcr_search_t *search = (kpcr_search_t *) data;
+
     dbprint(VMI_DEBUG_MISC, "** Trying kpcr_find2\n");
 
-    addr_t kisystemcall64shadow, kisystemcall32shadow;
+    addr_t kisystemcall64shadow, kisystemcall32shadow, ntoskrnl;
     reg_t lstar, cstar;
 
     if ( VMI_FAILURE == json_profile_lookup(vmi, "KiSystemCall64Shadow", NULL, &kisystemcall64shadow) )
@@ -763,16 +774,18 @@ static status_t kpcr_find2(vmi_instance_t vmi, windows_instance_t windows)
         return VMI_FAILURE;
     }
 
-    windows->ntoskrnl_va = ntbaseaddress;
-
-    if ( VMI_FAILURE == vmi_translate_kv2p(vmi, windows->ntoskrnl_va, &windows->ntoskrnl) )
+    if ( VMI_FAILURE == vmi_translate_kv2p(vmi, ntbaseaddress, &ntoskrnl) )
         return VMI_FAILURE;
 
+    search->ntoskrnl_va = ntbaseaddress;
+
     return VMI_SUCCESS;
 }
 
-static status_t kpcr_find3(vmi_instance_t vmi, windows_instance_t windows)
+static status_t kpcr_find3(vmi_instance_t vmi, void *data)
 {
+    kpcr_search_t *search = (kpcr_search_t *) data;
+
     dbprint(VMI_DEBUG_MISC, "** Trying kpcr_find3\n");
 
     addr_t int0_rva = 0;
@@ -796,13 +809,16 @@ static status_t kpcr_find3(vmi_instance_t vmi, windows_instance_t windows)
     if (VMI_PM_IA32E == vmi->page_mode && VMI_FAILURE == vmi_read_32_va(vmi, idt + 8, 0, &int0_high))
         return VMI_FAILURE;
 
-    windows->ntoskrnl_va = (((uint64_t)int0_high << 32) | ((uint64_t)int0_middle << 16) | int0_low) - int0_rva;
+    search->ntoskrnl_va = (((uint64_t)int0_high << 32) | ((uint64_t)int0_middle << 16) | int0_low) - int0_rva;
 
     return VMI_SUCCESS;
 }
 
-static status_t kpcr_find4(vmi_instance_t vmi, windows_instance_t windows, reg_t kpcr_reg)
+static status_t kpcr_find4(vmi_instance_t vmi, void *data)
 {
+    kpcr_search_t *search = (kpcr_search_t *) data;
+    reg_t kpcr_reg = search->kpcr_reg;
+
     dbprint(VMI_DEBUG_MISC, "** Trying kpcr_find4\n");
 
     // If we are in live mode and still don't have the kernel base the KPCR has to be
@@ -819,7 +835,7 @@ static status_t kpcr_find4(vmi_instance_t vmi, windows_instance_t windows, reg_t
         return VMI_FAILURE;
     if ( VMI_FAILURE == vmi_read_addr_va(vmi, kpcr_reg+kdvb_offset, 0, &kdvb) )
         return VMI_FAILURE;
-    if ( VMI_FAILURE == vmi_read_addr_va(vmi, kdvb+kernbase_offset, 0, &windows->ntoskrnl_va) )
+    if ( VMI_FAILURE == vmi_read_addr_va(vmi, kdvb+kernbase_offset, 0, &search->ntoskrnl_va) )
         return VMI_FAILURE;
 
     return VMI_SUCCESS;
@@ -840,11 +856,21 @@ init_from_json_profile_real(vmi_instance_t vmi, reg_t kpcr_register_to_use)
             goto done;
         }
 
-        if ( VMI_SUCCESS == kpcr_find1(vmi, windows, kpcr_reg) ) {}
-        else if ( VMI_SUCCESS == kpcr_find2(vmi, windows) ) {}
-        else if ( VMI_SUCCESS == kpcr_find3(vmi, windows) ) {}
-        else if ( VMI_SUCCESS == kpcr_find4(vmi, windows, kpcr_reg) ) {}
-        else goto done;
+        kpcr_search_t found[4] = {
+            { .kpcr_reg = kpcr_reg }, { .kpcr_reg = kpcr_reg },
+            { .kpcr_reg = kpcr_reg }, { .kpcr_reg = kpcr_reg },
+        };
+        const os_heuristic_method_t methods[] = {
+            { "kpcr_find1", kpcr_find1, &found[0] },
+            { "kpcr_find2", kpcr_find2, &found[1] },
+            { "kpcr_find3", kpcr_find3, &found[2] },
+            { "kpcr_find4", kpcr_find4, &found[3] },
+        };
+        int winner = os_heuristics_run(vmi, methods, G_N_ELEMENTS(methods));
+        if (winner < 0)
+            goto done;
+
+        windows->ntoskrnl_va = found[winner].ntoskrnl_va;
 
         if ( VMI_FAILURE == vmi_translate_kv2p(vmi, windows->ntoskrnl_va, &windows->ntoskrnl) || !windows->ntoskrnl ) {
             /*
@@ -1031,6 +1057,7 @@ windows_init(vmi_instance_t vmi, GHashTable *config)
 
     windows = vmi->os_data;
     windows->version = VMI_OS_WINDOWS_UNKNOWN;
+    pthread_mutex_init(&windows->export_lock, NULL);
 
     g_hash_table_foreach(config, (GHFunc)windows_read_config_ghashtable_entries, vmi);
 
@@ -1051,6 +1078,8 @@ windows_init(vmi_instance_t vmi, GHashTable *config)
     os_interface->os_read_unicode_struct = windows_read_unicode_struct;
     os_interface->os_read_unicode_struct_pm = windows_read_unicode_struct_pm;
     os_interface->os_teardown = windows_teardown;
+    os_interface->os_clone = windows_clone;
+    os_interface->os_process_list = windows_process_list;
 
     vmi->os_interface = os_interface;
 
@@ -1123,6 +1152,25 @@ done:
     return status;
 }
 
+status_t windows_clone(vmi_instance_t vmi, vmi_instance_t clone)
+{
+    windows_instance_t windows;
+
+    if (!vmi->os_data)
+        return VMI_SUCCESS;
+
+    windows = g_memdup(vmi->os_data, sizeof(struct windows_instance));
+    if (!windows)
+        return VMI_FAILURE;
+
+    /* the export indexes are a cache, the clone builds its own */
+    windows->export_indexes = NULL;
+    pthread_mutex_init(&windows->export_lock, NULL);
+
+    clone->os_data = windows;
+    return VMI_SUCCESS;
+}
+
 status_t windows_teardown(vmi_instance_t vmi)
 {
 
@@ -1133,6 +1181,10 @@ status_t windows_teardown(vmi_instance_t vmi)
         goto done;
     }
 
+    if (windows->export_indexes)
+        g_hash_table_destroy(windows->export_indexes);
+    pthread_mutex_destroy(&windows->export_lock);
+
     g_free(vmi->os_data);
     vmi->os_data = NULL;
     vmi->kpgd = 0;
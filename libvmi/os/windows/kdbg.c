@@ -685,165 +685,208 @@ find_windows_version(
     return VMI_OS_WINDOWS_UNKNOWN;
 }
 
-status_t find_kdbg_address(
+struct kdbg_scan {
+    unsigned long kernbase_offset;
+    addr_t kdbg_pa;
+    addr_t kernel_va;
+    bool found;
+};
+
+static bool
+kdbg_scan_cb(
     vmi_instance_t vmi,
-    addr_t *kdbg_pa,
-    addr_t *kernel_va)
+    addr_t paddr,
+    unsigned int pattern,
+    void *data)
 {
+    struct kdbg_scan *scan = (struct kdbg_scan *) data;
+    /* offset of the tag within the header, for the 64-bit and 32-bit pattern */
+    addr_t find_ofs = pattern ? 0x8 : 0xc;
+    addr_t kernel_va;
 
-    dbprint(VMI_DEBUG_MISC, "**Trying find_kdbg_address\n");
+    if (paddr < find_ofs)
+        return true;
 
-    status_t ret = VMI_FAILURE;
-    *kdbg_pa = 0;
-    addr_t paddr = 0;
-    unsigned char haystack[VMI_PS_4KB];
-    addr_t memsize = vmi_get_max_physical_address(vmi);
+    // Read "KernBase" from the header
+    if (VMI_FAILURE == vmi_read_64_pa(vmi, paddr - find_ofs + scan->kernbase_offset, &kernel_va))
+        return true;
 
-    void *bm64 = boyer_moore_init((unsigned char *)"\x00\xf8\xff\xffKDBG", 8);
-    void *bm32 = boyer_moore_init((unsigned char *)"\x00\x00\x00\x00\x00\x00\x00\x00KDBG",
-                                  12);
-    uint32_t find_ofs_64 = 0xc, find_ofs_32 = 0x8, find_ofs = 0;
+    scan->kdbg_pa = paddr - find_ofs;
+    scan->kernel_va = kernel_va;
+    scan->found = true;
 
-    for (; paddr<memsize; paddr+=VMI_PS_4KB) {
+    return false;
+}
 
-        find_ofs = 0;
+/* How much of physical memory find_kdbg_address scans between cancellation checks */
+#define KDBG_SCAN_PIECE (256ull << 20)
 
-        if (VMI_FAILURE == vmi_read_pa(vmi, paddr, VMI_PS_4KB, &haystack, NULL))
-            continue;
+/* Output of the KdDebuggerDataBlock search methods */
+typedef struct kdbg_search {
+    addr_t kdbg_pa;
+    addr_t kernel_pa;
+    addr_t kernel_va;
+} kdbg_search_t;
 
-        int match_offset = boyer_moore2(bm64, haystack, VMI_PS_4KB);
-        if (-1 != match_offset) {
-            find_ofs = find_ofs_64;
-        } else {
-            match_offset = boyer_moore2(bm32, haystack, VMI_PS_4KB);
-        }
+static status_t
+find_kdbg_address(
+    vmi_instance_t vmi,
+    void *data)
+{
+    kdbg_search_t *found = (kdbg_search_t *) data;
 
-        if (-1 != match_offset) {
+    dbprint(VMI_DEBUG_MISC, "**Trying find_kdbg_address\n");
 
-            if (!find_ofs) {
-                find_ofs = find_ofs_32;
-            }
+    struct kdbg_scan scan = { 0 };
+    const scan_pattern_t patterns[] = {
+        { (const uint8_t *)"\x00\xf8\xff\xffKDBG", 8 },
+        { (const uint8_t *)"\x00\x00\x00\x00\x00\x00\x00\x00KDBG", 12 },
+    };
+    addr_t memsize = vmi_get_max_physical_address(vmi);
+    ACCESS_CONTEXT(ctx);
 
-            // Read "KernBase" from the haystack
-            long unsigned int kernbase_offset = 0;
-            kdbg_symbol_offset("KernBase", &kernbase_offset);
+    kdbg_symbol_offset("KernBase", &scan.kernbase_offset);
 
-            if ( match_offset - find_ofs + kernbase_offset + sizeof(uint64_t) >= VMI_PS_4KB )
-                continue;
+    // this walks all of physical memory in order, a piece at a time so that
+    // it stops soon once another search method found the block
+    (void) vmi_set_access_hint(vmi, VMI_ACCESS_HINT_SEQUENTIAL);
+    for (ctx.addr = 0; ctx.addr < memsize && !scan.found; ctx.addr += KDBG_SCAN_PIECE) {
+        if (os_heuristics_cancelled(vmi))
+            break;
 
-            memcpy(kernel_va, &haystack[(unsigned int) match_offset - find_ofs + kernbase_offset], sizeof(uint64_t));
-            *kdbg_pa = paddr + (unsigned int) match_offset - find_ofs;
+        // the pieces overlap by a pattern, less a byte, for matches across them
+        addr_t length = MIN(memsize - ctx.addr, KDBG_SCAN_PIECE + 11);
+        (void) vmi_scan_memory(vmi, &ctx, length, patterns, 2, 0, kdbg_scan_cb, &scan);
+    }
+    (void) vmi_set_access_hint(vmi, VMI_ACCESS_HINT_NORMAL);
 
-            ret = VMI_SUCCESS;
+    if (!scan.found)
+        return VMI_FAILURE;
 
-            break;
-        }
-    }
+    found->kdbg_pa = scan.kdbg_pa;
+    found->kernel_va = scan.kernel_va;
+    found->kernel_pa = get_ntoskrnl_base(vmi, 0);
 
-    dbprint(VMI_DEBUG_MISC, "--Found KdDebuggerDataBlock at PA %.16"PRIx64"\n", *kdbg_pa);
+    dbprint(VMI_DEBUG_MISC, "--Found KdDebuggerDataBlock at PA %.16"PRIx64"\n", found->kdbg_pa);
 
-    boyer_moore_fini(bm32);
-    boyer_moore_fini(bm64);
-    return ret;
+    return VMI_SUCCESS;
 }
 
-status_t
-find_kdbg_address_fast(
+typedef struct kdbg_page_search {
+    kdbg_search_t *found;
+    reg_t cr3;
+    addr_t memsize;
+    void *bm;       // boyer-moore internal state
+    int find_ofs;
+    bool stop;      // found
+    status_t ret;
+} kdbg_page_search_t;
+
+static bool
+kdbg_search_range(
     vmi_instance_t vmi,
-    addr_t *kdbg_pa,
-    addr_t *kernel_pa,
-    addr_t *kernel_va)
+    const vmi_va_range_t *range,
+    void *data)
 {
+    kdbg_page_search_t *search = (kdbg_page_search_t *) data;
+    const unsigned char *haystack;
+    page_pin_t pin;
+    addr_t offset;
+
+    // We might get pages that are greater than 4Kb
+    // so we are just going to split them to 4Kb pages
+    for (offset = 0; offset < range->size; offset += VMI_PS_4KB) {
+        addr_t page_paddr = range->paddr + offset;
+
+        if (os_heuristics_cancelled(vmi)) {
+            search->stop = true;
+            return false;
+        }
 
-    dbprint(VMI_DEBUG_MISC, "**Trying find_kdbg_address_fast\n");
-
-    status_t ret = VMI_FAILURE;
-    reg_t cr3;
-    if (VMI_FAILURE == driver_get_vcpureg(vmi, &cr3, CR3, 0)) {
-        return ret;
-    }
-
-    addr_t memsize = vmi_get_max_physical_address(vmi);
-    GSList *va_pages = vmi_get_va_pages(vmi, (addr_t)cr3);
-    void *bm = 0;   // boyer-moore internal state
-    unsigned char haystack[VMI_PS_4KB];
-    int find_ofs = 0;
-
-    if (VMI_PM_IA32E == vmi->page_mode) {
-        bm = boyer_moore_init((unsigned char *)"\x00\xf8\xff\xffKDBG", 8);
-        find_ofs = 0xc;
-    } else {
-        bm = boyer_moore_init((unsigned char *)"\x00\x00\x00\x00\x00\x00\x00\x00KDBG",
-                              12);
-        find_ofs = 0x8;
-    }   // if-else
-
-    GSList *va_pages_loop = va_pages;
-    while (va_pages_loop) {
-
-        page_info_t *vap = (page_info_t *)va_pages_loop->data;
+        if (page_paddr + VMI_PS_4KB - 1 > search->memsize) {
+            continue;
+        }
 
-        // We might get pages that are greater than 4Kb
-        // so we are just going to split them to 4Kb pages
-        while (vap && vap->size >= VMI_PS_4KB) {
-            vap->size -= VMI_PS_4KB;
-            addr_t page_paddr = vap->paddr+vap->size;
+        ACCESS_CONTEXT(ctx, .addr = page_paddr);
+        if ( VMI_FAILURE == vmi_pin_page(vmi, &ctx, (const void **) &haystack, NULL, &pin) )
+            continue;
 
-            if (page_paddr + VMI_PS_4KB - 1 > memsize) {
-                continue;
-            }
+        int match_offset = boyer_moore2(search->bm, haystack, VMI_PS_4KB);
+        vmi_unpin_page(vmi, pin);
 
-            if ( VMI_FAILURE == vmi_read_pa(vmi, page_paddr, VMI_PS_4KB, haystack, NULL) )
-                continue;
+        if (-1 == match_offset)
+            continue;
 
-            int match_offset = boyer_moore2(bm, haystack, VMI_PS_4KB);
+        addr_t tmp_kva = 0, tmp_kpa = 0;
+        addr_t tmp_kdbg = page_paddr + (unsigned int) match_offset - search->find_ofs;
 
-            if (-1 != match_offset) {
+        if (VMI_FAILURE == vmi_read_64_pa(vmi, tmp_kdbg + sizeof(DBGKD_DEBUG_DATA_HEADER64), &tmp_kva)) {
+            continue;
+        }
 
-                addr_t tmp_kva = 0, tmp_kpa = 0;
-                addr_t tmp_kdbg = page_paddr + (unsigned int) match_offset - find_ofs;
+        if ( VMI_FAILURE == vmi_pagetable_lookup(vmi, search->cr3, tmp_kva, &tmp_kpa) )
+            continue;
 
-                if (VMI_FAILURE == vmi_read_64_pa(vmi, tmp_kdbg + sizeof(DBGKD_DEBUG_DATA_HEADER64), &tmp_kva)) {
-                    continue;
-                }
+        search->found->kdbg_pa = tmp_kdbg;
+        search->found->kernel_va = tmp_kva;
+        search->found->kernel_pa = tmp_kpa;
+        search->ret = VMI_SUCCESS;
+        search->stop = true;
+        return false;
+    }
 
-                if ( VMI_FAILURE == vmi_pagetable_lookup(vmi, cr3, tmp_kva, &tmp_kpa) )
-                    continue;
+    return true;
+}
 
-                *kdbg_pa = tmp_kdbg;
-                *kernel_va = tmp_kva;
-                *kernel_pa = tmp_kpa;
+static status_t
+find_kdbg_address_fast(
+    vmi_instance_t vmi,
+    void *data)
+{
+    kdbg_page_search_t search = {
+        .found = (kdbg_search_t *) data,
+        .ret = VMI_FAILURE,
+    };
+    addr_t kernel_start;
 
-                ret = VMI_SUCCESS;
+    dbprint(VMI_DEBUG_MISC, "**Trying find_kdbg_address_fast\n");
 
-                goto done;
-            }
-        }
-        g_free(vap);
-        va_pages_loop = va_pages_loop->next;
+    if (VMI_FAILURE == driver_get_vcpureg(vmi, &search.cr3, CR3, 0)) {
+        return VMI_FAILURE;
     }
 
-done:
-    // free the rest of the list
-    while (va_pages_loop) {
-        g_free(va_pages_loop->data);
-        va_pages_loop = va_pages_loop->next;
-    }
-    g_slist_free(va_pages);
+    search.memsize = vmi_get_max_physical_address(vmi);
 
-    if (VMI_SUCCESS == ret)
-        dbprint(VMI_DEBUG_MISC, "--Found KdDebuggerDataBlock at PA %.16"PRIx64"\n", *kdbg_pa);
-    boyer_moore_fini(bm);
-    return ret;
+    if (VMI_PM_IA32E == vmi->page_mode) {
+        search.bm = boyer_moore_init((unsigned char *)"\x00\xf8\xff\xffKDBG", 8);
+        search.find_ofs = 0xc;
+        kernel_start = 0xffff800000000000ull;
+    } else {
+        search.bm = boyer_moore_init((unsigned char *)"\x00\x00\x00\x00\x00\x00\x00\x00KDBG",
+                                     12);
+        search.find_ofs = 0x8;
+        kernel_start = 0x80000000ull;
+    }   // if-else
+
+    // The pages are searched as the walk finds them, kernel space first
+    vmi_walk_va_pages(vmi, 0, VMI_PM_NONE, search.cr3, vmi->page_mode, kernel_start, ~0ull, 0,
+                      kdbg_search_range, &search);
+    if (!search.stop)
+        vmi_walk_va_pages(vmi, 0, VMI_PM_NONE, search.cr3, vmi->page_mode, 0, kernel_start - 1, 0,
+                          kdbg_search_range, &search);
+
+    if (VMI_SUCCESS == search.ret)
+        dbprint(VMI_DEBUG_MISC, "--Found KdDebuggerDataBlock at PA %.16"PRIx64"\n", search.found->kdbg_pa);
+    boyer_moore_fini(search.bm);
+    return search.ret;
 }
 
-status_t
+static status_t
 find_kdbg_address_faster(
     vmi_instance_t vmi,
-    addr_t *kdbg_pa,
-    addr_t *kernel_pa,
-    addr_t *kernel_va)
+    void *data)
 {
+    kdbg_search_t *found = (kdbg_search_t *) data;
 
     dbprint(VMI_DEBUG_MISC, "**Trying find_kdbg_address_faster\n");
 
@@ -899,6 +942,9 @@ scan:
 
     for (; page_paddr + step < vmi->max_physical_address; page_paddr += step) {
 
+        if (os_heuristics_cancelled(vmi))
+            goto done;
+
         uint8_t page[VMI_PS_4KB];
         ctx.addr = page_paddr;
         status_t rc = peparse_get_image(vmi, &ctx, VMI_PS_4KB, page);
@@ -957,8 +1003,10 @@ scan:
             if ( !haystack )
                 goto done;
 
-            if ( VMI_FAILURE == vmi_read_pa(vmi, page_paddr + section.virtual_address, section.size_of_raw_data, haystack, NULL) )
+            if ( VMI_FAILURE == vmi_read_pa(vmi, page_paddr + section.virtual_address, section.size_of_raw_data, haystack, NULL) ) {
+                g_free(haystack);
                 continue;
+            }
 
             int match_offset = boyer_moore2(bm, haystack, section.size_of_raw_data);
 
@@ -973,15 +1021,16 @@ scan:
 
                 if ((*kernbase) << zeroes == page_paddr << zeroes) {
 
-                    *kernel_pa = page_paddr;
-                    *kernel_va = *kernbase;
-                    *kdbg_pa = page_paddr + section.virtual_address + (unsigned int) match_offset - find_ofs;
+                    found->kernel_pa = page_paddr;
+                    found->kernel_va = *kernbase;
+                    found->kdbg_pa = page_paddr + section.virtual_address + (unsigned int) match_offset - find_ofs;
 
                     ret = VMI_SUCCESS;
 
                     dbprint(VMI_DEBUG_MISC,
-                            "--Found KdDebuggerDataBlock at PA %.16"PRIx64"\n", *kdbg_pa);
+                            "--Found KdDebuggerDataBlock at PA %.16"PRIx64"\n", found->kdbg_pa);
 
+                    g_free(haystack);
                     goto done;
                 } else {
                     dbprint(VMI_DEBUG_MISC,
@@ -990,6 +1039,7 @@ scan:
                 }
             }
 
+            g_free(haystack);
             break;
         }
     }
@@ -1004,13 +1054,12 @@ done:
     return ret;
 }
 
-status_t
+static status_t
 find_kdbg_address_instant(
     vmi_instance_t vmi,
-    addr_t *kdbg_pa,
-    addr_t *kernel_pa,
-    addr_t *kernel_va)
+    void *data)
 {
+    kdbg_search_t *found = (kdbg_search_t *) data;
 
     dbprint(VMI_DEBUG_MISC, "**Trying find_kdbg_address_instant\n");
 
@@ -1056,9 +1105,9 @@ find_kdbg_address_instant(
     if ( !kernelbase_pa )
         goto done;
 
-    *kernel_pa = kernelbase_pa;
-    *kernel_va = kernelbase_va;
-    *kdbg_pa = kernelbase_pa + windows->kdbg_offset;
+    found->kernel_pa = kernelbase_pa;
+    found->kernel_va = kernelbase_va;
+    found->kdbg_pa = kernelbase_pa + windows->kdbg_offset;
 
     ret = VMI_SUCCESS;
 
@@ -1107,6 +1156,14 @@ init_from_kdbg(
     addr_t kernbase_pa = 0;
     addr_t kernbase_va = 0;
     addr_t kdbg_pa = 0;
+    kdbg_search_t kdbg_found[4] = {{0}};
+    const os_heuristic_method_t kdbg_methods[] = {
+        { "find_kdbg_address_instant", find_kdbg_address_instant, &kdbg_found[0] },
+        { "find_kdbg_address_faster", find_kdbg_address_faster, &kdbg_found[1] },
+        { "find_kdbg_address_fast", find_kdbg_address_fast, &kdbg_found[2] },
+        { "find_kdbg_address", find_kdbg_address, &kdbg_found[3] },
+    };
+    int winner;
 
     if (vmi->os_data == NULL) {
         goto exit;
@@ -1193,26 +1250,17 @@ init_from_kdbg(
 find_kdbg:
     dbprint(VMI_DEBUG_MISC, "**Attempting KdDebuggerDataBlock search methods\n");
 
-    if (VMI_SUCCESS == find_kdbg_address_instant(vmi, &kdbg_pa, &kernbase_pa, &kernbase_va)) {
-        goto found;
-    }
-    if (VMI_SUCCESS == find_kdbg_address_faster(vmi, &kdbg_pa, &kernbase_pa, &kernbase_va)) {
-        goto found;
-    }
-    if (VMI_SUCCESS == find_kdbg_address_fast(vmi, &kdbg_pa, &kernbase_pa, &kernbase_va)) {
-        goto found;
-    }
-
-    /* NOTE: This is the only method that does anything for VMI_FILE */
-    if (VMI_SUCCESS == find_kdbg_address(vmi, &kdbg_pa, &kernbase_va)) {
-        kernbase_pa = get_ntoskrnl_base(vmi, 0);
-        goto found;
+    /* NOTE: find_kdbg_address is the only method that does anything for VMI_FILE */
+    winner = os_heuristics_run(vmi, kdbg_methods, G_N_ELEMENTS(kdbg_methods));
+    if (winner < 0) {
+        dbprint(VMI_DEBUG_MISC, "**All KdDebuggerDataBlock search methods failed\n");
+        goto exit;
     }
 
-    dbprint(VMI_DEBUG_MISC, "**All KdDebuggerDataBlock search methods failed\n");
-    goto exit;
+    kdbg_pa = kdbg_found[winner].kdbg_pa;
+    kernbase_pa = kdbg_found[winner].kernel_pa;
+    kernbase_va = kdbg_found[winner].kernel_va;
 
-found:
     windows->ntoskrnl_va = kernbase_va;
     dbprint(VMI_DEBUG_MISC, "**set KernBase VA=0x%"PRIx64"\n", windows->ntoskrnl_va);
 
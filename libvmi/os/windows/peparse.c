@@ -494,6 +494,336 @@ peparse_get_export_table(
     return VMI_SUCCESS;
 }
 
+/*
+ * Export index.
+ *
+ * Resolving an export by walking the name pointer table in guest memory
+ * costs a string read per probe, and reverse lookups walk every export.
+ * Instead, the first lookup in a module reads the whole export directory in
+ * one go and indexes it per (DTB, module base): a name hash for forward
+ * lookups and an array sorted by RVA for reverse lookups.
+ *
+ * An index stays valid as long as the export directory header it was built
+ * from is unchanged, which is checked with a single small read on every
+ * use. A module that is unloaded fails that read and one that is replaced
+ * by another image has a different header, in both cases the index is
+ * dropped. Modules whose export data can't be read in bulk (paged out, or
+ * tables outside of the export directory) are resolved without an index.
+ */
+
+#define EXPORT_INDEX_MAX_SIZE   (32ul << 20)
+#define EXPORT_INDEX_MAX_COUNT  256
+
+typedef struct export_index_key {
+    addr_t dtb;
+    addr_t base;
+} export_index_key_t;
+
+typedef struct export_entry {
+    uint32_t rva;
+    uint32_t name_index;    /**< position in the name pointer table */
+    const char *name;
+} export_entry_t;
+
+typedef struct export_index {
+    struct export_table et;
+    addr_t et_rva;
+    size_t et_size;
+
+    bool usable;            /**< false if the exports couldn't be indexed */
+    uint8_t *data;          /**< copy of the export directory, names point into it */
+    GHashTable *by_name;    /**< name -> export_entry_t */
+    export_entry_t *by_rva;
+    uint32_t count;
+} export_index_t;
+
+static guint
+export_index_key_hash(
+    gconstpointer key)
+{
+    const export_index_key_t *k = key;
+
+    return g_int64_hash(&k->dtb) ^ g_int64_hash(&k->base);
+}
+
+static gboolean
+export_index_key_equal(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const export_index_key_t *ka = a, *kb = b;
+
+    return ka->dtb == kb->dtb && ka->base == kb->base;
+}
+
+static void
+export_index_free(
+    gpointer data)
+{
+    export_index_t *index = data;
+
+    if (index->by_name)
+        g_hash_table_destroy(index->by_name);
+    g_free(index->by_rva);
+    g_free(index->data);
+    g_free(index);
+}
+
+static gint
+compare_export_rva(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const export_entry_t *ea = a, *eb = b;
+
+    if (ea->rva != eb->rva)
+        return ea->rva < eb->rva ? -1 : 1;
+
+    return ea->name_index < eb->name_index ? -1 : ea->name_index > eb->name_index;
+}
+
+/* Pointer to [rva, rva + len) of the image within the export directory copy */
+static const void *
+export_index_ptr(
+    const export_index_t *index,
+    addr_t rva,
+    size_t len)
+{
+    if (rva < index->et_rva || rva - index->et_rva > index->et_size ||
+            len > index->et_size - (rva - index->et_rva))
+        return NULL;
+
+    return index->data + (rva - index->et_rva);
+}
+
+static void
+export_index_build(
+    vmi_instance_t vmi,
+    const access_context_t *ctx,
+    export_index_t *index)
+{
+    access_context_t _ctx = *ctx;
+    const struct export_table *et = &index->et;
+    const uint32_t *names, *functions;
+    const uint16_t *ordinals;
+    const char *name;
+    export_entry_t *entry, *found;
+    size_t max_len;
+    uint32_t i;
+
+    if (!index->et_size || index->et_size > EXPORT_INDEX_MAX_SIZE)
+        return;
+
+    index->data = g_try_malloc(index->et_size);
+    if (!index->data)
+        return;
+
+    _ctx.addr = ctx->addr + index->et_rva;
+    if (VMI_FAILURE == vmi_read(vmi, &_ctx, index->et_size, index->data, NULL)) {
+        dbprint(VMI_DEBUG_PEPARSE, "--PEParse: export directory of 0x%"PRIx64" is not fully readable\n", ctx->addr);
+        return;
+    }
+
+    names = export_index_ptr(index, et->address_of_names, (size_t) et->number_of_names * sizeof(uint32_t));
+    ordinals = export_index_ptr(index, et->address_of_name_ordinals, (size_t) et->number_of_names * sizeof(uint16_t));
+    functions = export_index_ptr(index, et->address_of_functions, (size_t) et->number_of_functions * sizeof(uint32_t));
+    if (!names || !ordinals || !functions) {
+        dbprint(VMI_DEBUG_PEPARSE, "--PEParse: export tables of 0x%"PRIx64" are outside the export directory\n", ctx->addr);
+        return;
+    }
+
+    index->by_name = g_hash_table_new(g_str_hash, g_str_equal);
+    index->by_rva = g_try_malloc0((et->number_of_names + 1) * sizeof(export_entry_t));
+    if (!index->by_rva)
+        return;
+
+    for (i = 0; i < et->number_of_names; i++) {
+        if (ordinals[i] >= et->number_of_functions)
+            continue;
+
+        name = export_index_ptr(index, names[i], 1);
+        if (!name)
+            continue;
+
+        max_len = index->et_size - (names[i] - index->et_rva);
+        if (strnlen(name, max_len) == max_len)
+            continue;
+
+        entry = &index->by_rva[index->count++];
+        entry->rva = functions[ordinals[i]];
+        entry->name_index = i;
+        entry->name = name;
+    }
+
+    qsort(index->by_rva, index->count, sizeof(export_entry_t), compare_export_rva);
+
+    /* the first name in the name pointer table wins, as with the table walk */
+    for (i = 0; i < index->count; i++) {
+        entry = &index->by_rva[i];
+        found = g_hash_table_lookup(index->by_name, entry->name);
+        if (!found || found->name_index > entry->name_index)
+            g_hash_table_insert(index->by_name, (gpointer) entry->name, entry);
+    }
+
+    index->usable = true;
+
+    dbprint(VMI_DEBUG_PEPARSE, "--PEParse: indexed %u exports of 0x%"PRIx64"\n", index->count, ctx->addr);
+}
+
+static bool
+export_index_dtb(
+    vmi_instance_t vmi,
+    const access_context_t *ctx,
+    addr_t *dtb)
+{
+    switch (ctx->translate_mechanism) {
+        case VMI_TM_PROCESS_PID:
+            return VMI_SUCCESS == vmi_pid_to_dtb(vmi, ctx->pid, dtb);
+        case VMI_TM_PROCESS_DTB:
+            *dtb = ctx->dtb;
+            return true;
+        default:
+            return false;
+    };
+}
+
+/* Finds or builds the index, called with the export lock held */
+static export_index_t *
+export_index_lookup(
+    vmi_instance_t vmi,
+    const access_context_t *ctx,
+    const export_index_key_t *key)
+{
+    windows_instance_t windows = vmi->os_data;
+    access_context_t _ctx = *ctx;
+    export_index_key_t *new_key;
+    export_index_t *index;
+    struct export_table et;
+    addr_t et_rva;
+    size_t et_size;
+
+    if (!windows->export_indexes)
+        windows->export_indexes = g_hash_table_new_full(export_index_key_hash, export_index_key_equal,
+                                  g_free, export_index_free);
+
+    index = g_hash_table_lookup(windows->export_indexes, key);
+    if (index) {
+        /* skip the reserved first field, it may sit on an unmapped page */
+        _ctx.addr = ctx->addr + index->et_rva + 4;
+        if (VMI_SUCCESS == vmi_read(vmi, &_ctx, sizeof(et) - 4, (uint8_t *) &et + 4, NULL) &&
+                !memcmp((uint8_t *) &et + 4, (uint8_t *) &index->et + 4, sizeof(et) - 4))
+            return index;
+
+        dbprint(VMI_DEBUG_PEPARSE, "--PEParse: export index of 0x%"PRIx64" is stale\n", ctx->addr);
+        g_hash_table_remove(windows->export_indexes, key);
+    }
+
+    if (VMI_FAILURE == peparse_get_export_table(vmi, ctx, &et, &et_rva, &et_size))
+        return NULL;
+
+    if (g_hash_table_size(windows->export_indexes) >= EXPORT_INDEX_MAX_COUNT)
+        g_hash_table_remove_all(windows->export_indexes);
+
+    index = g_try_malloc0(sizeof(export_index_t));
+    new_key = g_try_malloc(sizeof(export_index_key_t));
+    if (!index || !new_key) {
+        g_free(index);
+        g_free(new_key);
+        return NULL;
+    }
+
+    index->et = et;
+    index->et_rva = et_rva;
+    index->et_size = et_size;
+    export_index_build(vmi, ctx, index);
+
+    *new_key = *key;
+    g_hash_table_insert(windows->export_indexes, new_key, index);
+
+    return index;
+}
+
+/*
+ * Returns the export index of the module at ctx->addr, building it if needed.
+ * In concurrent mode the indexes stay locked while one is returned, so it
+ * can't be dropped while in use; hand it back with export_index_put.
+ */
+static export_index_t *
+export_index_get(
+    vmi_instance_t vmi,
+    const access_context_t *ctx)
+{
+    windows_instance_t windows = vmi->os_data;
+    export_index_key_t key = { 0 };
+    export_index_t *index;
+
+    if (VMI_OS_WINDOWS != vmi->os_type || !windows || !export_index_dtb(vmi, ctx, &key.dtb))
+        return NULL;
+
+    key.base = ctx->addr;
+
+    vmi_lock(vmi, &windows->export_lock);
+
+    index = export_index_lookup(vmi, ctx, &key);
+    if (!index)
+        vmi_unlock(vmi, &windows->export_lock);
+
+    return index;
+}
+
+static void
+export_index_put(
+    vmi_instance_t vmi)
+{
+    windows_instance_t windows = vmi->os_data;
+
+    vmi_unlock(vmi, &windows->export_lock);
+}
+
+static status_t
+export_index_to_rva(
+    export_index_t *index,
+    const char *symbol,
+    addr_t *rva)
+{
+    const export_entry_t *entry = g_hash_table_lookup(index->by_name, symbol);
+
+    if (!entry) {
+        dbprint(VMI_DEBUG_PEPARSE, "--PEParse: %s is not exported\n", symbol);
+        return VMI_FAILURE;
+    }
+
+    if (entry->rva >= index->et_rva && entry->rva < index->et_rva + index->et_size) {
+        dbprint(VMI_DEBUG_PEPARSE, "--PEParse: %s is forwarded\n", symbol);
+        return VMI_FAILURE;
+    }
+
+    *rva = entry->rva;
+    return VMI_SUCCESS;
+}
+
+static char *
+export_index_to_export(
+    export_index_t *index,
+    addr_t rva)
+{
+    uint32_t low = 0, high = index->count, mid;
+
+    /* first entry for the RVA, which has the lowest name index */
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (index->by_rva[mid].rva < rva)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low == index->count || index->by_rva[low].rva != rva)
+        return NULL;
+
+    return strdup(index->by_rva[low].name);
+}
+
 /* returns the rva value for a windows PE export */
 status_t
 windows_export_to_rva(
@@ -507,6 +837,17 @@ windows_export_to_rva(
     size_t et_size;
     int aon_index = -1;
     int aof_index = -1;
+    export_index_t *index = export_index_get(vmi, ctx);
+    status_t ret;
+
+    if (index && index->usable) {
+        ret = export_index_to_rva(index, symbol, rva);
+        export_index_put(vmi);
+        return ret;
+    }
+
+    if (index)
+        export_index_put(vmi);
 
     // get export table structure
     if (peparse_get_export_table(vmi, ctx, &et, &et_rva, &et_size) != VMI_SUCCESS) {
@@ -556,6 +897,21 @@ windows_rva_to_export(
     struct export_table et;
     addr_t et_rva;
     size_t et_size;
+    export_index_t *index = export_index_get(vmi, ctx);
+    char *export = NULL;
+
+    if (index && index->usable) {
+        if (rva >= index->et_rva && rva < index->et_rva + index->et_size)
+            dbprint(VMI_DEBUG_PEPARSE, "--PEParse: symbol @ 0x%"PRIx64" is forwarded\n", ctx->addr+rva);
+        else
+            export = export_index_to_export(index, rva);
+
+        export_index_put(vmi);
+        return export;
+    }
+
+    if (index)
+        export_index_put(vmi);
 
     // get export table structure
     if (peparse_get_export_table(vmi, ctx, &et, &et_rva, &et_size) != VMI_SUCCESS) {
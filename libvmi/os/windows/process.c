@@ -374,3 +374,81 @@ windows_find_eprocess_list_pgd(
     return find_eprocess(vmi, pdbase_offset, len, &pgd);
 }
 
+
+/* EPROCESS->ImageFileName is 15 bytes */
+#define WINDOWS_IMAGE_NAME_LEN 15
+
+/*
+ * Walks PsActiveProcessHead reading EPROCESS->ActiveProcessLinks,
+ * ->UniqueProcessId, ->InheritedFromUniqueProcessId, ->ImageFileName and
+ * ->Pcb.DirectoryTableBase with one read per process.
+ */
+status_t
+windows_process_list(
+    vmi_instance_t vmi,
+    GArray *procs)
+{
+    status_t ret = VMI_FAILURE;
+    windows_instance_t windows = vmi->os_data;
+    uint8_t *buf = NULL;
+    uint8_t width = vmi_get_address_width(vmi);
+    addr_t list_head = 0, entry = 0, ppid_offset = 0, lo, hi;
+    size_t name_len = MIN(WINDOWS_IMAGE_NAME_LEN, VMI_PROCESS_NAME_LEN - 1);
+    uint64_t next, dtb;
+
+    if (!windows || !width)
+        return VMI_FAILURE;
+
+    if ( VMI_FAILURE == vmi_translate_ksym2v(vmi, "PsActiveProcessHead", &list_head) ||
+            VMI_FAILURE == vmi_read_addr_va(vmi, list_head, 0, &entry) )
+        return VMI_FAILURE;
+
+    lo = MIN(windows->tasks_offset, MIN(windows->pdbase_offset, windows->pid_offset));
+    hi = MAX(windows->tasks_offset + width,
+             MAX(windows->pdbase_offset + width, windows->pid_offset + sizeof(vmi_pid_t)));
+
+    if (windows->pname_offset) {
+        lo = MIN(lo, windows->pname_offset);
+        hi = MAX(hi, windows->pname_offset + name_len);
+    }
+
+    if (VMI_SUCCESS == json_profile_lookup(vmi, "_EPROCESS", "InheritedFromUniqueProcessId", &ppid_offset)) {
+        lo = MIN(lo, ppid_offset);
+        hi = MAX(hi, ppid_offset + sizeof(vmi_pid_t));
+    }
+
+    buf = g_try_malloc0(hi - lo);
+    if (!buf)
+        return VMI_FAILURE;
+
+    while (entry != list_head) {
+        os_process_t proc = { .info.addr = entry - windows->tasks_offset, .info.ppid = -1 };
+
+        if (!entry || procs->len >= OS_PROCESS_LIST_MAX)
+            goto done;
+
+        if ( VMI_FAILURE == vmi_read_va(vmi, proc.info.addr + lo, 0, hi - lo, buf, NULL) )
+            goto done;
+
+        next = dtb = 0;
+        memcpy(&next, buf + windows->tasks_offset - lo, width);
+        memcpy(&dtb, buf + windows->pdbase_offset - lo, width);
+        memcpy(&proc.info.pid, buf + windows->pid_offset - lo, sizeof(vmi_pid_t));
+        proc.info.dtb = dtb;
+
+        if (ppid_offset)
+            memcpy(&proc.info.ppid, buf + ppid_offset - lo, sizeof(vmi_pid_t));
+
+        if (windows->pname_offset)
+            memcpy(proc.info.name, buf + windows->pname_offset - lo, name_len);
+
+        g_array_append_val(procs, proc);
+        entry = next;
+    }
+
+    ret = VMI_SUCCESS;
+
+done:
+    g_free(buf);
+    return ret;
+}
@@ -52,6 +52,10 @@ struct windows_instance {
     uint16_t major; /**< Windows major number */
 
     uint16_t minor; /**< Windows minor number */
+
+    GHashTable *export_indexes; /**< (dtb, module base) -> PE export index, see peparse.c */
+
+    pthread_mutex_t export_lock; /**< protects export_indexes in concurrent mode */
 };
 typedef struct windows_instance *windows_instance_t;
 
@@ -73,6 +77,8 @@ windows_export_to_rva(vmi_instance_t vmi, const access_context_t *ctx,
 char*
 windows_rva_to_export(vmi_instance_t vmi, addr_t rva, const access_context_t *ctx);
 
+status_t windows_clone(vmi_instance_t vmi, vmi_instance_t clone);
+
 status_t windows_teardown(vmi_instance_t vmi);
 
 typedef int (*check_magic_func)(uint32_t);
@@ -81,6 +87,7 @@ addr_t windows_find_eprocess(vmi_instance_t instance, const char *name);
 addr_t eprocess_list_search(vmi_instance_t vmi, addr_t list_head, int offset, size_t len, void *value);
 addr_t windows_find_eprocess_list_pid(vmi_instance_t vmi, vmi_pid_t pid);
 addr_t windows_find_eprocess_list_pgd(vmi_instance_t vmi, addr_t pgd);
+status_t windows_process_list(vmi_instance_t vmi, GArray *procs);
 
 status_t init_from_kdbg(vmi_instance_t vmi);
 status_t windows_kdbg_lookup(vmi_instance_t vmi, const char *symbol, addr_t *address);
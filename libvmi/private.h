@@ -40,6 +40,7 @@
 #include <ctype.h>
 #include <time.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include "libvmi.h"
 #define LIBVMI_EXTRA_GLIB
 #ifdef ENABLE_JSON_PROFILES
@@ -66,6 +67,12 @@ typedef enum vm_type {
 
 #include "driver/driver_interface.h"
 
+typedef struct process_index process_index_t;
+typedef struct init_cache init_cache_t;
+typedef struct translation_cache translation_cache_t;
+typedef struct translation_threads translation_threads_t;
+typedef struct stats_threads stats_threads_t;
+
 /**
  * @brief LibVMI Instance.
  *
@@ -76,16 +83,20 @@ typedef enum vm_type {
  */
 struct vmi_instance {
 
-    vmi_mode_t mode;        /**< VMI_FILE, VMI_XEN, VMI_KVM, VMI_BAREFLANK */
+    vmi_mode_t mode;        /**< VMI_FILE, VMI_XEN, VMI_KVM, VMI_BAREFLANK, VMI_MEM */
 
     driver_interface_t driver; /**< The driver supporting the chosen mode */
 
     uint32_t init_flags;    /**< init flags (events, etc.) */
 
+    bool concurrent;        /**< VMI_INIT_CONCURRENT, the caches are locked */
+
     char *image_type;       /**< image type that we are accessing */
 
     char *image_type_complete;  /**< full path for file images */
 
+    char *init_cache_dir;   /**< directory of the persistent OS init cache, NULL if disabled */
+
     uint32_t page_shift;    /**< page shift for last mapped page */
 
     uint32_t page_size;     /**< page size for last mapped page */
@@ -134,20 +145,38 @@ struct vmi_instance {
 
     GHashTable *pid_cache;  /**< hash table to hold the PID cache data */
 
+    pthread_mutex_t pid_cache_lock; /**< taken in concurrent mode */
+
+    process_index_t *process_index; /**< PID and DTB index of the process list */
+
+    GArray *init_methods;   /**< vmi_init_method_t, the heuristics that won during the OS init */
+
+    int *heuristics_cancel; /**< set once another heuristic won, see os/heuristics.c */
+
+    vmi_stats_t stats;      /**< counters, of exited threads only in concurrent mode */
+
+    vmi_stats_t stats_baseline; /**< counter values at the last vmi_reset_stats */
+
+    stats_threads_t *stats_threads; /**< per-thread counters in concurrent mode */
+
     GHashTable *sym_cache;  /**< hash table to hold the sym cache data */
 
+    pthread_mutex_t sym_cache_lock; /**< taken in concurrent mode */
+
     GHashTable *rva_cache;  /**< hash table to hold the rva cache data */
 
-    GHashTable *v2p_cache;  /**< hash table to hold the v2p cache data */
+    pthread_mutex_t rva_cache_lock; /**< taken in concurrent mode */
 
-#ifdef ENABLE_PAGE_CACHE
-    GHashTable *memory_cache;  /**< hash table for memory cache */
+    translation_cache_t *translation_cache; /**< v2p and paging-structure caches */
 
-    GQueue *memory_cache_lru;  /**< queue holding the most recently used pages */
+    translation_threads_t *translation_threads; /**< per-thread translation caches in concurrent mode */
 
-    uint32_t memory_cache_age; /**< max age of memory cache entry */
+    uint32_t v2p_epoch;     /**< v2p cache entries from older epochs are invalid */
 
-    uint32_t memory_cache_size_max;/**< max size of memory cache */
+    uint32_t v2p_generation; /**< per-thread translation caches from older generations are flushed */
+
+#ifdef ENABLE_PAGE_CACHE
+    struct memory_cache *memory_cache; /**< sharded page cache */
 #else
     void *last_used_page;   /**< the last used page */
 
@@ -160,6 +189,8 @@ struct vmi_instance {
 
     unsigned int num_vcpus; /**< number of VCPUs used by this instance */
 
+    pthread_mutex_t events_lock; /**< recursive, serializes the event API in concurrent mode */
+
     vmi_event_t *guest_requested_event; /**< Handler of guest-requested events */
 
     vmi_event_t *cpuid_event; /**< Handler of CPUID events */
@@ -201,6 +232,8 @@ struct vmi_instance {
     void *(*get_data_callback) (vmi_instance_t, addr_t, uint32_t); /**< memory_cache function */
 
     void (*release_data_callback) (vmi_instance_t, void *, size_t); /**< memory_cache function */
+
+    void (*get_data_batch_callback) (vmi_instance_t, const addr_t *, void **, uint32_t, uint32_t); /**< optional memory_cache function */
 };
 
 /** Event singlestep reregister wrapper */
@@ -253,6 +286,68 @@ addr_t canonical_addr(addr_t va)
     return VMI_GET_BIT(va, 47) ? (va | 0xffff000000000000) : va;
 }
 
+/* Shared state is only locked for instances initialized with VMI_INIT_CONCURRENT */
+static inline
+void vmi_lock(vmi_instance_t vmi, pthread_mutex_t *lock)
+{
+    if (vmi->concurrent)
+        pthread_mutex_lock(lock);
+}
+
+static inline
+void vmi_unlock(vmi_instance_t vmi, pthread_mutex_t *lock)
+{
+    if (vmi->concurrent)
+        pthread_mutex_unlock(lock);
+}
+
+/*----------------------------------------------
+ * stats.c
+ */
+void stats_init(
+    vmi_instance_t vmi);
+void stats_destroy(
+    vmi_instance_t vmi);
+vmi_stats_t *stats_thread_get(
+    vmi_instance_t vmi);
+
+/* The counters of the calling thread */
+static inline
+vmi_stats_t *stats_get(vmi_instance_t vmi)
+{
+    return vmi->stats_threads ? stats_thread_get(vmi) : &vmi->stats;
+}
+
+/* Only the owning thread writes a counter, vmi_get_stats may read it anytime */
+static inline
+void stats_counter_add(uint64_t *counter, uint64_t n)
+{
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+#define stats_add(vmi, counter, n)  stats_counter_add(&stats_get(vmi)->counter, (n))
+#define stats_inc(vmi, counter)     stats_add(vmi, counter, 1)
+
+/* Monotonic clock in nanoseconds, for the time spent in the driver */
+static inline
+uint64_t stats_clock(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/* Runs the callback of an event, counting it */
+static inline
+event_response_t vmi_event_callback(vmi_instance_t vmi, vmi_event_t *event)
+{
+    if (event->type < VMI_STATS_EVENT_TYPES)
+        stats_inc(vmi, events_handled[event->type]);
+
+    return event->callback(vmi, event);
+}
+
 /*----------------------------------------------
  * convenience.c
  */
@@ -299,6 +394,7 @@ int is_addr_aligned(
 
 void free_gint(gpointer p);
 void free_gint64(gpointer p);
+void mutex_init_recursive(pthread_mutex_t *lock);
 
 /*-------------------------------------
  * accessors.c
@@ -313,6 +409,53 @@ status_t vmi_pagetable_lookup_cache(
     addr_t vaddr,
     addr_t *paddr);
 
+status_t vmi_nested_pagetable_lookup_size(
+    vmi_instance_t vmi,
+    addr_t npt,
+    page_mode_t npm,
+    addr_t pt,
+    page_mode_t pm,
+    addr_t vaddr,
+    addr_t *paddr,
+    addr_t *naddr,
+    page_size_t *size);
+
+/*-----------------------------------------
+ * init_cache.c
+ */
+init_cache_t *init_cache_load(
+    vmi_instance_t vmi,
+    GHashTable *config);
+GHashTable *init_cache_config(
+    init_cache_t *cache);
+bool init_cache_validate(
+    vmi_instance_t vmi,
+    init_cache_t *cache);
+void init_cache_free(
+    init_cache_t *cache);
+void init_cache_store(
+    vmi_instance_t vmi);
+
+/*-----------------------------------------
+ * process_index.c
+ */
+void process_index_init(
+    vmi_instance_t vmi);
+void process_index_destroy(
+    vmi_instance_t vmi);
+void process_index_invalidate(
+    vmi_instance_t vmi);
+status_t process_index_refresh(
+    vmi_instance_t vmi);
+status_t process_index_pid_to_dtb(
+    vmi_instance_t vmi,
+    vmi_pid_t pid,
+    addr_t *dtb);
+status_t process_index_dtb_to_pid(
+    vmi_instance_t vmi,
+    addr_t dtb,
+    vmi_pid_t *pid);
+
 /*-----------------------------------------
  * strmatch.c
  */
@@ -322,7 +465,7 @@ void *boyer_moore_init(
     int m);
 int boyer_moore2(
     void *bm,
-    unsigned char *y,
+    const unsigned char *y,
     int n);
 void boyer_moore_fini(
     void *bm);
@@ -333,6 +476,23 @@ int boyer_moore(
     unsigned char *y,
     int n);
 
+typedef struct {
+    size_t offset;          /**< offset of the first byte of the match */
+    unsigned int pattern;   /**< index of the matching pattern */
+} strmatch_hit_t;
+
+void *aho_corasick_init(
+    const scan_pattern_t *patterns,
+    unsigned int count);
+void aho_corasick_search(
+    void *ac,
+    const unsigned char *y,
+    size_t n,
+    size_t min_end,
+    GArray *hits);
+void aho_corasick_fini(
+    void *ac);
+
 /*----------------------------------------------
  * events.c
  */
@@ -377,10 +537,9 @@ win_ver_t find_windows_version(
     addr_t kdbg);
 
 #ifdef ENABLE_JSON_PROFILES
-#define json_profile(vmi) (vmi->json.root)
-#define json_profile_lookup(vmi, ...) (vmi->json.handler ? \
-        vmi->json.handler(vmi->json.root, __VA_ARGS__, NULL) : \
-        VMI_FAILURE)
+#define json_profile(vmi) (vmi->json.root || vmi->json.binary)
+#define json_profile_lookup(vmi, ...) \
+        json_profile_query(vmi, vmi->json.root, __VA_ARGS__, NULL)
 #else
 #define json_profile(...) NULL
 #define json_profile_lookup(...) VMI_FAILURE
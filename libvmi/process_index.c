@@ -0,0 +1,344 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "private.h"
+
+/*
+ * Process index.
+ *
+ * Resolves PIDs and DTBs with a hash lookup instead of a walk of the guest's
+ * process list. The OS builds the index with one read per process, and it is
+ * refreshed when a lookup misses, before the first lookup of a new v2p cache
+ * epoch (see vmi_resume_vm) and on request. A refresh walks the list again
+ * and reads the dtbs of all processes in one batch; a CR3 write event for a
+ * process the index has seen costs a single lookup.
+ *
+ * OSes without an os_process_list, and a walk that fails, fall back to the
+ * per-lookup walks of os_pid_to_pgd and os_pgd_to_pid.
+ *
+ * In concurrent mode the index is locked while it is used or rebuilt. The
+ * lock is recursive, a walk may resolve addresses through the index again.
+ */
+
+struct process_index {
+    GArray *procs;          /**< os_process_t in list order, NULL if not built */
+    GHashTable *by_addr;    /**< task address -> entry in procs */
+    GHashTable *by_pid;     /**< pid -> entry in procs */
+    GHashTable *by_dtb;     /**< dtb -> entry in procs */
+    bool stale;             /**< refresh before the next lookup */
+    pthread_mutex_t lock;   /**< taken in concurrent mode */
+};
+
+void
+process_index_init(
+    vmi_instance_t vmi)
+{
+    process_index_t *index = g_malloc0(sizeof(process_index_t));
+
+    index->by_addr = g_hash_table_new(g_int64_hash, g_int64_equal);
+    index->by_pid = g_hash_table_new(g_int_hash, g_int_equal);
+    index->by_dtb = g_hash_table_new(g_int64_hash, g_int64_equal);
+    index->stale = true;
+    mutex_init_recursive(&index->lock);
+
+    vmi->process_index = index;
+}
+
+static void
+process_index_clear(
+    process_index_t *index)
+{
+    g_hash_table_remove_all(index->by_addr);
+    g_hash_table_remove_all(index->by_pid);
+    g_hash_table_remove_all(index->by_dtb);
+
+    if (index->procs)
+        g_array_free(index->procs, TRUE);
+    index->procs = NULL;
+}
+
+void
+process_index_destroy(
+    vmi_instance_t vmi)
+{
+    process_index_t *index = vmi->process_index;
+
+    if (!index)
+        return;
+
+    process_index_clear(index);
+    g_hash_table_destroy(index->by_addr);
+    g_hash_table_destroy(index->by_pid);
+    g_hash_table_destroy(index->by_dtb);
+    pthread_mutex_destroy(&index->lock);
+    g_free(index);
+
+    vmi->process_index = NULL;
+}
+
+void
+process_index_invalidate(
+    vmi_instance_t vmi)
+{
+    process_index_t *index = vmi->process_index;
+
+    if (!index)
+        return;
+
+    vmi_lock(vmi, &index->lock);
+    index->stale = true;
+    vmi_unlock(vmi, &index->lock);
+}
+
+/* Where two processes share a key, the first one in list order wins */
+static inline void
+process_index_insert(
+    GHashTable *table,
+    gpointer key,
+    os_process_t *proc)
+{
+    if (!g_hash_table_lookup(table, key))
+        g_hash_table_insert(table, key, proc);
+}
+
+/* Lock held */
+static status_t
+process_index_rebuild(
+    vmi_instance_t vmi,
+    process_index_t *index)
+{
+    GArray *procs;
+    os_process_t *proc, *parent;
+    guint i;
+
+    if (!vmi->os_interface || !vmi->os_interface->os_process_list)
+        return VMI_FAILURE;
+
+    procs = g_array_new(FALSE, FALSE, sizeof(os_process_t));
+
+    if ( VMI_FAILURE == vmi->os_interface->os_process_list(vmi, procs) ) {
+        dbprint(VMI_DEBUG_PIDCACHE, "--process index: walking the process list failed\n");
+        g_array_free(procs, TRUE);
+        process_index_clear(index);
+        index->stale = true;
+        return VMI_FAILURE;
+    }
+
+    process_index_clear(index);
+    index->procs = procs;
+    index->stale = false;
+
+    for (i = 0; i < procs->len; i++) {
+        proc = &g_array_index(procs, os_process_t, i);
+
+        process_index_insert(index->by_addr, &proc->info.addr, proc);
+        process_index_insert(index->by_pid, &proc->info.pid, proc);
+
+        /* a borrowed dtb identifies the task it belongs to, not this one */
+        if (proc->info.dtb && !(proc->info.flags & VMI_PROCESS_KERNEL_THREAD))
+            process_index_insert(index->by_dtb, &proc->info.dtb, proc);
+    }
+
+    for (i = 0; i < procs->len; i++) {
+        proc = &g_array_index(procs, os_process_t, i);
+
+        if (proc->parent && proc->info.ppid == -1) {
+            parent = g_hash_table_lookup(index->by_addr, &proc->parent);
+            if (parent)
+                proc->info.ppid = parent->info.pid;
+        }
+    }
+
+    dbprint(VMI_DEBUG_PIDCACHE, "--process index: %u processes\n", procs->len);
+    return VMI_SUCCESS;
+}
+
+status_t
+process_index_refresh(
+    vmi_instance_t vmi)
+{
+    process_index_t *index = vmi->process_index;
+    status_t ret;
+
+    if (!index)
+        return VMI_FAILURE;
+
+    vmi_lock(vmi, &index->lock);
+    ret = process_index_rebuild(vmi, index);
+    vmi_unlock(vmi, &index->lock);
+
+    return ret;
+}
+
+static os_process_t *
+process_index_find_dtb(
+    vmi_instance_t vmi,
+    process_index_t *index,
+    addr_t dtb)
+{
+    os_process_t *proc;
+
+    if (vmi->page_mode == VMI_PM_LEGACY || vmi->page_mode == VMI_PM_PAE)
+        dtb &= 0xffffffffull;
+
+    proc = g_hash_table_lookup(index->by_dtb, &dtb);
+
+    /*
+     * Linux with KPTI runs userspace on the pgd following the kernel one, and
+     * with PCID the low bits of CR3 are not part of the address.
+     */
+    if (!proc && VMI_OS_LINUX == vmi->os_type) {
+        dtb &= ~0x1fffull;
+        proc = g_hash_table_lookup(index->by_dtb, &dtb);
+    }
+
+    return proc;
+}
+
+/*
+ * Looks up a process by PID (dtb == NULL) or by DTB, refreshing the index
+ * when it is stale or misses. Lock held. Returns false if the index could
+ * not be built.
+ */
+static bool
+process_index_lookup(
+    vmi_instance_t vmi,
+    process_index_t *index,
+    vmi_pid_t pid,
+    const addr_t *dtb,
+    os_process_t **proc)
+{
+    bool refreshed = false;
+
+    if (index->stale) {
+        if ( VMI_FAILURE == process_index_rebuild(vmi, index) )
+            return false;
+        refreshed = true;
+    }
+
+    for (;;) {
+        if (dtb)
+            *proc = process_index_find_dtb(vmi, index, *dtb);
+        else
+            *proc = g_hash_table_lookup(index->by_pid, &pid);
+
+        if (*proc || refreshed)
+            return true;
+
+        if ( VMI_FAILURE == process_index_rebuild(vmi, index) )
+            return false;
+        refreshed = true;
+    }
+}
+
+status_t
+process_index_pid_to_dtb(
+    vmi_instance_t vmi,
+    vmi_pid_t pid,
+    addr_t *dtb)
+{
+    process_index_t *index = vmi->process_index;
+    os_process_t *proc = NULL;
+    status_t ret = VMI_FAILURE;
+    bool found = false;
+
+    if (index) {
+        vmi_lock(vmi, &index->lock);
+        found = process_index_lookup(vmi, index, pid, NULL, &proc);
+        if (found && proc && proc->info.dtb) {
+            *dtb = proc->info.dtb;
+            ret = VMI_SUCCESS;
+        }
+        vmi_unlock(vmi, &index->lock);
+    }
+
+    if (!found && vmi->os_interface && vmi->os_interface->os_pid_to_pgd)
+        return vmi->os_interface->os_pid_to_pgd(vmi, pid, dtb);
+
+    return ret;
+}
+
+status_t
+process_index_dtb_to_pid(
+    vmi_instance_t vmi,
+    addr_t dtb,
+    vmi_pid_t *pid)
+{
+    process_index_t *index = vmi->process_index;
+    os_process_t *proc = NULL;
+    status_t ret = VMI_FAILURE;
+    bool found = false;
+
+    if (index) {
+        vmi_lock(vmi, &index->lock);
+        found = process_index_lookup(vmi, index, 0, &dtb, &proc);
+        if (found && proc) {
+            *pid = proc->info.pid;
+            ret = VMI_SUCCESS;
+        }
+        vmi_unlock(vmi, &index->lock);
+    }
+
+    if (!found && vmi->os_interface && vmi->os_interface->os_pgd_to_pid)
+        return vmi->os_interface->os_pgd_to_pid(vmi, dtb, pid);
+
+    return ret;
+}
+
+status_t
+vmi_get_process_list(
+    vmi_instance_t vmi,
+    vmi_process_t **processes,
+    size_t *count)
+{
+    process_index_t *index;
+    vmi_process_t *list = NULL;
+    GArray *procs;
+    guint i;
+
+#ifdef ENABLE_SAFETY_CHECKS
+    if (!vmi || !processes || !count)
+        return VMI_FAILURE;
+#endif
+
+    index = vmi->process_index;
+    if (!index)
+        return VMI_FAILURE;
+
+    vmi_lock(vmi, &index->lock);
+
+    if ( VMI_FAILURE == process_index_rebuild(vmi, index) )
+        goto done;
+
+    procs = index->procs;
+    list = g_try_malloc0(MAX(procs->len, 1) * sizeof(vmi_process_t));
+    if (!list)
+        goto done;
+
+    for (i = 0; i < procs->len; i++)
+        list[i] = g_array_index(procs, os_process_t, i).info;
+
+    *processes = list;
+    *count = procs->len;
+
+done:
+    vmi_unlock(vmi, &index->lock);
+    return list ? VMI_SUCCESS : VMI_FAILURE;
+}
@@ -30,6 +30,7 @@
 
 #include "private.h"
 #include "driver/driver_wrapper.h"
+#include "driver/memory_cache.h"
 
 ///////////////////////////////////////////////////////////
 // Classic read functions for access to memory
@@ -148,6 +149,239 @@ done:
     return ret;
 }
 
+/*
+ * Work out the pagetable, page mode and start address for an access context.
+ */
+static status_t
+resolve_access_context(
+    vmi_instance_t vmi,
+    const access_context_t *ctx,
+    addr_t *pt,
+    page_mode_t *pm,
+    addr_t *start_addr)
+{
+    *pt = ctx->pt;
+    *pm = ctx->pm;
+    *start_addr = ctx->addr;
+
+    switch (ctx->tm) {
+        case VMI_TM_NONE:
+            *pm = VMI_PM_NONE;
+            *pt = 0;
+            break;
+        case VMI_TM_KERNEL_SYMBOL:
+#ifdef ENABLE_SAFETY_CHECKS
+            if (!vmi->os_interface || !vmi->kpgd)
+                return VMI_FAILURE;
+#endif
+            if ( VMI_FAILURE == vmi_translate_ksym2v(vmi, ctx->ksym, start_addr) )
+                return VMI_FAILURE;
+
+            *pt = vmi->kpgd;
+            if (!*pm)
+                *pm = vmi->page_mode;
+
+            break;
+        case VMI_TM_PROCESS_PID:
+#ifdef ENABLE_SAFETY_CHECKS
+            if (!vmi->os_interface)
+                return VMI_FAILURE;
+#endif
+
+            if ( !ctx->pid )
+                *pt = vmi->kpgd;
+            else if (ctx->pid > 0) {
+                if ( VMI_FAILURE == vmi_pid_to_dtb(vmi, ctx->pid, pt) )
+                    return VMI_FAILURE;
+            }
+            if (!*pm)
+                *pm = vmi->page_mode;
+            if (!*pt)
+                return VMI_FAILURE;
+            break;
+        case VMI_TM_PROCESS_DTB:
+            if (!*pm)
+                *pm = vmi->page_mode;
+            break;
+        default:
+            errprint("%s error: translation mechanism is not defined.\n", __FUNCTION__);
+            return VMI_FAILURE;
+    }
+
+#ifdef ENABLE_SAFETY_CHECKS
+    if (*pt && !valid_pm(*pm)) {
+        dbprint(VMI_DEBUG_READ, "--%s: pagetable specified with no page mode\n", __FUNCTION__);
+        return VMI_FAILURE;
+    }
+
+    if (ctx->npt && !valid_npm(ctx->npm)) {
+        dbprint(VMI_DEBUG_READ, "--%s: nested pagetable specified with no nested page mode\n", __FUNCTION__);
+        return VMI_FAILURE;
+    }
+#endif
+
+    return VMI_SUCCESS;
+}
+
+/*
+ * Translate an address of an access context to the physical address to read.
+ * If mapped is given it is set to the number of bytes from there to the end
+ * of the mapping, which are physically contiguous and need no translation of
+ * their own.
+ */
+static inline status_t
+translate_access(
+    vmi_instance_t vmi,
+    const access_context_t *ctx,
+    addr_t pt,
+    page_mode_t pm,
+    addr_t vaddr,
+    addr_t *paddr,
+    size_t *mapped)
+{
+    page_size_t size = 0;
+    addr_t naddr;
+
+    if (valid_pm(pm)) {
+        if (VMI_SUCCESS != vmi_nested_pagetable_lookup_size(vmi, ctx->npt, ctx->npm, pt, pm, vaddr, paddr, &naddr, &size))
+            return VMI_FAILURE;
+
+        if (valid_npm(ctx->npm)) {
+            dbprint(VMI_DEBUG_READ, "--Setting paddr to nested address 0x%lx\n", naddr);
+            *paddr = naddr;
+        }
+    } else {
+        *paddr = vaddr;
+
+        if (valid_npm(ctx->npm) && VMI_SUCCESS != vmi_nested_pagetable_lookup_size(vmi, 0, 0, ctx->npt, ctx->npm, vaddr, paddr, NULL, &size) )
+            return VMI_FAILURE;
+    }
+
+    if (mapped) {
+        /* physical addresses are not translated, they are all one mapping */
+        if (!size)
+            *mapped = SIZE_MAX;
+        else {
+            /* frames are the smallest unit read, even of smaller pages */
+            if (size < vmi->page_size)
+                size = vmi->page_size;
+            *mapped = size - (*paddr & (size - 1));
+        }
+    }
+
+    return VMI_SUCCESS;
+}
+
+#ifdef ENABLE_SAFETY_CHECKS
+static void
+check_access_context_version(
+    vmi_instance_t vmi,
+    const access_context_t *ctx,
+    const char *caller)
+{
+    if (ctx->version != ACCESS_CONTEXT_VERSION) {
+        if (!vmi->actx_version_warn_once)
+            errprint("--%s: access context version mismatch, please update your code\n", caller);
+        vmi->actx_version_warn_once = 1;
+
+        // TODO: for compatibility reasons we still accept code compiled
+        //       without the ABI version field initialized.
+        //       Turn this check into enforcement after appropriate amount of
+        //       time passed (in ~2023 or after).
+    }
+}
+#endif
+
+/*
+ * Max number of distinct frames handed to the driver in one batch. This
+ * keeps a batch well within the default page cache so the pages are still
+ * there by the time they are copied out.
+ */
+#define READ_BATCH_FRAMES 128
+
+/*
+ * In concurrent mode another thread can evict a cached page while it is
+ * being copied out, so the page is borrowed with a pin for the copy.
+ */
+static inline unsigned char *
+read_page_get(
+    vmi_instance_t vmi,
+    addr_t pfn,
+    page_pin_t *pin)
+{
+    *pin = NULL;
+
+    if (vmi->concurrent)
+        return memory_cache_pin(vmi, pfn << vmi->page_shift, pin);
+
+    return vmi_read_page(vmi, pfn);
+}
+
+/*
+ * Copy physically contiguous memory, such as the part of a read that falls
+ * within one large page. Frames are handed to the driver in batches when
+ * more than one is needed. Returns the number of bytes copied, which is less
+ * than count if a frame could not be read.
+ */
+static size_t
+read_contiguous(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    size_t count,
+    unsigned char *buf)
+{
+    addr_t frames[READ_BATCH_FRAMES];
+    addr_t pfn = paddr >> vmi->page_shift;
+    addr_t offset = (vmi->page_size - 1) & paddr;
+    size_t copied = 0;
+    size_t batched = 0;
+    size_t i;
+
+    while (copied < count) {
+        unsigned char *memory;
+        page_pin_t pin;
+        size_t read_len;
+
+        if (!batched) {
+            /* frames left to read, starting with this one */
+            batched = (offset + count - copied + vmi->page_size - 1) >> vmi->page_shift;
+            if (batched > READ_BATCH_FRAMES)
+                batched = READ_BATCH_FRAMES;
+
+            /* a failed batch is fine, vmi_read_page fetches what is missing */
+            if (batched > 1) {
+                for (i = 0; i < batched; i++)
+                    frames[i] = pfn + i;
+                (void) driver_read_pages(vmi, frames, batched);
+            }
+        }
+
+        /* access the memory */
+        dbprint(VMI_DEBUG_READ, "--Reading pfn 0x%lx\n", pfn);
+        memory = read_page_get(vmi, pfn, &pin);
+
+        if (NULL == memory)
+            break;
+
+        /* determine how much we can read */
+        read_len = vmi->page_size - offset;
+        if (read_len > count - copied)
+            read_len = count - copied;
+
+        /* do the read */
+        memcpy(buf + copied, memory + offset, read_len);
+        memory_cache_unpin(vmi, pin);
+
+        /* set variables for next loop */
+        copied += read_len;
+        offset = 0;
+        pfn++;
+        batched--;
+    }
+
+    return copied;
+}
+
 status_t
 vmi_read(
     vmi_instance_t vmi,
@@ -158,12 +392,8 @@ vmi_read(
 {
     status_t ret = VMI_FAILURE;
     size_t buf_offset = 0;
-    unsigned char *memory;
     addr_t start_addr;
     addr_t paddr;
-    addr_t naddr;
-    addr_t pfn;
-    addr_t offset;
     addr_t pt;
     page_mode_t pm;
 
@@ -183,126 +413,274 @@ vmi_read(
         goto done;
     }
 
-    if (ctx->version != ACCESS_CONTEXT_VERSION) {
-        if (!vmi->actx_version_warn_once)
-            errprint("--%s: access context version mismatch, please update your code\n", __FUNCTION__);
-        vmi->actx_version_warn_once = 1;
+    check_access_context_version(vmi, ctx, __FUNCTION__);
+#endif
 
-        // TODO: for compatibility reasons we still accept code compiled
-        //       without the ABI version field initialized.
-        //       Turn this check into enforcement after appropriate amount of
-        //       time passed (in ~2023 or after).
+    if (VMI_FAILURE == resolve_access_context(vmi, ctx, &pt, &pm, &start_addr))
+        goto done;
+
+    while (count > 0) {
+        size_t mapped, read_len;
+
+        if (VMI_FAILURE == translate_access(vmi, ctx, pt, pm, start_addr + buf_offset, &paddr, &mapped))
+            goto done;
+
+        /* the rest of the mapping is read without translating it again */
+        if (mapped > count)
+            mapped = count;
+
+        read_len = read_contiguous(vmi, paddr, mapped, ((unsigned char *) buf) + buf_offset);
+
+        /* set variables for next loop */
+        count -= read_len;
+        buf_offset += read_len;
+
+        if (read_len < mapped)
+            goto done;
     }
-#endif
 
-    // Set defaults
-    pt = ctx->pt;
-    pm = ctx->pm;
-    start_addr = ctx->addr;
+    ret = VMI_SUCCESS;
+
+done:
+    if ( bytes_read )
+        *bytes_read = buf_offset;
+
+    return ret;
+}
+
+status_t
+vmi_pin_page(
+    vmi_instance_t vmi,
+    const access_context_t *ctx,
+    const void **data,
+    size_t *length,
+    page_pin_t *pin)
+{
+    unsigned char *memory;
+    addr_t start_addr;
+    addr_t paddr;
+    addr_t offset;
+    addr_t pt;
+    page_mode_t pm;
 
-    switch (ctx->tm) {
-        case VMI_TM_NONE:
-            pm = VMI_PM_NONE;
-            pt = 0;
-            break;
-        case VMI_TM_KERNEL_SYMBOL:
 #ifdef ENABLE_SAFETY_CHECKS
-            if (!vmi->os_interface || !vmi->kpgd)
-                goto done;
+    if (NULL == vmi || NULL == ctx || NULL == data || NULL == pin) {
+        dbprint(VMI_DEBUG_READ, "--%s: invalid arguments, returning without pinning\n", __FUNCTION__);
+        return VMI_FAILURE;
+    }
+
+    check_access_context_version(vmi, ctx, __FUNCTION__);
 #endif
-            if ( VMI_FAILURE == vmi_translate_ksym2v(vmi, ctx->ksym, &start_addr) )
-                goto done;
 
-            pt = vmi->kpgd;
-            if (!pm)
-                pm = vmi->page_mode;
+    if (VMI_FAILURE == resolve_access_context(vmi, ctx, &pt, &pm, &start_addr))
+        return VMI_FAILURE;
 
-            break;
-        case VMI_TM_PROCESS_PID:
+    if (VMI_FAILURE == translate_access(vmi, ctx, pt, pm, start_addr, &paddr, NULL))
+        return VMI_FAILURE;
+
+    offset = (vmi->page_size - 1) & paddr;
+    memory = memory_cache_pin(vmi, paddr - offset, pin);
+    if (NULL == memory)
+        return VMI_FAILURE;
+
+    *data = memory + offset;
+    if (length)
+        *length = vmi->page_size - offset;
+
+    return VMI_SUCCESS;
+}
+
+void
+vmi_unpin_page(
+    vmi_instance_t vmi,
+    page_pin_t pin)
+{
 #ifdef ENABLE_SAFETY_CHECKS
-            if (!vmi->os_interface)
-                goto done;
+    if (NULL == vmi)
+        return;
 #endif
 
-            if ( !ctx->pid )
-                pt = vmi->kpgd;
-            else if (ctx->pid > 0) {
-                if ( VMI_FAILURE == vmi_pid_to_dtb(vmi, ctx->pid, &pt) )
-                    goto done;
-            }
-            if (!pm)
-                pm = vmi->page_mode;
-            if (!pt)
-                goto done;
-            break;
-        case VMI_TM_PROCESS_DTB:
-            if (!pm)
-                pm = vmi->page_mode;
-            break;
-        default:
-            errprint("%s error: translation mechanism is not defined.\n", __FUNCTION__);
-            goto done;
-    }
+    memory_cache_unpin(vmi, pin);
+}
+
+/* A piece of a read request that falls within a single frame */
+struct readv_chunk {
+    addr_t paddr;
+    size_t req;
+    size_t buf_offset;
+    size_t len;
+};
+
+static int
+readv_chunk_compare(
+    const void *a,
+    const void *b)
+{
+    const struct readv_chunk *ca = a;
+    const struct readv_chunk *cb = b;
+
+    if (ca->paddr != cb->paddr)
+        return ca->paddr < cb->paddr ? -1 : 1;
+
+    /* keep chunks of the same request in order */
+    if (ca->req != cb->req)
+        return ca->req < cb->req ? -1 : 1;
+
+    return 0;
+}
+
+status_t
+vmi_readv(
+    vmi_instance_t vmi,
+    read_request_t *reqs,
+    size_t num_reqs)
+{
+    status_t ret = VMI_SUCCESS;
+    struct readv_chunk *chunks = NULL;
+    addr_t *frames = NULL;
+    size_t max_chunks = 0, num_chunks = 0, num_frames = 0;
+    size_t i, c;
 
 #ifdef ENABLE_SAFETY_CHECKS
-    if (pt && !valid_pm(pm)) {
-        dbprint(VMI_DEBUG_READ, "--%s: pagetable specified with no page mode\n", __FUNCTION__);
-        goto done;
+    if (NULL == vmi) {
+        dbprint(VMI_DEBUG_READ, "--%s: vmi passed as NULL, returning without read\n", __FUNCTION__);
+        return VMI_FAILURE;
     }
 
-    if (ctx->npt && !valid_npm(ctx->npm)) {
-        dbprint(VMI_DEBUG_READ, "--%s: nested pagetable specified with no nested page mode\n", __FUNCTION__);
+    if (NULL == reqs && num_reqs) {
+        dbprint(VMI_DEBUG_READ, "--%s: reqs passed as NULL, returning without read\n", __FUNCTION__);
+        return VMI_FAILURE;
+    }
+#endif
+
+    for (i = 0; i < num_reqs; i++) {
+        reqs[i].bytes_read = 0;
+        max_chunks += reqs[i].count / vmi->page_size + 2;
+    }
+
+    if (!max_chunks)
+        return VMI_SUCCESS;
+
+    chunks = g_try_new(struct readv_chunk, max_chunks);
+    frames = g_try_new(addr_t, max_chunks);
+    if (!chunks || !frames) {
+        ret = VMI_FAILURE;
         goto done;
     }
+
+    /*
+     * Translate everything first. bytes_read is used as the point up to
+     * which a request can be satisfied and only ever shrinks from here.
+     */
+    for (i = 0; i < num_reqs; i++) {
+        read_request_t *req = &reqs[i];
+        size_t buf_offset = 0, mapped = 0;
+        addr_t start_addr, pt, paddr = 0;
+        page_mode_t pm;
+
+#ifdef ENABLE_SAFETY_CHECKS
+        if (NULL == req->ctx || NULL == req->buf) {
+            dbprint(VMI_DEBUG_READ, "--%s: request %zu has no ctx or buf\n", __FUNCTION__, i);
+            ret = VMI_FAILURE;
+            continue;
+        }
+
+        check_access_context_version(vmi, req->ctx, __FUNCTION__);
 #endif
 
-    while (count > 0) {
-        size_t read_len = 0;
+        if (VMI_FAILURE == resolve_access_context(vmi, req->ctx, &pt, &pm, &start_addr)) {
+            ret = VMI_FAILURE;
+            continue;
+        }
 
-        if (valid_pm(pm)) {
-            if (VMI_SUCCESS != vmi_nested_pagetable_lookup(vmi, ctx->npt, ctx->npm, pt, pm, start_addr + buf_offset, &paddr, &naddr))
-                goto done;
+        req->bytes_read = req->count;
 
-            if (valid_npm(ctx->npm)) {
-                dbprint(VMI_DEBUG_READ, "--Setting paddr to nested address 0x%lx\n", naddr);
-                paddr = naddr;
+        while (buf_offset < req->count) {
+            struct readv_chunk *chunk = &chunks[num_chunks];
+            addr_t offset;
+
+            /* translate once per mapping, the frames within follow each other */
+            if (!mapped && VMI_FAILURE == translate_access(vmi, req->ctx, pt, pm, start_addr + buf_offset, &paddr, &mapped)) {
+                req->bytes_read = buf_offset;
+                ret = VMI_FAILURE;
+                break;
             }
-        } else {
-            paddr = start_addr + buf_offset;
 
-            if (valid_npm(ctx->npm) && VMI_SUCCESS != vmi_nested_pagetable_lookup(vmi, 0, 0, ctx->npt, ctx->npm, paddr, &paddr, NULL) )
-                goto done;
-        }
+            offset = (vmi->page_size - 1) & paddr;
 
-        /* access the memory */
-        pfn = paddr >> vmi->page_shift;
-        dbprint(VMI_DEBUG_READ, "--Reading pfn 0x%lx\n", pfn);
+            chunk->paddr = paddr;
+            chunk->req = i;
+            chunk->buf_offset = buf_offset;
+            chunk->len = vmi->page_size - offset;
+            if (chunk->len > req->count - buf_offset)
+                chunk->len = req->count - buf_offset;
 
-        offset = (vmi->page_size - 1) & paddr;
-        memory = vmi_read_page(vmi, pfn);
+            buf_offset += chunk->len;
+            num_chunks++;
 
-        if (NULL == memory)
-            goto done;
+            paddr += chunk->len;
+            mapped -= chunk->len;
+        }
+    }
 
-        /* determine how much we can read */
-        if ((offset + count) > vmi->page_size)
-            read_len = vmi->page_size - offset;
-        else
-            read_len = count;
+    /* sort by frame and collect the distinct frames we need */
+    qsort(chunks, num_chunks, sizeof(struct readv_chunk), readv_chunk_compare);
 
-        /* do the read */
-        memcpy(((char *) buf) + (addr_t) buf_offset, memory + (addr_t) offset, read_len);
+    for (c = 0; c < num_chunks; c++) {
+        addr_t pfn = chunks[c].paddr >> vmi->page_shift;
 
-        /* set variables for next loop */
-        count -= read_len;
-        buf_offset += read_len;
+        if (!num_frames || frames[num_frames - 1] != pfn)
+            frames[num_frames++] = pfn;
     }
 
-    ret = VMI_SUCCESS;
+    dbprint(VMI_DEBUG_READ, "--%s: %zu requests, %zu chunks, %zu frames\n",
+            __FUNCTION__, num_reqs, num_chunks, num_frames);
+
+    c = 0;
+    for (i = 0; i < num_frames; i += READ_BATCH_FRAMES) {
+        size_t batch = num_frames - i;
+        addr_t last_pfn = ~0ull;
+        unsigned char *memory = NULL;
+        page_pin_t pin = NULL;
+
+        if (batch > READ_BATCH_FRAMES)
+            batch = READ_BATCH_FRAMES;
+
+        /* a failed batch is fine, vmi_read_page fetches what is missing */
+        (void) driver_read_pages(vmi, &frames[i], batch);
+
+        for (; c < num_chunks && (chunks[c].paddr >> vmi->page_shift) <= frames[i + batch - 1]; c++) {
+            struct readv_chunk *chunk = &chunks[c];
+            read_request_t *req = &reqs[chunk->req];
+            addr_t pfn = chunk->paddr >> vmi->page_shift;
+
+            /* nothing past a failed chunk counts as read */
+            if (chunk->buf_offset >= req->bytes_read)
+                continue;
+
+            if (pfn != last_pfn) {
+                memory_cache_unpin(vmi, pin);
+                memory = read_page_get(vmi, pfn, &pin);
+                last_pfn = pfn;
+            }
+
+            if (NULL == memory) {
+                req->bytes_read = chunk->buf_offset;
+                ret = VMI_FAILURE;
+                continue;
+            }
+
+            memcpy(((char *) req->buf) + chunk->buf_offset,
+                   memory + ((vmi->page_size - 1) & chunk->paddr),
+                   chunk->len);
+        }
+
+        memory_cache_unpin(vmi, pin);
+    }
 
 done:
-    if ( bytes_read )
-        *bytes_read = buf_offset;
+    g_free(chunks);
+    g_free(frames);
 
     return ret;
 }
@@ -0,0 +1,385 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "private.h"
+
+/*
+ * Memory scanning engine.
+ *
+ * The calling thread reads the range chunk by chunk through the regular
+ * read path (page cache, read-ahead and driver batching included) and
+ * queues every chunk for matching. Worker threads run the Aho-Corasick
+ * automaton over the chunks and never touch the LibVMI instance. Matches
+ * are handed back to the calling thread, which delivers them in address
+ * order as chunks complete.
+ *
+ * A chunk starts with the last (longest pattern - 1) bytes of the previous
+ * chunk when the two are contiguous, so matches crossing the boundary are
+ * found; only matches ending in the new part of a chunk are reported.
+ */
+
+#define SCAN_CHUNK_SIZE     (1ul << 20)
+#define SCAN_MAX_THREADS    64
+
+typedef struct scan_job {
+    addr_t addr;            /**< address of buf[0] */
+    unsigned char *buf;
+    size_t len;
+    size_t carry;           /**< leading bytes already scanned with the previous chunk */
+    GArray *hits;
+    bool done;
+} scan_job_t;
+
+typedef struct scan_pool {
+    void *ac;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    GQueue pending;
+    bool shutdown;
+
+    pthread_t threads[SCAN_MAX_THREADS];
+    unsigned int num_threads;
+} scan_pool_t;
+
+static void
+scan_job_run(
+    void *ac,
+    scan_job_t *job)
+{
+    aho_corasick_search(ac, job->buf, job->len, job->carry, job->hits);
+}
+
+static void *
+scan_worker(
+    void *arg)
+{
+    scan_pool_t *pool = (scan_pool_t *) arg;
+    scan_job_t *job;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->shutdown && g_queue_is_empty(&pool->pending))
+            pthread_cond_wait(&pool->work, &pool->lock);
+
+        if (g_queue_is_empty(&pool->pending))
+            break;
+
+        job = g_queue_pop_head(&pool->pending);
+        pthread_mutex_unlock(&pool->lock);
+
+        scan_job_run(pool->ac, job);
+
+        pthread_mutex_lock(&pool->lock);
+        job->done = true;
+        pthread_cond_broadcast(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static unsigned int
+scan_pool_start(
+    scan_pool_t *pool,
+    unsigned int num_threads)
+{
+    unsigned int i;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    g_queue_init(&pool->pending);
+
+    for (i = 0; i < num_threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, scan_worker, pool))
+            break;
+    }
+
+    pool->num_threads = i;
+    return i;
+}
+
+static void
+scan_pool_stop(
+    scan_pool_t *pool)
+{
+    unsigned int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    /* chunks nobody waits for anymore if the scan was stopped early */
+    g_queue_clear(&pool->pending);
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->num_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+static void
+scan_submit(
+    scan_pool_t *pool,
+    scan_job_t *job)
+{
+    job->done = false;
+
+    if (!pool->num_threads) {
+        scan_job_run(pool->ac, job);
+        job->done = true;
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    g_queue_push_tail(&pool->pending, job);
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static bool
+scan_job_done(
+    scan_pool_t *pool,
+    scan_job_t *job,
+    bool wait)
+{
+    bool done;
+
+    if (!pool->num_threads)
+        return true;
+
+    pthread_mutex_lock(&pool->lock);
+    while (wait && !job->done)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    done = job->done;
+    pthread_mutex_unlock(&pool->lock);
+
+    return done;
+}
+
+static gint
+compare_hits(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const strmatch_hit_t *ha = a, *hb = b;
+
+    if (ha->offset != hb->offset)
+        return ha->offset < hb->offset ? -1 : 1;
+
+    return ha->pattern < hb->pattern ? -1 : ha->pattern > hb->pattern;
+}
+
+/*
+ * Hands the matches of completed chunks at the head of the queue to the
+ * callback, moving the chunks to the free list. Returns false once the
+ * callback asked to stop.
+ */
+static bool
+scan_deliver(
+    vmi_instance_t vmi,
+    scan_pool_t *pool,
+    GQueue *inflight,
+    GQueue *free_jobs,
+    bool wait,
+    scan_callback_t cb,
+    void *data)
+{
+    scan_job_t *job;
+    strmatch_hit_t *hit;
+    bool keep_going = true;
+    guint i;
+
+    while ((job = g_queue_peek_head(inflight)) && scan_job_done(pool, job, wait)) {
+        g_queue_pop_head(inflight);
+
+        if (job->hits->len > 1)
+            g_array_sort(job->hits, compare_hits);
+
+        for (i = 0; keep_going && i < job->hits->len; i++) {
+            hit = &g_array_index(job->hits, strmatch_hit_t, i);
+            keep_going = cb(vmi, job->addr + hit->offset, hit->pattern, data);
+        }
+
+        g_array_set_size(job->hits, 0);
+        g_queue_push_tail(free_jobs, job);
+
+        if (!keep_going)
+            break;
+    }
+
+    return keep_going;
+}
+
+status_t
+vmi_scan_memory(
+    vmi_instance_t vmi,
+    const access_context_t *ctx,
+    size_t length,
+    const scan_pattern_t *patterns,
+    unsigned int num_patterns,
+    unsigned int threads,
+    scan_callback_t cb,
+    void *data)
+{
+    status_t ret = VMI_FAILURE;
+    scan_pool_t pool = { 0 };
+    GQueue inflight = G_QUEUE_INIT, free_jobs = G_QUEUE_INIT;
+    scan_job_t *jobs = NULL, *job;
+    unsigned char *carry = NULL;
+    size_t carry_len = 0, max_carry = 0, want, got;
+    unsigned int num_jobs, i;
+    access_context_t scan_ctx;
+    addr_t addr, end;
+    bool keep_going = true;
+
+#ifdef ENABLE_SAFETY_CHECKS
+    if (!vmi || !ctx || !patterns || !num_patterns || !cb)
+        return VMI_FAILURE;
+#endif
+
+    for (i = 0; i < num_patterns; i++) {
+        if (patterns[i].length > SCAN_CHUNK_SIZE) {
+            errprint("%s: pattern %u is longer than the scan chunk size\n", __FUNCTION__, i);
+            return VMI_FAILURE;
+        }
+        if (patterns[i].length > max_carry + 1)
+            max_carry = patterns[i].length - 1;
+    }
+
+    scan_ctx = *ctx;
+    if (VMI_TM_KERNEL_SYMBOL == ctx->tm) {
+        if (VMI_FAILURE == vmi_translate_ksym2v(vmi, ctx->ksym, &addr))
+            return VMI_FAILURE;
+
+        scan_ctx.tm = VMI_TM_PROCESS_PID;
+        scan_ctx.addr = addr;
+        scan_ctx.pid = 0;
+    }
+
+    addr = scan_ctx.addr;
+    end = addr + length;
+    if (end < addr)
+        end = ~0ull;
+
+    pool.ac = aho_corasick_init(patterns, num_patterns);
+    if (!pool.ac)
+        return VMI_FAILURE;
+
+    if (!threads) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? cpus : 1;
+    }
+    if (threads > SCAN_MAX_THREADS)
+        threads = SCAN_MAX_THREADS;
+
+    /* a single thread matches inline, without a pool */
+    if (threads > 1)
+        threads = scan_pool_start(&pool, threads);
+    else
+        threads = 0;
+
+    /* enough chunks to keep every worker busy while the next one is read */
+    num_jobs = threads ? 2 * threads : 1;
+    jobs = g_try_malloc0(num_jobs * sizeof(scan_job_t));
+    carry = g_try_malloc(max_carry + 1);
+    if (!jobs || !carry)
+        goto done;
+
+    for (i = 0; i < num_jobs; i++) {
+        jobs[i].buf = g_try_malloc(SCAN_CHUNK_SIZE + max_carry);
+        jobs[i].hits = g_array_new(FALSE, FALSE, sizeof(strmatch_hit_t));
+        if (!jobs[i].buf)
+            goto done;
+        g_queue_push_tail(&free_jobs, &jobs[i]);
+    }
+
+    while (keep_going && addr < end) {
+        if (g_queue_is_empty(&free_jobs)) {
+            keep_going = scan_deliver(vmi, &pool, &inflight, &free_jobs, true, cb, data);
+            continue;
+        }
+
+        job = g_queue_pop_head(&free_jobs);
+        want = MIN(SCAN_CHUNK_SIZE, end - addr);
+        got = 0;
+
+        memcpy(job->buf, carry, carry_len);
+        scan_ctx.addr = addr;
+        (void) vmi_read(vmi, &scan_ctx, want, job->buf + carry_len, &got);
+
+        if (got) {
+            job->addr = addr - carry_len;
+            job->carry = carry_len;
+            job->len = carry_len + got;
+            scan_submit(&pool, job);
+            g_queue_push_tail(&inflight, job);
+
+            carry_len = MIN(max_carry, job->len);
+            memcpy(carry, job->buf + job->len - carry_len, carry_len);
+            addr += got;
+        } else {
+            g_queue_push_tail(&free_jobs, job);
+        }
+
+        /* skip the page that could not be read, matches don't span it */
+        if (got < want) {
+            carry_len = 0;
+            addr = (addr & ~((addr_t) VMI_PS_4KB - 1)) + VMI_PS_4KB;
+            if (!addr)
+                break;
+        }
+
+        keep_going = scan_deliver(vmi, &pool, &inflight, &free_jobs, false, cb, data);
+    }
+
+    if (keep_going)
+        (void) scan_deliver(vmi, &pool, &inflight, &free_jobs, true, cb, data);
+
+    ret = VMI_SUCCESS;
+
+done:
+    if (threads)
+        scan_pool_stop(&pool);
+
+    g_queue_clear(&inflight);
+    g_queue_clear(&free_jobs);
+
+    if (jobs) {
+        for (i = 0; i < num_jobs; i++) {
+            g_free(jobs[i].buf);
+            if (jobs[i].hits)
+                g_array_free(jobs[i].hits, TRUE);
+        }
+    }
+
+    g_free(jobs);
+    g_free(carry);
+    aho_corasick_fini(pool.ac);
+    return ret;
+}
@@ -0,0 +1,216 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "private.h"
+
+/*
+ * Performance counters.
+ *
+ * The counters are bumped on the hot paths, so counting must not take a
+ * lock or make threads fight over a cache line. In concurrent mode every
+ * thread counts into a block of its own, found through a thread-specific
+ * key like its translation cache; a thread that exits adds its block to
+ * vmi->stats. Without concurrency vmi->stats is the only block.
+ *
+ * A block is only written by its thread, with relaxed atomic stores, so
+ * vmi_get_stats can sum the blocks up at any time. For the same reason
+ * vmi_reset_stats doesn't clear them: it remembers the current sum as the
+ * baseline that vmi_get_stats subtracts.
+ */
+
+#define STATS_COUNTERS  (sizeof(vmi_stats_t) / sizeof(uint64_t))
+
+struct stats_block {
+    vmi_stats_t stats;
+    stats_threads_t *threads;
+};
+
+struct stats_threads {
+    pthread_key_t key;      /**< the calling thread's block */
+    pthread_mutex_t lock;   /**< protects blocks, vmi->stats and the baseline */
+    GSList *blocks;         /**< every thread's block */
+    vmi_stats_t *retired;   /**< vmi->stats, where exited threads leave their counts */
+    vmi_stats_t lost;       /**< for threads that can't get a block, never read */
+};
+
+static void
+stats_sum(
+    vmi_stats_t *sum,
+    vmi_stats_t *stats)
+{
+    uint64_t *s = (uint64_t *) sum;
+    uint64_t *c = (uint64_t *) stats;
+    unsigned int i;
+
+    for (i = 0; i < STATS_COUNTERS; i++)
+        s[i] += __atomic_load_n(&c[i], __ATOMIC_RELAXED);
+}
+
+/* A thread exited, its counts stay with the instance */
+static void
+stats_block_release(
+    void *data)
+{
+    struct stats_block *block = (struct stats_block *) data;
+    stats_threads_t *threads = block->threads;
+
+    pthread_mutex_lock(&threads->lock);
+    threads->blocks = g_slist_remove(threads->blocks, block);
+    stats_sum(threads->retired, &block->stats);
+    pthread_mutex_unlock(&threads->lock);
+
+    g_free(block);
+}
+
+vmi_stats_t *
+stats_thread_get(
+    vmi_instance_t vmi)
+{
+    stats_threads_t *threads = vmi->stats_threads;
+    struct stats_block *block = pthread_getspecific(threads->key);
+
+    if ( block )
+        return &block->stats;
+
+    block = g_try_malloc0(sizeof(struct stats_block));
+    if ( !block )
+        return &threads->lost;
+
+    block->threads = threads;
+
+    if ( pthread_setspecific(threads->key, block) ) {
+        g_free(block);
+        return &threads->lost;
+    }
+
+    pthread_mutex_lock(&threads->lock);
+    threads->blocks = g_slist_prepend(threads->blocks, block);
+    pthread_mutex_unlock(&threads->lock);
+
+    return &block->stats;
+}
+
+void
+stats_init(
+    vmi_instance_t vmi)
+{
+    stats_threads_t *threads;
+
+    if ( !vmi->concurrent )
+        return;
+
+    threads = g_try_malloc0(sizeof(stats_threads_t));
+    if ( !threads )
+        return;
+
+    if ( pthread_key_create(&threads->key, stats_block_release) ) {
+        g_free(threads);
+        return;
+    }
+
+    pthread_mutex_init(&threads->lock, NULL);
+    threads->retired = &vmi->stats;
+    vmi->stats_threads = threads;
+}
+
+void
+stats_destroy(
+    vmi_instance_t vmi)
+{
+    stats_threads_t *threads = vmi->stats_threads;
+
+    if ( !threads )
+        return;
+
+    /* the threads still holding a block don't get to free it anymore */
+    vmi->stats_threads = NULL;
+    pthread_key_delete(threads->key);
+    g_slist_free_full(threads->blocks, g_free);
+    pthread_mutex_destroy(&threads->lock);
+    g_free(threads);
+}
+
+/* Sum of every block, lock held in concurrent mode */
+static void
+stats_total(
+    vmi_instance_t vmi,
+    vmi_stats_t *total)
+{
+    GSList *loop;
+
+    memset(total, 0, sizeof(vmi_stats_t));
+    stats_sum(total, &vmi->stats);
+
+    if ( vmi->stats_threads ) {
+        for (loop = vmi->stats_threads->blocks; loop; loop = loop->next)
+            stats_sum(total, &((struct stats_block *) loop->data)->stats);
+    }
+}
+
+status_t
+vmi_get_stats(
+    vmi_instance_t vmi,
+    vmi_stats_t *stats)
+{
+    uint64_t *s = (uint64_t *) stats;
+    uint64_t *b;
+    unsigned int i;
+
+#ifdef ENABLE_SAFETY_CHECKS
+    if (!vmi || !stats)
+        return VMI_FAILURE;
+#endif
+
+    b = (uint64_t *) &vmi->stats_baseline;
+
+    if ( vmi->stats_threads )
+        pthread_mutex_lock(&vmi->stats_threads->lock);
+
+    stats_total(vmi, stats);
+    for (i = 0; i < STATS_COUNTERS; i++)
+        s[i] -= b[i];
+
+    if ( vmi->stats_threads )
+        pthread_mutex_unlock(&vmi->stats_threads->lock);
+
+    return VMI_SUCCESS;
+}
+
+status_t
+vmi_reset_stats(
+    vmi_instance_t vmi)
+{
+#ifdef ENABLE_SAFETY_CHECKS
+    if (!vmi)
+        return VMI_FAILURE;
+#endif
+
+    if ( vmi->stats_threads )
+        pthread_mutex_lock(&vmi->stats_threads->lock);
+
+    stats_total(vmi, &vmi->stats_baseline);
+
+    if ( vmi->stats_threads )
+        pthread_mutex_unlock(&vmi->stats_threads->lock);
+
+    return VMI_SUCCESS;
+}
@@ -195,7 +195,7 @@ boyer_moore_fini(
 int
 boyer_moore2(
     void *bm,
-    unsigned char *y,
+    const unsigned char *y,
     int n)
 {
     int i, j;
@@ -217,3 +217,164 @@ boyer_moore2(
 
     return -1;
 }
+
+// Aho-Corasick automaton for matching several patterns in a single pass.
+// The goto and failure functions are folded into a full transition table,
+// so the search does one table lookup per input byte.
+
+typedef struct aho_corasick_data {
+    uint32_t *delta;        // delta[state * ASIZE + c] = next state
+    uint32_t *out;          // first state on the suffix chain with a match, 0 if none
+    uint32_t *out_next;     // next such state after out[state]
+    int *match;             // first pattern ending in a state, -1 if none
+    int *match_next;        // next pattern with the same bytes, -1 if none
+    size_t *length;         // pattern lengths
+    unsigned int count;
+} aho_corasick_data_t;
+
+void *
+aho_corasick_init(
+    const scan_pattern_t *patterns,
+    unsigned int count)
+{
+    aho_corasick_data_t *ac;
+    uint32_t *fail = NULL, *queue = NULL;
+    uint32_t states = 1, qhead = 0, qtail = 0, s, t;
+    size_t total = 1, i, j;
+    unsigned int c;
+
+    if (!patterns || !count)
+        return NULL;
+
+    for (i = 0; i < count; i++) {
+        if (!patterns[i].data || !patterns[i].length)
+            return NULL;
+        total += patterns[i].length;
+    }
+
+    if (total > UINT32_MAX / ASIZE)
+        return NULL;
+
+    ac = g_try_malloc0(sizeof(aho_corasick_data_t));
+    if (!ac)
+        return NULL;
+
+    ac->count = count;
+    ac->delta = g_try_malloc0(total * ASIZE * sizeof(uint32_t));
+    ac->out = g_try_malloc0(total * sizeof(uint32_t));
+    ac->out_next = g_try_malloc0(total * sizeof(uint32_t));
+    ac->match = g_try_malloc(total * sizeof(int));
+    ac->match_next = g_try_malloc(count * sizeof(int));
+    ac->length = g_try_malloc(count * sizeof(size_t));
+    fail = g_try_malloc0(total * sizeof(uint32_t));
+    queue = g_try_malloc(total * sizeof(uint32_t));
+
+    if (!ac->delta || !ac->out || !ac->out_next || !ac->match ||
+            !ac->match_next || !ac->length || !fail || !queue) {
+        g_free(fail);
+        g_free(queue);
+        aho_corasick_fini(ac);
+        return NULL;
+    }
+
+    for (i = 0; i < total; i++)
+        ac->match[i] = -1;
+
+    // Build the trie; state 0 is the root and never a child, so a zero
+    // entry in the table means "no edge" until the table is completed
+    for (i = 0; i < count; i++) {
+        s = 0;
+        for (j = 0; j < patterns[i].length; j++) {
+            c = patterns[i].data[j];
+            if (!ac->delta[s * ASIZE + c])
+                ac->delta[s * ASIZE + c] = states++;
+            s = ac->delta[s * ASIZE + c];
+        }
+
+        ac->length[i] = patterns[i].length;
+        ac->match_next[i] = ac->match[s];
+        ac->match[s] = i;
+    }
+
+    // Breadth-first: failure links of shallower states are complete
+    // before they are used
+    for (c = 0; c < ASIZE; c++) {
+        t = ac->delta[c];
+        if (t)
+            queue[qtail++] = t;
+    }
+
+    while (qhead < qtail) {
+        s = queue[qhead++];
+
+        ac->out[s] = ac->match[s] >= 0 ? s : ac->out[fail[s]];
+        ac->out_next[s] = ac->out[fail[s]];
+
+        for (c = 0; c < ASIZE; c++) {
+            t = ac->delta[s * ASIZE + c];
+            if (t) {
+                fail[t] = ac->delta[fail[s] * ASIZE + c];
+                queue[qtail++] = t;
+            } else {
+                ac->delta[s * ASIZE + c] = ac->delta[fail[s] * ASIZE + c];
+            }
+        }
+    }
+
+    g_free(fail);
+    g_free(queue);
+    return ac;
+}
+
+// y - pointer to string to search
+// n - len(y)
+// min_end - only report matches ending past this offset
+// appends a strmatch_hit_t to hits for every match
+void
+aho_corasick_search(
+    void *ac,
+    const unsigned char *y,
+    size_t n,
+    size_t min_end,
+    GArray *hits)
+{
+    aho_corasick_data_t *_ac = (aho_corasick_data_t *) ac;
+    const uint32_t *delta = _ac->delta;
+    uint32_t state = 0, s;
+    strmatch_hit_t hit;
+    size_t i;
+    int p;
+
+    for (i = 0; i < n; i++) {
+        state = delta[state * ASIZE + y[i]];
+
+        if (!_ac->out[state] || i < min_end)
+            continue;
+
+        for (s = _ac->out[state]; s; s = _ac->out_next[s]) {
+            for (p = _ac->match[s]; p >= 0; p = _ac->match_next[p]) {
+                hit.offset = i + 1 - _ac->length[p];
+                hit.pattern = p;
+                g_array_append_val(hits, hit);
+            }
+        }
+    }
+}
+
+void
+aho_corasick_fini(
+    void *ac)
+{
+    aho_corasick_data_t *_ac = (aho_corasick_data_t *) ac;
+
+    if (!_ac)
+        return;
+
+    g_free(_ac->delta);
+    g_free(_ac->out);
+    g_free(_ac->out_next);
+    g_free(_ac->match);
+    g_free(_ac->match_next);
+    g_free(_ac->length);
+    g_free(_ac);
+}
@@ -44,7 +44,9 @@ vmi_write(
     addr_t naddr;
     addr_t offset;
     page_mode_t pm;
+    page_size_t size;
     size_t buf_offset = 0;
+    size_t mapped = 0;
 
 #ifdef ENABLE_SAFETY_CHECKS
     if (NULL == vmi) {
@@ -129,18 +131,31 @@ vmi_write(
     while (count > 0) {
         size_t write_len = 0;
 
-        if (valid_pm(pm)) {
-            if (VMI_SUCCESS != vmi_nested_pagetable_lookup(vmi, ctx->npt, ctx->npm, pt, pm, start_addr + buf_offset, &paddr, &naddr))
-                goto done;
+        /* pages of a large mapping follow each other, translate it once */
+        if (!mapped) {
+            size = 0;
 
-            if (valid_npm(ctx->npm))
-                paddr = naddr;
+            if (valid_pm(pm)) {
+                if (VMI_SUCCESS != vmi_nested_pagetable_lookup_size(vmi, ctx->npt, ctx->npm, pt, pm, start_addr + buf_offset, &paddr, &naddr, &size))
+                    goto done;
 
-        } else {
-            paddr = start_addr + buf_offset;
+                if (valid_npm(ctx->npm))
+                    paddr = naddr;
 
-            if (valid_npm(ctx->npm) && VMI_SUCCESS != vmi_nested_pagetable_lookup(vmi, 0, 0, ctx->npt, ctx->npm, paddr, &paddr, NULL))
-                goto done;
+            } else {
+                paddr = start_addr + buf_offset;
+
+                if (valid_npm(ctx->npm) && VMI_SUCCESS != vmi_nested_pagetable_lookup_size(vmi, 0, 0, ctx->npt, ctx->npm, paddr, &paddr, NULL, &size))
+                    goto done;
+            }
+
+            if (!size)
+                mapped = count;
+            else {
+                if (size < vmi->page_size)
+                    size = vmi->page_size;
+                mapped = size - (paddr & (size - 1));
+            }
         }
 
         /* determine how much we can write to this page */
@@ -162,6 +177,8 @@ vmi_write(
         /* set variables for next loop */
         count -= write_len;
         buf_offset += write_len;
+        paddr += write_len;
+        mapped = mapped > write_len ? mapped - write_len : 0;
     }
 
     ret = VMI_SUCCESS;
@@ -37,6 +37,8 @@ TCase *util_tcase();
 TCase *peparse_tcase();
 TCase *cache_tcase();
 TCase *get_va_pages_tcase();
+TCase *file_tcase();
+TCase *nested_tcase();
 
 const char *get_testvm (void)
 {
@@ -69,6 +71,8 @@ main (void)
     suite_add_tcase(s, peparse_tcase());
     suite_add_tcase(s, cache_tcase());
     suite_add_tcase(s, get_va_pages_tcase());
+    suite_add_tcase(s, file_tcase());
+    suite_add_tcase(s, nested_tcase());
 
     /* run the tests */
     SRunner *sr = srunner_create(s);
@@ -43,18 +43,244 @@ START_TEST (test_libvmi_cache)
 
 #ifdef ENABLE_ADDRESS_CACHE
     addr_t pa = 0;
-    v2p_cache_flush(vmi, ~0ull);
-    v2p_cache_set(vmi, 0x400000, 0xabcde, 0x3b40a000);
+    v2p_cache_flush(vmi, ~0ull, 0);
+    v2p_cache_set(vmi, 0x400000, 0xabcde, 0, 0x3b40a000, VMI_PS_4KB);
 
-    status_t ret = v2p_cache_get(vmi, 0x880000400000ull, 0xabcde, &pa);
+    status_t ret = v2p_cache_get(vmi, 0x880000400000ull, 0xabcde, 0, &pa, NULL);
     fail_if(ret == VMI_SUCCESS, "hit a wrong cache");
 
     /* @awsaba 's complementary */
-    ret = v2p_cache_get(vmi, 0x00000400000ull, 0xabcde, &pa);
+    ret = v2p_cache_get(vmi, 0x00000400000ull, 0xabcde, 0, &pa, NULL);
     fail_if(ret == VMI_FAILURE, "cache entry not found");
+
+    /* a new epoch invalidates the entry without re-reading memory */
+    vmi_v2pcache_bump_epoch(vmi);
+    ret = v2p_cache_get(vmi, 0x00000400000ull, 0xabcde, 0, &pa, NULL);
+    fail_if(ret == VMI_SUCCESS, "stale cache entry hit after epoch bump");
 #endif
 
-    v2p_cache_flush(vmi, ~0ull);
+    v2p_cache_flush(vmi, ~0ull, 0);
+    vmi_destroy(vmi);
+}
+END_TEST
+
+/* test performance counters */
+START_TEST (test_libvmi_stats)
+{
+    vmi_instance_t vmi = NULL;
+    vmi_stats_t stats;
+    addr_t kpgd = 0;
+    uint64_t value = 0;
+
+    vmi_init_complete(&vmi, (void*)get_testvm(), VMI_INIT_DOMAINNAME, NULL,
+                      VMI_CONFIG_GLOBAL_FILE_ENTRY, NULL, NULL);
+    vmi_get_offset(vmi, "kpgd", &kpgd);
+
+    vmi_pagecache_flush(vmi);
+    fail_unless(VMI_SUCCESS == vmi_reset_stats(vmi), "vmi_reset_stats failed");
+    fail_unless(VMI_SUCCESS == vmi_get_stats(vmi, &stats), "vmi_get_stats failed");
+    fail_unless(!stats.page_cache_hits && !stats.page_cache_misses && !stats.driver_page_fetches,
+                "counters not zero after vmi_reset_stats");
+
+    /* the second read of the page is served from the page cache */
+    fail_unless(VMI_SUCCESS == vmi_read_64_pa(vmi, kpgd, &value), "vmi_read_64_pa failed");
+    fail_unless(VMI_SUCCESS == vmi_read_64_pa(vmi, kpgd, &value), "vmi_read_64_pa failed");
+
+    vmi_get_stats(vmi, &stats);
+    fail_unless(stats.page_cache_misses >= 1 && stats.page_cache_hits >= 1, "page cache not counted");
+    fail_unless(stats.driver_page_fetches >= 1 && stats.driver_bytes >= stats.driver_page_fetches,
+                "driver fetches not counted");
+
+    vmi_destroy(vmi);
+}
+END_TEST
+
+/* the page cache splits its pages over 16 shards, see libvmi/driver/memory_cache.c */
+#define PAGECACHE_SHARDS    16
+#define PAGECACHE_PAGE      0x1000ull
+
+/* reads from the page at pa and tells whether the page cache had it */
+static bool
+pagecache_hit(vmi_instance_t vmi, addr_t pa)
+{
+    vmi_stats_t before, after;
+    uint64_t value = 0;
+
+    vmi_get_stats(vmi, &before);
+    fail_unless(VMI_SUCCESS == vmi_read_64_pa(vmi, pa, &value), "vmi_read_64_pa failed");
+    vmi_get_stats(vmi, &after);
+
+    return after.page_cache_hits > before.page_cache_hits;
+}
+
+/* reads from the page at pa and tells whether another page was evicted for it */
+static bool
+pagecache_evicts(vmi_instance_t vmi, addr_t pa)
+{
+    vmi_stats_t before, after;
+    uint64_t value = 0;
+
+    vmi_get_stats(vmi, &before);
+    fail_unless(VMI_SUCCESS == vmi_read_64_pa(vmi, pa, &value), "vmi_read_64_pa failed");
+    vmi_get_stats(vmi, &after);
+
+    return after.page_cache_evictions > before.page_cache_evictions;
+}
+
+/*
+ * Opens the test vm with read-ahead off, so only the pages read by the test
+ * end up in the page cache, and finds count pages that share a shard,
+ * starting with the page of the kernel page directory.
+ */
+static vmi_instance_t
+pagecache_setup(addr_t *pages, unsigned int count)
+{
+    vmi_instance_t vmi = NULL;
+    addr_t kpgd = 0, pa;
+    unsigned int found = 1;
+
+    vmi_init_complete(&vmi, (void*)get_testvm(), VMI_INIT_DOMAINNAME, NULL,
+                      VMI_CONFIG_GLOBAL_FILE_ENTRY, NULL, NULL);
+    vmi_get_offset(vmi, "kpgd", &kpgd);
+
+    fail_unless(VMI_SUCCESS == vmi_pagecache_set_readahead(vmi, 0), "vmi_pagecache_set_readahead failed");
+    fail_unless(VMI_SUCCESS == vmi_pagecache_set_size(vmi, PAGECACHE_SHARDS),
+                "vmi_pagecache_set_size failed");
+
+    /* with one page per shard, a page evicts the first one only if they share its shard */
+    pages[0] = kpgd & ~(PAGECACHE_PAGE - 1);
+    for (pa = pages[0] + PAGECACHE_PAGE; found < count && pa < pages[0] + 256 * PAGECACHE_PAGE;
+            pa += PAGECACHE_PAGE) {
+        vmi_pagecache_flush(vmi);
+        pagecache_hit(vmi, pages[0]);
+        if (pagecache_evicts(vmi, pa))
+            pages[found++] = pa;
+    }
+    fail_unless(found == count, "no pages found that share a page cache shard");
+
+    vmi_pagecache_flush(vmi);
+    return vmi;
+}
+
+/* test that the least recently used page of a shard is evicted first */
+START_TEST (test_libvmi_pagecache_evict)
+{
+    addr_t pages[3];
+    vmi_instance_t vmi = pagecache_setup(pages, 3);
+
+    /* two pages per shard */
+    vmi_pagecache_set_size(vmi, 2 * PAGECACHE_SHARDS);
+
+    fail_if(pagecache_hit(vmi, pages[0]), "hit before the page was read");
+    fail_if(pagecache_hit(vmi, pages[1]), "hit before the page was read");
+    fail_unless(pagecache_hit(vmi, pages[0]), "page not cached");
+
+    /* pages[1] is now the least recently used one */
+    fail_unless(pagecache_evicts(vmi, pages[2]), "full shard didn't evict");
+    fail_unless(pagecache_hit(vmi, pages[0]), "recently used page was evicted");
+    fail_unless(pagecache_hit(vmi, pages[2]), "new page not cached");
+    fail_if(pagecache_hit(vmi, pages[1]), "least recently used page was not evicted");
+
+    vmi_destroy(vmi);
+}
+END_TEST
+
+/* test that a flush drops every page and the cache fills up again after it */
+START_TEST (test_libvmi_pagecache_flush)
+{
+    addr_t pages[2];
+    vmi_instance_t vmi = pagecache_setup(pages, 2);
+
+    vmi_pagecache_set_size(vmi, 2 * PAGECACHE_SHARDS);
+
+    fail_if(pagecache_hit(vmi, pages[0]), "hit before the page was read");
+    fail_if(pagecache_hit(vmi, pages[1]), "hit before the page was read");
+    fail_unless(pagecache_hit(vmi, pages[0]), "page not cached");
+    fail_unless(pagecache_hit(vmi, pages[1]), "page not cached");
+
+    vmi_pagecache_flush(vmi);
+
+    fail_if(pagecache_hit(vmi, pages[0]), "hit after flush");
+    fail_if(pagecache_hit(vmi, pages[1]), "hit after flush");
+    fail_unless(pagecache_hit(vmi, pages[0]), "page not cached again after flush");
+    fail_unless(pagecache_hit(vmi, pages[1]), "page not cached again after flush");
+
+    vmi_destroy(vmi);
+}
+END_TEST
+
+/* test that pinned pages survive eviction and flushes until they are unpinned */
+START_TEST (test_libvmi_pagecache_pin)
+{
+    addr_t pages[3];
+    const void *data = NULL;
+    page_pin_t pin = NULL;
+    uint64_t value = 0, pinned = 0;
+    vmi_instance_t vmi = pagecache_setup(pages, 3);
+
+    ACCESS_CONTEXT(ctx, .addr = pages[0]);
+    fail_unless(VMI_SUCCESS == vmi_pin_page(vmi, &ctx, &data, NULL, &pin), "vmi_pin_page failed");
+    memcpy(&pinned, data, sizeof(pinned));
+
+    /* the shard holds one page, but the pinned one has to stay */
+    fail_if(pagecache_evicts(vmi, pages[1]), "pinned page was evicted");
+    fail_unless(pagecache_hit(vmi, pages[0]), "pinned page not cached");
+
+    /* a flush drops the page from the cache, the pinned data stays valid */
+    vmi_pagecache_flush(vmi);
+    fail_if(pagecache_hit(vmi, pages[0]), "hit after flush");
+    fail_unless(VMI_SUCCESS == vmi_read_64_pa(vmi, pages[0], &value), "vmi_read_64_pa failed");
+    fail_unless(!memcmp(&value, data, sizeof(value)) && value == pinned,
+                "pinned page changed by flush");
+    vmi_unpin_page(vmi, pin);
+
+    /* once unpinned, it is evicted like any other page */
+    vmi_pagecache_flush(vmi);
+    fail_unless(VMI_SUCCESS == vmi_pin_page(vmi, &ctx, &data, NULL, &pin), "vmi_pin_page failed");
+    vmi_unpin_page(vmi, pin);
+    fail_unless(pagecache_evicts(vmi, pages[2]), "unpinned page was not evicted");
+    fail_if(pagecache_hit(vmi, pages[0]), "unpinned page still cached");
+
+    vmi_destroy(vmi);
+}
+END_TEST
+
+/* test that consecutive pages are spread evenly over the shards */
+START_TEST (test_libvmi_pagecache_shards)
+{
+    vmi_instance_t vmi = NULL;
+    vmi_stats_t stats;
+    addr_t kpgd = 0, base;
+    uint64_t value = 0;
+    unsigned int i;
+
+    vmi_init_complete(&vmi, (void*)get_testvm(), VMI_INIT_DOMAINNAME, NULL,
+                      VMI_CONFIG_GLOBAL_FILE_ENTRY, NULL, NULL);
+    vmi_get_offset(vmi, "kpgd", &kpgd);
+    base = kpgd & ~(PAGECACHE_PAGE - 1);
+
+    /*
+     * 64 pages in a cache of 96 only fit without evictions if no shard gets
+     * more than 6 of them, the average being 4.
+     */
+    vmi_pagecache_set_readahead(vmi, 0);
+    fail_unless(VMI_SUCCESS == vmi_pagecache_set_size(vmi, 6 * PAGECACHE_SHARDS),
+                "vmi_pagecache_set_size failed");
+    vmi_pagecache_flush(vmi);
+    vmi_reset_stats(vmi);
+
+    for (i = 0; i < 64; i++)
+        fail_unless(VMI_SUCCESS == vmi_read_64_pa(vmi, base + i * PAGECACHE_PAGE, &value),
+                    "vmi_read_64_pa failed");
+    for (i = 0; i < 64; i++)
+        fail_unless(VMI_SUCCESS == vmi_read_64_pa(vmi, base + i * PAGECACHE_PAGE, &value),
+                    "vmi_read_64_pa failed");
+
+    vmi_get_stats(vmi, &stats);
+    fail_unless(!stats.page_cache_evictions, "consecutive pages crowd a shard");
+    fail_unless(stats.page_cache_misses == 64 && stats.page_cache_hits == 64,
+                "consecutive pages not all cached");
+
     vmi_destroy(vmi);
 }
 END_TEST
@@ -64,5 +290,10 @@ TCase *cache_tcase (void)
 {
     TCase *tc_init = tcase_create("LibVMI cache");
     tcase_add_test(tc_init, test_libvmi_cache);
+    tcase_add_test(tc_init, test_libvmi_stats);
+    tcase_add_test(tc_init, test_libvmi_pagecache_evict);
+    tcase_add_test(tc_init, test_libvmi_pagecache_flush);
+    tcase_add_test(tc_init, test_libvmi_pagecache_pin);
+    tcase_add_test(tc_init, test_libvmi_pagecache_shards);
     return tc_init;
 }
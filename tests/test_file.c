@@ -0,0 +1,144 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <libvmi/libvmi.h>
+#include "check_tests.h"
+
+/* 16 whole pages and half of another one, which can't be read as a page */
+#define DUMP_PAGE   0x1000
+#define DUMP_SIZE   (16 * DUMP_PAGE + DUMP_PAGE / 2)
+
+/* writes a dump whose bytes are all derived from their offset */
+static void
+dump_create(char *path, unsigned char *content)
+{
+    size_t i;
+    int fd = mkstemp(path);
+
+    fail_unless(fd >= 0, "failed to create the dump file");
+
+    for (i = 0; i < DUMP_SIZE; i++)
+        content[i] = (unsigned char)(i ^ (i >> 8) ^ (i >> 16));
+
+    fail_unless(write(fd, content, DUMP_SIZE) == DUMP_SIZE, "failed to write the dump file");
+    close(fd);
+}
+
+static vmi_instance_t
+dump_open(const char *path, uint32_t mode)
+{
+    vmi_instance_t vmi = NULL;
+    vmi_init_data_t *init_data = malloc(sizeof(vmi_init_data_t) + sizeof(vmi_init_data_entry_t));
+
+    init_data->count = 1;
+    init_data->entry[0].type = VMI_INIT_DATA_FILE_MODE;
+    init_data->entry[0].data = &mode;
+
+    status_t ret = vmi_init(&vmi, VMI_FILE, path, VMI_INIT_DOMAINNAME, init_data, NULL);
+    fail_unless(ret == VMI_SUCCESS, "failed to open the dump in mode %u", mode);
+
+    free(init_data);
+    return vmi;
+}
+
+/* test that the file driver reads the same with pread and with mmap */
+START_TEST (test_libvmi_file_modes)
+{
+    char path[] = "/tmp/libvmi_check_dumpXXXXXX";
+    unsigned char *content = malloc(DUMP_SIZE);
+    unsigned char *buf[2];
+    size_t bytes_read[2];
+    status_t ret[2];
+    vmi_instance_t vmi[2];
+    unsigned int i, j;
+
+    /* start, length of the reads */
+    const addr_t reads[][2] = {
+        { 0, 100 },
+        { DUMP_PAGE - 50, 100 },                        /* crosses a page boundary */
+        { 3 * DUMP_PAGE, 4 * DUMP_PAGE },               /* several whole pages */
+        { 15 * DUMP_PAGE, DUMP_PAGE },                  /* the last whole page */
+        { 16 * DUMP_PAGE - 100, DUMP_PAGE },            /* into the partial page */
+        { DUMP_SIZE - 100, 200 },                       /* across the end of the file */
+        { DUMP_SIZE + DUMP_PAGE, 100 },                 /* past the end of the file */
+    };
+
+    dump_create(path, content);
+    vmi[0] = dump_open(path, 0);
+    vmi[1] = dump_open(path, VMI_FILE_MMAP);
+
+    for (i = 0; i < sizeof(reads) / sizeof(reads[0]); i++) {
+        addr_t pa = reads[i][0];
+        size_t count = reads[i][1];
+
+        for (j = 0; j < 2; j++) {
+            buf[j] = calloc(1, count);
+            ret[j] = vmi_read_pa(vmi[j], pa, count, buf[j], &bytes_read[j]);
+        }
+
+        fail_unless(ret[0] == ret[1] && bytes_read[0] == bytes_read[1],
+                    "read of %zu bytes at 0x%"PRIx64" differs between pread and mmap", count, pa);
+        fail_unless(!memcmp(buf[0], buf[1], bytes_read[0]),
+                    "data at 0x%"PRIx64" differs between pread and mmap", pa);
+        fail_unless(!bytes_read[0] || !memcmp(buf[0], content + pa, bytes_read[0]),
+                    "data at 0x%"PRIx64" differs from the file", pa);
+
+        /* everything up to the partial page is readable, nothing after it */
+        if (pa + count <= 16 * DUMP_PAGE)
+            fail_unless(ret[0] == VMI_SUCCESS, "read at 0x%"PRIx64" failed", pa);
+        else
+            fail_unless(ret[0] == VMI_FAILURE &&
+                        bytes_read[0] == (pa < 16 * DUMP_PAGE ? 16 * DUMP_PAGE - pa : 0),
+                        "read at 0x%"PRIx64" didn't stop at the partial page", pa);
+
+        for (j = 0; j < 2; j++)
+            free(buf[j]);
+    }
+
+    /* the access hints don't change what is read */
+    for (j = 0; j < 2; j++) {
+        unsigned char page[DUMP_PAGE];
+
+        fail_unless(VMI_SUCCESS == vmi_set_access_hint(vmi[j], VMI_ACCESS_HINT_SEQUENTIAL),
+                    "vmi_set_access_hint failed");
+        fail_unless(VMI_SUCCESS == vmi_read_pa(vmi[j], 2 * DUMP_PAGE, DUMP_PAGE, page, NULL),
+                    "vmi_read_pa failed");
+        fail_unless(!memcmp(page, content + 2 * DUMP_PAGE, DUMP_PAGE), "data differs from the file");
+        vmi_set_access_hint(vmi[j], VMI_ACCESS_HINT_NORMAL);
+    }
+
+    vmi_destroy(vmi[0]);
+    vmi_destroy(vmi[1]);
+    unlink(path);
+    free(content);
+}
+END_TEST
+
+/* file driver test cases */
+TCase *file_tcase (void)
+{
+    TCase *tc_file = tcase_create("LibVMI file driver");
+    tcase_add_test(tc_file, test_libvmi_file_modes);
+    return tc_file;
+}
@@ -61,12 +61,61 @@ START_TEST (test_get_va_pages)
 }
 END_TEST
 
+static bool count_range(vmi_instance_t vmi, const vmi_va_range_t *range, void *data)
+{
+    uint64_t *sizes = data;
+
+    sizes[0]++;
+    sizes[1] += range->size;
+
+    addr_t paddr = 0;
+    fail_unless(VMI_SUCCESS == vmi_pagetable_lookup(vmi, range->info->pt, range->vaddr, &paddr),
+                "vmi_walk_va_pages reported an unmapped page");
+    fail_unless(paddr == range->paddr, "vmi_walk_va_pages reported the wrong paddr");
+
+    return true;
+}
+
+/* The walk reports the pages vmi_get_va_pages lists, coalesced or not */
+START_TEST (test_walk_va_pages)
+{
+    vmi_instance_t vmi = NULL;
+    vmi_init_complete(&vmi, (void*)get_testvm(), VMI_INIT_DOMAINNAME, NULL,
+                      VMI_CONFIG_GLOBAL_FILE_ENTRY, NULL, NULL);
+
+    addr_t dtb = 0;
+    vmi_get_offset(vmi, "kpgd", &dtb);
+    page_mode_t pm = vmi_get_page_mode(vmi, 0);
+    uint64_t pages = 0, size = 0;
+    uint64_t single[2] = { 0 }, runs[2] = { 0 };
+
+    GSList *loop, *list = vmi_get_va_pages(vmi, dtb);
+    for (loop = list; loop; loop = loop->next) {
+        page_info_t *info = loop->data;
+        pages++;
+        size += info->size;
+    }
+    g_slist_free_full(list, g_free);
+
+    fail_unless(VMI_SUCCESS == vmi_walk_va_pages(vmi, 0, VMI_PM_NONE, dtb, pm, 0, ~0ull, 0, count_range, single),
+                "vmi_walk_va_pages failed");
+    fail_unless(single[0] == pages && single[1] == size, "vmi_walk_va_pages missed pages");
+
+    fail_unless(VMI_SUCCESS == vmi_walk_va_pages(vmi, 0, VMI_PM_NONE, dtb, pm, 0, ~0ull, VMI_WALK_COALESCE,
+                count_range, runs), "vmi_walk_va_pages failed to coalesce");
+    fail_unless(runs[0] <= pages && runs[1] == size, "coalesced runs don't cover the pages");
+
+    vmi_destroy(vmi);
+}
+END_TEST
+
 /* translate test cases */
 TCase *get_va_pages_tcase (void)
 {
     TCase *tc_get_va_pages = tcase_create("LibVMI get_va_pages");
     tcase_set_timeout(tc_get_va_pages, 90);
     tcase_add_test(tc_get_va_pages, test_get_va_pages);
+    tcase_add_test(tc_get_va_pages, test_walk_va_pages);
     return tc_get_va_pages;
 }
 
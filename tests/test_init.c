@@ -30,6 +30,10 @@
 #include <glib.h>
 
 #include <libvmi/libvmi.h>
+#ifdef REKALL_PROFILES
+#define LIBVMI_EXTRA_JSON
+#include <libvmi/libvmi_extra.h>
+#endif
 #include "check_tests.h"
 
 // disabled because fails in jenkins
@@ -80,6 +84,258 @@ done:
     vmi_destroy(vmi);
 }
 END_TEST
+
+/* test init_complete for Windows from a converted Rekall profile */
+START_TEST (test_libvmi_init5)
+{
+    const char *name = get_testvm();
+    vmi_instance_t vmi = NULL;
+    vmi_init_complete(&vmi, (void*)name, VMI_INIT_DOMAINNAME, NULL,
+                      VMI_CONFIG_GLOBAL_FILE_ENTRY, NULL, NULL);
+    if (VMI_OS_WINDOWS == vmi_get_ostype(vmi) && VMI_OS_WINDOWS_XP == vmi_get_winver(vmi)) {
+        char location[100];
+        getcwd(location, sizeof(location));
+
+        char *rekall_profile = NULL, *binary_profile = NULL;
+        addr_t offset = 0, binary_offset = 0;
+        vmi_mode_t mode;
+        if (VMI_FAILURE == vmi_get_access_mode(vmi, NULL, 0, NULL, &mode))
+            goto done;
+
+        rekall_profile = g_strdup_printf("%s/%s", location,
+                                         mode == VMI_FILE ? XP_REKALL_PROFILE_FILE : XP_REKALL_PROFILE_LIVE);
+        binary_profile = g_strdup_printf("%s/xp-test-profile.bin", location);
+
+        fail_unless(VMI_SUCCESS == vmi_convert_json_profile(rekall_profile, binary_profile),
+                    "failed to convert Rekall profile %s", rekall_profile);
+        fail_unless(VMI_FAILURE == vmi_convert_json_profile(binary_profile, binary_profile),
+                    "converted a binary profile");
+
+        vmi_destroy(vmi);
+
+        GHashTable *config = g_hash_table_new(g_str_hash, g_str_equal);
+        g_hash_table_insert(config, "ostype", "Windows");
+        g_hash_table_insert(config, "rekall_profile", binary_profile);
+        if (VMI_FAILURE == vmi_init_complete(&vmi, (void*)name, VMI_INIT_DOMAINNAME, NULL,
+                                             VMI_CONFIG_GHASHTABLE, config, NULL)) {
+            fail_unless(0, "failed to init XP test domain from binary profile %s.", binary_profile);
+        }
+        g_hash_table_destroy(config);
+
+        /* the binary profile answers the same as the JSON one */
+        json_object *json = json_object_from_file(rekall_profile);
+        fail_unless(VMI_SUCCESS == vmi_get_struct_member_offset_from_json(vmi, json, "_EPROCESS", "UniqueProcessId", &offset),
+                    "failed to look up _EPROCESS.UniqueProcessId in the JSON profile");
+        fail_unless(VMI_SUCCESS == vmi_get_struct_member_offset_from_json(vmi, NULL, "_EPROCESS", "UniqueProcessId", &binary_offset),
+                    "failed to look up _EPROCESS.UniqueProcessId in the binary profile");
+        fail_unless(offset == binary_offset, "member offsets differ");
+        json_object_put(json);
+
+        unlink(binary_profile);
+        g_free(binary_profile);
+        g_free(rekall_profile);
+    }
+
+done:
+    vmi_destroy(vmi);
+}
+END_TEST
+
+/* a small Rekall profile with a symbol, embedded structs, a bitfield and enums */
+static const char profile_json[] =
+    "{\"$METADATA\": {\"ProfileClass\": \"Nt\", \"Type\": \"Profile\"},"
+    " \"$CONSTANTS\": {\"PsActiveProcessHead\": 4096},"
+    " \"$FUNCTIONS\": {\"NtCreateFile\": 8192},"
+    " \"$STRUCTS\": {"
+    "  \"_KPROCESS\": [24, {\"DirectoryTableBase\": [16, [\"unsigned long long\"]]}],"
+    "  \"_LIST_ENTRY\": [16, {\"Flink\": [0, [\"Pointer\"]], \"Blink\": [8, [\"Pointer\"]]}],"
+    "  \"_EPROCESS\": [64, {\"Pcb\": [0, [\"_KPROCESS\"]],"
+    "                       \"ActiveProcessLinks\": [24, [\"_LIST_ENTRY\"]],"
+    "                       \"Flags\": [40, [\"BitField\", {\"start_bit\": 3, \"end_bit\": 5, \"target\": \"unsigned long\"}]]}]},"
+    " \"$ENUMS\": {"
+    "  \"_POOL_TYPE\": {\"-1\": \"-\", \"0\": \"NonPagedPool\", \"1\": \"PagedPool\", \"32\": \"SessionPoolMask\"},"
+    "  \"_MODE\": {\"0\": \"KernelMode\", \"1\": \"UserMode\"}}}";
+
+/* opens an in-memory guest and loads the profile at path into it */
+static vmi_instance_t
+profile_open(const char *dir, const char *path)
+{
+    vmi_instance_t vmi = NULL;
+    GHashTable *config;
+    gchar *guest = g_build_filename(dir, "guest.ini", NULL);
+
+    fail_unless(VMI_SUCCESS == vmi_init(&vmi, VMI_MEM, guest, VMI_INIT_DOMAINNAME, NULL, NULL),
+                "failed to open the in-memory guest");
+
+    config = g_hash_table_new(g_str_hash, g_str_equal);
+    g_hash_table_insert(config, "rekall_profile", (gpointer) path);
+    fail_unless(VMI_OS_WINDOWS == vmi_init_profile(vmi, VMI_CONFIG_GHASHTABLE, config),
+                "failed to load profile %s", path);
+    g_hash_table_destroy(config);
+
+    g_free(guest);
+    return vmi;
+}
+
+/* test that a converted profile answers every query like the JSON it came from */
+START_TEST (test_libvmi_binary_profile)
+{
+    char dir[] = "/tmp/libvmi_check_profileXXXXXX";
+    gchar *json_path, *binary_path, *path;
+    vmi_instance_t vmi[2];
+    json_object *json[2];
+    unsigned char page[0x1000] = { 0 };
+    unsigned int i, j;
+
+    const char *symbols[] = { "PsActiveProcessHead", "NtCreateFile", "NoSuchSymbol" };
+    const char *structs[] = { "_EPROCESS", "_KPROCESS", "_LIST_ENTRY", "_NO_SUCH_STRUCT" };
+    const char *members[][2] = {
+        { "_EPROCESS", "ActiveProcessLinks" },
+        { "_EPROCESS", "DirectoryTableBase" },      /* through the embedded _KPROCESS */
+        { "_EPROCESS", "Flags" },
+        { "_LIST_ENTRY", "Blink" },
+        { "_EPROCESS", "NoSuchMember" },
+    };
+    const char *constants[][2] = {
+        { "_POOL_TYPE", "-" },
+        { "_POOL_TYPE", "NonPagedPool" },
+        { "_POOL_TYPE", "PagedPool" },
+        { "_POOL_TYPE", "SessionPoolMask" },
+        { "_MODE", "UserMode" },
+        { "_MODE", "NoSuchMode" },
+        { "_NO_SUCH_ENUM", "KernelMode" },
+    };
+
+    fail_unless(mkdtemp(dir) != NULL, "failed to create the profile directory");
+
+    json_path = g_build_filename(dir, "profile.json", NULL);
+    binary_path = g_build_filename(dir, "profile.bin", NULL);
+    fail_unless(g_file_set_contents(json_path, profile_json, -1, NULL), "failed to write the JSON profile");
+
+    path = g_build_filename(dir, "guest.raw", NULL);
+    fail_unless(g_file_set_contents(path, (const gchar *) page, sizeof(page), NULL), "failed to write the guest");
+    g_free(path);
+    path = g_build_filename(dir, "guest.ini", NULL);
+    fail_unless(g_file_set_contents(path, "[memory]\nimage=guest.raw\n", -1, NULL), "failed to write the guest");
+    g_free(path);
+
+    fail_unless(VMI_SUCCESS == vmi_convert_json_profile(json_path, binary_path), "failed to convert the profile");
+
+    vmi[0] = profile_open(dir, json_path);
+    vmi[1] = profile_open(dir, binary_path);
+    json[0] = vmi_get_kernel_json(vmi[0]);
+    json[1] = vmi_get_kernel_json(vmi[1]);
+    fail_unless(json[0] && !json[1], "the binary profile was loaded as JSON");
+
+    for (i = 0; i < sizeof(symbols) / sizeof(symbols[0]); i++) {
+        addr_t rva[2] = { 0 };
+        status_t ret[2];
+
+        for (j = 0; j < 2; j++)
+            ret[j] = vmi_get_symbol_addr_from_json(vmi[j], json[j], symbols[i], &rva[j]);
+        fail_unless(ret[0] == ret[1] && rva[0] == rva[1], "symbol %s differs", symbols[i]);
+    }
+
+    for (i = 0; i < sizeof(structs) / sizeof(structs[0]); i++) {
+        size_t size[2] = { 0 };
+        status_t ret[2];
+
+        for (j = 0; j < 2; j++)
+            ret[j] = vmi_get_struct_size_from_json(vmi[j], json[j], structs[i], &size[j]);
+        fail_unless(ret[0] == ret[1] && size[0] == size[1], "size of %s differs", structs[i]);
+    }
+
+    for (i = 0; i < sizeof(members) / sizeof(members[0]); i++) {
+        addr_t offset[2] = { 0 }, bit_offset[2] = { 0 };
+        size_t size[2] = { 0 }, start_bit[2] = { 0 }, end_bit[2] = { 0 };
+        const char *type_name[2] = { NULL };
+        status_t ret[2], size_ret[2], bit_ret[2], type_ret[2];
+
+        for (j = 0; j < 2; j++) {
+            ret[j] = vmi_get_struct_member_offset_from_json(vmi[j], json[j], members[i][0], members[i][1], &offset[j]);
+            size_ret[j] = vmi_get_struct_member_size_from_json(vmi[j], json[j], members[i][0], members[i][1], &size[j]);
+            bit_ret[j] = vmi_get_bitfield_offset_and_size_from_json(vmi[j], json[j], members[i][0], members[i][1],
+                         &bit_offset[j], &start_bit[j], &end_bit[j]);
+            type_ret[j] = vmi_get_struct_field_type_name_from_json(vmi[j], json[j], members[i][0], members[i][1],
+                          &type_name[j]);
+        }
+
+        fail_unless(ret[0] == ret[1] && offset[0] == offset[1],
+                    "offset of %s.%s differs", members[i][0], members[i][1]);
+        fail_unless(size_ret[0] == size_ret[1] && size[0] == size[1],
+                    "size of %s.%s differs", members[i][0], members[i][1]);
+        fail_unless(bit_ret[0] == bit_ret[1] && bit_offset[0] == bit_offset[1] &&
+                    start_bit[0] == start_bit[1] && end_bit[0] == end_bit[1],
+                    "bitfield %s.%s differs", members[i][0], members[i][1]);
+        fail_unless(type_ret[0] == type_ret[1] &&
+                    (type_ret[0] != VMI_SUCCESS || !strcmp(type_name[0], type_name[1])),
+                    "type of %s.%s differs", members[i][0], members[i][1]);
+    }
+
+    for (i = 0; i < sizeof(constants) / sizeof(constants[0]); i++) {
+        int64_t value[2] = { 0 };
+        status_t ret[2];
+
+        for (j = 0; j < 2; j++)
+            ret[j] = vmi_get_enum_value_from_json(vmi[j], json[j], constants[i][0], constants[i][1], &value[j]);
+        fail_unless(ret[0] == ret[1] && value[0] == value[1],
+                    "enum constant %s.%s differs", constants[i][0], constants[i][1]);
+    }
+
+    /* and the answers are the ones in the profile */
+    {
+        addr_t offset = 0;
+        size_t size = 0;
+        int64_t value = 0;
+
+        fail_unless(VMI_SUCCESS == vmi_get_struct_member_offset_from_json(vmi[1], NULL, "_EPROCESS", "DirectoryTableBase", &offset) &&
+                    offset == 16, "embedded member at the wrong offset");
+        fail_unless(VMI_SUCCESS == vmi_get_struct_member_size_from_json(vmi[1], NULL, "_EPROCESS", "DirectoryTableBase", &size) &&
+                    size == 8, "embedded member has the wrong size");
+        fail_unless(VMI_SUCCESS == vmi_get_struct_member_size_from_json(vmi[1], NULL, "_EPROCESS", "ActiveProcessLinks", &size) &&
+                    size == 16, "struct member has the wrong size");
+        fail_unless(VMI_SUCCESS == vmi_get_struct_member_size_from_json(vmi[0], json[0], "_EPROCESS", "Flags", &size) &&
+                    size == 4, "bitfield has the wrong size");
+        fail_unless(VMI_SUCCESS == vmi_get_enum_value_from_json(vmi[1], NULL, "_POOL_TYPE", "SessionPoolMask", &value) &&
+                    value == 32, "wrong enum constant value");
+        fail_unless(VMI_SUCCESS == vmi_get_enum_value_from_json(vmi[1], NULL, "_POOL_TYPE", "-", &value) &&
+                    value == -1, "wrong negative enum constant value");
+        fail_unless(VMI_FAILURE == vmi_get_enum_value_from_json(vmi[1], NULL, "_MODE", "NoSuchMode", &value),
+                    "found a constant that isn't in the profile");
+    }
+
+    /* a clone shares the struct index, which outlives the instance */
+    {
+        vmi_instance_t clone = NULL;
+        addr_t offset = 0;
+        size_t size = 0;
+
+        fail_unless(VMI_SUCCESS == vmi_clone(vmi[0], &clone), "vmi_clone failed");
+        vmi_destroy(vmi[0]);
+
+        fail_unless(VMI_SUCCESS == vmi_get_struct_member_offset_from_json(clone, vmi_get_kernel_json(clone),
+                    "_EPROCESS", "DirectoryTableBase", &offset) && offset == 16,
+                    "embedded member at the wrong offset in the clone");
+        fail_unless(VMI_SUCCESS == vmi_get_struct_size_from_json(clone, vmi_get_kernel_json(clone), "_EPROCESS", &size) &&
+                    size == 64, "struct has the wrong size in the clone");
+        vmi_destroy(clone);
+    }
+
+    vmi_destroy(vmi[1]);
+
+    unlink(json_path);
+    unlink(binary_path);
+    path = g_build_filename(dir, "guest.raw", NULL);
+    unlink(path);
+    g_free(path);
+    path = g_build_filename(dir, "guest.ini", NULL);
+    unlink(path);
+    g_free(path);
+    rmdir(dir);
+    g_free(json_path);
+    g_free(binary_path);
+}
+END_TEST
 #endif
 
 #ifdef ENABLE_INIT3_TEST
@@ -198,13 +454,173 @@ END_TEST
 START_TEST (test_libvmi_init1)
 {
     vmi_instance_t vmi = NULL;
+    const vmi_init_method_t *methods = NULL;
+    size_t i, count = 0;
     status_t ret = vmi_init_complete(&vmi, (void*)get_testvm(), VMI_INIT_DOMAINNAME, NULL,
                                      VMI_CONFIG_GLOBAL_FILE_ENTRY, NULL, NULL);
     fail_unless(ret == VMI_SUCCESS,
                 "vmi_init failed with VMI_INIT_DOMAINNAME and global config");
     fail_unless(vmi != NULL,
                 "vmi_init failed to initialize vmi instance struct");
+    fail_unless(VMI_SUCCESS == vmi_get_init_methods(vmi, &methods, &count),
+                "vmi_get_init_methods failed");
+    for (i = 0; i < count; i++)
+        fail_unless(methods[i].name != NULL, "init method without a name");
+    vmi_destroy(vmi);
+}
+END_TEST
+
+/* inits the test VM with the init cache in cache_dir, returns its kpgd and cache stats */
+static addr_t
+init_cache_attach(char *cache_dir, vmi_stats_t *stats)
+{
+    vmi_instance_t vmi = NULL;
+    vmi_init_data_t *init_data;
+    addr_t kpgd = 0;
+
+    init_data = malloc(sizeof(vmi_init_data_t) + sizeof(vmi_init_data_entry_t));
+    init_data->count = 1;
+    init_data->entry[0].type = VMI_INIT_DATA_INIT_CACHE;
+    init_data->entry[0].data = cache_dir;
+
+    fail_unless(VMI_SUCCESS == vmi_init_complete(&vmi, (void*)get_testvm(), VMI_INIT_DOMAINNAME, init_data,
+                VMI_CONFIG_GLOBAL_FILE_ENTRY, NULL, NULL),
+                "vmi_init_complete failed with the init cache");
+    vmi_get_offset(vmi, "kpgd", &kpgd);
+    fail_unless(VMI_SUCCESS == vmi_get_stats(vmi, stats), "vmi_get_stats failed");
+    vmi_destroy(vmi);
+
+    free(init_data);
+    return kpgd;
+}
+
+/* the path of the only entry in the init cache directory */
+static gchar *
+init_cache_entry(const char *cache_dir)
+{
+    GDir *dir = g_dir_open(cache_dir, 0, NULL);
+    const gchar *file;
+    gchar *path = NULL;
+
+    fail_unless(dir != NULL, "failed to open the init cache directory");
+    file = g_dir_read_name(dir);
+    fail_unless(file != NULL, "the init cache is empty");
+    path = g_build_filename(cache_dir, file, NULL);
+    fail_unless(g_dir_read_name(dir) == NULL, "the init cache has more than one entry");
+    g_dir_close(dir);
+
+    return path;
+}
+
+static void
+init_cache_remove(const char *cache_dir)
+{
+    GDir *dir = g_dir_open(cache_dir, 0, NULL);
+    const gchar *file;
+
+    while (dir && (file = g_dir_read_name(dir))) {
+        gchar *path = g_build_filename(cache_dir, file, NULL);
+        unlink(path);
+        g_free(path);
+    }
+    if (dir)
+        g_dir_close(dir);
+    rmdir(cache_dir);
+}
+
+/* test that a second init comes from the init cache and ends up with the same kernel */
+START_TEST (test_libvmi_init6)
+{
+    char cache_dir[] = "/tmp/libvmi-init-cache-XXXXXX";
+    vmi_stats_t stats;
+    addr_t kpgd, cached_kpgd;
+
+    fail_unless(mkdtemp(cache_dir) != NULL, "failed to create the init cache directory");
+
+    kpgd = init_cache_attach(cache_dir, &stats);
+    fail_unless(stats.init_cache_hits == 0 && stats.init_cache_misses == 1,
+                "init with an empty init cache didn't miss");
+
+    cached_kpgd = init_cache_attach(cache_dir, &stats);
+    fail_unless(stats.init_cache_hits == 1 && stats.init_cache_misses == 0,
+                "second init didn't use the init cache");
+    fail_unless(kpgd == cached_kpgd, "kpgd differs after init from the cache");
+
+    init_cache_remove(cache_dir);
+}
+END_TEST
+
+/* test that an entry for another kernel is not used, and replaced by a fresh init */
+START_TEST (test_libvmi_init7)
+{
+    char cache_dir[] = "/tmp/libvmi-init-cache-XXXXXX";
+    gchar *path, *entry = NULL, *stale = NULL, *rewritten = NULL;
+    gchar **lines;
+    vmi_stats_t stats;
+    addr_t kpgd, fresh_kpgd;
+    guint i;
+
+    fail_unless(mkdtemp(cache_dir) != NULL, "failed to create the init cache directory");
+
+    kpgd = init_cache_attach(cache_dir, &stats);
+    path = init_cache_entry(cache_dir);
+    fail_unless(g_file_get_contents(path, &entry, NULL, NULL), "failed to read the init cache entry");
+
+    /* pretend the entry was stored for a different kernel */
+    lines = g_strsplit(entry, "\n", -1);
+    for (i = 0; lines[i]; i++) {
+        if (g_str_has_prefix(lines[i], "fingerprint ")) {
+            g_free(lines[i]);
+            lines[i] = g_strdup("fingerprint 0x1");
+        }
+    }
+    stale = g_strjoinv("\n", lines);
+    g_strfreev(lines);
+    fail_unless(strcmp(stale, entry), "the init cache entry has no fingerprint");
+    fail_unless(g_file_set_contents(path, stale, -1, NULL), "failed to write the init cache entry");
+
+    fresh_kpgd = init_cache_attach(cache_dir, &stats);
+    fail_unless(stats.init_cache_hits == 0 && stats.init_cache_misses == 1,
+                "init used an entry with the wrong fingerprint");
+    fail_unless(kpgd == fresh_kpgd, "kpgd differs after the fallback init");
+
+    /* the fresh init stored the entry of the running kernel again */
+    fail_unless(g_file_get_contents(path, &rewritten, NULL, NULL), "failed to read the init cache entry");
+    fail_unless(!strcmp(rewritten, entry), "the stale init cache entry was not replaced");
+
+    g_free(rewritten);
+    g_free(stale);
+    g_free(entry);
+    g_free(path);
+    init_cache_remove(cache_dir);
+}
+END_TEST
+
+/* test that a clone reads the same as the instance, and outlives it */
+START_TEST (test_libvmi_clone)
+{
+    vmi_instance_t vmi = NULL, clone = NULL;
+    addr_t kpgd = 0, clone_kpgd = 0;
+    uint64_t value = 0, clone_value = 0;
+
+    fail_unless(VMI_SUCCESS == vmi_init_complete(&vmi, (void*)get_testvm(), VMI_INIT_DOMAINNAME, NULL,
+                VMI_CONFIG_GLOBAL_FILE_ENTRY, NULL, NULL),
+                "vmi_init_complete failed");
+    fail_unless(VMI_SUCCESS == vmi_clone(vmi, &clone), "vmi_clone failed");
+    fail_unless(clone != NULL && clone != vmi, "vmi_clone didn't create an instance");
+
+    fail_unless(vmi_get_ostype(vmi) == vmi_get_ostype(clone), "OS type differs in the clone");
+    vmi_get_offset(vmi, "kpgd", &kpgd);
+    vmi_get_offset(clone, "kpgd", &clone_kpgd);
+    fail_unless(kpgd == clone_kpgd, "kpgd differs in the clone");
+
+    fail_unless(VMI_SUCCESS == vmi_read_64_pa(vmi, kpgd, &value), "vmi_read_64_pa failed");
     vmi_destroy(vmi);
+
+    fail_unless(VMI_SUCCESS == vmi_read_64_pa(clone, kpgd, &clone_value),
+                "vmi_read_64_pa failed on the clone");
+    fail_unless(value == clone_value, "the clone reads different memory");
+    vmi_destroy(clone);
 }
 END_TEST
 
@@ -214,12 +630,17 @@ TCase *init_tcase (void)
     TCase *tc_init = tcase_create("LibVMI Init");
     tcase_add_test(tc_init, test_libvmi_init1);
     tcase_add_test(tc_init, test_libvmi_init2);
+    tcase_add_test(tc_init, test_libvmi_init6);
+    tcase_add_test(tc_init, test_libvmi_init7);
+    tcase_add_test(tc_init, test_libvmi_clone);
 #ifdef ENABLE_INIT3_TEST
     tcase_add_test(tc_init, test_libvmi_init3);
 #endif
 
 #ifdef REKALL_PROFILES
     tcase_add_test(tc_init, test_libvmi_init4);
+    tcase_add_test(tc_init, test_libvmi_init5);
+    tcase_add_test(tc_init, test_libvmi_binary_profile);
 #endif
 
     return tc_init;
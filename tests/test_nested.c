@@ -0,0 +1,187 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <libvmi/libvmi.h>
+#include "check_tests.h"
+
+/*
+ * A synthetic guest for the in-memory driver. The guest maps the 2MB page
+ * at guest physical 0x200000 to the same virtual address with a single PDE,
+ * while the EPT backs the first pages of it with 4KB host frames in reverse
+ * order, so a read or write that runs from one guest page into the next
+ * has to be translated again:
+ *
+ *   host 0x1000-0x5fff     EPT PML4, PDPT, PD and two PTs
+ *   host 0x10000-0x12fff   guest PML4, PDPT and PD (guest physical 0x1000-0x3fff)
+ *   host 0x20000-0x23fff   guest physical 0x203000-0x200000, in that order
+ */
+#define GUEST_PAGE      0x1000
+#define GUEST_SIZE      0x24000
+#define GUEST_VA        0x200000ull
+#define GUEST_PAGES     4
+#define GUEST_CR3       0x1000ull
+#define GUEST_EPT       0x1000ull
+
+#define ENTRY(addr)     ((uint64_t)(addr) | 0x7)
+#define ENTRY_2MB(addr) ((uint64_t)(addr) | 0x87)
+
+static inline addr_t
+guest_frame(unsigned int page)
+{
+    return 0x20000 + (GUEST_PAGES - 1 - page) * GUEST_PAGE;
+}
+
+static inline void
+guest_entry(unsigned char *image, addr_t table, unsigned int index, uint64_t entry)
+{
+    memcpy(image + table + index * sizeof(uint64_t), &entry, sizeof(entry));
+}
+
+/* writes the image and its description, returns the path of the latter */
+static char *
+guest_create(char *dir, unsigned char *image)
+{
+    char *path = malloc(strlen(dir) + 32);
+    unsigned int i;
+    FILE *f;
+
+    fail_unless(mkdtemp(dir) != NULL, "failed to create the guest directory");
+
+    memset(image, 0, GUEST_SIZE);
+
+    /* EPT: guest physical 0-2MB through the PT at 0x4000, 2-4MB through 0x5000 */
+    guest_entry(image, 0x1000, 0, ENTRY(0x2000));
+    guest_entry(image, 0x2000, 0, ENTRY(0x3000));
+    guest_entry(image, 0x3000, 0, ENTRY(0x4000));
+    guest_entry(image, 0x3000, 1, ENTRY(0x5000));
+    for (i = 1; i < 4; i++)
+        guest_entry(image, 0x4000, i, ENTRY(0x10000 + (i - 1) * GUEST_PAGE));
+    for (i = 0; i < GUEST_PAGES; i++)
+        guest_entry(image, 0x5000, i, ENTRY(guest_frame(i)));
+
+    /* guest page tables, at guest physical 0x1000-0x3fff */
+    guest_entry(image, 0x10000, 0, ENTRY(0x2000));
+    guest_entry(image, 0x11000, 0, ENTRY(0x3000));
+    guest_entry(image, 0x12000, 1, ENTRY_2MB(GUEST_VA));
+
+    /* every byte of guest memory tells its offset in the 2MB page */
+    for (i = 0; i < GUEST_PAGES * GUEST_PAGE; i++)
+        image[guest_frame(i / GUEST_PAGE) + i % GUEST_PAGE] = (unsigned char)(i ^ (i >> 8));
+
+    sprintf(path, "%s/guest.raw", dir);
+    f = fopen(path, "wb");
+    fail_unless(f && fwrite(image, 1, GUEST_SIZE, f) == GUEST_SIZE, "failed to write the guest image");
+    fclose(f);
+
+    sprintf(path, "%s/guest.ini", dir);
+    f = fopen(path, "w");
+    fail_unless(f != NULL, "failed to write the guest description");
+    fprintf(f, "[memory]\nimage=guest.raw\n");
+    fclose(f);
+
+    return path;
+}
+
+static void
+guest_remove(const char *dir, char *path)
+{
+    sprintf(path, "%s/guest.raw", dir);
+    unlink(path);
+    sprintf(path, "%s/guest.ini", dir);
+    unlink(path);
+    rmdir(dir);
+    free(path);
+}
+
+/* test reads and writes of a large guest page that the EPT maps in 4KB pages */
+START_TEST (test_libvmi_nested_large_page)
+{
+    char dir[] = "/tmp/libvmi_check_nestedXXXXXX";
+    unsigned char *image = malloc(GUEST_SIZE);
+    unsigned char buf[3 * GUEST_PAGE], expected[3 * GUEST_PAGE];
+    vmi_instance_t vmi = NULL;
+    size_t bytes = 0;
+    addr_t pa = 0, na = 0;
+    unsigned int i;
+    char *path = guest_create(dir, image);
+
+    fail_unless(VMI_SUCCESS == vmi_init(&vmi, VMI_MEM, path, VMI_INIT_DOMAINNAME, NULL, NULL),
+                "failed to open the synthetic guest");
+
+    ACCESS_CONTEXT(ctx,
+                   .translate_mechanism = VMI_TM_PROCESS_DTB,
+                   .addr = GUEST_VA + GUEST_PAGE / 2,
+                   .dtb = GUEST_CR3,
+                   .pm = VMI_PM_IA32E,
+                   .npt = GUEST_EPT,
+                   .npm = VMI_PM_EPT_4L);
+
+    /* the nested translation of an address resolved before must not be reused for the next page */
+    for (i = 0; i < GUEST_PAGES; i++) {
+        fail_unless(VMI_SUCCESS == vmi_nested_pagetable_lookup(vmi, GUEST_EPT, VMI_PM_EPT_4L, GUEST_CR3,
+                    VMI_PM_IA32E, GUEST_VA + i * GUEST_PAGE + 8, &pa, &na),
+                    "nested lookup failed");
+        fail_unless(na == guest_frame(i) + 8, "page %u translated to 0x%"PRIx64, i, na);
+    }
+
+    /* a read across the guest pages picks up each page from its own host frame */
+    for (i = 0; i < sizeof(expected); i++)
+        expected[i] = (unsigned char)((i + GUEST_PAGE / 2) ^ ((i + GUEST_PAGE / 2) >> 8));
+
+    fail_unless(VMI_SUCCESS == vmi_read(vmi, &ctx, sizeof(buf), buf, &bytes), "nested read failed");
+    fail_unless(bytes == sizeof(buf), "nested read was short");
+    fail_unless(!memcmp(buf, expected, sizeof(buf)), "nested read crossed into the wrong host frame");
+
+    /* and so does a write */
+    memset(buf, 0xa5, sizeof(buf));
+    fail_unless(VMI_SUCCESS == vmi_write(vmi, &ctx, sizeof(buf), buf, &bytes), "nested write failed");
+    fail_unless(bytes == sizeof(buf), "nested write was short");
+
+    for (i = 0; i < GUEST_PAGES; i++) {
+        unsigned char page[GUEST_PAGE];
+        size_t start = i ? 0 : GUEST_PAGE / 2;
+        size_t end = i < 3 ? GUEST_PAGE : GUEST_PAGE / 2;
+
+        fail_unless(VMI_SUCCESS == vmi_read_pa(vmi, guest_frame(i), GUEST_PAGE, page, NULL),
+                    "vmi_read_pa failed");
+
+        memcpy(expected, image + guest_frame(i), GUEST_PAGE);
+        memset(expected + start, 0xa5, end - start);
+        fail_unless(!memcmp(page, expected, GUEST_PAGE), "nested write went to the wrong host frame");
+    }
+
+    vmi_destroy(vmi);
+    guest_remove(dir, path);
+    free(image);
+}
+END_TEST
+
+/* nested paging test cases */
+TCase *nested_tcase (void)
+{
+    TCase *tc_nested = tcase_create("LibVMI nested paging");
+    tcase_add_test(tc_nested, test_libvmi_nested_large_page);
+    return tc_nested;
+}
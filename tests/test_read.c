@@ -23,6 +23,8 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 #include <libvmi/libvmi.h>
 #include "check_tests.h"
 
@@ -109,6 +111,149 @@ START_TEST (test_vmi_read_pa)
 }
 END_TEST
 
+START_TEST (test_vmi_readv)
+{
+    vmi_instance_t vmi = NULL;
+    char *buf = malloc(300);
+    char *expected = malloc(300);
+    read_request_t reqs[3];
+    int i;
+    vmi_init_complete(&vmi, (void*)get_testvm(), VMI_INIT_DOMAINNAME, NULL,
+                      VMI_CONFIG_GLOBAL_FILE_ENTRY, NULL, NULL);
+    ACCESS_CONTEXT(va_ctx,
+                   .translate_mechanism = VMI_TM_PROCESS_PID,
+                   .addr = get_vaddr(vmi),
+                   .pid = 0);
+    ACCESS_CONTEXT(pa_ctx, .addr = get_paddr(vmi));
+    ACCESS_CONTEXT(sym_ctx,
+                   .translate_mechanism = VMI_TM_KERNEL_SYMBOL,
+                   .ksym = get_sym(vmi));
+    reqs[0] = (read_request_t) { .ctx = &va_ctx, .count = 100, .buf = buf };
+    reqs[1] = (read_request_t) { .ctx = &pa_ctx, .count = 100, .buf = buf + 100 };
+    reqs[2] = (read_request_t) { .ctx = &sym_ctx, .count = 100, .buf = buf + 200 };
+    status_t rc = vmi_readv(vmi, reqs, 3);
+    fail_unless(VMI_SUCCESS == rc, "vmi_readv failed");
+    for (i = 0; i < 3; i++) {
+        fail_unless(reqs[i].bytes_read == 100, "vmi_readv short read");
+        fail_unless(VMI_SUCCESS == vmi_read(vmi, reqs[i].ctx, 100, expected + i * 100, NULL),
+                    "vmi_read failed");
+    }
+    fail_unless(!memcmp(buf, expected, 300), "vmi_readv data differs from vmi_read");
+    free(expected);
+    free(buf);
+    vmi_destroy(vmi);
+}
+END_TEST
+
+START_TEST (test_vmi_pin_page)
+{
+    vmi_instance_t vmi = NULL;
+    const void *data = NULL;
+    size_t length = 0;
+    page_pin_t pin = NULL;
+    char *buf = malloc(100);
+    vmi_init_complete(&vmi, (void*)get_testvm(), VMI_INIT_DOMAINNAME, NULL,
+                      VMI_CONFIG_GLOBAL_FILE_ENTRY, NULL, NULL);
+    ACCESS_CONTEXT(ctx, .addr = get_paddr(vmi));
+    status_t rc = vmi_pin_page(vmi, &ctx, &data, &length, &pin);
+    fail_unless(VMI_SUCCESS == rc, "vmi_pin_page failed");
+    fail_unless(length > 0, "vmi_pin_page returned an empty page");
+    if (length > 100)
+        length = 100;
+    rc = vmi_read(vmi, &ctx, length, buf, NULL);
+    fail_unless(VMI_SUCCESS == rc, "vmi_read failed");
+    fail_unless(!memcmp(buf, data, length), "pinned page differs from vmi_read");
+    vmi_unpin_page(vmi, pin);
+    free(buf);
+    vmi_destroy(vmi);
+}
+END_TEST
+
+static bool scan_cb(vmi_instance_t vmi, addr_t addr, unsigned int pattern, void *data)
+{
+    addr_t *found = (addr_t *) data;
+    (void) vmi;
+    if (pattern == 0 && addr == found[0])
+        found[1] = 1;
+    return !found[1];
+}
+
+START_TEST (test_vmi_scan_memory)
+{
+    vmi_instance_t vmi = NULL;
+    uint8_t *buf = malloc(16);
+    addr_t found[2];
+    vmi_init_complete(&vmi, (void*)get_testvm(), VMI_INIT_DOMAINNAME, NULL,
+                      VMI_CONFIG_GLOBAL_FILE_ENTRY, NULL, NULL);
+    found[0] = get_paddr(vmi);
+    found[1] = 0;
+    status_t rc = vmi_read_pa(vmi, found[0], 16, buf, NULL);
+    fail_unless(VMI_SUCCESS == rc, "vmi_read_pa failed");
+    scan_pattern_t pattern = { .data = buf, .length = 16 };
+    ACCESS_CONTEXT(ctx, .addr = found[0] & ~0xfffull);
+    rc = vmi_scan_memory(vmi, &ctx, 0x2000, &pattern, 1, 2, scan_cb, found);
+    fail_unless(VMI_SUCCESS == rc, "vmi_scan_memory failed");
+    fail_unless(found[1], "vmi_scan_memory missed the pattern");
+    free(buf);
+    vmi_destroy(vmi);
+}
+END_TEST
+
+#define CONCURRENT_THREADS 4
+
+struct concurrent_read {
+    vmi_instance_t vmi;
+    addr_t va;
+    const char *expected;
+    bool ok;
+};
+
+static void *
+concurrent_read_thread(void *arg)
+{
+    struct concurrent_read *r = arg;
+    char buf[100];
+    int i;
+
+    r->ok = true;
+    for (i = 0; i < 1000 && r->ok; i++) {
+        if (VMI_FAILURE == vmi_read_va(r->vmi, r->va, 0, sizeof(buf), buf, NULL) ||
+                memcmp(buf, r->expected, sizeof(buf)))
+            r->ok = false;
+        if (!(i % 100))
+            vmi_v2pcache_flush(r->vmi, ~0ull);
+    }
+    return NULL;
+}
+
+START_TEST (test_vmi_read_concurrent)
+{
+    vmi_instance_t vmi = NULL;
+    char expected[100];
+    pthread_t threads[CONCURRENT_THREADS];
+    struct concurrent_read reads[CONCURRENT_THREADS];
+    addr_t va;
+    int i;
+    status_t rc = vmi_init_complete(&vmi, (void*)get_testvm(),
+                                    VMI_INIT_DOMAINNAME | VMI_INIT_CONCURRENT, NULL,
+                                    VMI_CONFIG_GLOBAL_FILE_ENTRY, NULL, NULL);
+    fail_unless(VMI_SUCCESS == rc, "vmi_init_complete with VMI_INIT_CONCURRENT failed");
+    va = get_vaddr(vmi);
+    fail_unless(VMI_SUCCESS == vmi_read_va(vmi, va, 0, sizeof(expected), expected, NULL),
+                "vmi_read_va failed");
+    for (i = 0; i < CONCURRENT_THREADS; i++) {
+        reads[i] = (struct concurrent_read) { .vmi = vmi, .va = va, .expected = expected };
+        fail_unless(!pthread_create(&threads[i], NULL, concurrent_read_thread, &reads[i]),
+                    "pthread_create failed");
+    }
+    for (i = 0; i < CONCURRENT_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        fail_unless(reads[i].ok, "concurrent read differs from vmi_read_va");
+    }
+    vmi_destroy(vmi);
+}
+END_TEST
+
 START_TEST (test_vmi_read_8_ksym)
 {
     vmi_instance_t vmi = NULL;
@@ -296,6 +441,10 @@ TCase *read_tcase (void)
     tcase_add_test(tc_read, test_vmi_read_ksym);
     tcase_add_test(tc_read, test_vmi_read_va);
     tcase_add_test(tc_read, test_vmi_read_pa);
+    tcase_add_test(tc_read, test_vmi_readv);
+    tcase_add_test(tc_read, test_vmi_pin_page);
+    tcase_add_test(tc_read, test_vmi_scan_memory);
+    tcase_add_test(tc_read, test_vmi_read_concurrent);
 
     tcase_add_test(tc_read, test_vmi_read_8_ksym);
     tcase_add_test(tc_read, test_vmi_read_16_ksym);
@@ -22,6 +22,7 @@
  * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdlib.h>
 #include <check.h>
 #include <libvmi/libvmi.h>
 #include "check_tests.h"
@@ -98,6 +99,76 @@ done:
 END_TEST
 
 
+/* test vmi_dtb_to_pid against the process index */
+START_TEST (test_libvmi_dtbpid)
+{
+    vmi_instance_t vmi = NULL;
+    vmi_pid_t pid = 0, found = -1;
+    addr_t dtb = 0;
+
+    vmi_init_complete(&vmi, (void*)get_testvm(), VMI_INIT_DOMAINNAME, NULL,
+                      VMI_CONFIG_GLOBAL_FILE_ENTRY, NULL, NULL);
+
+    switch (vmi_get_ostype(vmi)) {
+        case VMI_OS_LINUX:
+            pid = 1;
+            break;
+        case VMI_OS_WINDOWS:
+            pid = 4;
+            break;
+        default:
+            goto done;
+    }
+
+    fail_unless(VMI_SUCCESS == vmi_pidcache_refresh(vmi), "process index refresh failed");
+    fail_unless(VMI_SUCCESS == vmi_pid_to_dtb(vmi, pid, &dtb), "pid_to_dtb failed");
+    fail_unless(VMI_SUCCESS == vmi_dtb_to_pid(vmi, dtb, &found), "dtb_to_pid failed");
+    fail_unless(found == pid, "dtb_to_pid returned the wrong pid");
+
+    /* stale after a new epoch, the lookup walks the list again */
+    vmi_v2pcache_bump_epoch(vmi);
+    found = -1;
+    fail_unless(VMI_SUCCESS == vmi_dtb_to_pid(vmi, dtb, &found) && found == pid,
+                "dtb_to_pid failed after epoch bump");
+
+done:
+    vmi_destroy(vmi);
+}
+END_TEST
+
+/* test vmi_get_process_list */
+START_TEST (test_libvmi_process_list)
+{
+    vmi_instance_t vmi = NULL;
+    vmi_process_t *processes = NULL;
+    size_t count = 0, i;
+    addr_t dtb = 0;
+    int found = 0;
+
+    vmi_init_complete(&vmi, (void*)get_testvm(), VMI_INIT_DOMAINNAME, NULL,
+                      VMI_CONFIG_GLOBAL_FILE_ENTRY, NULL, NULL);
+
+    fail_unless(VMI_SUCCESS == vmi_get_process_list(vmi, &processes, &count),
+                "vmi_get_process_list failed");
+    fail_unless(count > 0, "empty process list");
+
+    for (i = 0; i < count; i++) {
+        if (!processes[i].pid || !processes[i].dtb ||
+                (processes[i].flags & VMI_PROCESS_KERNEL_THREAD))
+            continue;
+
+        fail_unless(VMI_SUCCESS == vmi_pid_to_dtb(vmi, processes[i].pid, &dtb) &&
+                    dtb == processes[i].dtb, "process list and pid_to_dtb disagree");
+        found = 1;
+        break;
+    }
+
+    free(processes);
+    vmi_destroy(vmi);
+    fail_unless(found, "no process with a dtb in the list");
+}
+END_TEST
+
 START_TEST (test_libvmi_invalid_pid)
 {
     vmi_instance_t vmi = NULL;
@@ -196,6 +267,8 @@ TCase *translate_tcase (void)
     // uv2p
     tcase_add_test(tc_translate, test_libvmi_kv2p);
     tcase_add_test(tc_translate, test_libvmi_piddtb);
+    tcase_add_test(tc_translate, test_libvmi_dtbpid);
+    tcase_add_test(tc_translate, test_libvmi_process_list);
     tcase_add_test(tc_translate, test_libvmi_invalid_pid);
     return tc_translate;
 }
@@ -0,0 +1,827 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Hermetic benchmarks: builds synthetic guests (see guest.c), opens them
+ * with the file or the mem driver and times reads, translations, symbol
+ * lookups, process list walks and scans on them. Results go out as JSON,
+ * one entry per guest and benchmark with the median and fastest of the
+ * repetitions:
+ *
+ *   vmi-benchmark -o results.json
+ *   vmi-benchmark --guest linux-pae --memory 128 --repeat 3 --mmap
+ *   vmi-benchmark --driver mem --latency 2000 --jitter 500
+ *
+ * The mem driver charges the latency on every call, as a hypervisor would,
+ * so it shows what the caches, batching and prefetching are worth.
+ *
+ * Every benchmark also checks its results against what the guest was built
+ * with, and the exit status is non-zero if any of them failed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <glib/gstdio.h>
+
+#include "guest.h"
+#include "image.h"
+
+#define REPEAT_DEFAULT      5
+#define REPEAT_MAX          100
+#define MEMORY_DEFAULT      256         /**< MB */
+
+#define OPS_RANDOM          100000      /**< random reads, translations, PID lookups */
+#define OPS_WARM_SET        256         /**< addresses the warm translations cycle through */
+#define OPS_PROCESS_LIST    50
+#define READ_CHUNK          (64 * 1024)
+
+/* What a benchmark needs from the guest */
+#define NEEDS_OS            (1u << 0)   /**< an initialized OS */
+#define NEEDS_X86           (1u << 1)   /**< x86 paging, for vmi_walk_va_pages */
+#define NEEDS_PAGING        (1u << 2)   /**< a known paging mode, to translate */
+
+typedef struct options {
+    vmi_mode_t mode;                /**< VMI_FILE or VMI_MEM */
+    uint32_t file_mode;             /**< VMI_FILE_* */
+    uint64_t latency;               /**< of the mem driver, in ns */
+    uint64_t jitter;
+    unsigned int ops;               /**< operations of the random benchmarks */
+    unsigned int repeat;
+    uint64_t seed;
+} options_t;
+
+typedef struct bench {
+    vmi_instance_t vmi;
+    guest_t *guest;
+    unsigned int ops;               /**< operations of the random benchmarks */
+
+    addr_t *pa;                     /**< random physical addresses */
+    addr_t *va;                     /**< random kernel addresses... */
+    addr_t *va_pa;                  /**< ...and what they translate to */
+    unsigned int *symbols;          /**< symbols in random order */
+    vmi_pid_t *pids;                /**< random PIDs */
+    uint8_t *buf;
+} bench_t;
+
+typedef status_t (*bench_fn_t)(bench_t *b, uint64_t *ops, uint64_t *bytes);
+
+typedef struct benchmark {
+    const char *name;
+    bench_fn_t fn;
+    uint32_t needs;
+} benchmark_t;
+
+static inline uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static status_t
+bench_read_pa_seq(
+    bench_t *b,
+    uint64_t *ops,
+    uint64_t *bytes)
+{
+    addr_t pa;
+
+    for (pa = 0; pa < b->guest->memory_size; pa += READ_CHUNK) {
+        if (VMI_FAILURE == vmi_read_pa(b->vmi, pa, READ_CHUNK, b->buf, NULL))
+            return VMI_FAILURE;
+    }
+
+    *ops = b->guest->memory_size / READ_CHUNK;
+    *bytes = b->guest->memory_size;
+    return VMI_SUCCESS;
+}
+
+static status_t
+bench_read_pa_random(
+    bench_t *b,
+    uint64_t *ops,
+    uint64_t *bytes)
+{
+    uint64_t value;
+    unsigned int i;
+
+    (void) bytes;
+
+    for (i = 0; i < b->ops; i++) {
+        if (VMI_FAILURE == vmi_read_64_pa(b->vmi, b->pa[i], &value))
+            return VMI_FAILURE;
+    }
+
+    *ops = b->ops;
+    return VMI_SUCCESS;
+}
+
+/* The kernel image, through its 4KB pages */
+static status_t
+bench_read_va_seq(
+    bench_t *b,
+    uint64_t *ops,
+    uint64_t *bytes)
+{
+    ACCESS_CONTEXT(ctx, .translate_mechanism = VMI_TM_PROCESS_DTB, .pm = b->guest->pm, .dtb = b->guest->kpgd);
+    addr_t offset;
+
+    for (offset = 0; offset < b->guest->kernel_size; offset += READ_CHUNK) {
+        ctx.addr = b->guest->kernel_va + offset;
+        if (VMI_FAILURE == vmi_read(b->vmi, &ctx, READ_CHUNK, b->buf, NULL))
+            return VMI_FAILURE;
+    }
+
+    *ops = b->guest->kernel_size / READ_CHUNK;
+    *bytes = b->guest->kernel_size;
+    return VMI_SUCCESS;
+}
+
+static status_t
+bench_read_va_random(
+    bench_t *b,
+    uint64_t *ops,
+    uint64_t *bytes)
+{
+    ACCESS_CONTEXT(ctx, .translate_mechanism = VMI_TM_PROCESS_DTB, .pm = b->guest->pm, .dtb = b->guest->kpgd);
+    uint64_t value;
+    unsigned int i;
+
+    (void) bytes;
+
+    for (i = 0; i < b->ops; i++) {
+        ctx.addr = b->va[i];
+        if (VMI_FAILURE == vmi_read_64(b->vmi, &ctx, &value))
+            return VMI_FAILURE;
+    }
+
+    *ops = b->ops;
+    return VMI_SUCCESS;
+}
+
+/* Every lookup walks the page tables, nothing is left in the address caches */
+static status_t
+bench_translate_cold(
+    bench_t *b,
+    uint64_t *ops,
+    uint64_t *bytes)
+{
+    addr_t pa;
+    unsigned int i;
+
+    (void) bytes;
+
+    for (i = 0; i < b->ops; i++) {
+        vmi_v2pcache_bump_epoch(b->vmi);
+        if (VMI_FAILURE == vmi_pagetable_lookup(b->vmi, b->guest->kpgd, b->va[i], &pa) || pa != b->va_pa[i])
+            return VMI_FAILURE;
+    }
+
+    *ops = b->ops;
+    return VMI_SUCCESS;
+}
+
+static status_t
+bench_translate_warm(
+    bench_t *b,
+    uint64_t *ops,
+    uint64_t *bytes)
+{
+    addr_t pa;
+    unsigned int i, j;
+
+    (void) bytes;
+
+    for (i = 0; i < b->ops; i++) {
+        j = i % OPS_WARM_SET;
+        if (VMI_FAILURE == vmi_pagetable_lookup(b->vmi, b->guest->kpgd, b->va[j], &pa) || pa != b->va_pa[j])
+            return VMI_FAILURE;
+    }
+
+    *ops = b->ops;
+    return VMI_SUCCESS;
+}
+
+static status_t
+bench_ksym(
+    bench_t *b,
+    bool cold)
+{
+    guest_t *guest = b->guest;
+    char name[64];
+    addr_t va;
+    unsigned int i, symbol;
+
+    if (cold)
+        vmi_symcache_flush(b->vmi);
+
+    for (i = 0; i < guest->symbols; i++) {
+        symbol = b->symbols[i];
+        guest_symbol(guest, symbol, name, sizeof(name));
+
+        if (VMI_FAILURE == vmi_translate_ksym2v(b->vmi, name, &va) ||
+                va != guest->symbol_base + symbol * guest->symbol_stride)
+            return VMI_FAILURE;
+    }
+
+    return VMI_SUCCESS;
+}
+
+/* Every symbol once, after the symbol cache was emptied */
+static status_t
+bench_ksym_cold(
+    bench_t *b,
+    uint64_t *ops,
+    uint64_t *bytes)
+{
+    (void) bytes;
+
+    *ops = b->guest->symbols;
+    return bench_ksym(b, true);
+}
+
+static status_t
+bench_ksym_warm(
+    bench_t *b,
+    uint64_t *ops,
+    uint64_t *bytes)
+{
+    (void) bytes;
+
+    *ops = b->guest->symbols;
+    return bench_ksym(b, false);
+}
+
+static status_t
+bench_process_list(
+    bench_t *b,
+    uint64_t *ops,
+    uint64_t *bytes)
+{
+    vmi_process_t *processes;
+    size_t count;
+    unsigned int i;
+
+    (void) bytes;
+
+    for (i = 0; i < OPS_PROCESS_LIST; i++) {
+        if (VMI_FAILURE == vmi_get_process_list(b->vmi, &processes, &count))
+            return VMI_FAILURE;
+
+        free(processes);
+        if (count != b->guest->processes)
+            return VMI_FAILURE;
+    }
+
+    *ops = OPS_PROCESS_LIST;
+    return VMI_SUCCESS;
+}
+
+static status_t
+bench_pid_to_dtb(
+    bench_t *b,
+    uint64_t *ops,
+    uint64_t *bytes)
+{
+    addr_t dtb;
+    unsigned int i;
+
+    (void) bytes;
+
+    for (i = 0; i < b->ops; i++) {
+        if (VMI_FAILURE == vmi_pid_to_dtb(b->vmi, b->pids[i], &dtb))
+            return VMI_FAILURE;
+    }
+
+    *ops = b->ops;
+    return VMI_SUCCESS;
+}
+
+static bool
+walk_count_cb(
+    vmi_instance_t vmi,
+    const vmi_va_range_t *range,
+    void *data)
+{
+    (void) vmi;
+    (void) range;
+
+    (*(uint64_t *) data)++;
+    return true;
+}
+
+/* The kernel address space, one callback per run of mappings */
+static status_t
+bench_walk_kernel(
+    bench_t *b,
+    uint64_t *ops,
+    uint64_t *bytes)
+{
+    addr_t end = VMI_PM_PAE == b->guest->pm ? 0xffffffffull : ~0ull;
+
+    (void) bytes;
+
+    *ops = 0;
+    return vmi_walk_va_pages(b->vmi, 0, VMI_PM_NONE, b->guest->kpgd, b->guest->pm, 0, end,
+                             VMI_WALK_COALESCE, walk_count_cb, ops);
+}
+
+static bool
+scan_count_cb(
+    vmi_instance_t vmi,
+    addr_t addr,
+    unsigned int pattern,
+    void *data)
+{
+    (void) vmi;
+    (void) addr;
+    (void) pattern;
+
+    (*(unsigned int *) data)++;
+    return true;
+}
+
+static status_t
+bench_scan_pa(
+    bench_t *b,
+    uint64_t *ops,
+    uint64_t *bytes)
+{
+    const scan_pattern_t pattern = {
+        .data = (const uint8_t *) GUEST_SCAN_PATTERN,
+        .length = strlen(GUEST_SCAN_PATTERN),
+    };
+    unsigned int hits = 0;
+    ACCESS_CONTEXT(ctx, .translate_mechanism = VMI_TM_NONE);
+
+    if (VMI_FAILURE == vmi_scan_memory(b->vmi, &ctx, b->guest->memory_size, &pattern, 1, 0,
+                                       scan_count_cb, &hits))
+        return VMI_FAILURE;
+
+    *ops = 1;
+    *bytes = b->guest->memory_size;
+    return hits == b->guest->scan_hits ? VMI_SUCCESS : VMI_FAILURE;
+}
+
+static const benchmark_t benchmarks[] = {
+    { "read_pa_seq", bench_read_pa_seq, 0 },
+    { "read_pa_random", bench_read_pa_random, 0 },
+    { "read_va_seq", bench_read_va_seq, NEEDS_PAGING },
+    { "read_va_random", bench_read_va_random, NEEDS_PAGING },
+    { "translate_cold", bench_translate_cold, NEEDS_PAGING },
+    { "translate_warm", bench_translate_warm, NEEDS_PAGING },
+    { "ksym_cold", bench_ksym_cold, NEEDS_OS },
+    { "ksym_warm", bench_ksym_warm, NEEDS_OS },
+    { "process_list", bench_process_list, NEEDS_OS },
+    { "pid_to_dtb", bench_pid_to_dtb, NEEDS_OS },
+    { "walk_kernel", bench_walk_kernel, NEEDS_PAGING | NEEDS_X86 },
+    { "scan_pa", bench_scan_pa, 0 },
+};
+
+/* Random inputs, drawn before anything is timed */
+static void
+bench_setup(
+    bench_t *b,
+    uint64_t seed)
+{
+    guest_t *guest = b->guest;
+    unsigned int i, j, tmp;
+    addr_t offset;
+
+    b->pa = g_malloc(b->ops * sizeof(addr_t));
+    b->va = g_malloc(b->ops * sizeof(addr_t));
+    b->va_pa = g_malloc(b->ops * sizeof(addr_t));
+    b->pids = g_malloc(b->ops * sizeof(vmi_pid_t));
+    b->symbols = g_malloc((guest->symbols + 1) * sizeof(unsigned int));
+    b->buf = g_malloc(READ_CHUNK);
+
+    for (i = 0; i < b->ops; i++) {
+        b->pa[i] = (image_random(&seed) % guest->memory_size) & ~7ull;
+
+        /* half in the kernel image, half anywhere in the direct map */
+        if (i & 1) {
+            offset = (image_random(&seed) % guest->kernel_size) & ~7ull;
+            b->va[i] = guest->kernel_va + offset;
+            b->va_pa[i] = guest->kernel_pa + offset;
+        } else {
+            b->va[i] = guest->direct_map + b->pa[i];
+            b->va_pa[i] = b->pa[i];
+        }
+
+        /* the init task has no address space of its own */
+        if (guest->processes > 1)
+            b->pids[i] = guest_pid(guest, 1 + image_random(&seed) % (guest->processes - 1));
+    }
+
+    for (i = 0; i < guest->symbols; i++)
+        b->symbols[i] = i;
+
+    for (i = guest->symbols; i > 1; i--) {
+        j = image_random(&seed) % i;
+        tmp = b->symbols[i - 1];
+        b->symbols[i - 1] = b->symbols[j];
+        b->symbols[j] = tmp;
+    }
+}
+
+static void
+bench_teardown(
+    bench_t *b)
+{
+    g_free(b->pa);
+    g_free(b->va);
+    g_free(b->va_pa);
+    g_free(b->pids);
+    g_free(b->symbols);
+    g_free(b->buf);
+}
+
+static status_t
+bench_init(
+    bench_t *b,
+    const options_t *options)
+{
+    vmi_init_data_t *init_data = g_malloc0(sizeof(vmi_init_data_t) + sizeof(vmi_init_data_entry_t));
+    uint32_t file_mode = options->file_mode;
+    vmi_init_error_t error;
+    status_t ret = VMI_FAILURE;
+
+    init_data->count = 1;
+    init_data->entry[0].type = VMI_INIT_DATA_FILE_MODE;
+    init_data->entry[0].data = &file_mode;
+
+    if (VMI_FAILURE == vmi_init(&b->vmi, options->mode,
+                                VMI_MEM == options->mode ? b->guest->description_path : b->guest->image_path,
+                                VMI_INIT_DOMAINNAME, VMI_MEM == options->mode ? NULL : init_data, &error)) {
+        fprintf(stderr, "%s: failed to open the image (error %d)\n", b->guest->name, error);
+        goto done;
+    }
+
+    /* the mem driver has the registers to tell, also without an OS */
+    if (VMI_MEM == options->mode && VMI_PM_UNKNOWN == vmi_init_paging(b->vmi, 0)) {
+        fprintf(stderr, "%s: failed to initialize paging\n", b->guest->name);
+        vmi_destroy(b->vmi);
+        b->vmi = NULL;
+        goto done;
+    }
+
+    if (b->guest->config &&
+            VMI_OS_UNKNOWN == vmi_init_os(b->vmi, VMI_CONFIG_GHASHTABLE, b->guest->config, &error)) {
+        fprintf(stderr, "%s: failed to initialize the OS (error %d)\n", b->guest->name, error);
+        vmi_destroy(b->vmi);
+        b->vmi = NULL;
+        goto done;
+    }
+
+    ret = VMI_SUCCESS;
+
+done:
+    g_free(init_data);
+    return ret;
+}
+
+static int
+compare_u64(
+    const void *a,
+    const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void
+print_result(
+    FILE *out,
+    const char *name,
+    uint64_t ops,
+    uint64_t bytes,
+    uint64_t *nsec,
+    unsigned int repeat,
+    bool first)
+{
+    uint64_t median, fastest;
+
+    qsort(nsec, repeat, sizeof(uint64_t), compare_u64);
+    median = nsec[repeat / 2];
+    fastest = nsec[0];
+
+    fprintf(out, "%s\n        { \"name\": \"%s\", \"ops\": %"PRIu64", \"bytes\": %"PRIu64
+            ", \"ns_median\": %"PRIu64", \"ns_min\": %"PRIu64", \"ns_per_op\": %.1f",
+            first ? "" : ",", name, ops, bytes, median, fastest, ops ? (double) median / ops : 0.0);
+
+    if (bytes)
+        fprintf(out, ", \"mb_per_s\": %.1f", median ? bytes * 1e3 / median : 0.0);
+
+    fprintf(out, " }");
+}
+
+static void
+print_stats(
+    FILE *out,
+    vmi_instance_t vmi)
+{
+    vmi_stats_t stats;
+
+    if (VMI_FAILURE == vmi_get_stats(vmi, &stats))
+        return;
+
+    fprintf(out, ",\n      \"stats\": { \"page_cache_hits\": %"PRIu64", \"page_cache_misses\": %"PRIu64
+            ", \"driver_page_fetches\": %"PRIu64", \"driver_nsec\": %"PRIu64", \"v2p_hits\": %"PRIu64
+            ", \"v2p_misses\": %"PRIu64", \"pt_cache_hits\": %"PRIu64", \"page_walk_reads\": %"PRIu64
+            ", \"sym_cache_hits\": %"PRIu64", \"sym_cache_misses\": %"PRIu64" }",
+            stats.page_cache_hits, stats.page_cache_misses, stats.driver_page_fetches, stats.driver_nsec,
+            stats.v2p_hits, stats.v2p_misses, stats.pt_cache_hits, stats.page_walk_reads,
+            stats.sym_cache_hits, stats.sym_cache_misses);
+}
+
+static const char *
+page_mode_name(
+    page_mode_t pm)
+{
+    switch (pm) {
+        case VMI_PM_LEGACY:
+            return "legacy";
+        case VMI_PM_PAE:
+            return "pae";
+        case VMI_PM_IA32E:
+            return "ia32e";
+        case VMI_PM_AARCH32:
+            return "aarch32";
+        case VMI_PM_AARCH64:
+            return "aarch64";
+        default:
+            return "unknown";
+    }
+}
+
+/* Runs every benchmark that applies to the guest, returns the number that failed */
+static unsigned int
+run_guest(
+    FILE *out,
+    guest_t *guest,
+    const options_t *options)
+{
+    bench_t b = { .guest = guest, .ops = options->ops };
+    unsigned int repeat = options->repeat;
+    uint64_t nsec[REPEAT_MAX], start, count = 0, bytes = 0;
+    unsigned int i, r, failed = 0;
+    uint32_t has = 0;
+
+    fprintf(out, "    {\n      \"name\": \"%s\",\n      \"page_mode\": \"%s\",\n      \"memory_size\": %zu,\n"
+            "      \"benchmarks\": [", guest->name, page_mode_name(guest->pm), guest->memory_size);
+
+    /* a fresh instance every time, the last one is kept for the benchmarks */
+    for (r = 0; r < repeat; r++) {
+        if (b.vmi) {
+            vmi_destroy(b.vmi);
+            b.vmi = NULL;
+        }
+
+        start = now_ns();
+        if (VMI_FAILURE == bench_init(&b, options)) {
+            fprintf(out, "\n      ]\n    }");
+            return G_N_ELEMENTS(benchmarks) + 1;
+        }
+        nsec[r] = now_ns() - start;
+    }
+
+    print_result(out, "init", 1, 0, nsec, repeat, true);
+
+    if (guest->config)
+        has |= NEEDS_OS;
+    if (VMI_PM_IA32E == guest->pm || VMI_PM_PAE == guest->pm)
+        has |= NEEDS_X86;
+    /* the file driver learns the paging mode from the OS only */
+    if (guest->pm == vmi_get_page_mode(b.vmi, 0))
+        has |= NEEDS_PAGING;
+
+    bench_setup(&b, options->seed);
+    vmi_reset_stats(b.vmi);
+
+    for (i = 0; i < G_N_ELEMENTS(benchmarks); i++) {
+        if ((benchmarks[i].needs & has) != benchmarks[i].needs)
+            continue;
+
+        count = bytes = 0;
+        for (r = 0; r < repeat; r++) {
+            start = now_ns();
+            if (VMI_FAILURE == benchmarks[i].fn(&b, &count, &bytes))
+                break;
+            nsec[r] = now_ns() - start;
+        }
+
+        if (r < repeat) {
+            fprintf(stderr, "%s: %s failed\n", guest->name, benchmarks[i].name);
+            failed++;
+            continue;
+        }
+
+        print_result(out, benchmarks[i].name, count, bytes, nsec, repeat, false);
+    }
+
+    fprintf(out, "\n      ]");
+    print_stats(out, b.vmi);
+    fprintf(out, "\n    }");
+
+    bench_teardown(&b);
+    vmi_destroy(b.vmi);
+
+    return failed;
+}
+
+static void
+usage(
+    const char *name)
+{
+    printf("Usage: %s [options]\n", name);
+    printf("\t -g/--guest <name>      guest to benchmark, may be repeated (default: all)\n");
+    printf("\t -m/--memory <MB>       guest memory size, at least 128 (default: %u)\n", MEMORY_DEFAULT);
+    printf("\t -r/--repeat <count>    repetitions of every benchmark (default: %u)\n", REPEAT_DEFAULT);
+    printf("\t -n/--ops <count>       operations of the random benchmarks (default: %u)\n", OPS_RANDOM);
+    printf("\t -s/--seed <seed>       seed of the guest contents and inputs\n");
+    printf("\t -d/--dir <path>        where to write the guest images (default: a temporary directory)\n");
+    printf("\t -o/--output <path>     write the results there instead of stdout\n");
+    printf("\t -M/--mmap              have the file driver map the images\n");
+    printf("\t -D/--driver <name>     file or mem (default: file)\n");
+    printf("\t -l/--latency <ns>      time every mem driver call takes (default: 0)\n");
+    printf("\t -j/--jitter <ns>       up to this much more, at random (default: 0)\n");
+    printf("\nGuests:");
+    for (const char **g = guest_names; *g; g++)
+        printf(" %s", *g);
+    printf("\n");
+}
+
+int
+main(
+    int argc,
+    char **argv)
+{
+    const struct option long_opts[] = {
+        {"guest", required_argument, NULL, 'g'},
+        {"memory", required_argument, NULL, 'm'},
+        {"repeat", required_argument, NULL, 'r'},
+        {"ops", required_argument, NULL, 'n'},
+        {"seed", required_argument, NULL, 's'},
+        {"dir", required_argument, NULL, 'd'},
+        {"output", required_argument, NULL, 'o'},
+        {"mmap", no_argument, NULL, 'M'},
+        {"driver", required_argument, NULL, 'D'},
+        {"latency", required_argument, NULL, 'l'},
+        {"jitter", required_argument, NULL, 'j'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    GPtrArray *names = g_ptr_array_new();
+    const char *dir = NULL, *output = NULL;
+    char *tmpdir = NULL;
+    size_t memory = MEMORY_DEFAULT;
+    options_t options = {
+        .mode = VMI_FILE,
+        .ops = OPS_RANDOM,
+        .repeat = REPEAT_DEFAULT,
+        .seed = 0x5eed,
+    };
+    unsigned int failed = 0, printed = 0, i;
+    FILE *out = stdout;
+    guest_t *guest;
+    int c, retcode = 1;
+
+    while ((c = getopt_long(argc, argv, "g:m:r:n:s:d:o:MD:l:j:h", long_opts, NULL)) != -1)
+        switch (c) {
+            case 'g':
+                g_ptr_array_add(names, optarg);
+                break;
+            case 'm':
+                memory = strtoull(optarg, NULL, 0);
+                break;
+            case 'r':
+                options.repeat = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                options.ops = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                options.seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'd':
+                dir = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'M':
+                options.file_mode |= VMI_FILE_MMAP;
+                break;
+            case 'D':
+                if (!strcmp(optarg, "mem"))
+                    options.mode = VMI_MEM;
+                else if (strcmp(optarg, "file")) {
+                    usage(argv[0]);
+                    goto done;
+                }
+                break;
+            case 'l':
+                options.latency = strtoull(optarg, NULL, 0);
+                break;
+            case 'j':
+                options.jitter = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                goto done;
+        }
+
+    /* xorshift gets stuck at zero */
+    if (!options.repeat || options.repeat > REPEAT_MAX || options.ops < OPS_WARM_SET || !options.seed) {
+        usage(argv[0]);
+        goto done;
+    }
+
+    if (!names->len) {
+        for (i = 0; guest_names[i]; i++)
+            g_ptr_array_add(names, (gpointer) guest_names[i]);
+    }
+
+    if (!dir) {
+        tmpdir = g_dir_make_tmp("vmi-benchmark-XXXXXX", NULL);
+        if (!tmpdir) {
+            fprintf(stderr, "Failed to create a temporary directory\n");
+            goto done;
+        }
+        dir = tmpdir;
+    }
+
+    if (output && !(out = fopen(output, "w"))) {
+        fprintf(stderr, "Failed to open %s\n", output);
+        out = stdout;
+        goto done;
+    }
+
+    fprintf(out, "{\n  \"seed\": %"PRIu64",\n  \"repeat\": %u,\n", options.seed, options.repeat);
+    if (VMI_MEM == options.mode)
+        fprintf(out, "  \"driver\": \"mem\",\n  \"latency_ns\": %"PRIu64",\n  \"jitter_ns\": %"PRIu64",\n",
+                options.latency, options.jitter);
+    else
+        fprintf(out, "  \"driver\": \"file\",\n  \"file_mode\": \"%s\",\n",
+                options.file_mode & VMI_FILE_MMAP ? "mmap" : "read");
+    fprintf(out, "  \"guests\": [\n");
+
+    for (i = 0; i < names->len; i++) {
+        guest = guest_new(g_ptr_array_index(names, i), dir, memory << 20, options.seed);
+        if (!guest) {
+            failed++;
+            continue;
+        }
+
+        if (VMI_MEM == options.mode &&
+                VMI_FAILURE == guest_write_description(guest, options.latency, options.jitter, options.seed)) {
+            guest_free(guest);
+            failed++;
+            continue;
+        }
+
+        if (printed++)
+            fprintf(out, ",\n");
+        failed += run_guest(out, guest, &options);
+        guest_free(guest);
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+
+    retcode = failed ? 1 : 0;
+
+done:
+    if (out != stdout)
+        fclose(out);
+    if (tmpdir) {
+        g_rmdir(tmpdir);
+        g_free(tmpdir);
+    }
+    g_ptr_array_free(names, TRUE);
+
+    return retcode;
+}
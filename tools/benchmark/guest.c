@@ -0,0 +1,581 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <libvmi/libvmi.h>
+#include <libvmi/peparse.h>
+
+#include "guest.h"
+#include "image.h"
+
+/*
+ * Physical layout shared by all guests: noise below the kernel, the kernel
+ * image at 16MB followed by page tables and process structures in the lower
+ * half of memory, and more noise with the scan pattern in the upper half.
+ */
+#define KERNEL_PA           0x1000000ull
+#define KERNEL_SIZE         0x400000ull
+
+/* Offsets into the kernel image */
+#define KERNEL_PGT          0x1000      /**< kernel page table root */
+#define KERNEL_INIT_TASK    0x2000      /**< Linux init_task */
+#define KERNEL_KDBG         0x2000      /**< Windows KdDebuggerDataBlock */
+#define KERNEL_PROCESS_HEAD 0x3000      /**< Windows PsActiveProcessHead */
+#define KERNEL_EXPORTS      0x10000     /**< Windows export directory */
+#define KERNEL_SYMBOLS      0x100000    /**< first symbol */
+
+#define SYMBOL_STRIDE       64
+#define SYMBOLS             4096
+#define PROCESSES           512
+#define SCAN_HITS           64
+
+#define USER_VA             0x400000ull
+
+/* Room for the process structures and their page tables below the upper half */
+#define MEMORY_MIN          (128ull << 20)
+
+/* A task_struct and its mm_struct share a page */
+#define LINUX_TASKS         0x40
+#define LINUX_MM            0x80        /**< active_mm follows */
+#define LINUX_PID           0xc0
+#define LINUX_NAME          0x100
+#define LINUX_MM_STRUCT     0x800
+#define LINUX_PGD           0x40
+
+/* Windows 7 SP1 x64 _EPROCESS */
+#define WIN_PDBASE          0x28
+#define WIN_PID             0x180
+#define WIN_TASKS           0x188
+#define WIN_PNAME           0x2e0
+
+/* KDDEBUGGER_DATA64 */
+#define KDBG_OWNER_TAG      0x10
+#define KDBG_SIZE           0x14
+#define KDBG_KERNBASE       0x18
+#define KDBG_PROCESS_HEAD   0x50
+#define KDBG_WINDOWS_7      0x340
+
+typedef struct layout {
+    const char *name;
+    os_t os;
+    page_mode_t pm;
+    addr_t kernel_va;
+    addr_t direct_map;
+} layout_t;
+
+static const layout_t layouts[] = {
+    { "linux-ia32e", VMI_OS_LINUX, VMI_PM_IA32E, 0xffffffff81000000ull, 0xffff888000000000ull },
+    { "linux-pae", VMI_OS_LINUX, VMI_PM_PAE, 0xc0000000ull + KERNEL_PA, 0xc0000000ull },
+    { "windows-ia32e", VMI_OS_WINDOWS, VMI_PM_IA32E, 0xfffff80002a00000ull, 0xfffffa8000000000ull },
+    { "aarch64", VMI_OS_UNKNOWN, VMI_PM_AARCH64, 0xffff800010000000ull, 0xffff000000000000ull },
+};
+
+const char *guest_names[] = {
+    "linux-ia32e",
+    "linux-pae",
+    "windows-ia32e",
+    "aarch64",
+    NULL
+};
+
+void
+guest_symbol(
+    guest_t *guest,
+    unsigned int i,
+    char *buf,
+    size_t len)
+{
+    (void) guest;
+
+    /* zero padded, so the names sort in symbol order */
+    snprintf(buf, len, "bench_symbol_%05u", i);
+}
+
+vmi_pid_t
+guest_pid(
+    guest_t *guest,
+    unsigned int i)
+{
+    /* the System process is 4 and Windows PIDs are multiples of 4 */
+    return VMI_OS_WINDOWS == guest->os ? (vmi_pid_t) (4 * (i + 1)) : (vmi_pid_t) i;
+}
+
+static void
+config_set_addr(
+    GHashTable *config,
+    const char *key,
+    addr_t value)
+{
+    addr_t *entry = g_malloc(sizeof(addr_t));
+
+    *entry = value;
+    g_hash_table_insert(config, (gpointer) key, entry);
+}
+
+static addr_t
+guest_va(
+    guest_t *guest,
+    addr_t pa)
+{
+    return guest->direct_map + pa;
+}
+
+/* The kernel image with 4KB pages, all of memory with 2MB pages around it */
+static status_t
+guest_map_kernel(
+    guest_t *guest,
+    image_t *image)
+{
+    addr_t direct_end = guest->direct_map + guest->memory_size;
+
+    if (VMI_FAILURE == image_map(image, guest->kpgd, guest->kernel_va, KERNEL_PA, KERNEL_SIZE, VMI_PS_4KB))
+        return VMI_FAILURE;
+
+    if (guest->kernel_va < guest->direct_map || guest->kernel_va >= direct_end)
+        return image_map(image, guest->kpgd, guest->direct_map, 0, guest->memory_size, VMI_PS_2MB);
+
+    /* 32-bit Linux runs its image out of the direct map */
+    if (VMI_FAILURE == image_map(image, guest->kpgd, guest->direct_map, 0, KERNEL_PA, VMI_PS_2MB))
+        return VMI_FAILURE;
+
+    return image_map(image, guest->kpgd, guest->kernel_va + KERNEL_SIZE, KERNEL_PA + KERNEL_SIZE,
+                     guest->memory_size - KERNEL_PA - KERNEL_SIZE, VMI_PS_2MB);
+}
+
+/* An address space with the kernel half and a page of user memory */
+static addr_t
+guest_new_process_root(
+    guest_t *guest,
+    image_t *image)
+{
+    addr_t root = image_new_root(image);
+    addr_t page = image_alloc(image, VMI_PS_4KB);
+
+    if (!root || !page)
+        return 0;
+
+    image_share_kernel(image, guest->kpgd, root);
+    if (VMI_FAILURE == image_map(image, root, USER_VA, page, VMI_PS_4KB, VMI_PS_4KB))
+        return 0;
+
+    return root;
+}
+
+static status_t
+guest_write_sysmap(
+    guest_t *guest)
+{
+    const char *phys_startup = "phys_startup_64", *startup = "startup_64", *pgt = "init_top_pgt";
+    int digits = 16;
+    char name[64];
+    unsigned int i;
+    status_t ret = VMI_SUCCESS;
+    FILE *f = fopen(guest->sysmap_path, "w");
+
+    if (!f)
+        return VMI_FAILURE;
+
+    if (VMI_PM_PAE == guest->pm) {
+        phys_startup = "phys_startup_32";
+        startup = "startup_32";
+        pgt = "swapper_pg_dir";
+        digits = 8;
+    }
+
+    fprintf(f, "%0*"PRIx64" A %s\n", digits, (uint64_t) KERNEL_PA, phys_startup);
+    fprintf(f, "%0*"PRIx64" T %s\n", digits, guest->kernel_va, startup);
+    fprintf(f, "%0*"PRIx64" T _text\n", digits, guest->kernel_va);
+    fprintf(f, "%0*"PRIx64" D %s\n", digits, guest->kernel_va + KERNEL_PGT, pgt);
+    fprintf(f, "%0*"PRIx64" D init_task\n", digits, guest->kernel_va + KERNEL_INIT_TASK);
+
+    for (i = 0; i < guest->symbols; i++) {
+        guest_symbol(guest, i, name, sizeof(name));
+        fprintf(f, "%0*"PRIx64" T %s\n", digits, guest->symbol_base + i * guest->symbol_stride, name);
+    }
+
+    if (ferror(f))
+        ret = VMI_FAILURE;
+
+    if (fclose(f))
+        ret = VMI_FAILURE;
+
+    return ret;
+}
+
+/*
+ * Appends the list entry at pa/va to a circular doubly linked list (Linux
+ * list_head, Windows LIST_ENTRY) whose last entry is at prev_pa/prev_va.
+ */
+static void
+guest_list_append(
+    image_t *image,
+    addr_t *prev_pa,
+    addr_t *prev_va,
+    addr_t pa,
+    addr_t va)
+{
+    image_write_addr(image, *prev_pa, va);
+    image_write_addr(image, pa + image_width(image), *prev_va);
+    *prev_pa = pa;
+    *prev_va = va;
+}
+
+static status_t
+guest_build_linux(
+    guest_t *guest,
+    image_t *image)
+{
+    unsigned int width = image_width(image), i;
+    addr_t init_task = KERNEL_PA + KERNEL_INIT_TASK;
+    addr_t head_pa = init_task + LINUX_TASKS, head_va = guest->kernel_va + KERNEL_INIT_TASK + LINUX_TASKS;
+    addr_t prev_pa = head_pa, prev_va = head_va;
+    addr_t task, mm, root;
+    vmi_pid_t pid;
+
+    /* the init task is a kernel thread, without mm */
+    pid = guest_pid(guest, 0);
+    memcpy(image_ptr(image, init_task + LINUX_PID), &pid, sizeof(pid));
+    strcpy(image_ptr(image, init_task + LINUX_NAME), "swapper/0");
+
+    for (i = 1; i < guest->processes; i++) {
+        task = image_alloc(image, VMI_PS_4KB);
+        root = guest_new_process_root(guest, image);
+        if (!task || !root)
+            return VMI_FAILURE;
+
+        mm = task + LINUX_MM_STRUCT;
+        pid = guest_pid(guest, i);
+        memcpy(image_ptr(image, task + LINUX_PID), &pid, sizeof(pid));
+        snprintf(image_ptr(image, task + LINUX_NAME), 16, "bench-%u", i);
+
+        /* mm, active_mm */
+        image_write_addr(image, task + LINUX_MM, guest_va(guest, mm));
+        image_write_addr(image, task + LINUX_MM + width, guest_va(guest, mm));
+        image_write_addr(image, mm + LINUX_PGD, guest_va(guest, root));
+
+        guest_list_append(image, &prev_pa, &prev_va, task + LINUX_TASKS, guest_va(guest, task + LINUX_TASKS));
+    }
+
+    guest_list_append(image, &prev_pa, &prev_va, head_pa, head_va);
+
+    guest->sysmap_path = g_strdup_printf("%s.map", guest->image_path);
+    if (VMI_FAILURE == guest_write_sysmap(guest))
+        return VMI_FAILURE;
+
+    guest->config = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+    g_hash_table_insert(guest->config, "ostype", g_strdup("Linux"));
+    g_hash_table_insert(guest->config, "sysmap", g_strdup(guest->sysmap_path));
+    config_set_addr(guest->config, "linux_tasks", LINUX_TASKS);
+    config_set_addr(guest->config, "linux_mm", LINUX_MM);
+    config_set_addr(guest->config, "linux_pid", LINUX_PID);
+    config_set_addr(guest->config, "linux_name", LINUX_NAME);
+    config_set_addr(guest->config, "linux_pgd", LINUX_PGD);
+
+    return VMI_SUCCESS;
+}
+
+/* An ntoskrnl.exe PE header and export directory exporting the symbols */
+static void
+guest_write_exports(
+    guest_t *guest,
+    image_t *image)
+{
+    uint8_t *base = image_ptr(image, KERNEL_PA);
+    struct dos_header *dos = (struct dos_header *) base;
+    struct pe_header *pe = (struct pe_header *) (base + 0x80);
+    struct optional_header_pe32plus *oh = (struct optional_header_pe32plus *) (pe + 1);
+    struct export_table *et = (struct export_table *) (base + KERNEL_EXPORTS);
+    uint32_t *functions = (uint32_t *) (et + 1);
+    uint32_t *names = functions + guest->symbols;
+    uint16_t *ordinals = (uint16_t *) (names + guest->symbols);
+    char *strings = (char *) (ordinals + guest->symbols);
+    unsigned int i;
+
+    dos->signature = IMAGE_DOS_HEADER;
+    dos->offset_to_pe = 0x80;
+
+    pe->signature = IMAGE_NT_SIGNATURE;
+    pe->machine = 0x8664;
+    pe->size_of_optional_header = sizeof(*oh);
+    pe->characteristics = 0x22;
+
+    oh->magic = IMAGE_PE32_PLUS_MAGIC;
+    oh->image_base = guest->kernel_va;
+    oh->section_alignment = VMI_PS_4KB;
+    oh->file_alignment = 0x200;
+    oh->size_of_image = KERNEL_SIZE;
+    oh->size_of_headers = VMI_PS_4KB;
+    oh->number_of_rva_and_sizes = 16;
+
+    et->base = 1;
+    et->number_of_functions = guest->symbols;
+    et->number_of_names = guest->symbols;
+    et->address_of_functions = (uint8_t *) functions - base;
+    et->address_of_names = (uint8_t *) names - base;
+    et->address_of_name_ordinals = (uint8_t *) ordinals - base;
+
+    for (i = 0; i < guest->symbols; i++) {
+        functions[i] = guest->symbol_base + i * guest->symbol_stride - guest->kernel_va;
+        ordinals[i] = i;
+        names[i] = (uint8_t *) strings - base;
+        guest_symbol(guest, i, strings, 32);
+        strings += strlen(strings) + 1;
+    }
+
+    et->name = (uint8_t *) strings - base;
+    strcpy(strings, "ntoskrnl.exe");
+    strings += strlen(strings) + 1;
+
+    oh->idd[IMAGE_DIRECTORY_ENTRY_EXPORT].virtual_address = KERNEL_EXPORTS;
+    oh->idd[IMAGE_DIRECTORY_ENTRY_EXPORT].size = (uint8_t *) strings - (uint8_t *) et;
+}
+
+static status_t
+guest_build_windows(
+    guest_t *guest,
+    image_t *image)
+{
+    addr_t kdbg = KERNEL_PA + KERNEL_KDBG;
+    addr_t head_pa = KERNEL_PA + KERNEL_PROCESS_HEAD, head_va = guest->kernel_va + KERNEL_PROCESS_HEAD;
+    addr_t prev_pa = head_pa, prev_va = head_va;
+    addr_t eprocess, root;
+    uint16_t kdbg_size = KDBG_WINDOWS_7;
+    vmi_pid_t pid;
+    unsigned int i;
+
+    guest_write_exports(guest, image);
+
+    memcpy(image_ptr(image, kdbg + KDBG_OWNER_TAG), "KDBG", 4);
+    memcpy(image_ptr(image, kdbg + KDBG_SIZE), &kdbg_size, sizeof(kdbg_size));
+    image_write_addr(image, kdbg + KDBG_KERNBASE, guest->kernel_va);
+    image_write_addr(image, kdbg + KDBG_PROCESS_HEAD, head_va);
+
+    for (i = 0; i < guest->processes; i++) {
+        eprocess = image_alloc(image, VMI_PS_4KB);
+        /* the System process runs on the kernel page tables */
+        root = i ? guest_new_process_root(guest, image) : guest->kpgd;
+        if (!eprocess || !root)
+            return VMI_FAILURE;
+
+        pid = guest_pid(guest, i);
+        memcpy(image_ptr(image, eprocess + WIN_PID), &pid, sizeof(pid));
+        image_write_addr(image, eprocess + WIN_PDBASE, root);
+        if (i)
+            snprintf(image_ptr(image, eprocess + WIN_PNAME), 15, "bench-%u.exe", i);
+        else
+            strcpy(image_ptr(image, eprocess + WIN_PNAME), "System");
+
+        guest_list_append(image, &prev_pa, &prev_va, eprocess + WIN_TASKS, guest_va(guest, eprocess + WIN_TASKS));
+    }
+
+    guest_list_append(image, &prev_pa, &prev_va, head_pa, head_va);
+
+    guest->exports = guest->kernel_va;
+
+    guest->config = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+    g_hash_table_insert(guest->config, "ostype", g_strdup("Windows"));
+    config_set_addr(guest->config, "win_ntoskrnl", KERNEL_PA);
+    config_set_addr(guest->config, "win_kdvb", guest->kernel_va + KERNEL_KDBG);
+    config_set_addr(guest->config, "win_kdbg", KERNEL_KDBG);
+    config_set_addr(guest->config, "win_tasks", WIN_TASKS);
+    config_set_addr(guest->config, "win_pdbase", WIN_PDBASE);
+    config_set_addr(guest->config, "win_pid", WIN_PID);
+    config_set_addr(guest->config, "win_pname", WIN_PNAME);
+    config_set_addr(guest->config, "kpgd", guest->kpgd);
+
+    return VMI_SUCCESS;
+}
+
+/* Scattered over the upper half, one per slot */
+static void
+guest_write_scan_hits(
+    guest_t *guest,
+    image_t *image,
+    uint64_t *seed)
+{
+    size_t len = strlen(GUEST_SCAN_PATTERN);
+    size_t start = guest->memory_size / 2;
+    size_t slot = (guest->memory_size - start) / guest->scan_hits;
+    unsigned int i;
+
+    for (i = 0; i < guest->scan_hits; i++)
+        memcpy(image_ptr(image, start + i * slot + image_random(seed) % (slot - len)),
+               GUEST_SCAN_PATTERN, len);
+}
+
+guest_t *
+guest_new(
+    const char *name,
+    const char *dir,
+    size_t memory_size,
+    uint64_t seed)
+{
+    const layout_t *layout = NULL;
+    guest_t *guest;
+    image_t *image;
+    status_t status = VMI_FAILURE;
+    unsigned int i;
+
+    for (i = 0; i < G_N_ELEMENTS(layouts); i++) {
+        if (!strcmp(name, layouts[i].name))
+            layout = &layouts[i];
+    }
+
+    if (!layout || memory_size % VMI_PS_2MB || memory_size < MEMORY_MIN)
+        return NULL;
+
+    /* the direct map of 32-bit Linux ends at 896MB */
+    if (VMI_PM_PAE == layout->pm && memory_size > (896ull << 20))
+        return NULL;
+
+    guest = g_malloc0(sizeof(guest_t));
+    guest->name = layout->name;
+    guest->os = layout->os;
+    guest->pm = layout->pm;
+    guest->memory_size = memory_size;
+    guest->image_path = g_strdup_printf("%s/%s.raw", dir, name);
+    guest->kernel_va = layout->kernel_va;
+    guest->kernel_pa = KERNEL_PA;
+    guest->kernel_size = KERNEL_SIZE;
+    guest->direct_map = layout->direct_map;
+    guest->scan_hits = SCAN_HITS;
+
+    if (VMI_OS_UNKNOWN != layout->os) {
+        guest->symbols = SYMBOLS;
+        guest->symbol_base = layout->kernel_va + KERNEL_SYMBOLS;
+        guest->symbol_stride = SYMBOL_STRIDE;
+        guest->processes = PROCESSES;
+    }
+
+    image = image_new(memory_size, layout->pm, KERNEL_PA, memory_size / 2, seed);
+    if (!image)
+        goto done;
+
+    /* first allocation, so it lands at KERNEL_PA */
+    if (KERNEL_PA != image_alloc(image, KERNEL_SIZE))
+        goto done;
+
+    guest->kpgd = KERNEL_PA + KERNEL_PGT;
+    if (VMI_FAILURE == guest_map_kernel(guest, image))
+        goto done;
+
+    switch (layout->os) {
+        case VMI_OS_LINUX:
+            status = guest_build_linux(guest, image);
+            break;
+        case VMI_OS_WINDOWS:
+            status = guest_build_windows(guest, image);
+            break;
+        default:
+            status = VMI_SUCCESS;
+            break;
+    }
+
+    if (VMI_FAILURE == status)
+        goto done;
+
+    guest_write_scan_hits(guest, image, &seed);
+    status = image_save(image, guest->image_path);
+
+done:
+    image_free(image);
+
+    if (VMI_FAILURE == status) {
+        fprintf(stderr, "Failed to build guest %s\n", name);
+        guest_free(guest);
+        return NULL;
+    }
+
+    return guest;
+}
+
+status_t
+guest_write_description(
+    guest_t *guest,
+    uint64_t latency,
+    uint64_t jitter,
+    uint64_t seed)
+{
+    status_t ret = VMI_SUCCESS;
+    FILE *f;
+
+    g_free(guest->description_path);
+    guest->description_path = g_strdup_printf("%s.mem", guest->image_path);
+
+    f = fopen(guest->description_path, "w");
+    if (!f)
+        return VMI_FAILURE;
+
+    fprintf(f, "[memory]\nimage=%s\n\n", guest->image_path);
+    fprintf(f, "[latency]\nnsec=%"PRIu64"\njitter=%"PRIu64"\nseed=%"PRIu64"\n\n", latency, jitter, seed);
+    fprintf(f, "[vcpu0]\n");
+
+    switch (guest->pm) {
+        case VMI_PM_IA32E:
+            /* PG, PAE and PSE, LME */
+            fprintf(f, "cr0=0x80050033\ncr4=0x6f0\nmsr_efer=0xd01\ncr3=0x%"PRIx64"\n", guest->kpgd);
+            break;
+        case VMI_PM_PAE:
+            fprintf(f, "cr0=0x80050033\ncr4=0x6b0\nmsr_efer=0\ncr3=0x%"PRIx64"\n", guest->kpgd);
+            break;
+        case VMI_PM_AARCH64:
+            /* EL1h, 48-bit VAs with 4KB granules in both halves */
+            fprintf(f, "cpsr=0x3c5\ntcr_el1=0x%x\nttbr0=0x%"PRIx64"\nttbr1=0x%"PRIx64"\n",
+                    16 | 16 << 16 | 2u << 30, guest->kpgd, guest->kpgd);
+            break;
+        default:
+            ret = VMI_FAILURE;
+            break;
+    }
+
+    if (ferror(f))
+        ret = VMI_FAILURE;
+
+    if (fclose(f))
+        ret = VMI_FAILURE;
+
+    return ret;
+}
+
+void
+guest_free(
+    guest_t *guest)
+{
+    if (!guest)
+        return;
+
+    if (guest->image_path)
+        unlink(guest->image_path);
+    if (guest->sysmap_path)
+        unlink(guest->sysmap_path);
+    if (guest->description_path)
+        unlink(guest->description_path);
+    if (guest->config)
+        g_hash_table_destroy(guest->config);
+
+    g_free(guest->image_path);
+    g_free(guest->sysmap_path);
+    g_free(guest->description_path);
+    g_free(guest);
+}
@@ -0,0 +1,95 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCHMARK_GUEST_H
+#define BENCHMARK_GUEST_H
+
+#include <glib.h>
+#include <libvmi/libvmi.h>
+
+#define GUEST_SCAN_PATTERN  "LibVMI benchmark"
+
+/*
+ * A synthetic guest written to disk: the memory image and whatever the
+ * LibVMI configuration needs to find its way around it.
+ */
+typedef struct guest {
+    const char *name;           /**< scenario name */
+    os_t os;                /**< VMI_OS_UNKNOWN if there is no OS to initialize */
+    page_mode_t pm;
+    size_t memory_size;         /**< bytes of guest physical memory */
+    char *image_path;
+    char *sysmap_path;          /**< Linux only */
+    char *description_path;     /**< for the mem driver, see guest_write_description */
+    GHashTable *config;         /**< for VMI_CONFIG_GHASHTABLE, owns its values, NULL if none */
+
+    addr_t kpgd;                /**< kernel page table root */
+
+    addr_t kernel_va;           /**< kernel image, mapped with 4KB pages */
+    addr_t kernel_pa;
+    size_t kernel_size;
+    addr_t direct_map;          /**< VA of physical address 0, maps all memory */
+    addr_t exports;             /**< VA of the PE image exporting the symbols, 0 if none */
+
+    unsigned int symbols;       /**< symbols to look up, see guest_symbol */
+    addr_t symbol_base;         /**< VA of the first symbol */
+    addr_t symbol_stride;       /**< distance between two symbols */
+
+    unsigned int processes;     /**< length of the process list */
+    unsigned int scan_hits;     /**< copies of GUEST_SCAN_PATTERN in memory */
+} guest_t;
+
+/* Names of the guests guest_new knows, NULL terminated */
+extern const char *guest_names[];
+
+/* Builds the named guest in the directory dir */
+guest_t *guest_new(
+    const char *name,
+    const char *dir,
+    size_t memory_size,
+    uint64_t seed);
+
+/*
+ * Writes the guest description the mem driver opens: the image, the vCPU
+ * registers of the guest's paging mode and the latency of every call.
+ */
+status_t guest_write_description(
+    guest_t *guest,
+    uint64_t latency,
+    uint64_t jitter,
+    uint64_t seed);
+
+/* Removes the files of the guest too */
+void guest_free(
+    guest_t *guest);
+
+/* Name of the i-th symbol */
+void guest_symbol(
+    guest_t *guest,
+    unsigned int i,
+    char *buf,
+    size_t len);
+
+/* PID of the i-th process of the process list */
+vmi_pid_t guest_pid(
+    guest_t *guest,
+    unsigned int i);
+
+#endif /* BENCHMARK_GUEST_H */
@@ -0,0 +1,341 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image.h"
+
+#define PAGE_SIZE       4096ull
+#define ENTRY_ADDR_MASK 0x000ffffffffff000ull
+
+#define X86_PRESENT     (1ull << 0)
+#define X86_RW          (1ull << 1)
+#define X86_USER        (1ull << 2)
+#define X86_PS          (1ull << 7)
+
+#define ARM_VALID       (1ull << 0)
+#define ARM_TABLE       (1ull << 1)     /**< table or page, clear for blocks */
+#define ARM_AP_EL0      (1ull << 6)
+#define ARM_AF          (1ull << 10)
+
+/* Layout of the paging structures, top level first */
+typedef struct paging {
+    unsigned int levels;
+    unsigned int shift[4];      /**< lowest VA bit indexing the level */
+    unsigned int bits[4];       /**< VA bits indexing the level */
+    unsigned int kernel_first;  /**< first top-level entry of the kernel half */
+    unsigned int root_entries;
+} paging_t;
+
+static const paging_t paging_ia32e = {
+    .levels = 4,
+    .shift = { 39, 30, 21, 12 },
+    .bits = { 9, 9, 9, 9 },
+    .kernel_first = 256,
+    .root_entries = 512,
+};
+
+/* Linux' 3G/1G split, the PDPT entry of the top gigabyte is the kernel's */
+static const paging_t paging_pae = {
+    .levels = 3,
+    .shift = { 30, 21, 12 },
+    .bits = { 2, 9, 9 },
+    .kernel_first = 3,
+    .root_entries = 4,
+};
+
+/* 4KB granule, 48-bit VAs; the kernel half lives in its own TTBR1 table */
+static const paging_t paging_aarch64 = {
+    .levels = 4,
+    .shift = { 39, 30, 21, 12 },
+    .bits = { 9, 9, 9, 9 },
+    .kernel_first = 256,
+    .root_entries = 512,
+};
+
+static const paging_t *
+image_paging(
+    image_t *image)
+{
+    switch (image->pm) {
+        case VMI_PM_PAE:
+            return &paging_pae;
+        case VMI_PM_AARCH64:
+            return &paging_aarch64;
+        default:
+            return &paging_ia32e;
+    }
+}
+
+uint64_t
+image_random(
+    uint64_t *state)
+{
+    uint64_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+
+    return *state = x;
+}
+
+image_t *
+image_new(
+    size_t size,
+    page_mode_t pm,
+    addr_t brk,
+    addr_t limit,
+    uint64_t seed)
+{
+    image_t *image;
+    uint64_t *mem;
+    size_t i;
+
+    if (VMI_PM_IA32E != pm && VMI_PM_PAE != pm && VMI_PM_AARCH64 != pm)
+        return NULL;
+
+    image = calloc(1, sizeof(image_t));
+    if (!image)
+        return NULL;
+
+    image->mem = malloc(size);
+    if (!image->mem) {
+        free(image);
+        return NULL;
+    }
+
+    /* whatever is not a guest structure is noise to the scans */
+    mem = (uint64_t *) image->mem;
+    for (i = 0; i < size / sizeof(uint64_t); i++)
+        mem[i] = image_random(&seed);
+
+    image->size = size;
+    image->pm = pm;
+    image->brk = brk;
+    image->limit = limit < size ? limit : size;
+
+    return image;
+}
+
+void
+image_free(
+    image_t *image)
+{
+    if (!image)
+        return;
+
+    free(image->mem);
+    free(image);
+}
+
+addr_t
+image_alloc(
+    image_t *image,
+    size_t len)
+{
+    addr_t pa = image->brk;
+
+    len = (len + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (!len || pa + len > image->limit)
+        return 0;
+
+    memset(image->mem + pa, 0, len);
+    image->brk += len;
+
+    return pa;
+}
+
+void *
+image_ptr(
+    image_t *image,
+    addr_t pa)
+{
+    return pa < image->size ? image->mem + pa : NULL;
+}
+
+unsigned int
+image_width(
+    image_t *image)
+{
+    return VMI_PM_PAE == image->pm ? 4 : 8;
+}
+
+void
+image_write_addr(
+    image_t *image,
+    addr_t pa,
+    addr_t value)
+{
+    memcpy(image->mem + pa, &value, image_width(image));
+}
+
+addr_t
+image_new_root(
+    image_t *image)
+{
+    return image_alloc(image, PAGE_SIZE);
+}
+
+/* Entry pointing at the next level, or mapping pa if it is the last one */
+static uint64_t
+image_entry(
+    image_t *image,
+    unsigned int level,
+    bool leaf,
+    bool user,
+    addr_t pa)
+{
+    const paging_t *paging = image_paging(image);
+    uint64_t entry = pa;
+
+    if (VMI_PM_AARCH64 == image->pm) {
+        if (!leaf)
+            return entry | ARM_VALID | ARM_TABLE;
+
+        entry |= ARM_VALID | ARM_AF | (user ? ARM_AP_EL0 : 0);
+        /* last-level entries are pages, blocks above */
+        return level + 1 < paging->levels ? entry : entry | ARM_TABLE;
+    }
+
+    /* RW and US are reserved in PAE PDPT entries */
+    if (VMI_PM_PAE == image->pm && !level)
+        return entry | X86_PRESENT;
+
+    entry |= X86_PRESENT | X86_RW | (user ? X86_USER : 0);
+    if (leaf && level + 1 < paging->levels)
+        entry |= X86_PS;
+
+    return entry;
+}
+
+/* Whether the entry points at a table of the next level */
+static bool
+image_entry_is_table(
+    image_t *image,
+    unsigned int level,
+    uint64_t entry)
+{
+    if (VMI_PM_AARCH64 == image->pm)
+        return (entry & (ARM_VALID | ARM_TABLE)) == (ARM_VALID | ARM_TABLE);
+
+    if (VMI_PM_PAE == image->pm && !level)
+        return entry & X86_PRESENT;
+
+    return (entry & (X86_PRESENT | X86_PS)) == X86_PRESENT;
+}
+
+static status_t
+image_map_page(
+    image_t *image,
+    addr_t root,
+    addr_t va,
+    addr_t pa,
+    page_size_t ps)
+{
+    const paging_t *paging = image_paging(image);
+    addr_t table = root, next;
+    uint64_t *entry;
+    unsigned int level, index;
+    bool user;
+
+    user = ((va >> paging->shift[0]) & ((1ull << paging->bits[0]) - 1)) < paging->kernel_first;
+
+    for (level = 0; level < paging->levels; level++) {
+        index = (va >> paging->shift[level]) & ((1ull << paging->bits[level]) - 1);
+        entry = (uint64_t *) image_ptr(image, table + index * sizeof(uint64_t));
+
+        if ((1ull << paging->shift[level]) == ps) {
+            *entry = image_entry(image, level, true, user, pa);
+            return VMI_SUCCESS;
+        }
+
+        if (!*entry) {
+            next = image_alloc(image, PAGE_SIZE);
+            if (!next)
+                return VMI_FAILURE;
+
+            *entry = image_entry(image, level, false, user, next);
+        } else if (!image_entry_is_table(image, level, *entry))
+            return VMI_FAILURE;
+
+        table = *entry & ENTRY_ADDR_MASK;
+    }
+
+    /* no such page size */
+    return VMI_FAILURE;
+}
+
+status_t
+image_map(
+    image_t *image,
+    addr_t root,
+    addr_t va,
+    addr_t pa,
+    size_t len,
+    page_size_t ps)
+{
+    size_t offset;
+
+    if ((va | pa | len) & (ps - 1) || pa + len > image->size)
+        return VMI_FAILURE;
+
+    for (offset = 0; offset < len; offset += ps) {
+        if (VMI_FAILURE == image_map_page(image, root, va + offset, pa + offset, ps))
+            return VMI_FAILURE;
+    }
+
+    return VMI_SUCCESS;
+}
+
+void
+image_share_kernel(
+    image_t *image,
+    addr_t from,
+    addr_t to)
+{
+    const paging_t *paging = image_paging(image);
+    size_t start = paging->kernel_first * sizeof(uint64_t);
+
+    memcpy(image->mem + to + start, image->mem + from + start,
+           (paging->root_entries - paging->kernel_first) * sizeof(uint64_t));
+}
+
+status_t
+image_save(
+    image_t *image,
+    const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    status_t ret = VMI_SUCCESS;
+
+    if (!f)
+        return VMI_FAILURE;
+
+    if (fwrite(image->mem, 1, image->size, f) != image->size)
+        ret = VMI_FAILURE;
+
+    if (fclose(f))
+        ret = VMI_FAILURE;
+
+    return ret;
+}
@@ -0,0 +1,97 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCHMARK_IMAGE_H
+#define BENCHMARK_IMAGE_H
+
+#include <libvmi/libvmi.h>
+
+/*
+ * A synthetic guest: physical memory filled with pseudo-random bytes, in
+ * which the guest structures are laid out with a bump allocator and mapped
+ * with real page tables of the image's paging mode.
+ */
+typedef struct image {
+    uint8_t *mem;       /**< guest physical memory */
+    size_t size;        /**< bytes of guest physical memory */
+    page_mode_t pm;     /**< VMI_PM_IA32E, VMI_PM_PAE or VMI_PM_AARCH64 */
+    addr_t brk;         /**< next free physical address */
+    addr_t limit;       /**< end of the allocation area */
+} image_t;
+
+/* Deterministic xorshift64, the same seed builds the same image */
+uint64_t image_random(
+    uint64_t *state);
+
+image_t *image_new(
+    size_t size,
+    page_mode_t pm,
+    addr_t brk,
+    addr_t limit,
+    uint64_t seed);
+
+void image_free(
+    image_t *image);
+
+/* Zeroed, page aligned; returns 0 once the allocation area is used up */
+addr_t image_alloc(
+    image_t *image,
+    size_t len);
+
+void *image_ptr(
+    image_t *image,
+    addr_t pa);
+
+/* Guest pointer width of the paging mode */
+unsigned int image_width(
+    image_t *image);
+
+void image_write_addr(
+    image_t *image,
+    addr_t pa,
+    addr_t value);
+
+/* A new top-level paging structure */
+addr_t image_new_root(
+    image_t *image);
+
+/* Maps [va, va + len) to [pa, pa + len) with pages of size ps */
+status_t image_map(
+    image_t *image,
+    addr_t root,
+    addr_t va,
+    addr_t pa,
+    size_t len,
+    page_size_t ps);
+
+/*
+ * Copies the kernel half of the address space of 'from' into 'to'. Not
+ * needed on AArch64, where the kernel half has a root of its own (TTBR1).
+ */
+void image_share_kernel(
+    image_t *image,
+    addr_t from,
+    addr_t to);
+
+status_t image_save(
+    image_t *image,
+    const char *path);
+
+#endif /* BENCHMARK_IMAGE_H */
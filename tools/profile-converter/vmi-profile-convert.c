@@ -0,0 +1,51 @@
+/* The LibVMI Library is an introspection library that simplifies access to
+ * memory in a target virtual machine or in a file containing a dump of
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Converts Rekall profiles and Volatility ISTs into LibVMI's binary profile
+ * format. The binary profile can be used in the configuration in place of
+ * the JSON profile:
+ *
+ *   vmi-profile-convert ntkrnlmp.json ntkrnlmp.vmiprof
+ */
+
+#define LIBVMI_EXTRA_JSON
+
+#include <stdio.h>
+#include <libvmi/libvmi.h>
+#include <libvmi/libvmi_extra.h>
+
+int
+main(
+    int argc,
+    char **argv)
+{
+    if ( argc != 3 ) {
+        fprintf(stderr, "Usage: %s <JSON profile> <binary profile>\n", argv[0]);
+        return 1;
+    }
+
+    if ( VMI_FAILURE == vmi_convert_json_profile(argv[1], argv[2]) ) {
+        fprintf(stderr, "Failed to convert %s\n", argv[1]);
+        return 1;
+    }
+
+    return 0;
+}